@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Linear allocator over one fixed block. Allocations are released together
+ * by resetting to an earlier mark, running past the end exits instead of
+ * growing so every caller is bounds checked.
+ */
+struct Arena {
+    const char *name;
+    uint8_t *base;
+    size_t capacity;
+    size_t offset;
+    // Largest offset reached since creation
+    size_t high_water;
+};
+
+#define ALLOCATE_ARRAY(arena, type, count) \
+    ((type *)allocate_array(arena, count, sizeof(type), _Alignof(type)))
+
+// arena should be cleaned up by destroy_arena()
+void create_arena(const char *name, size_t capacity, struct Arena *arena);
+
+// Exits when the arena is out of space, alignment must be a power of two
+void *allocate_arena(struct Arena *arena, size_t size, size_t alignment);
+
+// Same as allocate_arena() but also exits when count * size overflows
+void *allocate_array(struct Arena *arena, size_t count, size_t size, size_t alignment);
+
+/*
+ * Heap arrays that outlive any arena: reallocates data, capacity elements of
+ * size bytes, to hold at least needed, doubling from 1024
+ */
+void *grow_array(void *data, uint32_t *capacity, uint32_t needed, size_t size);
+
+size_t get_arena_mark(const struct Arena *arena);
+
+// Releases everything allocated after mark was taken
+void reset_arena(struct Arena *arena, size_t mark);
+
+void print_arena_usage(const struct Arena *arena);
+
+void destroy_arena(struct Arena *arena);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Layouts of the blob entries lindmar_cook writes next to textures. They are
+ * read in place from the pack, so fields are explicitly sized and padded.
+ */
+#define ATLAS_NAME_MAX 32u
+
+// "atlas/<name>/rects" holds one per packed image, in pixels of "atlas/<name>"
+struct AtlasRect {
+    char name[ATLAS_NAME_MAX];
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+};
+
+// "font/<name>/glyphs" starts with a FontInfo followed by glyph_count Glyphs
+struct FontInfo {
+    uint32_t glyph_count;
+    // Distance in pixels that maps to the full 0-255 range of "font/<name>"
+    float spread;
+    uint16_t line_height;
+    uint16_t padding;
+};
+
+struct Glyph {
+    uint32_t codepoint;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t advance;
+    uint16_t padding;
+};
+
+// "tilemap/<name>" starts with a TilemapHeader followed by width * height tiles row by row
+struct TilemapHeader {
+    uint32_t width;
+    uint32_t height;
+};
+
+#define TILEMAP_EMPTY 0xffffu
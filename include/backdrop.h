@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "pack.h"
+#include "record.h"
+#include "upload.h"
+#include "virtual.h"
+
+// Edge of the largest level kept resident before the view asks for more
+#define BACKDROP_RESIDENT_SIZE 512u
+
+// Matches the push constant block of backdrop.vert
+struct BackdropConstants {
+    float offset[2];
+    float scale[2];
+};
+
+/*
+ * A pack texture filling the framebuffer behind the scene. The view pans and
+ * zooms over it, and the detail levels it needs are streamed in as the zoom
+ * asks for them, or the pages it needs when it is a virtual texture.
+ */
+struct Backdrop {
+    VkDevice device;
+    const struct PackEntry *entry;
+    // Unused when virtual_texture is not NULL
+    struct StreamedTexture streamed;
+    // Not owned, sampled through virtual.glsl instead of streamed
+    struct VirtualTexture *virtual_texture;
+    // Frames still drawn after a view change so its feedback is read
+    uint32_t settle_frames;
+    VkSampler sampler;
+    VkDescriptorPool pool;
+    VkDescriptorSet sets[FRAMES_IN_FLIGHT];
+    // Bit i is set while sets[i] references a replaced texture
+    uint32_t stale_sets;
+    // Texture coordinates at the center of the framebuffer
+    float center[2];
+    // Magnification over the zoom at which the texture just covers the framebuffer
+    float zoom;
+};
+
+/*
+ * set_layout is the layout of set 0 of the backdrop shaders. backdrop should
+ * be cleaned up by destroy_backdrop()
+ */
+void create_backdrop(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, VkDescriptorSetLayout set_layout, struct Backdrop *backdrop);
+
+/*
+ * Draws texture, which has to outlive the backdrop. set_layout is the layout
+ * of set 0 of the backdrop shaders built with backdrop_virtual.frag.
+ * backdrop should be cleaned up by destroy_backdrop()
+ */
+void create_virtual_backdrop(struct VirtualTexture *texture, VkDescriptorSetLayout set_layout,
+    struct Backdrop *backdrop);
+
+// Returns true when the view changed, zoom is clamped to at least 1
+int set_backdrop_view(struct Backdrop *backdrop, float x, float y, float zoom);
+
+/*
+ * Call once per frame after the frame's fence has been waited on. Streams the
+ * detail the view needs and returns true when what the backdrop shows changed
+ * or is about to.
+ */
+int update_backdrop(struct Backdrop *backdrop, struct Uploader *uploader,
+    const struct AssetPack *pack, VkExtent2D extent, uint32_t frame);
+
+// Binds the frame's descriptor set and draws, the backdrop pipeline has to be bound
+void record_backdrop(const struct Backdrop *backdrop, VkCommandBuffer buffer,
+    VkPipelineLayout layout, VkExtent2D extent, uint32_t frame);
+
+void destroy_backdrop(struct Uploader *uploader, struct Backdrop *backdrop);
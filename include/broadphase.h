@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "jobs.h"
+
+// Pair jobs per worker, more than one so uneven cells balance out
+#define BROADPHASE_JOBS_PER_WORKER 4u
+
+struct Aabb {
+    float min_x;
+    float min_y;
+    float max_x;
+    float max_y;
+};
+
+// Indices of two overlapping boxes, a < b
+struct BroadphasePair {
+    uint32_t a;
+    uint32_t b;
+};
+
+// Cells a box covered when its entries were last built
+struct CellRect {
+    int32_t min_x;
+    int32_t min_y;
+    int32_t max_x;
+    int32_t max_y;
+};
+
+// One box in one cell, entries are kept sorted by key
+struct CellEntry {
+    uint32_t key;
+    uint32_t box;
+};
+
+struct PairBuffer {
+    uint32_t count;
+    uint32_t capacity;
+    struct BroadphasePair *pairs;
+};
+
+// Cells [first_cell, end_cell) searched by one pair job, with the job's own output
+struct BroadphaseJob {
+    uint32_t first_cell;
+    uint32_t end_cell;
+    struct PairBuffer pairs;
+    // Boxes of the cell being tested gathered as structure of arrays
+    uint32_t scratch_capacity;
+    float *scratch;
+    uint32_t *scratch_boxes;
+};
+
+/*
+ * Uniform grid spatial hash. Cell coordinates wrap at 65536 into a 32 bit
+ * key, so the world is unbounded and far apart boxes sharing a key only cost
+ * a rejected test. Cells are runs of a flat array sorted by key, rebuilt
+ * incrementally: only boxes that changed cells are re-sorted and merged back.
+ */
+struct Broadphase {
+    float cell_size;
+    float inverse_cell_size;
+    uint32_t box_count;
+    uint32_t box_capacity;
+    // Boxes of the last update as structure of arrays for SIMD tests
+    float *min_x;
+    float *min_y;
+    float *max_x;
+    float *max_y;
+    struct CellRect *rects;
+    uint8_t *moved;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    struct CellEntry *entries;
+    struct CellEntry *scratch;
+    struct CellEntry *moved_entries;
+    // Start of every cell's run in entries, the last element is entry_count
+    uint32_t cell_count;
+    uint32_t *cell_starts;
+    // Boxes whose cells changed in the last update
+    uint32_t moved_count;
+    uint32_t job_count;
+    struct BroadphaseJob jobs[(JOB_MAX_WORKERS + 1) * BROADPHASE_JOBS_PER_WORKER];
+    // Compact output of the last find_broadphase_pairs()
+    struct PairBuffer pairs;
+    struct JobPool *pool;
+};
+
+/*
+ * cell_size should be about the size of the larger boxes, pool may be NULL
+ * to find pairs on the calling thread. broadphase should be cleaned up by
+ * destroy_broadphase()
+ */
+void create_broadphase(float cell_size, struct JobPool *pool, struct Broadphase *broadphase);
+
+// Box i keeps its index between updates, boxes past count are dropped
+void update_broadphase(struct Broadphase *broadphase, const struct Aabb *boxes, uint32_t count);
+
+// Fills broadphase->pairs with every overlapping pair, each pair exactly once
+void find_broadphase_pairs(struct Broadphase *broadphase);
+
+void destroy_broadphase(struct Broadphase *broadphase);
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "timer.h"
+
+// At most FRAMES_IN_FLIGHT, the timers keep a query slot per compute frame
+#define COMPUTE_FRAME_COUNT 2u
+// At most GPU_TIMER_MAX_SCOPES, every pass is timed under its name
+#define COMPUTE_MAX_PASSES 16u
+#define COMPUTE_MAX_BUFFERS 8u
+
+enum ComputeQueue {
+    COMPUTE_QUEUE_GRAPHICS,
+    // Falls back to COMPUTE_QUEUE_GRAPHICS without a dedicated compute family
+    COMPUTE_QUEUE_ASYNC
+};
+
+typedef void (*ComputeRecordFunc)(VkCommandBuffer buffer, void *user_data);
+
+struct ComputePass {
+    // Also the name the pass is timed under, must outlive the scheduler
+    const char *name;
+    enum ComputeQueue queue;
+    ComputeRecordFunc record;
+    void *user_data;
+    /*
+     * Buffers written by the pass and read by graphics work, ownership moves
+     * to the graphics family when the pass runs on the async queue. Passes
+     * writing different buffers every frame update them with
+     * set_compute_pass_buffers().
+     */
+    uint32_t buffer_count;
+    VkBuffer buffers[COMPUTE_MAX_BUFFERS];
+    VkPipelineStageFlags dst_stage;
+    VkAccessFlags dst_access;
+};
+
+struct ComputeFrame {
+    VkCommandBuffer async_buffer;
+    VkCommandBuffer graphics_buffer;
+    VkFence async_fence;
+    VkFence graphics_fence;
+    VkSemaphore compute_done;
+    VkSemaphore graphics_done;
+};
+
+struct ComputeScheduler {
+    VkDevice device;
+    VkQueue graphics_queue;
+    VkQueue async_queue;
+    uint32_t graphics_family;
+    uint32_t async_family;
+    // False when async passes have to run on the graphics queue
+    int async;
+    VkCommandPool graphics_pool;
+    VkCommandPool async_pool;
+    // Each queue's passes are timed in its own query pool
+    struct GpuTimers graphics_timers;
+    struct GpuTimers async_timers;
+    uint32_t frame;
+    struct ComputeFrame frames[COMPUTE_FRAME_COUNT];
+    // The last graphics submission signalled graphics_done of this frame
+    int graphics_signaled;
+    uint32_t pass_count;
+    struct ComputePass passes[COMPUTE_MAX_PASSES];
+};
+
+/*
+ * Async work is only scheduled when async is true and the families differ.
+ * scheduler should be cleaned up by destroy_compute_scheduler()
+ */
+void create_compute_scheduler(VkDevice device, VkPhysicalDevice gpu, VkQueue graphics_queue,
+    uint32_t graphics_family, VkQueue compute_queue, uint32_t compute_family, int async,
+    struct ComputeScheduler *scheduler);
+
+// Returns the index of the added pass
+uint32_t add_compute_pass(struct ComputeScheduler *scheduler, const struct ComputePass *pass);
+
+// Replaces the buffers pass hands to graphics work, takes effect on the next submit
+void set_compute_pass_buffers(struct ComputeScheduler *scheduler, uint32_t pass,
+    uint32_t buffer_count, const VkBuffer *buffers);
+
+/*
+ * Records and submits every pass of the frame. Results are visible to graphics
+ * work submitted afterwards. The returned semaphore, if not VK_NULL_HANDLE,
+ * must be signalled by the next graphics submission so the following frame's
+ * async work does not overwrite buffers graphics still reads.
+ */
+VkSemaphore submit_compute(struct ComputeScheduler *scheduler);
+
+// Smoothed GPU seconds of the pass called name, 0 when it was never measured
+double get_compute_time(const struct ComputeScheduler *scheduler, const char *name);
+
+void destroy_compute_scheduler(struct ComputeScheduler *scheduler);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "memory.h"
+#include "record.h"
+
+// Sprites one workgroup of sprite_cull.comp culls and draws with one indirect draw
+#define CULL_GROUP_SIZE 256u
+#define CULL_BUFFER_COUNT 2u
+
+// Matches the push constant block of sprite_cull.comp
+struct CullConstants {
+    float extent[2];
+    uint32_t count;
+};
+
+struct CullFrame {
+    // Device local, each workgroup compacts its visible sprites into its own range
+    struct GpuBuffer visible;
+    // One VkDrawIndirectCommand per workgroup
+    struct GpuBuffer draws;
+    VkDescriptorSet set;
+    // Sprite instances set binds, rewritten when they are regrown
+    VkBuffer sprites;
+    uint32_t count;
+    VkExtent2D extent;
+};
+
+/*
+ * Culls sprite instances against the framebuffer on the GPU. The visible ones
+ * are drawn with one vkCmdDrawIndirect() of a draw per workgroup, which keeps
+ * them in their original order, so it needs the multiDrawIndirect and
+ * drawIndirectFirstInstance features.
+ */
+struct SpriteCuller {
+    VkDevice device;
+    VkPhysicalDevice gpu;
+    VkShaderModule module;
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    VkDescriptorPool pool;
+    // Workgroups a frame may cull, bounded by maxDrawIndirectCount
+    uint32_t max_groups;
+    struct CullFrame frames[FRAMES_IN_FLIGHT];
+};
+
+/*
+ * code is sprite_cull.comp SPIR-V. culler should be cleaned up by
+ * destroy_sprite_culler()
+ */
+void create_sprite_culler(VkDevice device, VkPhysicalDevice gpu, const uint32_t *code,
+    size_t code_size, struct SpriteCuller *culler);
+
+/*
+ * Culls count instances of sprites, a storage buffer, against extent on the
+ * frame's next record_sprite_culling(). Call once the frame's fence has been
+ * waited on. Returns false when there are too many to cull, the frame then
+ * has to draw sprites directly.
+ */
+int set_culled_sprites(struct SpriteCuller *culler, uint32_t frame,
+    const struct GpuBuffer *sprites, uint32_t count, VkExtent2D extent);
+
+// Buffers the frame's culling writes and the draw reads, returns their count
+uint32_t get_culled_buffers(const struct SpriteCuller *culler, uint32_t frame,
+    VkBuffer buffers[CULL_BUFFER_COUNT]);
+
+// Dispatches the frame's culling, outside a render pass
+void record_sprite_culling(const struct SpriteCuller *culler, VkCommandBuffer buffer,
+    uint32_t frame);
+
+// Binds the visible instances and draws them, the sprite pipeline has to be bound
+void record_culled_sprites(const struct SpriteCuller *culler, VkCommandBuffer buffer,
+    uint32_t frame);
+
+void destroy_sprite_culler(struct SpriteCuller *culler);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+// Rectangles a region keeps apart, more are merged into their closest neighbour
+#define DAMAGE_RECT_MAX 8u
+
+/*
+ * Part of the framebuffer that changed, as rectangles that never overlap so
+ * every pixel is covered once. Adding a rectangle merges it with every
+ * rectangle it overlaps into their bounding box, which may damage a little
+ * more than changed but never less.
+ */
+struct DamageRegion {
+    // The whole extent changed, rects are unused
+    int full;
+    uint32_t count;
+    VkRect2D rects[DAMAGE_RECT_MAX];
+};
+
+void clear_damage(struct DamageRegion *region);
+
+// rect is clipped to extent, an empty result adds nothing
+void add_damage(struct DamageRegion *region, const VkRect2D *rect, VkExtent2D extent);
+
+void add_full_damage(struct DamageRegion *region);
+
+// Adds every rectangle of src to dst
+void merge_damage(struct DamageRegion *dst, const struct DamageRegion *src, VkExtent2D extent);
+
+int is_damaged(const struct DamageRegion *region);
+
+// Smallest rectangle covering the region, extent when full
+VkRect2D get_damage_bounds(const struct DamageRegion *region, VkExtent2D extent);
+
+// Pixels covered, the region's rectangles are disjoint
+uint64_t get_damage_area(const struct DamageRegion *region, VkExtent2D extent);
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+// Messages buffered between two flushes, a power of two
+#define DEBUG_QUEUE_SIZE 256u
+#define DEBUG_MESSAGE_LENGTH 512u
+// Distinct message ids counted, a power of two
+#define DEBUG_ID_MAX 128u
+#define DEBUG_ID_NAME_LENGTH 64u
+
+/*
+ * Slot of the message queue. sequence tells producers and the consumer whose
+ * turn the slot is, see push_message() in debug.c.
+ */
+struct DebugMessage {
+    atomic_uint sequence;
+    int32_t id;
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+    VkDebugUtilsMessageTypeFlagsEXT type;
+    char text[DEBUG_MESSAGE_LENGTH];
+};
+
+// Occurrences of one message id, claimed by the first thread to see the id
+struct DebugIdCount {
+    // Message id plus one, 0 while the slot is free
+    atomic_llong key;
+    // Set once name is written
+    atomic_int ready;
+    char name[DEBUG_ID_NAME_LENGTH];
+    VkDebugUtilsMessageTypeFlagsEXT type;
+    atomic_uint frame_count;
+    // Owned by the flushing thread
+    uint32_t last_frame_count;
+    uint64_t total_count;
+};
+
+/*
+ * Receives validation and performance messages on whatever thread the driver
+ * raises them. The callback only classifies, counts and copies the message
+ * into a lock-free queue, printing happens in flush_debug_messenger().
+ * Performance warnings are counted per message id every frame and only the
+ * first one of each id is printed.
+ */
+struct DebugMessenger {
+    VkInstance instance;
+    VkDebugUtilsMessengerEXT messenger;
+    // Also deliver info and verbose messages
+    int verbose;
+    atomic_uint head;
+    uint32_t tail;
+    // Messages lost to a full queue since the last flush
+    atomic_uint dropped;
+    struct DebugMessage messages[DEBUG_QUEUE_SIZE];
+    struct DebugIdCount ids[DEBUG_ID_MAX];
+    // Of the last flush
+    uint32_t frame_performance_warnings;
+    uint64_t errors;
+    uint64_t warnings;
+};
+
+/*
+ * Loads the naming and label functions of VK_EXT_debug_utils, without this
+ * call they do nothing. Process wide like the Vulkan loader itself.
+ */
+void load_debug_functions(VkInstance instance);
+
+/*
+ * The instance needs VK_EXT_debug_utils. messenger should be cleaned up by
+ * destroy_debug_messenger()
+ */
+void create_debug_messenger(VkInstance instance, int verbose, struct DebugMessenger *messenger);
+
+// Call once per frame on one thread, prints queued messages and rolls the per frame counts
+void flush_debug_messenger(struct DebugMessenger *messenger);
+
+void destroy_debug_messenger(struct DebugMessenger *messenger);
+
+// Names handle for validation messages and GPU profilers, format is printf style
+void set_debug_name(VkDevice device, VkObjectType type, uint64_t handle, const char *format, ...);
+
+// Labels the commands until end_debug_label(), labels nest
+void begin_debug_label(VkCommandBuffer buffer, const char *name);
+
+void end_debug_label(VkCommandBuffer buffer);
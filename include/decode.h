@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/*
+ * CPU fallback for block compressed formats the device cannot sample.
+ * Decoded levels are RGBA8 in the matching sRGB or UNORM format.
+ */
+int can_decode_texture(VkFormat format);
+
+VkFormat get_decoded_format(VkFormat format);
+
+// src is one tightly packed level of format, rgba receives width * height texels
+void decode_texture_level(VkFormat format, uint32_t width, uint32_t height, const uint8_t *src,
+    uint8_t *rgba);
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jobs.h"
+
+#define ECS_MAX_COMPONENTS 64u
+#define ECS_MAX_ARCHETYPES 256u
+#define ECS_MAX_SYSTEMS 64u
+#define ECS_CHUNK_SIZE (16u * 1024u)
+// Columns start on cache lines so a chunk column can be loaded with aligned SIMD
+#define ECS_COLUMN_ALIGNMENT 64u
+// Chunks handed to a worker at a time
+#define ECS_JOB_CHUNKS 4u
+
+/*
+ * Entity ids are an index into the world's records in the low 32 bits and
+ * the generation of that record in the high 32 bits. Destroying an entity
+ * bumps the generation, so stale ids stop resolving once the index is reused.
+ */
+#define ECS_NULL_ENTITY 0ull
+#define ECS_ENTITY_INDEX(entity) ((uint32_t)(entity))
+#define ECS_ENTITY_GENERATION(entity) ((uint32_t)((entity) >> 32))
+#define ECS_COMPONENT_BIT(component) (1ull << (component))
+
+struct ComponentInfo {
+    const char *name;
+    uint32_t size;
+};
+
+/*
+ * ECS_CHUNK_SIZE block holding capacity entities of one archetype. The
+ * entity ids come first, then one column per component in the archetype's
+ * component order, each column a tightly packed array.
+ */
+struct Chunk {
+    uint8_t *data;
+    uint32_t count;
+};
+
+// Every entity with exactly the components of mask, packed into full chunks
+struct Archetype {
+    uint64_t mask;
+    uint32_t component_count;
+    uint32_t components[ECS_MAX_COMPONENTS];
+    // Byte offset of each component's column, indexed by component id
+    uint32_t offsets[ECS_MAX_COMPONENTS];
+    uint32_t capacity;
+    // Only the last chunk is ever partially filled
+    uint32_t chunk_count;
+    uint32_t chunk_capacity;
+    struct Chunk *chunks;
+};
+
+struct EntityRecord {
+    uint32_t generation;
+    // UINT32_MAX while the index is free or the entity's creation is still deferred
+    uint32_t archetype;
+    uint32_t chunk;
+    uint32_t row;
+};
+
+// The rows of one chunk a system runs over
+struct ChunkView {
+    const struct Archetype *archetype;
+    uint8_t *data;
+    uint32_t count;
+};
+
+struct World;
+
+// Runs on any worker thread, structural changes have to go through the deferred calls
+typedef void (*SystemFunc)(struct World *world, const struct ChunkView *view, void *user_data);
+
+/*
+ * Runs over every chunk holding all of reads and writes and none of
+ * excludes. Systems whose sets do not conflict run in parallel, conflicting
+ * ones run in the order they were added.
+ */
+struct System {
+    const char *name;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t excludes;
+    SystemFunc run;
+    void *user_data;
+};
+
+enum EcsCommandType {
+    ECS_COMMAND_CREATE,
+    ECS_COMMAND_DESTROY,
+    ECS_COMMAND_ADD,
+    ECS_COMMAND_REMOVE
+};
+
+struct EcsCommand {
+    enum EcsCommandType type;
+    uint32_t component;
+    uint64_t entity;
+    // Offset of the component data in World.command_data, ECS_COMMAND_ADD only
+    size_t data;
+};
+
+struct SystemJob {
+    uint32_t system;
+    uint32_t archetype;
+    uint32_t first_chunk;
+    uint32_t chunk_count;
+};
+
+struct World {
+    uint32_t component_count;
+    struct ComponentInfo components[ECS_MAX_COMPONENTS];
+    uint32_t archetype_count;
+    struct Archetype archetypes[ECS_MAX_ARCHETYPES];
+    uint32_t record_count;
+    uint32_t record_capacity;
+    struct EntityRecord *records;
+    uint32_t free_count;
+    uint32_t *free_indices;
+    // Indices past record_count handed out by create_entity() since the last flush
+    uint32_t reserved_count;
+    // Deferred structural changes, applied in order by flush_world()
+    pthread_mutex_t command_lock;
+    uint32_t command_count;
+    uint32_t command_capacity;
+    struct EcsCommand *commands;
+    size_t command_data_size;
+    size_t command_data_capacity;
+    uint8_t *command_data;
+    // Systems grouped into stages, a stage only conflicts with earlier ones
+    uint32_t system_count;
+    struct System systems[ECS_MAX_SYSTEMS];
+    uint32_t system_stages[ECS_MAX_SYSTEMS];
+    uint32_t stage_count;
+    // Jobs of the stage being run
+    uint32_t job_count;
+    uint32_t job_capacity;
+    struct SystemJob *jobs;
+    struct JobPool pool;
+};
+
+/*
+ * worker_count threads help run systems next to the calling thread, 0 runs
+ * everything on the caller. world should be cleaned up by destroy_world()
+ */
+void create_world(uint32_t worker_count, struct World *world);
+
+// Returns the component id, exits past ECS_MAX_COMPONENTS
+uint32_t register_component(struct World *world, const char *name, uint32_t size);
+
+/*
+ * The id is valid right away, the entity itself only exists after the next
+ * flush_world(). Safe to call from systems.
+ */
+uint64_t create_entity(struct World *world);
+
+// The deferred calls below are safe from systems and ignore stale ids at flush time
+void destroy_entity(struct World *world, uint64_t entity);
+
+// data is copied now, NULL zero-fills the component. Replaces the value if already present.
+void add_component(struct World *world, uint64_t entity, uint32_t component, const void *data);
+
+void remove_component(struct World *world, uint64_t entity, uint32_t component);
+
+// Applies every deferred change, must not run while systems do
+void flush_world(struct World *world);
+
+int is_entity_alive(const struct World *world, uint64_t entity);
+
+// NULL when the entity is stale or lacks the component
+void *get_entity_component(struct World *world, uint64_t entity, uint32_t component);
+
+uint64_t *get_chunk_entities(const struct ChunkView *view);
+
+// Column of component in view, the component must be part of the archetype
+void *get_chunk_column(const struct ChunkView *view, uint32_t component);
+
+// Exits past ECS_MAX_SYSTEMS
+void add_system(struct World *world, const struct System *system);
+
+// Runs every system stage by stage, then flushes the changes they deferred
+void run_systems(struct World *world);
+
+/*
+ * Calls func on the calling thread for every chunk holding all of mask, in
+ * archetype and chunk order
+ */
+void for_each_chunk(struct World *world, uint64_t mask, SystemFunc func, void *user_data);
+
+void destroy_world(struct World *world);
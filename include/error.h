@@ -0,0 +1,7 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+void print_exit(const char *message);
+
+void assert_vulkan(VkResult result, const char *message);
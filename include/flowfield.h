@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "asset.h"
+#include "jobs.h"
+
+#define FLOW_SECTOR_SIZE 16u
+// Goals with a cached field, the least recently requested one is replaced
+#define FLOW_MAX_FIELDS 32u
+#define FLOW_BLOCKED 0xffu
+#define FLOW_UNREACHABLE UINT32_MAX
+// Direction of tiles that are blocked, unreachable or the goal itself
+#define FLOW_DIRECTION_NONE 8u
+// Vector field sectors handed to a worker at a time
+#define FLOW_JOB_SECTORS 8u
+
+/*
+ * Paths toward one goal tile. integration holds the cost of the cheapest
+ * path from every tile to the goal, directions point each tile at the
+ * neighbor continuing that path. Directions are rebuilt per sector, only
+ * where the integration changed.
+ */
+struct FlowField {
+    uint32_t goal_x;
+    uint32_t goal_y;
+    // False until the next update_flow_grid() solved the field
+    int solved;
+    uint64_t last_requested;
+    uint32_t *integration;
+    uint8_t *directions;
+    uint8_t *dirty_sectors;
+    // Tiles reset by an incremental solve, scratch of the owning job
+    uint8_t *invalid;
+    uint32_t heap_count;
+    uint32_t heap_capacity;
+    uint64_t *heap;
+    uint32_t stack_count;
+    uint32_t stack_capacity;
+    uint32_t *stack;
+    double solve_time;
+};
+
+struct FlowSectorJob {
+    uint32_t field;
+    uint32_t first_sector;
+    uint32_t sector_count;
+};
+
+struct FlowStats {
+    uint32_t full_solves;
+    uint32_t incremental_solves;
+    uint32_t sectors_rebuilt;
+    // Seconds of the whole update and of the slowest single field
+    double update_time;
+    double max_solve_time;
+};
+
+/*
+ * Tile grid with a traversal cost per tile, 1 to FLOW_BLOCKED - 1 or
+ * FLOW_BLOCKED. Fields are cached per goal and shared by every unit heading
+ * there, cost changes are folded into them incrementally by the next update.
+ */
+struct FlowGrid {
+    uint32_t width;
+    uint32_t height;
+    uint32_t sectors_x;
+    uint32_t sectors_y;
+    uint8_t *costs;
+    // Tiles whose cost changed since the last update
+    uint32_t change_count;
+    uint32_t change_capacity;
+    uint32_t *changes;
+    uint8_t *changed;
+    uint64_t updates;
+    uint32_t field_count;
+    struct FlowField fields[FLOW_MAX_FIELDS];
+    uint32_t job_count;
+    uint32_t job_capacity;
+    struct FlowSectorJob *jobs;
+    struct JobPool *pool;
+    // Of the last update_flow_grid()
+    struct FlowStats stats;
+};
+
+/*
+ * Every tile starts at cost 1, pool may be NULL to solve on the calling
+ * thread. grid should be cleaned up by destroy_flow_grid()
+ */
+void create_flow_grid(uint32_t width, uint32_t height, struct JobPool *pool,
+    struct FlowGrid *grid);
+
+/*
+ * Tile i of the tilemap costs tile_costs[i], empty tiles and tiles past
+ * tile_cost_count cost 1
+ */
+void create_flow_grid_from_tilemap(const struct TilemapHeader *tilemap,
+    const uint8_t *tile_costs, uint32_t tile_cost_count, struct JobPool *pool,
+    struct FlowGrid *grid);
+
+// Takes effect on every cached field at the next update_flow_grid()
+void set_flow_cost(struct FlowGrid *grid, uint32_t x, uint32_t y, uint8_t cost);
+
+/*
+ * Returns the cached field for the goal, or a new one that is solved by the
+ * next update_flow_grid(). Fields stay valid until FLOW_MAX_FIELDS other
+ * goals were requested.
+ */
+const struct FlowField *request_flow_field(struct FlowGrid *grid, uint32_t goal_x,
+    uint32_t goal_y);
+
+/*
+ * Solves new fields, repairs cached ones around changed tiles and rebuilds
+ * dirty direction sectors, spread over the pool. Fields are read-only until
+ * the next call, so units can sample them from any thread.
+ */
+void update_flow_grid(struct FlowGrid *grid);
+
+// Unit vector toward the goal, zero for FLOW_DIRECTION_NONE
+void get_flow_vector(const struct FlowGrid *grid, const struct FlowField *field, uint32_t x,
+    uint32_t y, float vector[2]);
+
+void destroy_flow_grid(struct FlowGrid *grid);
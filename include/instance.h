@@ -1,15 +1,19 @@
 #pragma once
 
-#define LAYER_COUNT 1u
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "error.h"
 
-void print_exit(const char *message);
+#define LAYER_COUNT 1u
 
 #ifndef NDEBUG
-void get_layers(const char *layers[LAYER_COUNT]);
+// scratch is only used during the call
+void get_layers(struct Arena *scratch, const char *layers[LAYER_COUNT]);
 #endif
 
 /*
- * Debug: should be cleaned up by free()
+ * Debug: allocated from arena
  * Release: should be cleaned up by glfwTerminate()
  */
-const char **create_instance_extensions(uint32_t *count);
\ No newline at end of file
+const char **create_instance_extensions(struct Arena *arena, uint32_t *count);
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define JOB_MAX_WORKERS 16u
+
+typedef void (*JobFunc)(uint32_t job, void *user_data);
+
+// Persistent threads that split a batch of independent jobs with the calling thread
+struct JobPool {
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    // Bumped for every batch, workers wait for it to change
+    uint64_t generation;
+    int running;
+    uint32_t worker_count;
+    // Workers done with the current batch, none of them touches it afterwards
+    uint32_t finished_workers;
+    pthread_t workers[JOB_MAX_WORKERS];
+    JobFunc func;
+    void *user_data;
+    uint32_t job_count;
+    atomic_uint next_job;
+};
+
+// One less than the online CPUs, the calling thread makes up the difference
+uint32_t get_default_worker_count(void);
+
+/*
+ * worker_count is clamped to JOB_MAX_WORKERS, 0 runs every batch on the
+ * caller. pool should be cleaned up by destroy_job_pool()
+ */
+void create_job_pool(uint32_t worker_count, struct JobPool *pool);
+
+// Calls func for every job in [0, job_count) in any order, returns once all are done
+void run_job_pool(struct JobPool *pool, uint32_t job_count, JobFunc func, void *user_data);
+
+void destroy_job_pool(struct JobPool *pool);
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#define MEMORY_PRESSURE_CALLBACK_MAX 8u
+
+// Block compressed format families, each gated by a device feature
+enum TextureFamily {
+    TEXTURE_FAMILY_BC = 1 << 0,
+    TEXTURE_FAMILY_ETC2 = 1 << 1,
+    TEXTURE_FAMILY_ASTC = 1 << 2
+};
+
+struct GpuBuffer {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    // Persistently mapped when the memory is host visible, NULL otherwise
+    void *mapped;
+    // Memory heap and bytes the allocation took from it
+    uint32_t heap;
+    VkDeviceSize allocation_size;
+};
+
+struct Texture {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkFormat format;
+    VkExtent2D extent;
+    uint32_t levels;
+    // Memory heap and bytes the allocation took from it, 0 for lazily allocated memory
+    uint32_t heap;
+    VkDeviceSize allocation_size;
+};
+
+// Called while a heap's usage is over the pressure threshold of its budget
+typedef void (*MemoryPressureFunc)(uint32_t heap, VkDeviceSize usage, VkDeviceSize budget,
+    void *user_data);
+
+struct MemoryPressureCallback {
+    MemoryPressureFunc func;
+    void *user_data;
+};
+
+/*
+ * Usage and budget of every memory heap. VK_EXT_memory_budget reports what
+ * the whole process uses and what the driver can give it before paging,
+ * without it usage is what create_buffer() and create_texture() allocated
+ * and the budget a fixed share of the heap.
+ */
+struct MemoryBudget {
+    VkPhysicalDevice gpu;
+    int extension_enabled;
+    // Fraction of the budget at which pressure callbacks start firing
+    double pressure_threshold;
+    uint32_t heap_count;
+    VkDeviceSize heap_sizes[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize usage[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize budget[VK_MAX_MEMORY_HEAPS];
+    // Bit i is set while heap i is over the threshold
+    uint32_t pressured_heaps;
+    uint32_t callback_count;
+    struct MemoryPressureCallback callbacks[MEMORY_PRESSURE_CALLBACK_MAX];
+};
+
+// 0 for uncompressed formats
+uint32_t get_texture_family(VkFormat format);
+
+// Bytes of one tightly packed mip level, exits for formats assets do not use
+VkDeviceSize get_texture_level_size(VkFormat format, uint32_t width, uint32_t height);
+
+// Short name of a format get_texture_level_size() accepts, "unknown" for others
+const char *get_texture_format_name(VkFormat format);
+
+// Exits when no memory type in type_bits has all of properties
+uint32_t find_memory_type(VkPhysicalDevice gpu, uint32_t type_bits,
+    VkMemoryPropertyFlags properties);
+
+/*
+ * Bytes currently allocated on heap by create_buffer() and create_texture(),
+ * from any thread
+ */
+uint64_t get_memory_heap_usage(uint32_t heap);
+
+// buffer should be cleaned up by destroy_buffer()
+void create_buffer(VkDevice device, VkPhysicalDevice gpu, VkDeviceSize size,
+    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, struct GpuBuffer *buffer);
+
+void destroy_buffer(VkDevice device, struct GpuBuffer *buffer);
+
+// texture should be cleaned up by destroy_texture(), the image starts out undefined
+void create_texture(VkDevice device, VkPhysicalDevice gpu, VkFormat format, VkExtent2D extent,
+    uint32_t levels, VkImageUsageFlags usage, struct Texture *texture);
+
+/*
+ * Multisampled color attachment that only lives within a render pass, in
+ * lazily allocated memory when the device has it. texture should be cleaned
+ * up by destroy_texture()
+ */
+void create_transient_texture(VkDevice device, VkPhysicalDevice gpu, VkFormat format,
+    VkExtent2D extent, VkSampleCountFlagBits samples, struct Texture *texture);
+
+void destroy_texture(VkDevice device, struct Texture *texture);
+
+/*
+ * extension_enabled when the device was created with VK_EXT_memory_budget,
+ * polls once so the numbers are valid right away
+ */
+void create_memory_budget(VkPhysicalDevice gpu, int extension_enabled, double pressure_threshold,
+    struct MemoryBudget *budget);
+
+// Exits past MEMORY_PRESSURE_CALLBACK_MAX
+void add_memory_pressure_callback(struct MemoryBudget *budget, MemoryPressureFunc func,
+    void *user_data);
+
+/*
+ * Refreshes usage and budget, then calls every callback once per heap over
+ * the threshold. Callbacks keep firing every poll until usage drops.
+ */
+void poll_memory_budget(struct MemoryBudget *budget);
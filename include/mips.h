@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "memory.h"
+
+// Levels one compute dispatch writes, matching the 8x8 workgroup of downsample.comp
+#define MIP_LEVELS_PER_DISPATCH 4u
+#define MIP_MAX_VIEWS 128u
+#define MIP_MAX_SETS 32u
+
+enum MipPath {
+    // Compressed or unsupported formats, levels have to come from the asset
+    MIP_PATH_NONE,
+    // vkCmdBlitImage with linear filtering, one level at a time
+    MIP_PATH_BLIT,
+    // downsample.comp for formats without linear blits, four levels per dispatch
+    MIP_PATH_COMPUTE
+};
+
+/*
+ * Fills mip chains on the GPU. Views and descriptor sets of compute
+ * dispatches live until reset_mip_generator(), which must wait for the
+ * recorded commands to complete.
+ */
+struct MipGenerator {
+    VkDevice device;
+    VkPhysicalDevice gpu;
+    // VK_NULL_HANDLE when only blits are available
+    VkPipeline pipeline;
+    VkShaderModule module;
+    VkPipelineLayout layout;
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool pool;
+    VkSampler sampler;
+    uint32_t set_count;
+    uint32_t view_count;
+    VkImageView views[MIP_MAX_VIEWS];
+    // Textures generated by each path
+    uint64_t blit_count;
+    uint64_t compute_count;
+};
+
+// Levels of a full chain down to 1x1
+uint32_t get_mip_count(VkExtent2D extent);
+
+/*
+ * code is downsample.comp SPIR-V, NULL restricts generation to blits. The
+ * device must have shaderStorageImageWriteWithoutFormat enabled when it is given.
+ * generator should be cleaned up by destroy_mip_generator()
+ */
+void create_mip_generator(VkDevice device, VkPhysicalDevice gpu, const uint32_t *code,
+    size_t code_size, struct MipGenerator *generator);
+
+enum MipPath get_mip_path(const struct MipGenerator *generator, VkFormat format);
+
+// Usage textures need on top of sampling to have their chain generated by path
+VkImageUsageFlags get_mip_usage(enum MipPath path);
+
+// False when a texture of levels has to wait for a reset before it can be generated
+int has_mip_capacity(const struct MipGenerator *generator, uint32_t levels);
+
+void transition_texture_levels(VkCommandBuffer buffer, const struct Texture *texture,
+    uint32_t base_level, uint32_t level_count, VkImageLayout old_layout,
+    VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access,
+    VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage);
+
+/*
+ * Fills the levels after base_level from it. base_level must be in
+ * TRANSFER_DST_OPTIMAL after a transfer write, every level from base_level on
+ * ends up in SHADER_READ_ONLY_OPTIMAL.
+ */
+void record_mip_generation(struct MipGenerator *generator, VkCommandBuffer buffer,
+    const struct Texture *texture, uint32_t base_level);
+
+// Releases compute views and sets, the commands that used them must have completed
+void reset_mip_generator(struct MipGenerator *generator);
+
+void destroy_mip_generator(struct MipGenerator *generator);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "record.h"
+#include "sprite.h"
+
+// Frames shown by the frame time graph
+#define OVERLAY_HISTORY 120u
+
+// Counters of one frame, times in seconds
+struct OverlayFrame {
+    double frame_time;
+    double cpu_time;
+    double gpu_time;
+    double fence_wait;
+    double acquire_wait;
+    // GPU time of the overlay pass itself
+    double overlay_time;
+    struct DrawCounters counters;
+    uint64_t upload_bytes;
+    // Validation layer performance warnings, always 0 in release builds
+    uint32_t performance_warnings;
+    // Pipeline statistics of the draw passes, shown when statistics is set
+    int statistics;
+    double fragments_per_pixel;
+    uint64_t vertex_invocations;
+    uint64_t clipping_primitives;
+    // Scene resolution, shown when dynamic_resolution is set
+    int dynamic_resolution;
+    double resolution_scale;
+    VkExtent2D scene_extent;
+    uint32_t heap_count;
+    uint64_t heap_usage[VK_MAX_MEMORY_HEAPS];
+    uint64_t heap_budgets[VK_MAX_MEMORY_HEAPS];
+};
+
+/*
+ * Frame time graph and counters built from plain quads, drawn with the
+ * sprite pipeline in one instanced draw. Text uses a built in 3x5 font with
+ * every horizontal run of a glyph row merged into one quad.
+ */
+struct Overlay {
+    int visible;
+    uint32_t head;
+    float frame_times[OVERLAY_HISTORY];
+    float gpu_times[OVERLAY_HISTORY];
+    // CPU seconds the last build_overlay() took
+    double build_time;
+    struct SpriteBatch batch;
+};
+
+// overlay should be cleaned up by destroy_overlay()
+void create_overlay(int visible, struct Overlay *overlay);
+
+// Records frame in the history and rebuilds overlay->batch, which is empty while hidden
+void build_overlay(struct Overlay *overlay, const struct OverlayFrame *frame);
+
+void destroy_overlay(struct Overlay *overlay);
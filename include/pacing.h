@@ -0,0 +1,156 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+// The bundled headers predate these extensions
+#ifndef VK_KHR_present_id
+#define VK_KHR_present_id 1
+#define VK_KHR_PRESENT_ID_EXTENSION_NAME "VK_KHR_present_id"
+#define VK_STRUCTURE_TYPE_PRESENT_ID_KHR ((VkStructureType)1000294000)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR ((VkStructureType)1000294001)
+
+typedef struct VkPresentIdKHR {
+    VkStructureType sType;
+    const void *pNext;
+    uint32_t swapchainCount;
+    const uint64_t *pPresentIds;
+} VkPresentIdKHR;
+
+typedef struct VkPhysicalDevicePresentIdFeaturesKHR {
+    VkStructureType sType;
+    void *pNext;
+    VkBool32 presentId;
+} VkPhysicalDevicePresentIdFeaturesKHR;
+#endif
+
+#ifndef VK_KHR_present_wait
+#define VK_KHR_present_wait 1
+#define VK_KHR_PRESENT_WAIT_EXTENSION_NAME "VK_KHR_present_wait"
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR ((VkStructureType)1000248000)
+
+typedef struct VkPhysicalDevicePresentWaitFeaturesKHR {
+    VkStructureType sType;
+    void *pNext;
+    VkBool32 presentWait;
+} VkPhysicalDevicePresentWaitFeaturesKHR;
+
+typedef VkResult (VKAPI_PTR *PFN_vkWaitForPresentKHR)(VkDevice device,
+    VkSwapchainKHR swapchain, uint64_t presentId, uint64_t timeout);
+#endif
+
+#define LATENCY_HISTORY 8u
+
+struct FramePacer {
+    // Seconds per frame, 0 leaves the rate to the present mode
+    double target;
+    double refresh_period;
+    // Wait for the last frame to be shown instead of keeping one queued
+    int low_latency;
+    // NULL when present_wait is unavailable
+    PFN_vkWaitForPresentKHR wait_for_present;
+    uint64_t present_id;
+    // First id presented to the current swapchain
+    uint64_t swapchain_first_id;
+    double frame_start;
+    double last_shown;
+    // Smoothed CPU time from frame start to present
+    double cpu_time;
+    uint64_t frames;
+    uint64_t missed_vsyncs;
+    // Earliest input event not yet consumed by a frame, 0 when there is none
+    double pending_input;
+    // Input time of the frame being built, 0 when it saw no input
+    double frame_input;
+    // Input time of each present id still waiting to be shown
+    double present_inputs[LATENCY_HISTORY];
+    // Smoothed latencies in seconds
+    double input_to_submit;
+    double input_to_present;
+};
+
+/*
+ * Splits wall time into ticks of tick_time seconds, independent of the frame
+ * rate. The time left over after the last tick is carried to the next frame
+ * and exposed as alpha for interpolating between the last two ticks.
+ */
+struct FixedTimestep {
+    double tick_time;
+    // Ticks run by one frame at most, the time beyond them is dropped
+    uint32_t max_ticks;
+    double accumulator;
+    double last_time;
+    // Fraction of a tick carried over, 0 is the last tick and 1 the next
+    double alpha;
+    uint64_t ticks;
+    uint64_t dropped_ticks;
+    uint32_t frame_ticks;
+    // Smoothed ticks per frame
+    double ticks_per_frame;
+};
+
+/*
+ * Fraction of the output resolution the scene renders at, chosen so the
+ * scene's GPU time stays under target_time. Pixel cost follows the square of
+ * the scale. Changes snap to RESOLUTION_SCALE_STEP and are held for a while
+ * so the smoothed GPU timers settle before the next decision.
+ */
+struct ResolutionScale {
+    double target_time;
+    double min_scale;
+    double max_scale;
+    double scale;
+    // Frames left before the scale may change again
+    uint32_t cooldown;
+    uint64_t changes;
+};
+
+void create_frame_pacer(double target, double refresh_period,
+    PFN_vkWaitForPresentKHR wait_for_present, int low_latency, struct FramePacer *pacer);
+
+// Present ids of an old swapchain must not be waited on after recreation
+void reset_frame_pacer(struct FramePacer *pacer);
+
+/*
+ * Blocks until the CPU should start building the next frame. With
+ * present_wait the start is placed so the frame is ready just before the
+ * vsync following the previous frame, otherwise frames start target apart.
+ */
+void pace_frame(struct FramePacer *pacer, VkDevice device, VkSwapchainKHR swapchain);
+
+// Call from input callbacks, only the earliest event per frame is kept
+void record_input(struct FramePacer *pacer);
+
+// Call after polling events, the pending input belongs to the frame being built
+void begin_input(struct FramePacer *pacer);
+
+// Call right after the frame's vkQueueSubmit
+void record_submit(struct FramePacer *pacer);
+
+// Call right before vkQueuePresentKHR, returns the id for VkPresentIdKHR
+uint64_t end_frame(struct FramePacer *pacer);
+
+/*
+ * Call right after vkQueuePresentKHR. Without present_wait the present call
+ * stands in for the moment the frame is shown.
+ */
+void record_present(struct FramePacer *pacer);
+
+// Sleeps the calling thread until glfwGetTime() reaches time
+void sleep_until(double time);
+
+// Ticks tick_rate times per second, time starts counting now
+void create_fixed_timestep(double tick_rate, uint32_t max_ticks, struct FixedTimestep *timestep);
+
+// Call once per frame, returns how many ticks the frame should run
+uint32_t advance_fixed_timestep(struct FixedTimestep *timestep);
+
+// Starts at max_scale, the bounds are clamped to (0, 1]
+void create_resolution_scale(double target_time, double min_scale, double max_scale,
+    struct ResolutionScale *resolution);
+
+/*
+ * Call once per frame with the smoothed GPU seconds of the scene, 0 when
+ * unmeasured. Returns 1 when resolution->scale changed.
+ */
+int update_resolution_scale(struct ResolutionScale *resolution, double gpu_time);
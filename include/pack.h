@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Pack layout: a PackHeader, payloads at PACK_ALIGNMENT aligned offsets and
+ * the table of contents at toc_offset, sorted by name_hash. Payloads are
+ * stored exactly as the GPU consumes them so loading is a copy at most.
+ */
+#define PACK_MAGIC 0x4b504e4cu
+#define PACK_VERSION 1u
+// Satisfies optimalBufferCopyOffsetAlignment and nonCoherentAtomSize on common GPUs
+#define PACK_ALIGNMENT 256u
+// Mip levels of a texture payload are tightly packed at this alignment
+#define PACK_LEVEL_ALIGNMENT 16u
+#define PACK_NAME_MAX 48u
+
+enum PackEntryType {
+    PACK_ENTRY_BLOB,
+    // SPIR-V words
+    PACK_ENTRY_SHADER,
+    // Mip chain in format, largest level first
+    PACK_ENTRY_TEXTURE
+};
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t padding;
+    uint64_t toc_offset;
+    // Total file size, catches truncated packs
+    uint64_t size;
+};
+
+struct PackEntry {
+    char name[PACK_NAME_MAX];
+    uint64_t name_hash;
+    // hash_bytes() of the payload
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t type;
+    // VkFormat of texture entries
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t padding;
+};
+
+// A read only mapping of a pack file
+struct AssetPack {
+    const uint8_t *data;
+    size_t size;
+    // Page rounded length of the mapping
+    size_t mapped_size;
+    uint32_t entry_count;
+    const struct PackEntry *entries;
+};
+
+struct PackWriter {
+    FILE *file;
+    uint64_t offset;
+    uint32_t count;
+    uint32_t capacity;
+    struct PackEntry *entries;
+};
+
+// Offset basis of FNV-1a, the hash mix_hash_bytes() continues starts from it
+#define HASH_BASIS 14695981039346656037ull
+
+// FNV-1a
+uint64_t hash_bytes(const void *data, size_t size);
+
+// Continues an FNV-1a hash with data, so inputs can be hashed piece by piece
+uint64_t mix_hash_bytes(uint64_t hash, const void *data, size_t size);
+
+// Exits when the file is missing or malformed, pack should be cleaned up by close_asset_pack()
+void open_asset_pack(const char *path, struct AssetPack *pack);
+
+// NULL when the pack has no entry called name
+const struct PackEntry *find_pack_entry(const struct AssetPack *pack, const char *name);
+
+const void *get_pack_payload(const struct AssetPack *pack, const struct PackEntry *entry);
+
+// Rehashes the payload, meant for tools and debug builds
+int is_pack_entry_intact(const struct AssetPack *pack, const struct PackEntry *entry);
+
+void close_asset_pack(struct AssetPack *pack);
+
+// writer should be cleaned up by finish_pack_writer()
+void create_pack_writer(const char *path, struct PackWriter *writer);
+
+// Fills in the name hash, payload hash, offset and size of entry before storing it
+void add_pack_entry(struct PackWriter *writer, const struct PackEntry *entry, const void *data,
+    size_t size);
+
+// Writes the table of contents and closes the file
+void finish_pack_writer(struct PackWriter *writer);
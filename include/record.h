@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+
+#define DRAW_PASS_MAX 16u
+#define FRAMES_IN_FLIGHT 2u
+#define FRAME_ARENA_SIZE (64u * 1024u)
+
+struct PipelineStatistics;
+
+// Work a draw pass recorded, passes add to them for the performance overlay
+struct DrawCounters {
+    uint32_t draws;
+    uint32_t instances;
+    uint32_t pipeline_binds;
+};
+
+typedef void (*DrawRecordFunc)(VkCommandBuffer buffer, struct DrawCounters *counters,
+    void *user_data);
+
+struct DrawPass {
+    const char *name;
+    DrawRecordFunc record;
+    void *user_data;
+    // Record once into a secondary command buffer and reuse it until invalidated
+    int cached;
+};
+
+/*
+ * Cached passes keep one secondary per frame in flight so an invalidated pass
+ * is never re-recorded while an earlier frame still executes it
+ */
+struct DrawPassEntry {
+    struct DrawPass pass;
+    VkCommandBuffer secondaries[FRAMES_IN_FLIGHT];
+    // What secondaries[i] recorded, counted again every frame it executes
+    struct DrawCounters counters[FRAMES_IN_FLIGHT];
+    // Bit i is set while secondaries[i] is up to date
+    uint32_t valid;
+};
+
+// Passes recorded in order inside the main render pass every frame
+struct DrawPassList {
+    VkCommandPool cache_pool;
+    // Queries every pass when not NULL, query i belongs to entries[i]
+    struct PipelineStatistics *statistics;
+    uint32_t count;
+    struct DrawPassEntry entries[DRAW_PASS_MAX];
+};
+
+struct FrameCommands {
+    // Frame in flight the commands belong to
+    uint32_t index;
+    // Transient, reset wholesale at the start of every frame
+    VkCommandPool pool;
+    VkCommandBuffer primary;
+    // Allocated on first use and recycled by every pool reset
+    uint32_t secondary_count;
+    VkCommandBuffer secondaries[DRAW_PASS_MAX];
+    // CPU memory for recording, reset together with the pool
+    struct Arena scratch;
+};
+
+// list should be cleaned up by destroy_draw_pass_list()
+void create_draw_pass_list(VkDevice device, uint32_t family, struct DrawPassList *list);
+
+// Returns the index used to invalidate the pass
+uint32_t add_draw_pass(VkDevice device, struct DrawPassList *list, const struct DrawPass *pass);
+
+// Cached passes are re-recorded the next time they are drawn
+void invalidate_draw_pass(struct DrawPassList *list, uint32_t index);
+
+void invalidate_draw_passes(struct DrawPassList *list);
+
+// Contents the render pass has to begin with for record_draw_passes()
+VkSubpassContents get_draw_pass_contents(const struct DrawPassList *list);
+
+/*
+ * Records every pass into primary, which must be inside subpass 0 of
+ * render_pass. The work of every pass is added to counters.
+ */
+void record_draw_passes(VkDevice device, struct DrawPassList *list,
+    struct FrameCommands *commands, VkRenderPass render_pass, VkExtent2D extent,
+    struct DrawCounters *counters);
+
+/*
+ * Records every pass inline into primary once per region, scissored to it,
+ * for redrawing only what changed. The render pass has to begin with
+ * VK_SUBPASS_CONTENTS_INLINE. regions must not overlap, or blended passes
+ * would draw overlapping pixels twice.
+ */
+void record_draw_pass_regions(struct DrawPassList *list, struct FrameCommands *commands,
+    VkExtent2D extent, const VkRect2D *regions, uint32_t region_count,
+    struct DrawCounters *counters);
+
+void destroy_draw_pass_list(VkDevice device, struct DrawPassList *list);
+
+// commands should be cleaned up by destroy_frame_commands()
+void create_frame_commands(VkDevice device, uint32_t family, uint32_t index,
+    struct FrameCommands *commands);
+
+// Resets the pool and scratch arena and begins commands->primary
+VkCommandBuffer begin_frame_commands(VkDevice device, struct FrameCommands *commands);
+
+void destroy_frame_commands(VkDevice device, struct FrameCommands *commands);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#define REFLECT_MAX_SETS 4u
+#define REFLECT_MAX_BINDINGS 16u
+#define REFLECT_MAX_ATTRIBUTES 16u
+
+struct DescriptorBinding {
+    uint32_t set;
+    uint32_t binding;
+    uint32_t count;
+    VkDescriptorType type;
+    VkShaderStageFlags stages;
+};
+
+struct VertexAttribute {
+    uint32_t location;
+    uint32_t size;
+    VkFormat format;
+};
+
+// Interface of a single shader stage as read from its SPIR-V
+struct ShaderReflection {
+    VkShaderStageFlagBits stage;
+    uint32_t binding_count;
+    struct DescriptorBinding bindings[REFLECT_MAX_BINDINGS];
+    uint32_t push_constant_size;
+    // Bit i is set when the stage declares specialization constant i
+    uint32_t spec_constants;
+    // Sorted by location
+    uint32_t attribute_count;
+    struct VertexAttribute attributes[REFLECT_MAX_ATTRIBUTES];
+};
+
+struct SetLayoutEntry {
+    uint32_t binding_count;
+    struct DescriptorBinding bindings[REFLECT_MAX_BINDINGS];
+    VkDescriptorSetLayout layout;
+};
+
+struct PipelineLayoutEntry {
+    uint32_t set_count;
+    VkDescriptorSetLayout set_layouts[REFLECT_MAX_SETS];
+    VkPushConstantRange push_range;
+    VkPipelineLayout layout;
+};
+
+// Deduplicates set and pipeline layouts so identical shader interfaces share objects
+struct LayoutCache {
+    uint32_t set_count;
+    uint32_t set_capacity;
+    struct SetLayoutEntry *sets;
+    uint32_t pipeline_count;
+    uint32_t pipeline_capacity;
+    struct PipelineLayoutEntry *pipelines;
+};
+
+void reflect_shader(const uint32_t *code, size_t size, struct ShaderReflection *reflection);
+
+// cache should be cleaned up by destroy_layout_cache()
+void create_layout_cache(struct LayoutCache *cache);
+
+/*
+ * Merges the interfaces of every stage into one pipeline layout. set_layouts
+ * receives set_count layouts indexed by set number. All handles are owned by
+ * cache.
+ */
+VkPipelineLayout get_pipeline_layout(VkDevice device, struct LayoutCache *cache,
+    const struct ShaderReflection *reflections, uint32_t count,
+    VkDescriptorSetLayout set_layouts[REFLECT_MAX_SETS], uint32_t *set_count);
+
+void destroy_layout_cache(VkDevice device, struct LayoutCache *cache);
@@ -1,10 +1,218 @@
 #pragma once
 
+#include "compute.h"
+#include "record.h"
+#include "sprite.h"
+#include "upload.h"
+#include "virtual.h"
+
 struct Renderer;
 
+/*
+ * delta is the time in seconds since the previous update, alpha how far the
+ * frame is between the last two ticks, 0 at the one before the last and 1 at
+ * the last
+ */
+typedef void (*RendererUpdateFunc)(struct Renderer *renderer, double delta, double alpha,
+    void *user_data);
+
+// tick_time is the fixed simulation step in seconds
+typedef void (*RendererTickFunc)(struct Renderer *renderer, double tick_time, void *user_data);
+
+struct RendererSettings {
+    // Index or name substring of the GPU to use, NULL selects the best scored GPU
+    const char *gpu;
+    // Run COMPUTE_QUEUE_ASYNC passes on a dedicated compute family when there is one
+    int async_compute;
+    // Cull sprites against the framebuffer in a compute pass, drawn indirectly
+    int sprite_culling;
+    // Falls back to FIFO when the surface does not support it
+    VkPresentModeKHR present_mode;
+    // Seconds per frame the pacer aims for, 0 leaves the rate to the present mode
+    double target_frame_time;
+    // Print RendererStats to stdout once per second
+    int print_stats;
+    // Wait for the frame slot before sampling input, trades throughput for latency
+    int low_latency;
+    // Asset pack to load shaders and assets from, NULL loads loose files
+    const char *asset_pack;
+    // Bytes of the physical page cache of each virtual texture
+    VkDeviceSize virtual_texture_budget;
+    // Pack texture drawn behind the scene and streamed by detail level, NULL for none
+    const char *backdrop;
+    // Streams the backdrop page by page through a virtual texture
+    int virtual_backdrop;
+    // Simulation ticks per second, independent of the frame rate
+    double tick_rate;
+    // Ticks one frame may run to catch up, the rest of a stall is dropped
+    uint32_t max_ticks_per_frame;
+    // Show the performance overlay from the start, F3 toggles it
+    int overlay;
+    // Fraction of a heap's budget at which memory pressure callbacks fire
+    double memory_pressure_threshold;
+    // Debug builds also print info and verbose validation messages
+    int verbose_validation;
+    // Query pipeline statistics around every draw pass when the GPU supports it
+    int pipeline_statistics;
+    // Start with the overdraw heatmap, F4 toggles it
+    int overdraw;
+    // Render the scene offscreen at a scale that keeps its GPU time under target_gpu_time
+    int dynamic_resolution;
+    // Bounds of the scale, fractions of the swapchain extent in (0, 1]
+    double min_resolution_scale;
+    double max_resolution_scale;
+    // Seconds of GPU time the scene may take, 0 derives it from the frame period
+    double target_gpu_time;
+    // Samples per pixel of the main pass, 1, 2, 4 or 8, capped by the GPU
+    uint32_t msaa_samples;
+    /*
+     * Redraw only what changed and skip frames where nothing did. Sprite
+     * changes are found automatically, draw passes report theirs through
+     * add_renderer_damage() or by being invalidated.
+     */
+    int damage_tracking;
+};
+
+struct RendererStats {
+    uint64_t frames;
+    uint64_t missed_vsyncs;
+    // Smoothed seconds from frame start to present
+    double cpu_time;
+    VkPresentModeKHR present_mode;
+    // Pacing and vsync misses come from VK_KHR_present_wait instead of CPU timing
+    int present_wait;
+    // Smoothed seconds from the first input event of a frame to its submit and present
+    double input_to_submit;
+    double input_to_present;
+    // Smoothed GPU seconds of the main render pass, 0 without timestamp support
+    double gpu_draw_time;
+    // Smoothed GPU seconds of sprite culling, 0 when sprites are not culled
+    double gpu_cull_time;
+    uint64_t ticks;
+    // Ticks dropped by frames that fell too far behind
+    uint64_t dropped_ticks;
+    // Smoothed simulation ticks run per frame
+    double ticks_per_frame;
+    // Polled every frame, see struct MemoryBudget
+    uint32_t heap_count;
+    uint32_t pressured_heaps;
+    VkDeviceSize heap_usage[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heap_budget[VK_MAX_MEMORY_HEAPS];
+    // Performance warnings the validation layers raised last frame, 0 in release builds
+    uint32_t performance_warnings;
+    // Summed over the draw passes, 0 unless RendererSettings.pipeline_statistics
+    uint64_t vertex_invocations;
+    uint64_t clipping_primitives;
+    uint64_t fragment_invocations;
+    // Fragment shader invocations per scene pixel, the average overdraw
+    double fragments_per_pixel;
+    // Fraction of the swapchain extent the scene renders at, 1 without dynamic resolution
+    double resolution_scale;
+    VkExtent2D scene_extent;
+    uint64_t resolution_changes;
+    // Samples per pixel the main pass renders with
+    uint32_t msaa_samples;
+    // Frames damage tracking skipped because nothing changed
+    uint64_t skipped_frames;
+    // Share of the extent the last rendered frame redrew, 1 for a full redraw
+    double redraw_share;
+    int incremental_present;
+};
+
+void get_default_renderer_settings(struct RendererSettings *settings);
+
 // Should be cleaned up by destroy_renderer()
-struct Renderer *create_renderer(void);
+struct Renderer *create_renderer(const struct RendererSettings *settings);
+
+// Passes run every frame before graphics work, in the order they were added
+void add_renderer_compute_pass(struct Renderer *renderer, const struct ComputePass *pass);
+
+// Passes draw every frame inside the main render pass, in the order they were added
+uint32_t add_renderer_draw_pass(struct Renderer *renderer, const struct DrawPass *pass);
+
+// Cached passes are re-recorded before their next draw, which redraws the whole frame
+void invalidate_renderer_draw_pass(struct Renderer *renderer, uint32_t index);
+
+/*
+ * Marks rect in swapchain pixels as changed for RendererSettings.damage_tracking,
+ * NULL marks the whole frame. Only call from the update function. Undamaged
+ * frames submit no work at all, so while add_renderer_compute_pass() passes
+ * are added every frame counts as fully damaged and the passes keep running.
+ */
+void add_renderer_damage(struct Renderer *renderer, const VkRect2D *rect);
+
+/*
+ * Centers the backdrop on x, y in texture coordinates, zoom magnifies it over
+ * the scale at which it just covers the window and is at least 1. Only call
+ * from the update function.
+ */
+void set_renderer_backdrop_view(struct Renderer *renderer, float x, float y, float zoom);
+
+// NULL when the renderer was created without an asset pack
+const struct AssetPack *get_renderer_pack(const struct Renderer *renderer);
+
+// Uploads textures and buffers from a pack on the graphics queue
+struct Uploader *get_renderer_uploader(struct Renderer *renderer);
+
+/*
+ * Streams the pack texture name through a page cache of
+ * RendererSettings.virtual_texture_budget bytes, updated at the start of every
+ * frame. Returns 0 without creating texture when the device lacks
+ * fragmentStoresAndAtomics, which the feedback needs. Otherwise texture should
+ * be cleaned up by destroy_renderer_virtual_texture()
+ */
+int create_renderer_virtual_texture(struct Renderer *renderer, const char *name,
+    struct VirtualTexture *texture);
+
+void destroy_renderer_virtual_texture(struct Renderer *renderer, struct VirtualTexture *texture);
+
+/*
+ * update runs once per frame after the frame's resources are free and
+ * before it is recorded, after the frame's ticks. NULL removes it
+ */
+void set_renderer_update(struct Renderer *renderer, RendererUpdateFunc update, void *user_data);
+
+/*
+ * tick runs RendererSettings.tick_rate times per second, as many times per
+ * frame as the time since the last frame covers. NULL removes it
+ */
+void set_renderer_tick(struct Renderer *renderer, RendererTickFunc tick, void *user_data);
+
+/*
+ * Copies the sprites the frame draws into its instance buffer, only call from
+ * the update function. The sprites stay until the next call for the frame.
+ */
+void set_renderer_sprites(struct Renderer *renderer, const struct SpriteInstance *instances,
+    uint32_t count);
+
+/*
+ * Scratch memory of the frame being recorded, valid until the frame's commands
+ * are reset FRAMES_IN_FLIGHT frames later. Only call while recording.
+ */
+struct Arena *get_renderer_frame_arena(struct Renderer *renderer);
+
+// Extent of the swapchain images, changes when the window is resized
+VkExtent2D get_renderer_extent(const struct Renderer *renderer);
+
+void get_renderer_stats(const struct Renderer *renderer, struct RendererStats *stats);
+
+/*
+ * Draws the built in passes as an additive heatmap of how often each pixel is
+ * shaded. Passes added with their own pipelines are drawn unchanged.
+ */
+void set_renderer_overdraw(struct Renderer *renderer, int overdraw);
+
+/*
+ * func runs on the render thread right after the frame fence, once per heap
+ * over RendererSettings.memory_pressure_threshold of its budget, so streaming
+ * systems can evict before the driver starts paging
+ */
+void add_renderer_memory_pressure_callback(struct Renderer *renderer, MemoryPressureFunc func,
+    void *user_data);
 
 void run_renderer(struct Renderer *renderer);
 
+// run_renderer() returns after the frame being built, callable from the update function
+void close_renderer(struct Renderer *renderer);
+
 void destroy_renderer(struct Renderer *renderer);
\ No newline at end of file
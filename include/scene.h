@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ecs.h"
+#include "flowfield.h"
+#include "renderer.h"
+#include "sprite.h"
+
+struct Velocity {
+    float x;
+    float y;
+    // Radians per second
+    float spin;
+};
+
+// Static sprite blocking a flow tile
+struct Wall {
+    uint32_t tile;
+};
+
+// Units steered along the flow field toward the scene's current goal
+struct Seeker {
+    // Pixels per second
+    float speed;
+};
+
+/*
+ * Bouncing sprites driven by the ECS, drawn through the renderer's sprite
+ * pass. Half of them seek a goal through a flow field around walls that are
+ * toggled over time.
+ */
+struct Scene {
+    struct World world;
+    struct SpriteComponents sprite_components;
+    uint32_t velocity;
+    uint32_t seeker;
+    uint32_t wall;
+    struct SpriteBatch batch;
+    float width;
+    float height;
+    float delta;
+    // Seconds into the alpha pulse, wraps every PULSE_PERIOD
+    float pulse_time;
+    // Seconds into the backdrop pan, wraps every BACKDROP_PERIOD
+    float backdrop_time;
+    struct FlowGrid flow;
+    const struct FlowField *field;
+    uint32_t goal;
+    // Wall entity of every flow tile, ECS_NULL_ENTITY where there is none
+    uint64_t *walls;
+    float goal_timer;
+    float wall_timer;
+    float stats_timer;
+    // Summed since the last print, update_time and max_solve_time are maxima
+    struct FlowStats flow_stats;
+    int print_stats;
+};
+
+/*
+ * Spawns sprites over the renderer's extent and prints flow field stats once
+ * a second if print_stats. scene should be cleaned up by destroy_scene()
+ */
+void create_scene(const struct Renderer *renderer, uint32_t sprite_count, int print_stats,
+    struct Scene *scene);
+
+// RendererTickFunc, user_data is the scene
+void tick_scene(struct Renderer *renderer, double tick_time, void *user_data);
+
+/*
+ * RendererUpdateFunc, interpolates the sprites of the last two ticks and pans
+ * the backdrop. user_data is the scene
+ */
+void update_scene(struct Renderer *renderer, double delta, double alpha, void *user_data);
+
+void destroy_scene(struct Scene *scene);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "pack.h"
+#include "reflect.h"
+
+#define SHADER_STAGE_COUNT 2u
+#define SHADER_FEATURE_COUNT 1u
+
+/*
+ * Feature bits select a shader permutation. Bit i is fed to the shader as
+ * the boolean specialization constant with constant_id i, so disabled paths
+ * are eliminated when the pipeline is compiled.
+ */
+enum ShaderFeature {
+    // Outputs a constant heat per fragment, blended additively to show overdraw
+    SHADER_FEATURE_OVERDRAW = 1u << 0
+};
+
+enum BlendMode {
+    BLEND_MODE_OPAQUE,
+    BLEND_MODE_ALPHA,
+    BLEND_MODE_ADDITIVE
+};
+
+struct ShaderProgram {
+    VkShaderModule modules[SHADER_STAGE_COUNT];
+    VkShaderStageFlagBits stages[SHADER_STAGE_COUNT];
+    struct ShaderReflection reflections[SHADER_STAGE_COUNT];
+    // Owned by the LayoutCache the program was created with
+    VkPipelineLayout layout;
+    uint32_t set_count;
+    VkDescriptorSetLayout set_layouts[REFLECT_MAX_SETS];
+    // Requested feature bits the SPIR-V declares, other bits never create a permutation
+    uint32_t features;
+};
+
+// Fixed-function state that is part of a pipeline key
+struct PipelineState {
+    VkRenderPass render_pass;
+    uint32_t topology;
+    uint32_t cull_mode;
+    uint32_t samples;
+    uint32_t blend_mode;
+    // VkVertexInputRate of the interleaved vertex binding
+    uint32_t input_rate;
+    // Keeps the state free of implicit padding
+    uint32_t padding;
+};
+
+struct PipelineKey {
+    VkShaderModule modules[SHADER_STAGE_COUNT];
+    struct PipelineState state;
+    uint32_t permutation;
+    // Keeps the key free of implicit padding so it can be hashed bytewise
+    uint32_t padding;
+};
+
+struct PipelineEntry {
+    uint64_t hash;
+    struct PipelineKey key;
+    VkPipeline pipeline;
+};
+
+struct PipelineCache {
+    VkPipelineCache cache;
+    uint32_t count;
+    uint32_t capacity;
+    struct PipelineEntry *entries;
+};
+
+// Should be cleaned up by free()
+uint32_t *get_shader_code(const char *path, size_t *size);
+
+/*
+ * Stages, pipeline layout and vertex input are reflected from the SPIR-V.
+ * program should be cleaned up by destroy_shader_program()
+ */
+void create_shader_program(VkDevice device, struct LayoutCache *layouts,
+    const char *const paths[SHADER_STAGE_COUNT], uint32_t features,
+    struct ShaderProgram *program);
+
+// Same as create_shader_program() with SPIR-V read in place from pack entries
+void create_shader_program_from_pack(VkDevice device, struct LayoutCache *layouts,
+    const struct AssetPack *pack, const char *const names[SHADER_STAGE_COUNT],
+    uint32_t features, struct ShaderProgram *program);
+
+void destroy_shader_program(VkDevice device, struct ShaderProgram *program);
+
+// cache should be cleaned up by destroy_pipeline_cache()
+void create_pipeline_cache(VkDevice device, struct PipelineCache *cache);
+
+/*
+ * Returns the pipeline for program, state and permutation, compiling it on
+ * first use. The pipeline is owned by cache.
+ */
+VkPipeline get_pipeline(VkDevice device, struct PipelineCache *cache,
+    const struct ShaderProgram *program, const struct PipelineState *state,
+    uint32_t permutation);
+
+// Destroys every cached pipeline but keeps the VkPipelineCache
+void clear_pipeline_cache(VkDevice device, struct PipelineCache *cache);
+
+void destroy_pipeline_cache(VkDevice device, struct PipelineCache *cache);
@@ -0,0 +1,15 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "overdraw.glsl"
+
+layout(set = 0, binding = 0) uniform sampler2D backdrop;
+
+layout(location = 0) in vec2 in_uv;
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+        out_color = apply_overdraw(vec4(texture(backdrop, in_uv).rgb, 1.0));
+}
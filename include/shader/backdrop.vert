@@ -0,0 +1,26 @@
+#version 450
+
+// See struct BackdropConstants in backdrop.h
+layout(push_constant) uniform Constants {
+        // Texture coordinates at the top left corner of the framebuffer
+        vec2 offset;
+        // Texture coordinates the framebuffer spans
+        vec2 scale;
+} constants;
+
+layout(location = 0) out vec2 out_uv;
+
+// One triangle covering the framebuffer
+vec2 corners[3] = vec2[](
+        vec2(0.0, 0.0),
+        vec2(2.0, 0.0),
+        vec2(0.0, 2.0)
+);
+
+void main()
+{
+        const vec2 corner = corners[gl_VertexIndex];
+
+        gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+        out_uv = constants.offset + corner * constants.scale;
+}
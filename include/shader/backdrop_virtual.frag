@@ -0,0 +1,17 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "overdraw.glsl"
+
+#define VIRTUAL_SET 0
+#define VIRTUAL_BINDING 0
+#include "virtual.glsl"
+
+layout(location = 0) in vec2 in_uv;
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+        out_color = apply_overdraw(vec4(sample_virtual(in_uv).rgb, 1.0));
+}
@@ -1,2 +1,9 @@
 glslc basic.vert -o basic_vs.spv
-glslc basic.frag -o basic_fs.spv
\ No newline at end of file
+glslc basic.frag -o basic_fs.spv
+glslc downsample.comp -o downsample_cs.spv
+glslc sprite_cull.comp -o sprite_cull_cs.spv
+glslc sprite.vert -o sprite_vs.spv
+glslc sprite.frag -o sprite_fs.spv
+glslc backdrop.vert -o backdrop_vs.spv
+glslc backdrop.frag -o backdrop_fs.spv
+glslc backdrop_virtual.frag -o backdrop_virtual_fs.spv
\ No newline at end of file
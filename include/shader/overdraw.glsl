@@ -0,0 +1,13 @@
+// Overdraw heatmap permutation, include with GL_GOOGLE_include_directive
+
+// Permutation feature bits, see enum ShaderFeature in shader.h
+layout(constant_id = 0) const bool OVERDRAW = false;
+
+/*
+ * Replaces color by a constant heat the overdraw pass blends additively.
+ * Eight layers saturate red, about twenty yellow and fifty white.
+ */
+vec4 apply_overdraw(vec4 color)
+{
+        return OVERDRAW ? vec4(0.125, 0.05, 0.02, 1.0) : color;
+}
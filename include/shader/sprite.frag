@@ -0,0 +1,13 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "overdraw.glsl"
+
+layout(location = 0) in vec4 in_color;
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+        out_color = apply_overdraw(in_color);
+}
@@ -0,0 +1,34 @@
+#version 450
+
+// One instance per sprite, see struct SpriteInstance in sprite.h
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 size;
+layout(location = 2) in float rotation;
+layout(location = 3) in uint color;
+
+layout(push_constant) uniform Constants {
+        // 2 / framebuffer extent, maps pixels to clip space
+        vec2 scale;
+} constants;
+
+layout(location = 0) out vec4 out_color;
+
+vec2 corners[6] = vec2[](
+        vec2(-0.5, -0.5),
+        vec2(0.5, -0.5),
+        vec2(0.5, 0.5),
+        vec2(-0.5, -0.5),
+        vec2(0.5, 0.5),
+        vec2(-0.5, 0.5)
+);
+
+void main()
+{
+        const vec2 corner = corners[gl_VertexIndex] * size;
+        const float s = sin(rotation);
+        const float c = cos(rotation);
+        const vec2 pixel = position + vec2(corner.x * c - corner.y * s, corner.x * s + corner.y * c);
+
+        gl_Position = vec4(pixel * constants.scale - 1.0, 0.0, 1.0);
+        out_color = unpackUnorm4x8(color);
+}
@@ -0,0 +1,83 @@
+// Virtual texture sampling, include with GL_GOOGLE_include_directive after
+// defining VIRTUAL_SET and VIRTUAL_BINDING. Needs fragmentStoresAndAtomics.
+
+// Page table entry bits, see virtual.h
+#define VIRTUAL_ENTRY_SLOT_MASK 0xffffu
+#define VIRTUAL_ENTRY_LEVEL_SHIFT 16u
+#define VIRTUAL_ENTRY_VALID 0x80000000u
+#define VIRTUAL_FEEDBACK_GRID 8u
+
+layout(set = VIRTUAL_SET, binding = VIRTUAL_BINDING) uniform sampler2D virtual_cache;
+
+// Matches struct VirtualHeader in virtual.h
+layout(std430, set = VIRTUAL_SET, binding = VIRTUAL_BINDING + 1) readonly buffer VirtualPages {
+        uint width;
+        uint height;
+        uint level_count;
+        uint slots_per_row;
+        uint cache_width;
+        uint cache_height;
+        uint page_size;
+        uint border;
+        uint jitter;
+        uint padding[3];
+        uint level_offsets[16];
+        uint level_pages[16];
+        uint entries[];
+} virtual_pages;
+
+// One bit per page, read and cleared by update_virtual_texture()
+layout(std430, set = VIRTUAL_SET, binding = VIRTUAL_BINDING + 2) buffer VirtualFeedback {
+        uint bits[];
+} virtual_feedback;
+
+uint get_virtual_page(uint level, vec2 uv)
+{
+        const uvec2 size = max(uvec2(virtual_pages.width, virtual_pages.height) >> level,
+                uvec2(1));
+        const uvec2 texel = min(uvec2(uv * vec2(size)), size - 1);
+        const uvec2 page = texel / virtual_pages.page_size;
+
+        return virtual_pages.level_offsets[level] + page.y * virtual_pages.level_pages[level] +
+                page.x;
+}
+
+vec4 sample_virtual(vec2 uv)
+{
+        const vec2 texels = uv * vec2(virtual_pages.width, virtual_pages.height);
+        const vec2 dx = dFdx(texels);
+        const vec2 dy = dFdy(texels);
+        const float lod = clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0,
+                float(virtual_pages.level_count - 1));
+        const uint wanted = uint(lod);
+
+        uv = clamp(uv, 0.0, 1.0);
+
+        const uint page = get_virtual_page(wanted, uv);
+        const uvec2 pixel = uvec2(gl_FragCoord.xy) % VIRTUAL_FEEDBACK_GRID;
+
+        // A single pixel of every block reports, enough to find every page on screen
+        if (pixel.x + pixel.y * VIRTUAL_FEEDBACK_GRID == virtual_pages.jitter)
+                atomicOr(virtual_feedback.bits[page / 32u], 1u << (page % 32u));
+
+        const uint entry = virtual_pages.entries[page];
+
+        if ((entry & VIRTUAL_ENTRY_VALID) == 0u)
+                return vec4(0.0);
+
+        // Falls back to the coarser level the entry points at
+        const uint level = (entry >> VIRTUAL_ENTRY_LEVEL_SHIFT) & 0xfu;
+        const uint slot = entry & VIRTUAL_ENTRY_SLOT_MASK;
+        const vec2 size = vec2(max(uvec2(virtual_pages.width, virtual_pages.height) >> level,
+                uvec2(1)));
+        const vec2 texel = uv * size;
+        const vec2 page_origin = floor(texel / float(virtual_pages.page_size)) *
+                float(virtual_pages.page_size);
+        const vec2 slot_origin = vec2(slot % virtual_pages.slots_per_row,
+                slot / virtual_pages.slots_per_row) *
+                float(virtual_pages.page_size + virtual_pages.border * 2u);
+        const vec2 cache_texel = slot_origin + float(virtual_pages.border) + texel - page_origin;
+
+        return textureLod(virtual_cache, cache_texel /
+                vec2(virtual_pages.cache_width, virtual_pages.cache_height), 0.0);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ecs.h"
+
+// Matches the instance attributes of sprite.vert
+struct SpriteInstance {
+    // Center in pixels from the top left of the framebuffer
+    float position[2];
+    float size[2];
+    // Radians, clockwise
+    float rotation;
+    // RGBA8, red in the lowest byte
+    uint32_t color;
+};
+
+// 16 byte aligned so a chunk's transforms load straight into SIMD registers
+struct Transform {
+    float x;
+    float y;
+    float rotation;
+    float scale;
+};
+
+struct Sprite {
+    float width;
+    float height;
+    uint32_t color;
+};
+
+struct SpriteComponents {
+    uint32_t transform;
+    uint32_t sprite;
+    // Transform as of the previous tick, only moving sprites need one
+    uint32_t previous;
+};
+
+// Instances gathered for one frame, reused between frames
+struct SpriteBatch {
+    uint32_t count;
+    uint32_t capacity;
+    struct SpriteInstance *instances;
+};
+
+void register_sprite_components(struct World *world, struct SpriteComponents *components);
+
+// Call at the start of every tick, before anything moves
+void save_sprite_transforms(struct World *world, const struct SpriteComponents *components);
+
+/*
+ * Interleaves the transform and sprite columns of every chunk into
+ * batch->instances in chunk order, ready to be copied to the GPU in one go.
+ * Sprites with a previous transform are placed alpha of the way from it to
+ * the current one. batch should be cleaned up by destroy_sprite_batch()
+ */
+void gather_sprites(struct World *world, const struct SpriteComponents *components, float alpha,
+    struct SpriteBatch *batch);
+
+void destroy_sprite_batch(struct SpriteBatch *batch);
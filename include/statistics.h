@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "record.h"
+
+// One query per draw pass, indexed like DrawPassList.entries
+#define STATISTICS_MAX_QUERIES DRAW_PASS_MAX
+// Results come back in bit order, see struct PipelineCounts
+#define STATISTICS_FLAGS (VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
+
+struct PipelineCounts {
+    uint64_t vertex_invocations;
+    // Primitives that reached clipping and the primitives clipping output
+    uint64_t clipping_invocations;
+    uint64_t clipping_primitives;
+    uint64_t fragment_invocations;
+};
+
+/*
+ * Pipeline statistics queries around every draw pass. Like GpuTimers the
+ * results of a frame are read FRAMES_IN_FLIGHT frames later, after the
+ * frame's fence, so reading never stalls.
+ */
+struct PipelineStatistics {
+    VkDevice device;
+    // VK_NULL_HANDLE when disabled or pipelineStatisticsQuery is unsupported
+    VkQueryPool pool;
+    uint32_t frame;
+    // Queries each frame in flight writes, the first query_counts[i] of its range
+    uint32_t query_counts[FRAMES_IN_FLIGHT];
+    // Counts of the last frame read back, per query
+    uint32_t count;
+    struct PipelineCounts counts[STATISTICS_MAX_QUERIES];
+};
+
+/*
+ * The device needs pipelineStatisticsQuery when enabled. stats should be
+ * cleaned up by destroy_pipeline_statistics()
+ */
+void create_pipeline_statistics(VkDevice device, int enabled, struct PipelineStatistics *stats);
+
+/*
+ * Call outside a render pass after the frame's fence. Reads back the frame's
+ * previous queries and resets the first query_count, every one of which the
+ * frame has to write.
+ */
+void begin_pipeline_statistics(struct PipelineStatistics *stats, VkCommandBuffer buffer,
+    uint32_t frame, uint32_t query_count);
+
+/*
+ * Queries do not nest. Inside a render pass a query has to end in the same
+ * subpass and command buffer, so cached secondaries hold their own query,
+ * which stays valid because every frame resets its range before executing it.
+ */
+void begin_statistics_query(struct PipelineStatistics *stats, VkCommandBuffer buffer,
+    uint32_t index);
+
+void end_statistics_query(struct PipelineStatistics *stats, VkCommandBuffer buffer,
+    uint32_t index);
+
+// Sum over every query of the last frame read back
+void get_pipeline_totals(const struct PipelineStatistics *stats, struct PipelineCounts *totals);
+
+void destroy_pipeline_statistics(struct PipelineStatistics *stats);
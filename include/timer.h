@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "record.h"
+
+#define GPU_TIMER_MAX_SCOPES 16u
+
+// Scopes written by one frame in flight, read back when the slot is reused
+struct GpuTimerFrame {
+    uint32_t count;
+    // Index into GpuTimers.names of each scope
+    uint32_t scopes[GPU_TIMER_MAX_SCOPES];
+};
+
+/*
+ * Timestamp pairs around GPU work, averaged per scope name. Results are read
+ * FRAMES_IN_FLIGHT frames later without stalling, after the frame's fence.
+ */
+struct GpuTimers {
+    VkDevice device;
+    // VK_NULL_HANDLE when the graphics family cannot write timestamps
+    VkQueryPool pool;
+    // Nanoseconds per timestamp tick
+    double period;
+    uint64_t valid_mask;
+    uint32_t frame;
+    struct GpuTimerFrame frames[FRAMES_IN_FLIGHT];
+    uint32_t name_count;
+    const char *names[GPU_TIMER_MAX_SCOPES];
+    // Smoothed seconds per scope name
+    double times[GPU_TIMER_MAX_SCOPES];
+};
+
+// timers should be cleaned up by destroy_gpu_timers()
+void create_gpu_timers(VkDevice device, VkPhysicalDevice gpu, uint32_t family,
+    struct GpuTimers *timers);
+
+// Call after the frame's fence, reads back its previous scopes and resets its queries
+void begin_gpu_timers(struct GpuTimers *timers, VkCommandBuffer buffer, uint32_t frame);
+
+// name must outlive timers, returns the scope to end
+uint32_t begin_gpu_scope(struct GpuTimers *timers, VkCommandBuffer buffer, const char *name);
+
+void end_gpu_scope(struct GpuTimers *timers, VkCommandBuffer buffer, uint32_t scope);
+
+// Smoothed seconds spent in name, 0 when it was never measured
+double get_gpu_time(const struct GpuTimers *timers, const char *name);
+
+void destroy_gpu_timers(struct GpuTimers *timers);
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "memory.h"
+#include "mips.h"
+#include "pack.h"
+#include "record.h"
+
+#define UPLOAD_STAGING_SIZE (32u * 1024u * 1024u)
+#define UPLOAD_MAX_DECODES 16u
+#define UPLOAD_MAX_LEVELS 16u
+
+// A texture in a format the device cannot sample, decoded to RGBA8 on its own thread
+struct DecodeJob {
+    pthread_t thread;
+    const struct PackEntry *entry;
+    const uint8_t *src;
+    // Decoded mip chain laid out like a pack payload
+    uint8_t *pixels;
+    VkDeviceSize size;
+    struct Texture *texture;
+};
+
+/*
+ * Copies pack payloads into device local resources. Payloads are copied
+ * straight from the pack mapping into a persistently mapped staging buffer,
+ * or with VK_EXT_external_memory_host the mapping itself is imported as the
+ * transfer source and the CPU copies nothing.
+ */
+struct Uploader {
+    VkDevice device;
+    VkPhysicalDevice gpu;
+    VkQueue queue;
+    VkCommandPool pool;
+    VkCommandBuffer buffer;
+    VkFence fence;
+    int recording;
+    struct GpuBuffer staging;
+    VkDeviceSize staging_offset;
+    // 0 when VK_EXT_external_memory_host is not enabled
+    VkDeviceSize import_alignment;
+    // Pack whose mapping is imported, NULL while uploads go through staging
+    const struct AssetPack *imported_pack;
+    VkBuffer imported;
+    VkDeviceMemory imported_memory;
+    // Bytes the CPU copied and bytes the GPU read directly from the mapping
+    uint64_t staged_bytes;
+    uint64_t imported_bytes;
+    // TextureFamily bits enabled on the device
+    uint32_t texture_families;
+    // Print the memory use of every texture
+    int report;
+    uint32_t decode_count;
+    struct DecodeJob decodes[UPLOAD_MAX_DECODES];
+    // Device bytes of uploaded textures and what they would take as RGBA8
+    uint64_t texture_bytes;
+    uint64_t uncompressed_bytes;
+    // Generates missing mip levels, NULL uploads only the levels a pack stores
+    struct MipGenerator *mips;
+};
+
+/*
+ * A pack texture whose most detailed levels are only uploaded once the view
+ * needs them. Growing builds a larger texture in the background and swaps it
+ * in once the GPU finished, so descriptors referencing it have to be
+ * rewritten after update_streamed_texture() returned true.
+ */
+struct StreamedTexture {
+    const struct PackEntry *entry;
+    // Level i holds level resident_level + i of the entry
+    struct Texture texture;
+    uint32_t resident_level;
+    // Most detailed level requested since the texture was created
+    uint32_t wanted_level;
+    // Texture being grown from grown_level while growing is set
+    int growing;
+    struct Texture grown;
+    uint32_t grown_level;
+    // Submits the growth on the uploader's queue, VK_NULL_HANDLE until the first one
+    VkCommandBuffer buffer;
+    VkFence fence;
+    // Levels read from the pack for the growth, released when it finishes
+    struct GpuBuffer staging;
+    // Replaced texture, destroyed once frames in flight no longer sample it
+    struct Texture retired;
+    uint32_t retire_countdown;
+};
+
+/*
+ * uploader should be cleaned up by destroy_uploader(), host_import requires
+ * VK_EXT_external_memory_host to be enabled on device and texture_families
+ * are the compression features enabled on it
+ */
+void create_uploader(VkDevice device, VkPhysicalDevice gpu, VkQueue queue, uint32_t family,
+    int host_import, uint32_t texture_families, struct Uploader *uploader);
+
+// Whether textures in format can be uploaded without decoding them on the CPU
+int is_texture_format_supported(const struct Uploader *uploader, VkFormat format);
+
+// Imports the mapping of pack when possible, uploads from pack should follow
+void begin_pack_uploads(struct Uploader *uploader, const struct AssetPack *pack);
+
+/*
+ * texture should be cleaned up by destroy_texture(), ready for sampling after
+ * a flush. Formats the device lacks are decoded on a worker thread until then.
+ */
+void upload_pack_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, struct Texture *texture);
+
+/*
+ * Same as upload_pack_texture() but levels the pack does not store are
+ * generated on the GPU from the smallest stored one, when uploader->mips is
+ * set and the format allows it
+ */
+void upload_pack_texture_mipmapped(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, struct Texture *texture);
+
+/*
+ * Uploads the levels of entry no larger than resident_size, the rest waits
+ * for request_texture_detail(). Entries without a full chain or in a format
+ * that is decoded are uploaded whole, with missing levels generated.
+ * streamed should be cleaned up by destroy_streamed_texture()
+ */
+void create_streamed_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, uint32_t resident_size, struct StreamedTexture *streamed);
+
+// scale is screen pixels per texel of level 0 where the texture is drawn
+void request_texture_detail(struct StreamedTexture *streamed, float scale);
+
+/*
+ * Call once per frame. Starts uploading requested levels without waiting for
+ * them and returns true when streamed->texture was replaced.
+ */
+int update_streamed_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    struct StreamedTexture *streamed);
+
+void destroy_streamed_texture(struct Uploader *uploader, struct StreamedTexture *streamed);
+
+// buffer should be cleaned up by destroy_buffer(), usage gains TRANSFER_DST
+void upload_pack_buffer(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, VkBufferUsageFlags usage, struct GpuBuffer *buffer);
+
+// Finishes pending decodes, submits recorded copies and waits for them
+void flush_uploads(struct Uploader *uploader);
+
+// Flushes and releases the imported mapping
+void end_pack_uploads(struct Uploader *uploader);
+
+void destroy_uploader(struct Uploader *uploader);
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "memory.h"
+#include "pack.h"
+#include "record.h"
+#include "upload.h"
+
+#define VIRTUAL_PAGE_SIZE 128u
+// Keeps bilinear filtering inside a page, a multiple of the 4x4 block size
+#define VIRTUAL_PAGE_BORDER 4u
+#define VIRTUAL_SLOT_SIZE (VIRTUAL_PAGE_SIZE + VIRTUAL_PAGE_BORDER * 2u)
+#define VIRTUAL_MAX_LEVELS 16u
+#define VIRTUAL_MAX_REQUESTS 256u
+#define VIRTUAL_STAGING_PAGES 32u
+// Pages copied into the cache per frame, bounds the frame time spent streaming
+#define VIRTUAL_UPLOADS_PER_FRAME 8u
+// Feedback is written by one pixel of every 8x8 block, a different one each frame
+#define VIRTUAL_FEEDBACK_GRID 8u
+
+// Page table entry bits, matching virtual.glsl
+#define VIRTUAL_ENTRY_SLOT_MASK 0xffffu
+#define VIRTUAL_ENTRY_LEVEL_SHIFT 16u
+#define VIRTUAL_ENTRY_VALID (1u << 31)
+
+// Start of the page table buffer, std430 layout of VirtualHeader in virtual.glsl
+struct VirtualHeader {
+    uint32_t width;
+    uint32_t height;
+    // Levels addressed through pages, the last one fits in a single page
+    uint32_t level_count;
+    uint32_t slots_per_row;
+    uint32_t cache_width;
+    uint32_t cache_height;
+    uint32_t page_size;
+    uint32_t border;
+    // Pixel of each 8x8 block that writes feedback this frame, x | y << 3
+    uint32_t jitter;
+    uint32_t padding[3];
+    uint32_t level_offsets[VIRTUAL_MAX_LEVELS];
+    uint32_t level_pages[VIRTUAL_MAX_LEVELS];
+};
+
+enum VirtualPageState {
+    VIRTUAL_PAGE_ABSENT,
+    VIRTUAL_PAGE_QUEUED,
+    VIRTUAL_PAGE_RESIDENT
+};
+
+enum VirtualStagingState {
+    VIRTUAL_STAGING_FREE,
+    // Owned by the streaming thread
+    VIRTUAL_STAGING_FILLING,
+    VIRTUAL_STAGING_READY,
+    // Copied by the frame in flight stored with it
+    VIRTUAL_STAGING_IN_FLIGHT
+};
+
+struct VirtualStagingPage {
+    enum VirtualStagingState state;
+    uint32_t page;
+    uint32_t frame;
+};
+
+/*
+ * A pack texture far larger than the budget, split into pages of
+ * VIRTUAL_PAGE_SIZE texels. Shaders sample it through virtual.glsl, which
+ * resolves pages through the page table, falls back to the closest resident
+ * coarser page and marks the pages it wanted in the feedback buffer. A
+ * streaming thread reads missing pages from the pack mapping into staging
+ * while the frame only records the copies.
+ */
+struct VirtualTexture {
+    VkDevice device;
+    const struct AssetPack *pack;
+    const struct PackEntry *entry;
+    int report;
+    // Texels per block and bytes per block of the format
+    uint32_t block_size;
+    uint32_t block_bytes;
+    uint32_t level_count;
+    uint32_t page_count;
+    VkDeviceSize level_offsets[VIRTUAL_MAX_LEVELS];
+    // CPU copy of the page table header, the streaming thread reads it too
+    struct VirtualHeader header;
+    // Physical cache of slot_count pages, one slot is pinned to the last level
+    struct Texture cache;
+    uint32_t slot_count;
+    uint32_t slots_per_row;
+    // Per page, UINT32_MAX when not resident
+    uint32_t *page_slots;
+    uint8_t *page_states;
+    // Page table built on the CPU, copied to a frame's buffer when it is stale
+    uint32_t *entries;
+    uint64_t version;
+    uint64_t frame_versions[FRAMES_IN_FLIGHT];
+    struct GpuBuffer page_tables[FRAMES_IN_FLIGHT];
+    struct GpuBuffer feedback[FRAMES_IN_FLIGHT];
+    VkDeviceSize feedback_size;
+    // Per slot page and least recently used order, head is the most recent
+    uint32_t *slot_pages;
+    uint32_t *slot_prev;
+    uint32_t *slot_next;
+    // Frame counter value when the slot's page was last wanted
+    uint64_t *slot_used;
+    uint32_t lru_head;
+    uint32_t lru_tail;
+    uint64_t frames;
+    // The cache is still undefined until the first update
+    int initialized;
+    // Shared with the streaming thread under lock
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int running;
+    uint32_t request_start;
+    uint32_t request_count;
+    uint32_t requests[VIRTUAL_MAX_REQUESTS];
+    struct GpuBuffer staging;
+    VkDeviceSize staging_page_size;
+    struct VirtualStagingPage staging_pages[VIRTUAL_STAGING_PAGES];
+    uint64_t streamed_pages;
+    uint64_t evicted_pages;
+};
+
+/*
+ * entry must be a mipmapped texture in pack, budget is the size of the
+ * physical cache in bytes. texture should be cleaned up by
+ * destroy_virtual_texture()
+ */
+void create_virtual_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, VkDeviceSize budget, struct VirtualTexture *texture);
+
+/*
+ * Call while recording frame, outside a render pass, once the frame's fence
+ * has been waited on. Reads the frame's previous feedback, queues missing
+ * pages and records copies of streamed ones.
+ */
+void update_virtual_texture(struct VirtualTexture *texture, VkCommandBuffer buffer,
+    uint32_t frame);
+
+/*
+ * Call after the last pass sampling a virtual texture, makes its feedback
+ * writes visible to the host once the frame's fence signals
+ */
+void record_virtual_feedback_barrier(VkCommandBuffer buffer);
+
+/*
+ * True while pages are queued, being read or waiting for their copy to
+ * finish, every frame has to be recorded until then for them to show
+ */
+int is_virtual_texture_streaming(struct VirtualTexture *texture);
+
+// Page table and feedback buffers the shaders of frame have to bind
+VkBuffer get_virtual_page_table(const struct VirtualTexture *texture, uint32_t frame);
+
+VkBuffer get_virtual_feedback(const struct VirtualTexture *texture, uint32_t frame);
+
+void destroy_virtual_texture(struct VirtualTexture *texture);
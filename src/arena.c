@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "error.h"
+
+void create_arena(const char *name, size_t capacity, struct Arena *arena)
+{
+    arena->name = name;
+    arena->base = malloc(capacity);
+    arena->capacity = capacity;
+    arena->offset = 0;
+    arena->high_water = 0;
+
+    if (arena->base == NULL)
+        print_exit("Failed to allocate an arena!");
+}
+
+void *allocate_arena(struct Arena *arena, size_t size, size_t alignment)
+{
+    const size_t start = (arena->offset + alignment - 1) & ~(alignment - 1);
+
+    if (start < arena->offset || start > arena->capacity || size > arena->capacity - start) {
+        fprintf(stderr, "Arena %s: %zu bytes requested with %zu of %zu bytes used\n",
+            arena->name, size, arena->offset, arena->capacity);
+        print_exit("Failed to allocate from an arena, capacity exceeded!");
+    }
+
+    arena->offset = start + size;
+
+    if (arena->offset > arena->high_water)
+        arena->high_water = arena->offset;
+
+    return arena->base + start;
+}
+
+void *allocate_array(struct Arena *arena, size_t count, size_t size, size_t alignment)
+{
+    if (size != 0 && count > SIZE_MAX / size)
+        print_exit("Failed to allocate from an arena, array size overflows!");
+
+    return allocate_arena(arena, count * size, alignment);
+}
+
+void *grow_array(void *data, uint32_t *capacity, uint32_t needed, size_t size)
+{
+    if (needed <= *capacity)
+        return data;
+
+    while (*capacity < needed)
+        *capacity = *capacity > 0 ? *capacity * 2 : 1024;
+
+    return realloc(data, *capacity * size);
+}
+
+size_t get_arena_mark(const struct Arena *arena)
+{
+    return arena->offset;
+}
+
+void reset_arena(struct Arena *arena, size_t mark)
+{
+    arena->offset = mark;
+}
+
+void print_arena_usage(const struct Arena *arena)
+{
+    printf("Arena %s: high water %zu of %zu bytes\n", arena->name, arena->high_water,
+        arena->capacity);
+}
+
+void destroy_arena(struct Arena *arena)
+{
+    free(arena->base);
+}
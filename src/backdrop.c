@@ -0,0 +1,237 @@
+#include <math.h>
+#include <string.h>
+
+#include "backdrop.h"
+#include "debug.h"
+#include "instance.h"
+
+#define ALL_SETS ((1u << FRAMES_IN_FLIGHT) - 1u)
+
+// Virtual backdrops also bind the page table and the feedback of every frame
+static void create_sets(VkDescriptorSetLayout set_layout, struct Backdrop *backdrop)
+{
+    VkDescriptorPoolSize sizes[2] = {};
+    sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    sizes[0].descriptorCount = FRAMES_IN_FLIGHT;
+    sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    sizes[1].descriptorCount = FRAMES_IN_FLIGHT * 2;
+
+    VkDescriptorPoolCreateInfo poolinfo = {};
+    poolinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolinfo.maxSets = FRAMES_IN_FLIGHT;
+    poolinfo.poolSizeCount = backdrop->virtual_texture != NULL ? 2 : 1;
+    poolinfo.pPoolSizes = sizes;
+
+    assert_vulkan(vkCreateDescriptorPool(backdrop->device, &poolinfo, NULL, &backdrop->pool),
+        "Failed to create a Vulkan descriptor pool!");
+
+    VkDescriptorSetLayout layouts[FRAMES_IN_FLIGHT];
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i)
+        layouts[i] = set_layout;
+
+    VkDescriptorSetAllocateInfo allocinfo = {};
+    allocinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocinfo.descriptorPool = backdrop->pool;
+    allocinfo.descriptorSetCount = FRAMES_IN_FLIGHT;
+    allocinfo.pSetLayouts = layouts;
+
+    assert_vulkan(vkAllocateDescriptorSets(backdrop->device, &allocinfo, backdrop->sets),
+        "Failed to allocate Vulkan descriptor sets!");
+
+    // Every level is sampled, the view decides which through the derivatives
+    VkSamplerCreateInfo samplerinfo = {};
+    samplerinfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerinfo.magFilter = VK_FILTER_LINEAR;
+    samplerinfo.minFilter = VK_FILTER_LINEAR;
+    samplerinfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerinfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerinfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerinfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerinfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    assert_vulkan(vkCreateSampler(backdrop->device, &samplerinfo, NULL, &backdrop->sampler),
+        "Failed to create a Vulkan sampler!");
+
+    set_debug_name(backdrop->device, VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)backdrop->pool,
+        "backdrop descriptors");
+    set_debug_name(backdrop->device, VK_OBJECT_TYPE_SAMPLER, (uint64_t)backdrop->sampler,
+        "backdrop sampler");
+}
+
+void create_backdrop(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, VkDescriptorSetLayout set_layout, struct Backdrop *backdrop)
+{
+    memset(backdrop, 0, sizeof(*backdrop));
+    backdrop->device = uploader->device;
+    backdrop->entry = entry;
+    backdrop->center[0] = 0.5f;
+    backdrop->center[1] = 0.5f;
+    backdrop->zoom = 1.0f;
+
+    create_streamed_texture(uploader, pack, entry, BACKDROP_RESIDENT_SIZE, &backdrop->streamed);
+    create_sets(set_layout, backdrop);
+    backdrop->stale_sets = ALL_SETS;
+}
+
+// The sets never change, the cache and the buffers of every frame live as long as texture
+static void write_virtual_sets(struct Backdrop *backdrop)
+{
+    const struct VirtualTexture *texture = backdrop->virtual_texture;
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorImageInfo imageinfo = {};
+        imageinfo.sampler = backdrop->sampler;
+        imageinfo.imageView = texture->cache.view;
+        imageinfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkDescriptorBufferInfo bufferinfos[2] = {};
+        bufferinfos[0].buffer = get_virtual_page_table(texture, i);
+        bufferinfos[0].range = VK_WHOLE_SIZE;
+        bufferinfos[1].buffer = get_virtual_feedback(texture, i);
+        bufferinfos[1].range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet writes[2] = {};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = backdrop->sets[i];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &imageinfo;
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = backdrop->sets[i];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 2;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].pBufferInfo = bufferinfos;
+
+        vkUpdateDescriptorSets(backdrop->device, 2, writes, 0, NULL);
+    }
+}
+
+void create_virtual_backdrop(struct VirtualTexture *texture, VkDescriptorSetLayout set_layout,
+    struct Backdrop *backdrop)
+{
+    memset(backdrop, 0, sizeof(*backdrop));
+    backdrop->device = texture->device;
+    backdrop->entry = texture->entry;
+    backdrop->virtual_texture = texture;
+    backdrop->settle_frames = FRAMES_IN_FLIGHT + 1;
+    backdrop->center[0] = 0.5f;
+    backdrop->center[1] = 0.5f;
+    backdrop->zoom = 1.0f;
+
+    create_sets(set_layout, backdrop);
+    write_virtual_sets(backdrop);
+}
+
+int set_backdrop_view(struct Backdrop *backdrop, float x, float y, float zoom)
+{
+    zoom = zoom > 1.0f ? zoom : 1.0f;
+
+    if (backdrop->center[0] == x && backdrop->center[1] == y && backdrop->zoom == zoom)
+        return 0;
+
+    backdrop->center[0] = x;
+    backdrop->center[1] = y;
+    backdrop->zoom = zoom;
+    // Feedback of the frame showing the new view is read FRAMES_IN_FLIGHT frames later
+    backdrop->settle_frames = FRAMES_IN_FLIGHT + 1;
+
+    return 1;
+}
+
+// Framebuffer pixels per texel of level 0
+static float get_pixels_per_texel(const struct Backdrop *backdrop, VkExtent2D extent)
+{
+    const struct PackEntry *entry = backdrop->entry;
+
+    return fmaxf((float)extent.width / entry->width, (float)extent.height / entry->height) *
+        backdrop->zoom;
+}
+
+// The view is kept inside the texture, so the edges are never stretched
+static void get_constants(const struct Backdrop *backdrop, VkExtent2D extent,
+    struct BackdropConstants *constants)
+{
+    const struct PackEntry *entry = backdrop->entry;
+    const float pixels = get_pixels_per_texel(backdrop, extent);
+    const float sizes[2] = {(float)entry->width, (float)entry->height};
+    const float extents[2] = {(float)extent.width, (float)extent.height};
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        const float scale = extents[i] / (pixels * sizes[i]);
+        const float half = scale * 0.5f;
+
+        constants->scale[i] = scale;
+        constants->offset[i] = fminf(fmaxf(backdrop->center[i], half), 1.0f - half) - half;
+    }
+}
+
+static void write_set(struct Backdrop *backdrop, uint32_t frame)
+{
+    VkDescriptorImageInfo imageinfo = {};
+    imageinfo.sampler = backdrop->sampler;
+    imageinfo.imageView = backdrop->streamed.texture.view;
+    imageinfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = backdrop->sets[frame];
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageinfo;
+
+    vkUpdateDescriptorSets(backdrop->device, 1, &write, 0, NULL);
+}
+
+int update_backdrop(struct Backdrop *backdrop, struct Uploader *uploader,
+    const struct AssetPack *pack, VkExtent2D extent, uint32_t frame)
+{
+    if (backdrop->virtual_texture != NULL) {
+        const int settling = backdrop->settle_frames > 0;
+
+        if (settling)
+            --backdrop->settle_frames;
+
+        return settling || is_virtual_texture_streaming(backdrop->virtual_texture);
+    }
+
+    request_texture_detail(&backdrop->streamed, get_pixels_per_texel(backdrop, extent));
+
+    const int replaced = update_streamed_texture(uploader, pack, &backdrop->streamed);
+
+    // Sets of frames still in flight are rewritten once their frame comes around
+    if (replaced)
+        backdrop->stale_sets = ALL_SETS;
+
+    if (backdrop->stale_sets & 1u << frame) {
+        write_set(backdrop, frame);
+        backdrop->stale_sets &= ~(1u << frame);
+    }
+
+    return replaced;
+}
+
+void record_backdrop(const struct Backdrop *backdrop, VkCommandBuffer buffer,
+    VkPipelineLayout layout, VkExtent2D extent, uint32_t frame)
+{
+    struct BackdropConstants constants;
+    get_constants(backdrop, extent, &constants);
+
+    vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1,
+        &backdrop->sets[frame], 0, NULL);
+    vkCmdPushConstants(buffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+        &constants);
+    vkCmdDraw(buffer, 3, 1, 0, 0);
+}
+
+void destroy_backdrop(struct Uploader *uploader, struct Backdrop *backdrop)
+{
+    vkDestroySampler(backdrop->device, backdrop->sampler, NULL);
+    vkDestroyDescriptorPool(backdrop->device, backdrop->pool, NULL);
+
+    if (backdrop->virtual_texture == NULL)
+        destroy_streamed_texture(uploader, &backdrop->streamed);
+}
@@ -0,0 +1,395 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "arena.h"
+#include "broadphase.h"
+
+// Lanes of one AABB test, the scratch arrays are padded by this many empty boxes
+#define TEST_WIDTH 4u
+
+void create_broadphase(float cell_size, struct JobPool *pool, struct Broadphase *broadphase)
+{
+    memset(broadphase, 0, sizeof(*broadphase));
+    broadphase->cell_size = cell_size;
+    broadphase->inverse_cell_size = 1.0f / cell_size;
+    broadphase->pool = pool;
+}
+
+static uint32_t get_cell_key(int32_t x, int32_t y)
+{
+    return ((uint32_t)x & 0xffffu) | ((uint32_t)y & 0xffffu) << 16;
+}
+
+static int32_t get_cell(const struct Broadphase *broadphase, float position)
+{
+    return (int32_t)floorf(position * broadphase->inverse_cell_size);
+}
+
+static void grow_boxes(struct Broadphase *broadphase, uint32_t count)
+{
+    uint32_t capacity = broadphase->box_capacity;
+
+    if (count <= capacity)
+        return;
+
+    while (capacity < count)
+        capacity = capacity > 0 ? capacity * 2 : 1024;
+
+    broadphase->min_x = realloc(broadphase->min_x, capacity * sizeof(float));
+    broadphase->min_y = realloc(broadphase->min_y, capacity * sizeof(float));
+    broadphase->max_x = realloc(broadphase->max_x, capacity * sizeof(float));
+    broadphase->max_y = realloc(broadphase->max_y, capacity * sizeof(float));
+    broadphase->rects = realloc(broadphase->rects, capacity * sizeof(struct CellRect));
+    broadphase->moved = realloc(broadphase->moved, capacity);
+    broadphase->box_capacity = capacity;
+}
+
+// Flags the boxes that cover different cells than when their entries were built
+static uint32_t find_moved_boxes(struct Broadphase *broadphase, const struct Aabb *boxes,
+    uint32_t count)
+{
+    uint32_t moved_cells = 0;
+    broadphase->moved_count = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        struct CellRect rect;
+        rect.min_x = get_cell(broadphase, boxes[i].min_x);
+        rect.min_y = get_cell(broadphase, boxes[i].min_y);
+        rect.max_x = get_cell(broadphase, boxes[i].max_x);
+        rect.max_y = get_cell(broadphase, boxes[i].max_y);
+
+        broadphase->min_x[i] = boxes[i].min_x;
+        broadphase->min_y[i] = boxes[i].min_y;
+        broadphase->max_x[i] = boxes[i].max_x;
+        broadphase->max_y[i] = boxes[i].max_y;
+        broadphase->moved[i] = i >= broadphase->box_count ||
+            memcmp(&rect, &broadphase->rects[i], sizeof(rect)) != 0;
+
+        if (broadphase->moved[i]) {
+            broadphase->rects[i] = rect;
+            moved_cells += (uint32_t)(rect.max_x - rect.min_x + 1) *
+                (uint32_t)(rect.max_y - rect.min_y + 1);
+            ++broadphase->moved_count;
+        }
+    }
+
+    return moved_cells;
+}
+
+// Stable LSD radix sort by key, bytes every entry shares are skipped
+static void sort_entries(struct CellEntry *entries, struct CellEntry *temp, uint32_t count)
+{
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        uint32_t offsets[256] = {};
+
+        for (uint32_t i = 0; i < count; ++i)
+            ++offsets[entries[i].key >> shift & 0xffu];
+
+        if (count == 0 || offsets[entries[0].key >> shift & 0xffu] == count)
+            continue;
+
+        for (uint32_t i = 0, sum = 0; i < 256; ++i) {
+            const uint32_t bucket = offsets[i];
+            offsets[i] = sum;
+            sum += bucket;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+            temp[offsets[entries[i].key >> shift & 0xffu]++] = entries[i];
+
+        memcpy(entries, temp, count * sizeof(struct CellEntry));
+    }
+}
+
+static uint32_t create_moved_entries(struct Broadphase *broadphase, uint32_t count)
+{
+    uint32_t moved_count = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!broadphase->moved[i])
+            continue;
+
+        const struct CellRect *rect = &broadphase->rects[i];
+
+        for (int32_t y = rect->min_y; y <= rect->max_y; ++y)
+            for (int32_t x = rect->min_x; x <= rect->max_x; ++x) {
+                broadphase->moved_entries[moved_count].key = get_cell_key(x, y);
+                broadphase->moved_entries[moved_count++].box = i;
+            }
+    }
+
+    return moved_count;
+}
+
+// Entries of boxes that neither moved nor were dropped, still sorted
+static uint32_t keep_entries(struct Broadphase *broadphase, uint32_t count)
+{
+    uint32_t kept = 0;
+
+    for (uint32_t i = 0; i < broadphase->entry_count; ++i) {
+        const uint32_t box = broadphase->entries[i].box;
+
+        if (box < count && !broadphase->moved[box])
+            broadphase->scratch[kept++] = broadphase->entries[i];
+    }
+
+    return kept;
+}
+
+static void merge_entries(struct Broadphase *broadphase, uint32_t kept, uint32_t moved)
+{
+    const struct CellEntry *left = broadphase->scratch;
+    const struct CellEntry *right = broadphase->moved_entries;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t k = 0;
+
+    while (i < kept && j < moved)
+        broadphase->entries[k++] = right[j].key < left[i].key ? right[j++] : left[i++];
+    while (i < kept)
+        broadphase->entries[k++] = left[i++];
+    while (j < moved)
+        broadphase->entries[k++] = right[j++];
+
+    broadphase->entry_count = k;
+}
+
+static void find_cells(struct Broadphase *broadphase)
+{
+    broadphase->cell_count = 0;
+
+    for (uint32_t i = 0; i < broadphase->entry_count; ++i)
+        if (i == 0 || broadphase->entries[i].key != broadphase->entries[i - 1].key)
+            broadphase->cell_starts[broadphase->cell_count++] = i;
+
+    broadphase->cell_starts[broadphase->cell_count] = broadphase->entry_count;
+}
+
+void update_broadphase(struct Broadphase *broadphase, const struct Aabb *boxes, uint32_t count)
+{
+    grow_boxes(broadphase, count);
+
+    const uint32_t moved_cells = find_moved_boxes(broadphase, boxes, count);
+    // Upper bound, the moved boxes' old entries are among the ones dropped
+    const uint32_t needed = broadphase->entry_count + moved_cells;
+    uint32_t capacity = broadphase->entry_capacity;
+
+    // cell_starts always holds at least the end of the last run
+    if (needed > capacity || capacity == 0) {
+        while (capacity < needed || capacity == 0)
+            capacity = capacity > 0 ? capacity * 2 : 1024;
+
+        broadphase->entries = realloc(broadphase->entries, capacity * sizeof(struct CellEntry));
+        broadphase->scratch = realloc(broadphase->scratch, capacity * sizeof(struct CellEntry));
+        broadphase->moved_entries = realloc(broadphase->moved_entries,
+            capacity * sizeof(struct CellEntry));
+        broadphase->cell_starts = realloc(broadphase->cell_starts,
+            (capacity + 1) * sizeof(uint32_t));
+        broadphase->entry_capacity = capacity;
+    }
+
+    const uint32_t kept = keep_entries(broadphase, count);
+    const uint32_t moved = create_moved_entries(broadphase, count);
+
+    // The old entries were copied out, so they serve as the sort's temporary
+    sort_entries(broadphase->moved_entries, broadphase->entries, moved);
+    merge_entries(broadphase, kept, moved);
+    find_cells(broadphase);
+    broadphase->box_count = count;
+}
+
+static void push_pair(struct PairBuffer *buffer, uint32_t a, uint32_t b)
+{
+    buffer->pairs = grow_array(buffer->pairs, &buffer->capacity, buffer->count + 1,
+        sizeof(struct BroadphasePair));
+    buffer->pairs[buffer->count].a = a < b ? a : b;
+    buffer->pairs[buffer->count++].b = a < b ? b : a;
+}
+
+/*
+ * A pair sharing several cells is only reported by the cell holding the
+ * top left corner of the boxes' overlap
+ */
+static int is_pair_owner(const struct Broadphase *broadphase, uint32_t key, uint32_t a,
+    uint32_t b)
+{
+    const float x = fmaxf(broadphase->min_x[a], broadphase->min_x[b]);
+    const float y = fmaxf(broadphase->min_y[a], broadphase->min_y[b]);
+
+    return get_cell_key(get_cell(broadphase, x), get_cell(broadphase, y)) == key;
+}
+
+// Copies the cell's boxes into the job's scratch, padded with boxes that overlap nothing
+static void gather_cell(const struct Broadphase *broadphase, struct BroadphaseJob *job,
+    uint32_t start, uint32_t count)
+{
+    const uint32_t padded = count + TEST_WIDTH;
+
+    if (padded > job->scratch_capacity) {
+        uint32_t capacity = job->scratch_capacity;
+        job->scratch_boxes = grow_array(job->scratch_boxes, &capacity, padded, sizeof(uint32_t));
+        job->scratch = realloc(job->scratch, (size_t)capacity * 4 * sizeof(float));
+        job->scratch_capacity = capacity;
+    }
+
+    float *min_x = job->scratch;
+    float *min_y = min_x + job->scratch_capacity;
+    float *max_x = min_y + job->scratch_capacity;
+    float *max_y = max_x + job->scratch_capacity;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t box = broadphase->entries[start + i].box;
+        job->scratch_boxes[i] = box;
+        min_x[i] = broadphase->min_x[box];
+        min_y[i] = broadphase->min_y[box];
+        max_x[i] = broadphase->max_x[box];
+        max_y[i] = broadphase->max_y[box];
+    }
+
+    for (uint32_t i = count; i < padded; ++i) {
+        min_x[i] = FLT_MAX;
+        min_y[i] = FLT_MAX;
+        max_x[i] = -FLT_MAX;
+        max_y[i] = -FLT_MAX;
+    }
+}
+
+// Bit k is set when box i overlaps box j + k of the gathered cell
+static uint32_t test_boxes(const struct BroadphaseJob *job, uint32_t i, uint32_t j)
+{
+    const float *min_x = job->scratch;
+    const float *min_y = min_x + job->scratch_capacity;
+    const float *max_x = min_y + job->scratch_capacity;
+    const float *max_y = max_x + job->scratch_capacity;
+
+#if defined(__SSE2__)
+    const __m128 overlap = _mm_and_ps(
+        _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(min_x[i]), _mm_loadu_ps(max_x + j)),
+            _mm_cmple_ps(_mm_loadu_ps(min_x + j), _mm_set1_ps(max_x[i]))),
+        _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(min_y[i]), _mm_loadu_ps(max_y + j)),
+            _mm_cmple_ps(_mm_loadu_ps(min_y + j), _mm_set1_ps(max_y[i]))));
+
+    return (uint32_t)_mm_movemask_ps(overlap);
+#else
+    uint32_t mask = 0;
+
+    for (uint32_t k = 0; k < TEST_WIDTH; ++k)
+        if (min_x[i] <= max_x[j + k] && min_x[j + k] <= max_x[i] &&
+            min_y[i] <= max_y[j + k] && min_y[j + k] <= max_y[i])
+            mask |= 1u << k;
+
+    return mask;
+#endif
+}
+
+static void find_cell_pairs(const struct Broadphase *broadphase, struct BroadphaseJob *job,
+    uint32_t cell)
+{
+    const uint32_t start = broadphase->cell_starts[cell];
+    const uint32_t count = broadphase->cell_starts[cell + 1] - start;
+    const uint32_t key = broadphase->entries[start].key;
+
+    if (count < 2)
+        return;
+
+    gather_cell(broadphase, job, start, count);
+
+    for (uint32_t i = 0; i + 1 < count; ++i)
+        for (uint32_t j = i + 1; j < count; j += TEST_WIDTH)
+            for (uint32_t mask = test_boxes(job, i, j); mask != 0; mask &= mask - 1) {
+                const uint32_t a = job->scratch_boxes[i];
+                const uint32_t b = job->scratch_boxes[j + (uint32_t)__builtin_ctz(mask)];
+
+                if (is_pair_owner(broadphase, key, a, b))
+                    push_pair(&job->pairs, a, b);
+            }
+}
+
+static void run_pair_job(uint32_t index, void *user_data)
+{
+    struct Broadphase *broadphase = user_data;
+    struct BroadphaseJob *job = &broadphase->jobs[index];
+
+    job->pairs.count = 0;
+
+    for (uint32_t cell = job->first_cell; cell < job->end_cell; ++cell)
+        find_cell_pairs(broadphase, job, cell);
+}
+
+// Splits the cells into jobs holding about the same number of entries
+static void create_pair_jobs(struct Broadphase *broadphase)
+{
+    const uint32_t workers = broadphase->pool != NULL ? broadphase->pool->worker_count + 1 : 1;
+    uint32_t job_count = workers * BROADPHASE_JOBS_PER_WORKER;
+
+    if (job_count > broadphase->cell_count)
+        job_count = broadphase->cell_count > 0 ? broadphase->cell_count : 1;
+
+    uint32_t cell = 0;
+
+    for (uint32_t i = 0; i < job_count; ++i) {
+        const uint64_t target = (uint64_t)broadphase->entry_count * (i + 1) / job_count;
+
+        broadphase->jobs[i].first_cell = cell;
+
+        while (cell < broadphase->cell_count && broadphase->cell_starts[cell] < target)
+            ++cell;
+
+        broadphase->jobs[i].end_cell = i + 1 == job_count ? broadphase->cell_count : cell;
+    }
+
+    broadphase->job_count = job_count;
+}
+
+void find_broadphase_pairs(struct Broadphase *broadphase)
+{
+    create_pair_jobs(broadphase);
+
+    if (broadphase->pool != NULL)
+        run_job_pool(broadphase->pool, broadphase->job_count, &run_pair_job, broadphase);
+    else
+        for (uint32_t i = 0; i < broadphase->job_count; ++i)
+            run_pair_job(i, broadphase);
+
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < broadphase->job_count; ++i)
+        total += broadphase->jobs[i].pairs.count;
+
+    struct PairBuffer *pairs = &broadphase->pairs;
+    pairs->pairs = grow_array(pairs->pairs, &pairs->capacity, total, sizeof(struct BroadphasePair));
+    pairs->count = 0;
+
+    for (uint32_t i = 0; i < broadphase->job_count; ++i) {
+        const struct PairBuffer *job_pairs = &broadphase->jobs[i].pairs;
+        memcpy(pairs->pairs + pairs->count, job_pairs->pairs,
+            job_pairs->count * sizeof(struct BroadphasePair));
+        pairs->count += job_pairs->count;
+    }
+}
+
+void destroy_broadphase(struct Broadphase *broadphase)
+{
+    for (uint32_t i = 0; i < sizeof(broadphase->jobs) / sizeof(broadphase->jobs[0]); ++i) {
+        free(broadphase->jobs[i].pairs.pairs);
+        free(broadphase->jobs[i].scratch);
+        free(broadphase->jobs[i].scratch_boxes);
+    }
+
+    free(broadphase->pairs.pairs);
+    free(broadphase->min_x);
+    free(broadphase->min_y);
+    free(broadphase->max_x);
+    free(broadphase->max_y);
+    free(broadphase->rects);
+    free(broadphase->moved);
+    free(broadphase->entries);
+    free(broadphase->scratch);
+    free(broadphase->moved_entries);
+    free(broadphase->cell_starts);
+}
@@ -0,0 +1,328 @@
+#include <string.h>
+
+#include "compute.h"
+#include "debug.h"
+#include "instance.h"
+
+// pool should be cleaned up by vkDestroyCommandPool()
+static void create_pool(VkDevice device, uint32_t family, VkCommandPool *pool)
+{
+    VkCommandPoolCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    info.queueFamilyIndex = family;
+
+    assert_vulkan(vkCreateCommandPool(device, &info, NULL, pool),
+        "Failed to create a Vulkan compute command pool!");
+}
+
+static void allocate_buffer(VkDevice device, VkCommandPool pool, VkCommandBuffer *buffer)
+{
+    VkCommandBufferAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    info.commandBufferCount = 1;
+    info.commandPool = pool;
+    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+    assert_vulkan(vkAllocateCommandBuffers(device, &info, buffer),
+        "Failed to allocate a Vulkan compute command buffer!");
+}
+
+void create_compute_scheduler(VkDevice device, VkPhysicalDevice gpu, VkQueue graphics_queue,
+    uint32_t graphics_family, VkQueue compute_queue, uint32_t compute_family, int async,
+    struct ComputeScheduler *scheduler)
+{
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->device = device;
+    scheduler->graphics_queue = graphics_queue;
+    scheduler->graphics_family = graphics_family;
+    scheduler->async_queue = compute_queue;
+    scheduler->async_family = compute_family;
+    scheduler->async = async && compute_family != graphics_family;
+
+    create_pool(device, graphics_family, &scheduler->graphics_pool);
+    set_debug_name(device, VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)scheduler->graphics_pool,
+        "compute graphics pool");
+    create_gpu_timers(device, gpu, graphics_family, &scheduler->graphics_timers);
+
+    if (scheduler->async) {
+        create_pool(device, compute_family, &scheduler->async_pool);
+        set_debug_name(device, VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)scheduler->async_pool,
+            "compute async pool");
+        create_gpu_timers(device, gpu, compute_family, &scheduler->async_timers);
+    }
+
+    VkSemaphoreCreateInfo seminfo = {};
+    seminfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo feninfo = {};
+    feninfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    feninfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (uint32_t i = 0; i < COMPUTE_FRAME_COUNT; ++i) {
+        struct ComputeFrame *frame = &scheduler->frames[i];
+
+        allocate_buffer(device, scheduler->graphics_pool, &frame->graphics_buffer);
+        assert_vulkan(vkCreateFence(device, &feninfo, NULL, &frame->graphics_fence),
+            "Failed to create a Vulkan fence!");
+        set_debug_name(device, VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)frame->graphics_buffer,
+            "compute %u graphics", i);
+        set_debug_name(device, VK_OBJECT_TYPE_FENCE, (uint64_t)frame->graphics_fence,
+            "compute %u graphics fence", i);
+
+        if (!scheduler->async)
+            continue;
+
+        allocate_buffer(device, scheduler->async_pool, &frame->async_buffer);
+        assert_vulkan(vkCreateFence(device, &feninfo, NULL, &frame->async_fence),
+            "Failed to create a Vulkan fence!");
+        assert_vulkan(vkCreateSemaphore(device, &seminfo, NULL, &frame->compute_done),
+            "Failed to create a Vulkan compute finished semaphore!");
+        assert_vulkan(vkCreateSemaphore(device, &seminfo, NULL, &frame->graphics_done),
+            "Failed to create a Vulkan graphics finished semaphore!");
+        set_debug_name(device, VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)frame->async_buffer,
+            "compute %u async", i);
+        set_debug_name(device, VK_OBJECT_TYPE_FENCE, (uint64_t)frame->async_fence,
+            "compute %u async fence", i);
+        set_debug_name(device, VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)frame->compute_done,
+            "compute %u done", i);
+        set_debug_name(device, VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)frame->graphics_done,
+            "compute %u graphics done", i);
+    }
+}
+
+uint32_t add_compute_pass(struct ComputeScheduler *scheduler, const struct ComputePass *pass)
+{
+    if (scheduler->pass_count == COMPUTE_MAX_PASSES)
+        print_exit("Failed to add a compute pass, too many passes!");
+
+    struct ComputePass *added = &scheduler->passes[scheduler->pass_count++];
+    *added = *pass;
+
+    if (added->dst_stage == 0) {
+        added->dst_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        added->dst_access = VK_ACCESS_MEMORY_READ_BIT;
+    }
+
+    return scheduler->pass_count - 1;
+}
+
+void set_compute_pass_buffers(struct ComputeScheduler *scheduler, uint32_t pass,
+    uint32_t buffer_count, const VkBuffer *buffers)
+{
+    if (buffer_count > COMPUTE_MAX_BUFFERS)
+        print_exit("Failed to set compute pass buffers, too many buffers!");
+
+    struct ComputePass *updated = &scheduler->passes[pass];
+    updated->buffer_count = buffer_count;
+
+    if (buffer_count > 0)
+        memcpy(updated->buffers, buffers, buffer_count * sizeof(VkBuffer));
+}
+
+static int is_pass_async(const struct ComputeScheduler *scheduler, const struct ComputePass *pass)
+{
+    return scheduler->async && pass->queue == COMPUTE_QUEUE_ASYNC;
+}
+
+static void begin_buffer(VkCommandBuffer buffer)
+{
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    assert_vulkan(vkBeginCommandBuffer(buffer, &info),
+        "Failed to begin a Vulkan compute command buffer!");
+}
+
+// Release when recorded on the async queue, acquire when recorded on the graphics queue
+static void transfer_ownership(const struct ComputeScheduler *scheduler,
+    const struct ComputePass *pass, VkCommandBuffer buffer, int release)
+{
+    VkBufferMemoryBarrier barriers[COMPUTE_MAX_BUFFERS];
+
+    for (uint32_t i = 0; i < pass->buffer_count; ++i) {
+        barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].pNext = NULL;
+        barriers[i].srcAccessMask = release ? VK_ACCESS_SHADER_WRITE_BIT : 0;
+        barriers[i].dstAccessMask = release ? 0 : pass->dst_access;
+        barriers[i].srcQueueFamilyIndex = scheduler->async_family;
+        barriers[i].dstQueueFamilyIndex = scheduler->graphics_family;
+        barriers[i].buffer = pass->buffers[i];
+        barriers[i].offset = 0;
+        barriers[i].size = VK_WHOLE_SIZE;
+    }
+
+    if (release)
+        vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, pass->buffer_count, barriers,
+            0, NULL);
+    else
+        vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pass->dst_stage, 0,
+            0, NULL, pass->buffer_count, barriers, 0, NULL);
+}
+
+// Returns the graphics stages that consume async results
+static VkPipelineStageFlags record_async(struct ComputeScheduler *scheduler,
+    VkCommandBuffer buffer)
+{
+    struct GpuTimers *timers = &scheduler->async_timers;
+    VkPipelineStageFlags dst_stages = 0;
+
+    begin_buffer(buffer);
+    begin_gpu_timers(timers, buffer, scheduler->frame);
+
+    for (uint32_t i = 0; i < scheduler->pass_count; ++i) {
+        const struct ComputePass *pass = &scheduler->passes[i];
+
+        if (!is_pass_async(scheduler, pass))
+            continue;
+
+        begin_debug_label(buffer, pass->name);
+        const uint32_t scope = begin_gpu_scope(timers, buffer, pass->name);
+        pass->record(buffer, pass->user_data);
+        end_gpu_scope(timers, buffer, scope);
+        end_debug_label(buffer);
+        transfer_ownership(scheduler, pass, buffer, 1);
+        dst_stages |= pass->dst_stage;
+    }
+
+    assert_vulkan(vkEndCommandBuffer(buffer), "Failed to end a Vulkan compute command buffer!");
+
+    return dst_stages;
+}
+
+static void record_graphics(struct ComputeScheduler *scheduler, VkCommandBuffer buffer,
+    int has_async)
+{
+    struct GpuTimers *timers = &scheduler->graphics_timers;
+
+    begin_buffer(buffer);
+    begin_gpu_timers(timers, buffer, scheduler->frame);
+
+    for (uint32_t i = 0; i < scheduler->pass_count; ++i) {
+        const struct ComputePass *pass = &scheduler->passes[i];
+
+        if (is_pass_async(scheduler, pass)) {
+            if (has_async)
+                transfer_ownership(scheduler, pass, buffer, 0);
+
+            continue;
+        }
+
+        begin_debug_label(buffer, pass->name);
+        const uint32_t scope = begin_gpu_scope(timers, buffer, pass->name);
+        pass->record(buffer, pass->user_data);
+        end_gpu_scope(timers, buffer, scope);
+        end_debug_label(buffer);
+
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = pass->dst_access;
+
+        vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, pass->dst_stage, 0,
+            1, &barrier, 0, NULL, 0, NULL);
+    }
+
+    assert_vulkan(vkEndCommandBuffer(buffer), "Failed to end a Vulkan compute command buffer!");
+}
+
+VkSemaphore submit_compute(struct ComputeScheduler *scheduler)
+{
+    if (scheduler->pass_count == 0)
+        return VK_NULL_HANDLE;
+
+    struct ComputeFrame *frame = &scheduler->frames[scheduler->frame];
+    struct ComputeFrame *previous = &scheduler->frames[
+        (scheduler->frame + COMPUTE_FRAME_COUNT - 1) % COMPUTE_FRAME_COUNT];
+
+    int has_async = 0;
+
+    for (uint32_t i = 0; i < scheduler->pass_count; ++i)
+        has_async |= is_pass_async(scheduler, &scheduler->passes[i]);
+
+    vkWaitForFences(scheduler->device, 1, &frame->graphics_fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(scheduler->device, 1, &frame->graphics_fence);
+
+    const VkPipelineStageFlags compute_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkPipelineStageFlags dst_stages = 0;
+
+    if (has_async) {
+        vkWaitForFences(scheduler->device, 1, &frame->async_fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(scheduler->device, 1, &frame->async_fence);
+
+        dst_stages = record_async(scheduler, frame->async_buffer);
+
+        VkSubmitInfo submit = {};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &frame->async_buffer;
+        submit.waitSemaphoreCount = scheduler->graphics_signaled ? 1 : 0;
+        submit.pWaitSemaphores = &previous->graphics_done;
+        submit.pWaitDstStageMask = &compute_stage;
+        submit.signalSemaphoreCount = 1;
+        submit.pSignalSemaphores = &frame->compute_done;
+
+        assert_vulkan(vkQueueSubmit(scheduler->async_queue, 1, &submit, frame->async_fence),
+            "Failed to submit Vulkan async compute work!");
+    }
+
+    record_graphics(scheduler, frame->graphics_buffer, has_async);
+
+    VkSubmitInfo submit = {};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &frame->graphics_buffer;
+
+    if (has_async) {
+        submit.waitSemaphoreCount = 1;
+        submit.pWaitSemaphores = &frame->compute_done;
+        submit.pWaitDstStageMask = &dst_stages;
+    } else if (scheduler->graphics_signaled) {
+        // Nothing else waits for the pending signal, consume it here
+        submit.waitSemaphoreCount = 1;
+        submit.pWaitSemaphores = &previous->graphics_done;
+        submit.pWaitDstStageMask = &compute_stage;
+    }
+
+    assert_vulkan(vkQueueSubmit(scheduler->graphics_queue, 1, &submit, frame->graphics_fence),
+        "Failed to submit Vulkan compute work!");
+
+    scheduler->graphics_signaled = has_async;
+    scheduler->frame = (scheduler->frame + 1) % COMPUTE_FRAME_COUNT;
+
+    return has_async ? frame->graphics_done : VK_NULL_HANDLE;
+}
+
+double get_compute_time(const struct ComputeScheduler *scheduler, const char *name)
+{
+    const double async_time = scheduler->async ?
+        get_gpu_time(&scheduler->async_timers, name) : 0.0;
+
+    return async_time > 0.0 ? async_time : get_gpu_time(&scheduler->graphics_timers, name);
+}
+
+void destroy_compute_scheduler(struct ComputeScheduler *scheduler)
+{
+    for (uint32_t i = 0; i < COMPUTE_FRAME_COUNT; ++i) {
+        struct ComputeFrame *frame = &scheduler->frames[i];
+
+        vkDestroyFence(scheduler->device, frame->graphics_fence, NULL);
+
+        if (!scheduler->async)
+            continue;
+
+        vkDestroyFence(scheduler->device, frame->async_fence, NULL);
+        vkDestroySemaphore(scheduler->device, frame->compute_done, NULL);
+        vkDestroySemaphore(scheduler->device, frame->graphics_done, NULL);
+    }
+
+    vkDestroyCommandPool(scheduler->device, scheduler->graphics_pool, NULL);
+    destroy_gpu_timers(&scheduler->graphics_timers);
+
+    if (scheduler->async) {
+        vkDestroyCommandPool(scheduler->device, scheduler->async_pool, NULL);
+        destroy_gpu_timers(&scheduler->async_timers);
+    }
+}
@@ -0,0 +1,268 @@
+#include <string.h>
+
+#include "cull.h"
+#include "debug.h"
+#include "error.h"
+#include "sprite.h"
+
+#define CULL_BINDING_COUNT 3u
+
+static void create_cull_pipeline(const uint32_t *code, size_t code_size,
+    struct SpriteCuller *culler)
+{
+    VkDescriptorSetLayoutBinding bindings[CULL_BINDING_COUNT] = {};
+
+    for (uint32_t i = 0; i < CULL_BINDING_COUNT; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo setinfo = {};
+    setinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setinfo.bindingCount = CULL_BINDING_COUNT;
+    setinfo.pBindings = bindings;
+
+    assert_vulkan(vkCreateDescriptorSetLayout(culler->device, &setinfo, NULL,
+        &culler->set_layout), "Failed to create a Vulkan descriptor set layout!");
+
+    VkPushConstantRange range = {};
+    range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range.size = sizeof(struct CullConstants);
+
+    VkPipelineLayoutCreateInfo layoutinfo = {};
+    layoutinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutinfo.setLayoutCount = 1;
+    layoutinfo.pSetLayouts = &culler->set_layout;
+    layoutinfo.pushConstantRangeCount = 1;
+    layoutinfo.pPushConstantRanges = &range;
+
+    assert_vulkan(vkCreatePipelineLayout(culler->device, &layoutinfo, NULL, &culler->layout),
+        "Failed to create a Vulkan pipeline layout!");
+
+    VkShaderModuleCreateInfo moduleinfo = {};
+    moduleinfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleinfo.codeSize = code_size;
+    moduleinfo.pCode = code;
+
+    assert_vulkan(vkCreateShaderModule(culler->device, &moduleinfo, NULL, &culler->module),
+        "Failed to create a Vulkan shader module!");
+
+    VkComputePipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = culler->module;
+    info.stage.pName = "main";
+    info.layout = culler->layout;
+
+    assert_vulkan(vkCreateComputePipelines(culler->device, VK_NULL_HANDLE, 1, &info, NULL,
+        &culler->pipeline), "Failed to create the Vulkan sprite culling pipeline!");
+
+    set_debug_name(culler->device, VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT,
+        (uint64_t)culler->set_layout, "sprite cull set layout");
+    set_debug_name(culler->device, VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)culler->layout,
+        "sprite cull layout");
+    set_debug_name(culler->device, VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)culler->module,
+        "sprite_cull.comp");
+    set_debug_name(culler->device, VK_OBJECT_TYPE_PIPELINE, (uint64_t)culler->pipeline,
+        "sprite cull");
+}
+
+static void create_cull_sets(struct SpriteCuller *culler)
+{
+    VkDescriptorPoolSize size = {};
+    size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    size.descriptorCount = FRAMES_IN_FLIGHT * CULL_BINDING_COUNT;
+
+    VkDescriptorPoolCreateInfo poolinfo = {};
+    poolinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolinfo.maxSets = FRAMES_IN_FLIGHT;
+    poolinfo.poolSizeCount = 1;
+    poolinfo.pPoolSizes = &size;
+
+    assert_vulkan(vkCreateDescriptorPool(culler->device, &poolinfo, NULL, &culler->pool),
+        "Failed to create a Vulkan descriptor pool!");
+    set_debug_name(culler->device, VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)culler->pool,
+        "sprite cull descriptors");
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorSetAllocateInfo allocinfo = {};
+        allocinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocinfo.descriptorPool = culler->pool;
+        allocinfo.descriptorSetCount = 1;
+        allocinfo.pSetLayouts = &culler->set_layout;
+
+        assert_vulkan(vkAllocateDescriptorSets(culler->device, &allocinfo,
+            &culler->frames[i].set), "Failed to allocate Vulkan descriptor sets!");
+    }
+}
+
+void create_sprite_culler(VkDevice device, VkPhysicalDevice gpu, const uint32_t *code,
+    size_t code_size, struct SpriteCuller *culler)
+{
+    memset(culler, 0, sizeof(*culler));
+    culler->device = device;
+    culler->gpu = gpu;
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(gpu, &props);
+    culler->max_groups = props.limits.maxDrawIndirectCount;
+
+    create_cull_pipeline(code, code_size, culler);
+    create_cull_sets(culler);
+}
+
+// Returns true when buffer was recreated, it grows geometrically so steady growth rarely does
+static int reserve_buffer(struct SpriteCuller *culler, VkDeviceSize size,
+    VkBufferUsageFlags usage, struct GpuBuffer *buffer)
+{
+    if (size <= buffer->size)
+        return 0;
+
+    VkDeviceSize capacity = buffer->size > 0 ? buffer->size : 4096;
+
+    while (capacity < size)
+        capacity *= 2;
+
+    if (buffer->buffer != VK_NULL_HANDLE)
+        destroy_buffer(culler->device, buffer);
+
+    create_buffer(culler->device, culler->gpu, capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer);
+
+    return 1;
+}
+
+static void write_cull_set(const struct SpriteCuller *culler, const struct CullFrame *frame)
+{
+    VkDescriptorBufferInfo bufferinfos[CULL_BINDING_COUNT] = {};
+    bufferinfos[0].buffer = frame->sprites;
+    bufferinfos[0].range = VK_WHOLE_SIZE;
+    bufferinfos[1].buffer = frame->visible.buffer;
+    bufferinfos[1].range = VK_WHOLE_SIZE;
+    bufferinfos[2].buffer = frame->draws.buffer;
+    bufferinfos[2].range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = frame->set;
+    write.dstBinding = 0;
+    write.descriptorCount = CULL_BINDING_COUNT;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = bufferinfos;
+
+    vkUpdateDescriptorSets(culler->device, 1, &write, 0, NULL);
+}
+
+static uint32_t get_group_count(uint32_t count)
+{
+    return (count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+}
+
+int set_culled_sprites(struct SpriteCuller *culler, uint32_t frame,
+    const struct GpuBuffer *sprites, uint32_t count, VkExtent2D extent)
+{
+    struct CullFrame *culled = &culler->frames[frame];
+    const uint32_t groups = get_group_count(count);
+
+    culled->count = 0;
+
+    if (groups > culler->max_groups)
+        return 0;
+    if (count == 0)
+        return 1;
+
+    const VkDeviceSize visible_size = (VkDeviceSize)groups * CULL_GROUP_SIZE *
+        sizeof(struct SpriteInstance);
+    const VkDeviceSize draws_size = (VkDeviceSize)groups * sizeof(VkDrawIndirectCommand);
+    int stale = culled->sprites != sprites->buffer;
+
+    if (reserve_buffer(culler, visible_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        &culled->visible)) {
+        set_debug_name(culler->device, VK_OBJECT_TYPE_BUFFER, (uint64_t)culled->visible.buffer,
+            "frame %u culled sprites", frame);
+        stale = 1;
+    }
+
+    if (reserve_buffer(culler, draws_size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        &culled->draws)) {
+        set_debug_name(culler->device, VK_OBJECT_TYPE_BUFFER, (uint64_t)culled->draws.buffer,
+            "frame %u cull draws", frame);
+        stale = 1;
+    }
+
+    culled->sprites = sprites->buffer;
+    culled->count = count;
+    culled->extent = extent;
+
+    if (stale)
+        write_cull_set(culler, culled);
+
+    return 1;
+}
+
+uint32_t get_culled_buffers(const struct SpriteCuller *culler, uint32_t frame,
+    VkBuffer buffers[CULL_BUFFER_COUNT])
+{
+    const struct CullFrame *culled = &culler->frames[frame];
+
+    if (culled->count == 0)
+        return 0;
+
+    buffers[0] = culled->visible.buffer;
+    buffers[1] = culled->draws.buffer;
+
+    return CULL_BUFFER_COUNT;
+}
+
+void record_sprite_culling(const struct SpriteCuller *culler, VkCommandBuffer buffer,
+    uint32_t frame)
+{
+    const struct CullFrame *culled = &culler->frames[frame];
+
+    if (culled->count == 0)
+        return;
+
+    struct CullConstants constants;
+    constants.extent[0] = (float)culled->extent.width;
+    constants.extent[1] = (float)culled->extent.height;
+    constants.count = culled->count;
+
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->pipeline);
+    vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->layout, 0, 1,
+        &culled->set, 0, NULL);
+    vkCmdPushConstants(buffer, culler->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+        sizeof(constants), &constants);
+    vkCmdDispatch(buffer, get_group_count(culled->count), 1, 1);
+}
+
+void record_culled_sprites(const struct SpriteCuller *culler, VkCommandBuffer buffer,
+    uint32_t frame)
+{
+    const struct CullFrame *culled = &culler->frames[frame];
+    const VkDeviceSize offset = 0;
+
+    vkCmdBindVertexBuffers(buffer, 0, 1, &culled->visible.buffer, &offset);
+    vkCmdDrawIndirect(buffer, culled->draws.buffer, 0, get_group_count(culled->count),
+        sizeof(VkDrawIndirectCommand));
+}
+
+void destroy_sprite_culler(struct SpriteCuller *culler)
+{
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        struct CullFrame *frame = &culler->frames[i];
+
+        if (frame->visible.buffer != VK_NULL_HANDLE)
+            destroy_buffer(culler->device, &frame->visible);
+        if (frame->draws.buffer != VK_NULL_HANDLE)
+            destroy_buffer(culler->device, &frame->draws);
+    }
+
+    vkDestroyDescriptorPool(culler->device, culler->pool, NULL);
+    vkDestroyPipeline(culler->device, culler->pipeline, NULL);
+    vkDestroyShaderModule(culler->device, culler->module, NULL);
+    vkDestroyPipelineLayout(culler->device, culler->layout, NULL);
+    vkDestroyDescriptorSetLayout(culler->device, culler->set_layout, NULL);
+}
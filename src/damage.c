@@ -0,0 +1,156 @@
+#include "damage.h"
+
+static int64_t get_right(const VkRect2D *rect)
+{
+    return (int64_t)rect->offset.x + rect->extent.width;
+}
+
+static int64_t get_bottom(const VkRect2D *rect)
+{
+    return (int64_t)rect->offset.y + rect->extent.height;
+}
+
+static int is_overlapping(const VkRect2D *a, const VkRect2D *b)
+{
+    return a->offset.x < get_right(b) && b->offset.x < get_right(a) &&
+        a->offset.y < get_bottom(b) && b->offset.y < get_bottom(a);
+}
+
+static VkRect2D get_union(const VkRect2D *a, const VkRect2D *b)
+{
+    const int64_t right = get_right(a) > get_right(b) ? get_right(a) : get_right(b);
+    const int64_t bottom = get_bottom(a) > get_bottom(b) ? get_bottom(a) : get_bottom(b);
+
+    VkRect2D rect;
+    rect.offset.x = a->offset.x < b->offset.x ? a->offset.x : b->offset.x;
+    rect.offset.y = a->offset.y < b->offset.y ? a->offset.y : b->offset.y;
+    rect.extent.width = (uint32_t)(right - rect.offset.x);
+    rect.extent.height = (uint32_t)(bottom - rect.offset.y);
+
+    return rect;
+}
+
+static uint64_t get_area(const VkRect2D *rect)
+{
+    return (uint64_t)rect->extent.width * rect->extent.height;
+}
+
+static void remove_rect(struct DamageRegion *region, uint32_t index)
+{
+    region->rects[index] = region->rects[--region->count];
+}
+
+void clear_damage(struct DamageRegion *region)
+{
+    region->full = 0;
+    region->count = 0;
+}
+
+void add_damage(struct DamageRegion *region, const VkRect2D *rect, VkExtent2D extent)
+{
+    if (region->full)
+        return;
+
+    const int64_t left = rect->offset.x > 0 ? rect->offset.x : 0;
+    const int64_t top = rect->offset.y > 0 ? rect->offset.y : 0;
+    const int64_t right = get_right(rect) < extent.width ? get_right(rect) : extent.width;
+    const int64_t bottom = get_bottom(rect) < extent.height ? get_bottom(rect) : extent.height;
+
+    if (left >= right || top >= bottom)
+        return;
+
+    VkRect2D added;
+    added.offset.x = (int32_t)left;
+    added.offset.y = (int32_t)top;
+    added.extent.width = (uint32_t)(right - left);
+    added.extent.height = (uint32_t)(bottom - top);
+
+    // A merged rectangle can reach rectangles checked before it, so start over
+    for (uint32_t i = 0; i < region->count;) {
+        if (is_overlapping(&added, &region->rects[i])) {
+            added = get_union(&added, &region->rects[i]);
+            remove_rect(region, i);
+            i = 0;
+        } else {
+            ++i;
+        }
+    }
+
+    // Full, merge with the rectangle whose bounding box grows the least and retry
+    if (region->count == DAMAGE_RECT_MAX) {
+        uint32_t closest = 0;
+        uint64_t least = UINT64_MAX;
+
+        for (uint32_t i = 0; i < region->count; ++i) {
+            const VkRect2D merged = get_union(&added, &region->rects[i]);
+            const uint64_t growth = get_area(&merged) - get_area(&region->rects[i]);
+
+            if (growth < least) {
+                least = growth;
+                closest = i;
+            }
+        }
+
+        const VkRect2D merged = get_union(&added, &region->rects[closest]);
+        remove_rect(region, closest);
+        add_damage(region, &merged, extent);
+        return;
+    }
+
+    if (added.extent.width == extent.width && added.extent.height == extent.height) {
+        add_full_damage(region);
+        return;
+    }
+
+    region->rects[region->count++] = added;
+}
+
+void add_full_damage(struct DamageRegion *region)
+{
+    region->full = 1;
+    region->count = 0;
+}
+
+void merge_damage(struct DamageRegion *dst, const struct DamageRegion *src, VkExtent2D extent)
+{
+    if (src->full) {
+        add_full_damage(dst);
+        return;
+    }
+
+    for (uint32_t i = 0; i < src->count; ++i)
+        add_damage(dst, &src->rects[i], extent);
+}
+
+int is_damaged(const struct DamageRegion *region)
+{
+    return region->full || region->count > 0;
+}
+
+VkRect2D get_damage_bounds(const struct DamageRegion *region, VkExtent2D extent)
+{
+    VkRect2D bounds = {};
+
+    if (region->full) {
+        bounds.extent = extent;
+        return bounds;
+    }
+
+    for (uint32_t i = 0; i < region->count; ++i)
+        bounds = i == 0 ? region->rects[0] : get_union(&bounds, &region->rects[i]);
+
+    return bounds;
+}
+
+uint64_t get_damage_area(const struct DamageRegion *region, VkExtent2D extent)
+{
+    if (region->full)
+        return (uint64_t)extent.width * extent.height;
+
+    uint64_t area = 0;
+
+    for (uint32_t i = 0; i < region->count; ++i)
+        area += get_area(&region->rects[i]);
+
+    return area;
+}
@@ -0,0 +1,256 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "instance.h"
+
+#define DEBUG_NAME_LENGTH 128u
+
+static PFN_vkSetDebugUtilsObjectNameEXT set_object_name;
+static PFN_vkCmdBeginDebugUtilsLabelEXT cmd_begin_label;
+static PFN_vkCmdEndDebugUtilsLabelEXT cmd_end_label;
+
+void load_debug_functions(VkInstance instance)
+{
+    set_object_name = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetInstanceProcAddr(instance,
+        "vkSetDebugUtilsObjectNameEXT");
+    cmd_begin_label = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance,
+        "vkCmdBeginDebugUtilsLabelEXT");
+    cmd_end_label = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance,
+        "vkCmdEndDebugUtilsLabelEXT");
+}
+
+/*
+ * Returns the count of id, claiming a free slot by linear probing the first
+ * time it is seen. NULL when every slot is taken by other ids.
+ */
+static struct DebugIdCount *find_id(struct DebugMessenger *messenger,
+    const VkDebugUtilsMessengerCallbackDataEXT *data, VkDebugUtilsMessageTypeFlagsEXT type,
+    int *first)
+{
+    const long long key = (long long)(uint32_t)data->messageIdNumber + 1;
+    *first = 0;
+
+    for (uint32_t i = 0; i < DEBUG_ID_MAX; ++i) {
+        struct DebugIdCount *count = &messenger->ids[((uint32_t)key + i) & (DEBUG_ID_MAX - 1)];
+        long long expected = 0;
+
+        if (atomic_load(&count->key) == key)
+            return count;
+
+        if (atomic_compare_exchange_strong(&count->key, &expected, key)) {
+            snprintf(count->name, sizeof(count->name), "%s",
+                data->pMessageIdName != NULL ? data->pMessageIdName : "");
+            count->type = type;
+            atomic_store(&count->ready, 1);
+            *first = 1;
+            return count;
+        }
+
+        // Another thread claimed the slot for the same id in the meantime
+        if (expected == key)
+            return count;
+    }
+
+    return NULL;
+}
+
+/*
+ * Bounded multi-producer queue. A slot is free for position pos while its
+ * sequence equals pos and readable once a producer stored pos + 1.
+ */
+static void push_message(struct DebugMessenger *messenger,
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+    const VkDebugUtilsMessengerCallbackDataEXT *data)
+{
+    unsigned pos = atomic_load_explicit(&messenger->head, memory_order_relaxed);
+    struct DebugMessage *message;
+
+    for (;;) {
+        message = &messenger->messages[pos & (DEBUG_QUEUE_SIZE - 1)];
+        const int difference = (int)(atomic_load_explicit(&message->sequence,
+            memory_order_acquire) - pos);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&messenger->head, &pos, pos + 1,
+                memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            atomic_fetch_add(&messenger->dropped, 1);
+            return;
+        } else {
+            pos = atomic_load_explicit(&messenger->head, memory_order_relaxed);
+        }
+    }
+
+    message->id = data->messageIdNumber;
+    message->severity = severity;
+    message->type = type;
+    snprintf(message->text, sizeof(message->text), "%s", data->pMessage);
+    atomic_store_explicit(&message->sequence, pos + 1, memory_order_release);
+}
+
+static VkBool32 debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+    VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT *data,
+    void *user_data)
+{
+    struct DebugMessenger *messenger = user_data;
+    int first = 0;
+
+    if (severity < VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT && !messenger->verbose)
+        return VK_FALSE;
+
+    struct DebugIdCount *count = find_id(messenger, data, type, &first);
+
+    if (count != NULL)
+        atomic_fetch_add_explicit(&count->frame_count, 1, memory_order_relaxed);
+
+    // Performance warnings repeat every frame, counting them is enough after the first
+    if ((type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) && !first && count != NULL)
+        return VK_FALSE;
+
+    push_message(messenger, severity, type, data);
+
+    return VK_FALSE;
+}
+
+void create_debug_messenger(VkInstance instance, int verbose, struct DebugMessenger *messenger)
+{
+    memset(messenger, 0, sizeof(*messenger));
+    messenger->instance = instance;
+    messenger->verbose = verbose;
+
+    for (uint32_t i = 0; i < DEBUG_QUEUE_SIZE; ++i)
+        atomic_init(&messenger->messages[i].sequence, i);
+
+    VkDebugUtilsMessengerCreateInfoEXT info = {};
+    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT |
+        VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+    info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+        VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT |
+        VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+    info.pfnUserCallback = &debug_callback;
+    info.pUserData = messenger;
+
+    if (verbose)
+        info.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
+            VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+
+    PFN_vkCreateDebugUtilsMessengerEXT func =
+        (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+        instance, "vkCreateDebugUtilsMessengerEXT");
+
+    assert_vulkan(func(instance, &info, NULL, &messenger->messenger),
+        "Failed to create a Vulkan debug messenger!");
+}
+
+static const char *get_message_kind(const struct DebugMessage *message)
+{
+    if (message->severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+        return "error";
+    if (message->type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+        return "performance";
+    if (message->severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
+        return "warning";
+
+    return "info";
+}
+
+void flush_debug_messenger(struct DebugMessenger *messenger)
+{
+    for (;;) {
+        struct DebugMessage *message =
+            &messenger->messages[messenger->tail & (DEBUG_QUEUE_SIZE - 1)];
+
+        if (atomic_load_explicit(&message->sequence, memory_order_acquire) !=
+            messenger->tail + 1)
+            break;
+
+        printf("Vulkan %s %d: %s\n", get_message_kind(message), message->id, message->text);
+
+        if (message->severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+            ++messenger->errors;
+        else if (message->severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
+            ++messenger->warnings;
+
+        atomic_store_explicit(&message->sequence, messenger->tail + DEBUG_QUEUE_SIZE,
+            memory_order_release);
+        ++messenger->tail;
+    }
+
+    const unsigned dropped = atomic_exchange(&messenger->dropped, 0);
+
+    if (dropped > 0)
+        printf("Vulkan: %u messages dropped, the debug queue was full\n", dropped);
+
+    messenger->frame_performance_warnings = 0;
+
+    for (uint32_t i = 0; i < DEBUG_ID_MAX; ++i) {
+        struct DebugIdCount *count = &messenger->ids[i];
+
+        if (!atomic_load(&count->ready))
+            continue;
+
+        count->last_frame_count = atomic_exchange(&count->frame_count, 0);
+        count->total_count += count->last_frame_count;
+
+        if (count->type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+            messenger->frame_performance_warnings += count->last_frame_count;
+    }
+}
+
+void destroy_debug_messenger(struct DebugMessenger *messenger)
+{
+    PFN_vkDestroyDebugUtilsMessengerEXT func =
+        (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+        messenger->instance, "vkDestroyDebugUtilsMessengerEXT");
+
+    func(messenger->instance, messenger->messenger, NULL);
+    flush_debug_messenger(messenger);
+
+    for (uint32_t i = 0; i < DEBUG_ID_MAX; ++i)
+        if (atomic_load(&messenger->ids[i].ready) &&
+            (messenger->ids[i].type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT))
+            printf("Vulkan performance %s: %llu times\n", messenger->ids[i].name,
+                (unsigned long long)messenger->ids[i].total_count);
+}
+
+void set_debug_name(VkDevice device, VkObjectType type, uint64_t handle, const char *format, ...)
+{
+    if (set_object_name == NULL)
+        return;
+
+    char name[DEBUG_NAME_LENGTH];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(name, sizeof(name), format, args);
+    va_end(args);
+
+    VkDebugUtilsObjectNameInfoEXT info = {};
+    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    info.objectType = type;
+    info.objectHandle = handle;
+    info.pObjectName = name;
+
+    set_object_name(device, &info);
+}
+
+void begin_debug_label(VkCommandBuffer buffer, const char *name)
+{
+    if (cmd_begin_label == NULL)
+        return;
+
+    VkDebugUtilsLabelEXT label = {};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+
+    cmd_begin_label(buffer, &label);
+}
+
+void end_debug_label(VkCommandBuffer buffer)
+{
+    if (cmd_end_label != NULL)
+        cmd_end_label(buffer);
+}
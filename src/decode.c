@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "decode.h"
+
+int can_decode_texture(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+VkFormat get_decoded_format(VkFormat format)
+{
+    return format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK ?
+        VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+static void decode_565(uint16_t color, uint8_t *rgb)
+{
+    rgb[0] = (color >> 11 & 31) * 255 / 31;
+    rgb[1] = (color >> 5 & 63) * 255 / 63;
+    rgb[2] = (color & 31) * 255 / 31;
+}
+
+// 4x4 texels of RGBA into block, opaque forces the four color mode BC3 always uses
+static void decode_color_block(const uint8_t *src, int opaque, uint8_t block[16][4])
+{
+    const uint16_t c0 = src[0] | src[1] << 8;
+    const uint16_t c1 = src[2] | src[3] << 8;
+    uint8_t palette[4][4];
+
+    decode_565(c0, palette[0]);
+    decode_565(c1, palette[1]);
+    palette[0][3] = 255;
+    palette[1][3] = 255;
+
+    for (int c = 0; c < 3; ++c) {
+        if (c0 > c1 || opaque) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+
+    palette[2][3] = 255;
+    palette[3][3] = c0 > c1 || opaque ? 255 : 0;
+
+    const uint32_t indices = src[4] | src[5] << 8 | src[6] << 16 | (uint32_t)src[7] << 24;
+
+    for (int i = 0; i < 16; ++i)
+        memcpy(block[i], palette[indices >> (i * 2) & 3], 4);
+}
+
+// BC4 style block of 8 bit values, shared by BC3 alpha and BC4/BC5 channels
+static void decode_value_block(const uint8_t *src, uint8_t values[16])
+{
+    const uint8_t v0 = src[0];
+    const uint8_t v1 = src[1];
+    uint8_t palette[8] = {v0, v1};
+
+    for (int i = 1; i < 7 && v0 > v1; ++i)
+        palette[i + 1] = ((7 - i) * v0 + i * v1) / 7;
+
+    for (int i = 1; i < 5 && v0 <= v1; ++i)
+        palette[i + 1] = ((5 - i) * v0 + i * v1) / 5;
+
+    if (v0 <= v1) {
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+
+    for (int i = 0; i < 6; ++i)
+        indices |= (uint64_t)src[2 + i] << (i * 8);
+
+    for (int i = 0; i < 16; ++i)
+        values[i] = palette[indices >> (i * 3) & 7];
+}
+
+static void decode_block(VkFormat format, const uint8_t *src, uint8_t block[16][4])
+{
+    uint8_t values[16];
+
+    switch (format) {
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        decode_color_block(src, 0, block);
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        decode_color_block(src + 8, 1, block);
+        decode_value_block(src, values);
+
+        for (int i = 0; i < 16; ++i)
+            block[i][3] = values[i];
+        break;
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        decode_value_block(src, values);
+
+        for (int i = 0; i < 16; ++i) {
+            block[i][0] = values[i];
+            block[i][1] = 0;
+            block[i][2] = 0;
+            block[i][3] = 255;
+        }
+        break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        decode_value_block(src, values);
+
+        for (int i = 0; i < 16; ++i) {
+            block[i][0] = values[i];
+            block[i][2] = 0;
+            block[i][3] = 255;
+        }
+
+        decode_value_block(src + 8, values);
+
+        for (int i = 0; i < 16; ++i)
+            block[i][1] = values[i];
+        break;
+    default:
+        break;
+    }
+}
+
+void decode_texture_level(VkFormat format, uint32_t width, uint32_t height, const uint8_t *src,
+    uint8_t *rgba)
+{
+    const uint32_t block_size = format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK ||
+        format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK || format == VK_FORMAT_BC4_UNORM_BLOCK ? 8 : 16;
+
+    for (uint32_t by = 0; by < (height + 3) / 4; ++by) {
+        for (uint32_t bx = 0; bx < (width + 3) / 4; ++bx, src += block_size) {
+            uint8_t block[16][4];
+            decode_block(format, src, block);
+
+            // Blocks overhanging the level edge are cropped
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+                    memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4,
+                        block[y * 4 + x], 4);
+        }
+    }
+}
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ecs.h"
+#include "error.h"
+
+#define EMPTY_ARCHETYPE 0u
+
+static uint32_t align_offset(uint32_t offset)
+{
+    return (offset + ECS_COLUMN_ALIGNMENT - 1) / ECS_COLUMN_ALIGNMENT * ECS_COLUMN_ALIGNMENT;
+}
+
+static void create_archetype(struct World *world, uint64_t mask)
+{
+    if (world->archetype_count == ECS_MAX_ARCHETYPES)
+        print_exit("Failed to create an archetype, too many component combinations!");
+
+    struct Archetype *archetype = &world->archetypes[world->archetype_count++];
+    memset(archetype, 0, sizeof(*archetype));
+    archetype->mask = mask;
+
+    uint32_t row_size = sizeof(uint64_t);
+
+    for (uint32_t i = 0; i < world->component_count; ++i)
+        if (mask & ECS_COMPONENT_BIT(i)) {
+            archetype->components[archetype->component_count++] = i;
+            row_size += world->components[i].size;
+        }
+
+    // Every column may waste up to one alignment worth of padding
+    const uint32_t padding = (archetype->component_count + 1) * ECS_COLUMN_ALIGNMENT;
+
+    if (ECS_CHUNK_SIZE < padding + row_size)
+        print_exit("Failed to create an archetype, its components do not fit in a chunk!");
+
+    archetype->capacity = (ECS_CHUNK_SIZE - padding) / row_size;
+
+    uint32_t offset = align_offset(archetype->capacity * sizeof(uint64_t));
+
+    for (uint32_t i = 0; i < archetype->component_count; ++i) {
+        const uint32_t component = archetype->components[i];
+        archetype->offsets[component] = offset;
+        offset = align_offset(offset + archetype->capacity * world->components[component].size);
+    }
+}
+
+static uint32_t find_archetype(struct World *world, uint64_t mask)
+{
+    for (uint32_t i = 0; i < world->archetype_count; ++i)
+        if (world->archetypes[i].mask == mask)
+            return i;
+
+    create_archetype(world, mask);
+
+    return world->archetype_count - 1;
+}
+
+uint32_t register_component(struct World *world, const char *name, uint32_t size)
+{
+    if (world->component_count == ECS_MAX_COMPONENTS)
+        print_exit("Failed to register a component, too many components!");
+
+    // Archetypes are laid out for the components known at the time
+    if (world->archetype_count > 1)
+        print_exit("Failed to register a component after entities were created!");
+
+    world->components[world->component_count].name = name;
+    world->components[world->component_count].size = size;
+
+    return world->component_count++;
+}
+
+static struct EcsCommand *push_command(struct World *world, enum EcsCommandType type,
+    uint64_t entity, uint32_t component)
+{
+    if (world->command_count == world->command_capacity) {
+        world->command_capacity = world->command_capacity > 0 ? world->command_capacity * 2 : 256;
+        world->commands = realloc(world->commands,
+            world->command_capacity * sizeof(struct EcsCommand));
+    }
+
+    struct EcsCommand *command = &world->commands[world->command_count++];
+    command->type = type;
+    command->entity = entity;
+    command->component = component;
+    command->data = 0;
+
+    return command;
+}
+
+uint64_t create_entity(struct World *world)
+{
+    pthread_mutex_lock(&world->command_lock);
+
+    uint32_t index;
+    uint32_t generation = 1;
+
+    // Records only grow during flush_world(), systems may be reading them
+    if (world->free_count > 0) {
+        index = world->free_indices[--world->free_count];
+        generation = world->records[index].generation;
+    } else {
+        index = world->record_count + world->reserved_count++;
+    }
+
+    const uint64_t entity = (uint64_t)generation << 32 | index;
+    push_command(world, ECS_COMMAND_CREATE, entity, 0);
+
+    pthread_mutex_unlock(&world->command_lock);
+
+    return entity;
+}
+
+void destroy_entity(struct World *world, uint64_t entity)
+{
+    pthread_mutex_lock(&world->command_lock);
+    push_command(world, ECS_COMMAND_DESTROY, entity, 0);
+    pthread_mutex_unlock(&world->command_lock);
+}
+
+void add_component(struct World *world, uint64_t entity, uint32_t component, const void *data)
+{
+    const uint32_t size = world->components[component].size;
+
+    pthread_mutex_lock(&world->command_lock);
+
+    struct EcsCommand *command = push_command(world, ECS_COMMAND_ADD, entity, component);
+    command->data = world->command_data_size;
+
+    if (world->command_data_size + size > world->command_data_capacity) {
+        while (world->command_data_size + size > world->command_data_capacity)
+            world->command_data_capacity = world->command_data_capacity > 0 ?
+                world->command_data_capacity * 2 : 4096;
+
+        world->command_data = realloc(world->command_data, world->command_data_capacity);
+    }
+
+    if (data != NULL)
+        memcpy(world->command_data + command->data, data, size);
+    else
+        memset(world->command_data + command->data, 0, size);
+
+    world->command_data_size += size;
+
+    pthread_mutex_unlock(&world->command_lock);
+}
+
+void remove_component(struct World *world, uint64_t entity, uint32_t component)
+{
+    pthread_mutex_lock(&world->command_lock);
+    push_command(world, ECS_COMMAND_REMOVE, entity, component);
+    pthread_mutex_unlock(&world->command_lock);
+}
+
+int is_entity_alive(const struct World *world, uint64_t entity)
+{
+    const uint32_t index = ECS_ENTITY_INDEX(entity);
+
+    return index < world->record_count &&
+        world->records[index].generation == ECS_ENTITY_GENERATION(entity) &&
+        world->records[index].archetype != UINT32_MAX;
+}
+
+static uint8_t *get_row_component(const struct World *world, const struct Archetype *archetype,
+    uint32_t chunk, uint32_t row, uint32_t component)
+{
+    return archetype->chunks[chunk].data + archetype->offsets[component] +
+        (size_t)row * world->components[component].size;
+}
+
+void *get_entity_component(struct World *world, uint64_t entity, uint32_t component)
+{
+    if (!is_entity_alive(world, entity))
+        return NULL;
+
+    const struct EntityRecord *record = &world->records[ECS_ENTITY_INDEX(entity)];
+    const struct Archetype *archetype = &world->archetypes[record->archetype];
+
+    if (!(archetype->mask & ECS_COMPONENT_BIT(component)))
+        return NULL;
+
+    return get_row_component(world, archetype, record->chunk, record->row, component);
+}
+
+uint64_t *get_chunk_entities(const struct ChunkView *view)
+{
+    return (uint64_t *)view->data;
+}
+
+void *get_chunk_column(const struct ChunkView *view, uint32_t component)
+{
+    return view->data + view->archetype->offsets[component];
+}
+
+// Appends an uninitialized row to the last chunk, adding a chunk when it is full
+static void push_row(struct Archetype *archetype, uint32_t *chunk, uint32_t *row)
+{
+    if (archetype->chunk_count == 0 ||
+        archetype->chunks[archetype->chunk_count - 1].count == archetype->capacity) {
+        if (archetype->chunk_count == archetype->chunk_capacity) {
+            archetype->chunk_capacity = archetype->chunk_capacity > 0 ?
+                archetype->chunk_capacity * 2 : 4;
+            archetype->chunks = realloc(archetype->chunks,
+                archetype->chunk_capacity * sizeof(struct Chunk));
+        }
+
+        struct Chunk *added = &archetype->chunks[archetype->chunk_count++];
+        added->data = aligned_alloc(ECS_COLUMN_ALIGNMENT, ECS_CHUNK_SIZE);
+        added->count = 0;
+
+        if (added->data == NULL)
+            print_exit("Failed to allocate an entity chunk!");
+    }
+
+    *chunk = archetype->chunk_count - 1;
+    *row = archetype->chunks[*chunk].count++;
+}
+
+// Fills the hole with the archetype's last row so chunks stay packed
+static void remove_row(struct World *world, struct Archetype *archetype, uint32_t chunk,
+    uint32_t row)
+{
+    const uint32_t last_chunk = archetype->chunk_count - 1;
+    const uint32_t last_row = archetype->chunks[last_chunk].count - 1;
+
+    if (chunk != last_chunk || row != last_row) {
+        uint64_t *entities = (uint64_t *)archetype->chunks[chunk].data;
+        const uint64_t moved = ((uint64_t *)archetype->chunks[last_chunk].data)[last_row];
+        entities[row] = moved;
+
+        for (uint32_t i = 0; i < archetype->component_count; ++i) {
+            const uint32_t component = archetype->components[i];
+            memcpy(get_row_component(world, archetype, chunk, row, component),
+                get_row_component(world, archetype, last_chunk, last_row, component),
+                world->components[component].size);
+        }
+
+        world->records[ECS_ENTITY_INDEX(moved)].chunk = chunk;
+        world->records[ECS_ENTITY_INDEX(moved)].row = row;
+    }
+
+    if (--archetype->chunks[last_chunk].count == 0) {
+        free(archetype->chunks[last_chunk].data);
+        --archetype->chunk_count;
+    }
+}
+
+static void place_entity(struct World *world, uint64_t entity, uint32_t archetype_index)
+{
+    struct EntityRecord *record = &world->records[ECS_ENTITY_INDEX(entity)];
+    struct Archetype *archetype = &world->archetypes[archetype_index];
+
+    push_row(archetype, &record->chunk, &record->row);
+    ((uint64_t *)archetype->chunks[record->chunk].data)[record->row] = entity;
+    record->archetype = archetype_index;
+}
+
+// Moves the entity's row, components missing from the source are left uninitialized
+static void move_entity(struct World *world, uint64_t entity, uint64_t mask)
+{
+    struct EntityRecord *record = &world->records[ECS_ENTITY_INDEX(entity)];
+    const uint32_t destination = find_archetype(world, mask);
+    struct Archetype *source = &world->archetypes[record->archetype];
+    const uint32_t chunk = record->chunk;
+    const uint32_t row = record->row;
+
+    place_entity(world, entity, destination);
+
+    const struct Archetype *target = &world->archetypes[destination];
+
+    for (uint32_t i = 0; i < target->component_count; ++i) {
+        const uint32_t component = target->components[i];
+
+        if (source->mask & ECS_COMPONENT_BIT(component))
+            memcpy(get_row_component(world, target, record->chunk, record->row, component),
+                get_row_component(world, source, chunk, row, component),
+                world->components[component].size);
+    }
+
+    remove_row(world, source, chunk, row);
+}
+
+static void grow_records(struct World *world)
+{
+    const uint32_t count = world->record_count + world->reserved_count;
+
+    if (count > world->record_capacity) {
+        while (count > world->record_capacity)
+            world->record_capacity = world->record_capacity > 0 ? world->record_capacity * 2 : 1024;
+
+        world->records = realloc(world->records,
+            world->record_capacity * sizeof(struct EntityRecord));
+        world->free_indices = realloc(world->free_indices,
+            world->record_capacity * sizeof(uint32_t));
+    }
+
+    for (uint32_t i = world->record_count; i < count; ++i) {
+        world->records[i].generation = 1;
+        world->records[i].archetype = UINT32_MAX;
+    }
+
+    world->record_count = count;
+    world->reserved_count = 0;
+}
+
+static void apply_command(struct World *world, const struct EcsCommand *command)
+{
+    const uint32_t index = ECS_ENTITY_INDEX(command->entity);
+
+    if (index >= world->record_count ||
+        world->records[index].generation != ECS_ENTITY_GENERATION(command->entity))
+        return;
+
+    struct EntityRecord *record = &world->records[index];
+
+    if (command->type == ECS_COMMAND_CREATE) {
+        if (record->archetype == UINT32_MAX)
+            place_entity(world, command->entity, EMPTY_ARCHETYPE);
+        return;
+    }
+
+    if (record->archetype == UINT32_MAX)
+        return;
+
+    const uint64_t mask = world->archetypes[record->archetype].mask;
+    const uint64_t bit = ECS_COMPONENT_BIT(command->component);
+
+    switch (command->type) {
+    case ECS_COMMAND_DESTROY:
+        remove_row(world, &world->archetypes[record->archetype], record->chunk, record->row);
+        record->archetype = UINT32_MAX;
+        // Generation 0 is never handed out so ECS_NULL_ENTITY stays invalid
+        record->generation = record->generation + 1 > 0 ? record->generation + 1 : 1;
+        world->free_indices[world->free_count++] = index;
+        break;
+    case ECS_COMMAND_ADD:
+        if (!(mask & bit))
+            move_entity(world, command->entity, mask | bit);
+
+        memcpy(get_entity_component(world, command->entity, command->component),
+            world->command_data + command->data, world->components[command->component].size);
+        break;
+    case ECS_COMMAND_REMOVE:
+        if (mask & bit)
+            move_entity(world, command->entity, mask & ~bit);
+        break;
+    default:
+        break;
+    }
+}
+
+void flush_world(struct World *world)
+{
+    pthread_mutex_lock(&world->command_lock);
+    grow_records(world);
+
+    for (uint32_t i = 0; i < world->command_count; ++i)
+        apply_command(world, &world->commands[i]);
+
+    world->command_count = 0;
+    world->command_data_size = 0;
+    pthread_mutex_unlock(&world->command_lock);
+}
+
+static int is_system_conflicting(const struct System *a, const struct System *b)
+{
+    return (a->writes & (b->reads | b->writes)) != 0 || (b->writes & a->reads) != 0;
+}
+
+void add_system(struct World *world, const struct System *system)
+{
+    if (world->system_count == ECS_MAX_SYSTEMS)
+        print_exit("Failed to add a system, too many systems!");
+
+    uint32_t stage = 0;
+
+    for (uint32_t i = 0; i < world->system_count; ++i)
+        if (is_system_conflicting(&world->systems[i], system) &&
+            world->system_stages[i] + 1 > stage)
+            stage = world->system_stages[i] + 1;
+
+    world->systems[world->system_count] = *system;
+    world->system_stages[world->system_count++] = stage;
+
+    if (stage + 1 > world->stage_count)
+        world->stage_count = stage + 1;
+}
+
+static void push_job(struct World *world, uint32_t system, uint32_t archetype,
+    uint32_t first_chunk, uint32_t chunk_count)
+{
+    if (world->job_count == world->job_capacity) {
+        world->job_capacity = world->job_capacity > 0 ? world->job_capacity * 2 : 64;
+        world->jobs = realloc(world->jobs, world->job_capacity * sizeof(struct SystemJob));
+    }
+
+    struct SystemJob *job = &world->jobs[world->job_count++];
+    job->system = system;
+    job->archetype = archetype;
+    job->first_chunk = first_chunk;
+    job->chunk_count = chunk_count;
+}
+
+// Splits every system of stage into jobs of at most ECS_JOB_CHUNKS chunks
+static void create_stage_jobs(struct World *world, uint32_t stage)
+{
+    world->job_count = 0;
+
+    for (uint32_t i = 0; i < world->system_count; ++i) {
+        if (world->system_stages[i] != stage)
+            continue;
+
+        const struct System *system = &world->systems[i];
+        const uint64_t required = system->reads | system->writes;
+
+        for (uint32_t j = 0; j < world->archetype_count; ++j) {
+            const struct Archetype *archetype = &world->archetypes[j];
+
+            if ((archetype->mask & required) != required || (archetype->mask & system->excludes))
+                continue;
+
+            for (uint32_t k = 0; k < archetype->chunk_count; k += ECS_JOB_CHUNKS)
+                push_job(world, i, j, k, archetype->chunk_count - k < ECS_JOB_CHUNKS ?
+                    archetype->chunk_count - k : ECS_JOB_CHUNKS);
+        }
+    }
+}
+
+static void run_job(uint32_t index, void *user_data)
+{
+    struct World *world = user_data;
+    const struct SystemJob *job = &world->jobs[index];
+    const struct System *system = &world->systems[job->system];
+    const struct Archetype *archetype = &world->archetypes[job->archetype];
+
+    for (uint32_t i = job->first_chunk; i < job->first_chunk + job->chunk_count; ++i) {
+        struct ChunkView view;
+        view.archetype = archetype;
+        view.data = archetype->chunks[i].data;
+        view.count = archetype->chunks[i].count;
+
+        system->run(world, &view, system->user_data);
+    }
+}
+
+void create_world(uint32_t worker_count, struct World *world)
+{
+    memset(world, 0, sizeof(*world));
+    pthread_mutex_init(&world->command_lock, NULL);
+    create_archetype(world, 0);
+    create_job_pool(worker_count, &world->pool);
+}
+
+void run_systems(struct World *world)
+{
+    for (uint32_t stage = 0; stage < world->stage_count; ++stage) {
+        create_stage_jobs(world, stage);
+
+        if (world->job_count > 0)
+            run_job_pool(&world->pool, world->job_count, &run_job, world);
+    }
+
+    flush_world(world);
+}
+
+void for_each_chunk(struct World *world, uint64_t mask, SystemFunc func, void *user_data)
+{
+    for (uint32_t i = 0; i < world->archetype_count; ++i) {
+        const struct Archetype *archetype = &world->archetypes[i];
+
+        if ((archetype->mask & mask) != mask)
+            continue;
+
+        for (uint32_t j = 0; j < archetype->chunk_count; ++j) {
+            struct ChunkView view;
+            view.archetype = archetype;
+            view.data = archetype->chunks[j].data;
+            view.count = archetype->chunks[j].count;
+
+            func(world, &view, user_data);
+        }
+    }
+}
+
+void destroy_world(struct World *world)
+{
+    destroy_job_pool(&world->pool);
+
+    for (uint32_t i = 0; i < world->archetype_count; ++i) {
+        for (uint32_t j = 0; j < world->archetypes[i].chunk_count; ++j)
+            free(world->archetypes[i].chunks[j].data);
+
+        free(world->archetypes[i].chunks);
+    }
+
+    pthread_mutex_destroy(&world->command_lock);
+    free(world->records);
+    free(world->free_indices);
+    free(world->commands);
+    free(world->command_data);
+    free(world->jobs);
+}
@@ -0,0 +1,16 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "error.h"
+
+void print_exit(const char *message)
+{
+    fprintf(stderr, "%s\n", message);
+    exit(-1);
+}
+
+void assert_vulkan(VkResult result, const char *message) 
+{
+    if (result != VK_SUCCESS)
+        print_exit(message);
+}
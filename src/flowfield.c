@@ -0,0 +1,506 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "error.h"
+#include "flowfield.h"
+
+#define ORTHOGONAL_STEP 10u
+#define DIAGONAL_STEP 14u
+
+static const int32_t DIRECTIONS[8][2] = {
+    {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+};
+
+// Directions normalized, indexed like DIRECTIONS
+static const float VECTORS[8][2] = {
+    {1.0f, 0.0f}, {0.70710678f, 0.70710678f}, {0.0f, 1.0f}, {-0.70710678f, 0.70710678f},
+    {-1.0f, 0.0f}, {-0.70710678f, -0.70710678f}, {0.0f, -1.0f}, {0.70710678f, -0.70710678f}
+};
+
+struct SolveBatch {
+    struct FlowGrid *grid;
+    uint32_t fields[FLOW_MAX_FIELDS];
+};
+
+static double get_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void create_flow_grid(uint32_t width, uint32_t height, struct JobPool *pool,
+    struct FlowGrid *grid)
+{
+    memset(grid, 0, sizeof(*grid));
+    grid->width = width;
+    grid->height = height;
+    grid->sectors_x = (width + FLOW_SECTOR_SIZE - 1) / FLOW_SECTOR_SIZE;
+    grid->sectors_y = (height + FLOW_SECTOR_SIZE - 1) / FLOW_SECTOR_SIZE;
+    grid->costs = malloc((size_t)width * height);
+    grid->changed = calloc((size_t)width * height, 1);
+    grid->pool = pool;
+
+    memset(grid->costs, 1, (size_t)width * height);
+}
+
+void create_flow_grid_from_tilemap(const struct TilemapHeader *tilemap,
+    const uint8_t *tile_costs, uint32_t tile_cost_count, struct JobPool *pool,
+    struct FlowGrid *grid)
+{
+    const uint16_t *tiles = (const uint16_t *)(tilemap + 1);
+
+    create_flow_grid(tilemap->width, tilemap->height, pool, grid);
+
+    for (uint32_t i = 0; i < tilemap->width * tilemap->height; ++i)
+        if (tiles[i] != TILEMAP_EMPTY && tiles[i] < tile_cost_count)
+            grid->costs[i] = tile_costs[tiles[i]] > 0 ? tile_costs[tiles[i]] : 1;
+}
+
+void set_flow_cost(struct FlowGrid *grid, uint32_t x, uint32_t y, uint8_t cost)
+{
+    if (x >= grid->width || y >= grid->height)
+        print_exit("Failed to set a flow cost, tile outside the grid!");
+
+    const uint32_t tile = y * grid->width + x;
+
+    if (cost == 0)
+        cost = 1;
+
+    if (grid->costs[tile] == cost)
+        return;
+
+    grid->costs[tile] = cost;
+
+    if (!grid->changed[tile]) {
+        grid->changed[tile] = 1;
+        grid->changes = grow_array(grid->changes, &grid->change_capacity, grid->change_count + 1,
+            sizeof(uint32_t));
+        grid->changes[grid->change_count++] = tile;
+    }
+}
+
+static void create_field(const struct FlowGrid *grid, struct FlowField *field)
+{
+    const size_t tiles = (size_t)grid->width * grid->height;
+
+    memset(field, 0, sizeof(*field));
+    field->integration = malloc(tiles * sizeof(uint32_t));
+    field->directions = malloc(tiles);
+    field->invalid = calloc(tiles, 1);
+    field->dirty_sectors = malloc(grid->sectors_x * grid->sectors_y);
+}
+
+const struct FlowField *request_flow_field(struct FlowGrid *grid, uint32_t goal_x,
+    uint32_t goal_y)
+{
+    if (goal_x >= grid->width || goal_y >= grid->height)
+        print_exit("Failed to request a flow field, goal outside the grid!");
+
+    uint32_t oldest = 0;
+
+    for (uint32_t i = 0; i < grid->field_count; ++i) {
+        struct FlowField *field = &grid->fields[i];
+
+        if (field->goal_x == goal_x && field->goal_y == goal_y) {
+            field->last_requested = grid->updates;
+            return field;
+        }
+
+        if (field->last_requested < grid->fields[oldest].last_requested)
+            oldest = i;
+    }
+
+    if (grid->field_count < FLOW_MAX_FIELDS) {
+        oldest = grid->field_count++;
+        create_field(grid, &grid->fields[oldest]);
+    }
+
+    struct FlowField *field = &grid->fields[oldest];
+    field->goal_x = goal_x;
+    field->goal_y = goal_y;
+    field->solved = 0;
+    field->last_requested = grid->updates;
+
+    return field;
+}
+
+// Neighbor of tile in direction, UINT32_MAX when the move leaves the grid or cuts a corner
+static uint32_t get_neighbor(const struct FlowGrid *grid, uint32_t tile, uint32_t direction)
+{
+    const int32_t x = (int32_t)(tile % grid->width) + DIRECTIONS[direction][0];
+    const int32_t y = (int32_t)(tile / grid->width) + DIRECTIONS[direction][1];
+
+    if (x < 0 || y < 0 || x >= (int32_t)grid->width || y >= (int32_t)grid->height)
+        return UINT32_MAX;
+
+    if (direction & 1) {
+        const uint32_t side_x = (tile / grid->width) * grid->width + (uint32_t)x;
+        const uint32_t side_y = (uint32_t)y * grid->width + tile % grid->width;
+
+        if (grid->costs[side_x] == FLOW_BLOCKED || grid->costs[side_y] == FLOW_BLOCKED)
+            return UINT32_MAX;
+    }
+
+    return (uint32_t)y * grid->width + (uint32_t)x;
+}
+
+static uint32_t get_step(uint32_t direction)
+{
+    return direction & 1 ? DIAGONAL_STEP : ORTHOGONAL_STEP;
+}
+
+// Marks the sectors whose directions can see tile
+static void mark_dirty(const struct FlowGrid *grid, struct FlowField *field, uint32_t tile)
+{
+    const uint32_t x = tile % grid->width;
+    const uint32_t y = tile / grid->width;
+    const uint32_t min_x = (x > 0 ? x - 1 : 0) / FLOW_SECTOR_SIZE;
+    const uint32_t min_y = (y > 0 ? y - 1 : 0) / FLOW_SECTOR_SIZE;
+    const uint32_t max_x = (x + 1 < grid->width ? x + 1 : x) / FLOW_SECTOR_SIZE;
+    const uint32_t max_y = (y + 1 < grid->height ? y + 1 : y) / FLOW_SECTOR_SIZE;
+
+    for (uint32_t sector_y = min_y; sector_y <= max_y; ++sector_y)
+        for (uint32_t sector_x = min_x; sector_x <= max_x; ++sector_x)
+            field->dirty_sectors[sector_y * grid->sectors_x + sector_x] = 1;
+}
+
+static void push_heap(struct FlowField *field, uint32_t cost, uint32_t tile)
+{
+    field->heap = grow_array(field->heap, &field->heap_capacity, field->heap_count + 1,
+        sizeof(uint64_t));
+
+    uint32_t i = field->heap_count++;
+    const uint64_t value = (uint64_t)cost << 32 | tile;
+
+    while (i > 0 && field->heap[(i - 1) / 2] > value) {
+        field->heap[i] = field->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    field->heap[i] = value;
+}
+
+static uint64_t pop_heap(struct FlowField *field)
+{
+    const uint64_t top = field->heap[0];
+    const uint64_t last = field->heap[--field->heap_count];
+    uint32_t i = 0;
+
+    while (i * 2 + 1 < field->heap_count) {
+        uint32_t child = i * 2 + 1;
+
+        if (child + 1 < field->heap_count && field->heap[child + 1] < field->heap[child])
+            ++child;
+        if (field->heap[child] >= last)
+            break;
+
+        field->heap[i] = field->heap[child];
+        i = child;
+    }
+
+    field->heap[i] = last;
+
+    return top;
+}
+
+// Dijkstra from whatever is queued, tiles only ever get cheaper
+static void propagate(const struct FlowGrid *grid, struct FlowField *field)
+{
+    while (field->heap_count > 0) {
+        const uint64_t top = pop_heap(field);
+        const uint32_t cost = (uint32_t)(top >> 32);
+        const uint32_t tile = (uint32_t)top;
+
+        if (cost > field->integration[tile])
+            continue;
+
+        for (uint32_t direction = 0; direction < 8; ++direction) {
+            const uint32_t neighbor = get_neighbor(grid, tile, direction);
+
+            if (neighbor == UINT32_MAX || grid->costs[neighbor] == FLOW_BLOCKED)
+                continue;
+
+            const uint32_t next = cost + get_step(direction) * grid->costs[neighbor];
+
+            if (next < field->integration[neighbor]) {
+                field->integration[neighbor] = next;
+                mark_dirty(grid, field, neighbor);
+                push_heap(field, next, neighbor);
+            }
+        }
+    }
+}
+
+static void solve_field(const struct FlowGrid *grid, struct FlowField *field)
+{
+    const uint32_t goal = field->goal_y * grid->width + field->goal_x;
+
+    memset(field->integration, 0xff, (size_t)grid->width * grid->height * sizeof(uint32_t));
+    memset(field->dirty_sectors, 1, grid->sectors_x * grid->sectors_y);
+
+    field->integration[goal] = 0;
+    field->heap_count = 0;
+    push_heap(field, 0, goal);
+    propagate(grid, field);
+}
+
+static void push_invalid(struct FlowField *field, uint32_t tile)
+{
+    if (field->invalid[tile])
+        return;
+
+    field->invalid[tile] = 1;
+    field->stack = grow_array(field->stack, &field->stack_capacity, field->stack_count + 1,
+        sizeof(uint32_t));
+    field->stack[field->stack_count++] = tile;
+}
+
+/*
+ * Resets the changed tiles, their neighbors and every tile whose cost was
+ * derived through them, then propagates again from the valid tiles around
+ * the hole. Ties are invalidated too, which is conservative but exact.
+ */
+static void repair_field(const struct FlowGrid *grid, struct FlowField *field)
+{
+    const uint32_t goal = field->goal_y * grid->width + field->goal_x;
+
+    field->stack_count = 0;
+    field->heap_count = 0;
+
+    for (uint32_t i = 0; i < grid->change_count; ++i) {
+        push_invalid(field, grid->changes[i]);
+
+        for (uint32_t direction = 0; direction < 8; ++direction) {
+            const int32_t x = (int32_t)(grid->changes[i] % grid->width) +
+                DIRECTIONS[direction][0];
+            const int32_t y = (int32_t)(grid->changes[i] / grid->width) +
+                DIRECTIONS[direction][1];
+
+            if (x >= 0 && y >= 0 && x < (int32_t)grid->width && y < (int32_t)grid->height)
+                push_invalid(field, (uint32_t)y * grid->width + (uint32_t)x);
+        }
+    }
+
+    for (uint32_t i = 0; i < field->stack_count; ++i) {
+        const uint32_t tile = field->stack[i];
+
+        if (field->integration[tile] == FLOW_UNREACHABLE)
+            continue;
+
+        for (uint32_t direction = 0; direction < 8; ++direction) {
+            const int32_t x = (int32_t)(tile % grid->width) + DIRECTIONS[direction][0];
+            const int32_t y = (int32_t)(tile / grid->width) + DIRECTIONS[direction][1];
+
+            if (x < 0 || y < 0 || x >= (int32_t)grid->width || y >= (int32_t)grid->height)
+                continue;
+
+            const uint32_t neighbor = (uint32_t)y * grid->width + (uint32_t)x;
+            const uint32_t value = field->integration[neighbor];
+
+            if (value != FLOW_UNREACHABLE && neighbor != goal &&
+                value == field->integration[tile] + get_step(direction) * grid->costs[neighbor])
+                push_invalid(field, neighbor);
+        }
+    }
+
+    for (uint32_t i = 0; i < field->stack_count; ++i) {
+        field->integration[field->stack[i]] = FLOW_UNREACHABLE;
+        mark_dirty(grid, field, field->stack[i]);
+    }
+
+    if (field->invalid[goal]) {
+        field->integration[goal] = 0;
+        push_heap(field, 0, goal);
+    }
+
+    for (uint32_t i = 0; i < field->stack_count; ++i)
+        for (uint32_t direction = 0; direction < 8; ++direction) {
+            const uint32_t neighbor = get_neighbor(grid, field->stack[i], direction);
+
+            if (neighbor != UINT32_MAX && !field->invalid[neighbor] &&
+                field->integration[neighbor] != FLOW_UNREACHABLE)
+                push_heap(field, field->integration[neighbor], neighbor);
+        }
+
+    for (uint32_t i = 0; i < field->stack_count; ++i)
+        field->invalid[field->stack[i]] = 0;
+
+    propagate(grid, field);
+}
+
+static void run_solve_job(uint32_t job, void *user_data)
+{
+    struct SolveBatch *batch = user_data;
+    struct FlowField *field = &batch->grid->fields[batch->fields[job]];
+    const double start = get_seconds();
+
+    if (field->solved) {
+        repair_field(batch->grid, field);
+    } else {
+        solve_field(batch->grid, field);
+        field->solved = 1;
+    }
+
+    field->solve_time = get_seconds() - start;
+}
+
+static void build_sector(const struct FlowGrid *grid, struct FlowField *field, uint32_t sector)
+{
+    const uint32_t goal = field->goal_y * grid->width + field->goal_x;
+    const uint32_t min_x = sector % grid->sectors_x * FLOW_SECTOR_SIZE;
+    const uint32_t min_y = sector / grid->sectors_x * FLOW_SECTOR_SIZE;
+    const uint32_t max_x = min_x + FLOW_SECTOR_SIZE < grid->width ?
+        min_x + FLOW_SECTOR_SIZE : grid->width;
+    const uint32_t max_y = min_y + FLOW_SECTOR_SIZE < grid->height ?
+        min_y + FLOW_SECTOR_SIZE : grid->height;
+
+    for (uint32_t y = min_y; y < max_y; ++y)
+        for (uint32_t x = min_x; x < max_x; ++x) {
+            const uint32_t tile = y * grid->width + x;
+            uint32_t best = field->integration[tile];
+            uint8_t best_direction = FLOW_DIRECTION_NONE;
+
+            if (tile != goal && grid->costs[tile] != FLOW_BLOCKED)
+                for (uint32_t direction = 0; direction < 8; ++direction) {
+                    const uint32_t neighbor = get_neighbor(grid, tile, direction);
+
+                    if (neighbor == UINT32_MAX || field->integration[neighbor] >= best)
+                        continue;
+
+                    best = field->integration[neighbor];
+                    best_direction = (uint8_t)direction;
+                }
+
+            field->directions[tile] = best_direction;
+        }
+
+    field->dirty_sectors[sector] = 0;
+}
+
+static void run_sector_job(uint32_t job, void *user_data)
+{
+    struct FlowGrid *grid = user_data;
+    const struct FlowSectorJob *sector_job = &grid->jobs[job];
+    struct FlowField *field = &grid->fields[sector_job->field];
+
+    for (uint32_t i = 0; i < sector_job->sector_count; ++i)
+        if (field->dirty_sectors[sector_job->first_sector + i])
+            build_sector(grid, field, sector_job->first_sector + i);
+}
+
+static void run_jobs(struct FlowGrid *grid, uint32_t count, JobFunc func, void *user_data)
+{
+    if (grid->pool != NULL)
+        run_job_pool(grid->pool, count, func, user_data);
+    else
+        for (uint32_t i = 0; i < count; ++i)
+            func(i, user_data);
+}
+
+// Jobs of up to FLOW_JOB_SECTORS consecutive sectors, skipping stretches that are clean
+static void create_sector_jobs(struct FlowGrid *grid)
+{
+    const uint32_t sector_count = grid->sectors_x * grid->sectors_y;
+
+    grid->job_count = 0;
+    grid->stats.sectors_rebuilt = 0;
+
+    for (uint32_t i = 0; i < grid->field_count; ++i) {
+        const struct FlowField *field = &grid->fields[i];
+
+        if (!field->solved)
+            continue;
+
+        for (uint32_t first = 0; first < sector_count; first += FLOW_JOB_SECTORS) {
+            const uint32_t count = sector_count - first < FLOW_JOB_SECTORS ?
+                sector_count - first : FLOW_JOB_SECTORS;
+            uint32_t dirty = 0;
+
+            for (uint32_t j = 0; j < count; ++j)
+                dirty += field->dirty_sectors[first + j];
+
+            if (dirty == 0)
+                continue;
+
+            grid->jobs = grow_array(grid->jobs, &grid->job_capacity, grid->job_count + 1,
+                sizeof(struct FlowSectorJob));
+            grid->jobs[grid->job_count].field = i;
+            grid->jobs[grid->job_count].first_sector = first;
+            grid->jobs[grid->job_count++].sector_count = count;
+            grid->stats.sectors_rebuilt += dirty;
+        }
+    }
+}
+
+void update_flow_grid(struct FlowGrid *grid)
+{
+    const double start = get_seconds();
+    struct SolveBatch batch;
+    uint32_t solve_count = 0;
+
+    batch.grid = grid;
+    grid->stats.full_solves = 0;
+    grid->stats.incremental_solves = 0;
+    grid->stats.max_solve_time = 0.0;
+
+    for (uint32_t i = 0; i < grid->field_count; ++i) {
+        if (!grid->fields[i].solved)
+            ++grid->stats.full_solves;
+        else if (grid->change_count > 0)
+            ++grid->stats.incremental_solves;
+        else
+            continue;
+
+        batch.fields[solve_count++] = i;
+    }
+
+    // One job per field, fields never share memory
+    run_jobs(grid, solve_count, &run_solve_job, &batch);
+
+    for (uint32_t i = 0; i < solve_count; ++i)
+        if (grid->fields[batch.fields[i]].solve_time > grid->stats.max_solve_time)
+            grid->stats.max_solve_time = grid->fields[batch.fields[i]].solve_time;
+
+    create_sector_jobs(grid);
+    run_jobs(grid, grid->job_count, &run_sector_job, grid);
+
+    for (uint32_t i = 0; i < grid->change_count; ++i)
+        grid->changed[grid->changes[i]] = 0;
+
+    grid->change_count = 0;
+    ++grid->updates;
+    grid->stats.update_time = get_seconds() - start;
+}
+
+void get_flow_vector(const struct FlowGrid *grid, const struct FlowField *field, uint32_t x,
+    uint32_t y, float vector[2])
+{
+    const uint8_t direction = field->solved && x < grid->width && y < grid->height ?
+        field->directions[y * grid->width + x] : FLOW_DIRECTION_NONE;
+
+    vector[0] = direction != FLOW_DIRECTION_NONE ? VECTORS[direction][0] : 0.0f;
+    vector[1] = direction != FLOW_DIRECTION_NONE ? VECTORS[direction][1] : 0.0f;
+}
+
+void destroy_flow_grid(struct FlowGrid *grid)
+{
+    for (uint32_t i = 0; i < grid->field_count; ++i) {
+        struct FlowField *field = &grid->fields[i];
+
+        free(field->integration);
+        free(field->directions);
+        free(field->dirty_sectors);
+        free(field->invalid);
+        free(field->heap);
+        free(field->stack);
+    }
+
+    free(grid->costs);
+    free(grid->changed);
+    free(grid->changes);
+    free(grid->jobs);
+}
@@ -1,26 +1,20 @@
 #include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
 #define GLFW_INCLUDE_VULKAN
 #include <glfw/glfw3.h>
 
+#include "arena.h"
 #include "instance.h"
 
-void print_exit(const char *message)
-{
-    fprintf(stderr, "%s\n", message);
-    exit(-1);
-}
-
 #ifndef NDEBUG
-void get_layers(const char *layers[LAYER_COUNT]) 
+void get_layers(struct Arena *scratch, const char *layers[LAYER_COUNT]) 
 {
     layers[0] = "VK_LAYER_LUNARG_standard_validation";
 
     uint32_t lyrcount = 0;
     vkEnumerateInstanceLayerProperties(&lyrcount, NULL);
 
-    VkLayerProperties lyrs[lyrcount];
+    const size_t mark = get_arena_mark(scratch);
+    VkLayerProperties *lyrs = ALLOCATE_ARRAY(scratch, VkLayerProperties, lyrcount);
     vkEnumerateInstanceLayerProperties(&lyrcount, lyrs);
 
     for (uint32_t i = 0; i < LAYER_COUNT; ++i) {
@@ -32,10 +26,12 @@ void get_layers(const char *layers[LAYER_COUNT])
 
         nextLayer:;
     }
+
+    reset_arena(scratch, mark);
 }
 #endif
 
-const char **create_instance_extensions(uint32_t *count) 
+const char **create_instance_extensions(struct Arena *arena, uint32_t *count) 
 {
 #ifdef NDEBUG
     return glfwGetRequiredInstanceExtensions(count);
@@ -43,14 +39,15 @@ const char **create_instance_extensions(uint32_t *count)
     uint32_t glfwext_count = 0;
     const char **glfwexts = glfwGetRequiredInstanceExtensions(&glfwext_count);
     *count = glfwext_count + 1;
-    const char **reqextensions = malloc(sizeof(*count * sizeof(const char *)));
+    const char **reqextensions = ALLOCATE_ARRAY(arena, const char *, *count);
     memcpy(reqextensions, glfwexts, glfwext_count * sizeof(const char *));
     reqextensions[glfwext_count] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
 
     uint32_t extcount = 0;
     vkEnumerateInstanceExtensionProperties(NULL, &extcount, NULL);
 
-    VkExtensionProperties exts[extcount];
+    const size_t mark = get_arena_mark(arena);
+    VkExtensionProperties *exts = ALLOCATE_ARRAY(arena, VkExtensionProperties, extcount);
     vkEnumerateInstanceExtensionProperties(NULL, &extcount, exts);
 
     for (uint32_t i = 0; i < *count; ++i) {
@@ -63,6 +60,8 @@ const char **create_instance_extensions(uint32_t *count)
         next_extensions:;
     }
 
+    reset_arena(arena, mark);
+
     return reqextensions;      
 #endif
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <unistd.h>
+
+#include "error.h"
+#include "jobs.h"
+
+uint32_t get_default_worker_count(void)
+{
+    const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cpu_count > 1 ? (uint32_t)cpu_count - 1 : 0;
+}
+
+static void run_jobs(struct JobPool *pool)
+{
+    for (uint32_t i = atomic_fetch_add(&pool->next_job, 1); i < pool->job_count;
+        i = atomic_fetch_add(&pool->next_job, 1))
+        pool->func(i, pool->user_data);
+}
+
+static void *run_worker(void *data)
+{
+    struct JobPool *pool = data;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (1) {
+        while (pool->running && pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+
+        if (!pool->running)
+            break;
+
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_jobs(pool);
+
+        pthread_mutex_lock(&pool->lock);
+
+        if (++pool->finished_workers == pool->worker_count)
+            pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+void create_job_pool(uint32_t worker_count, struct JobPool *pool)
+{
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    atomic_init(&pool->next_job, 0);
+    pool->generation = 0;
+    pool->running = 1;
+    pool->worker_count = 0;
+    pool->finished_workers = 0;
+    pool->job_count = 0;
+
+    if (worker_count > JOB_MAX_WORKERS)
+        worker_count = JOB_MAX_WORKERS;
+
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        if (pthread_create(&pool->workers[i], NULL, &run_worker, pool) != 0)
+            print_exit("Failed to start a worker thread!");
+
+        ++pool->worker_count;
+    }
+}
+
+void run_job_pool(struct JobPool *pool, uint32_t job_count, JobFunc func, void *user_data)
+{
+    pool->func = func;
+    pool->user_data = user_data;
+    pool->job_count = job_count;
+    atomic_store(&pool->next_job, 0);
+
+    // Waking the workers costs more than a single job saves
+    if (pool->worker_count == 0 || job_count <= 1) {
+        run_jobs(pool);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->finished_workers = 0;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_jobs(pool);
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->finished_workers < pool->worker_count)
+        pthread_cond_wait(&pool->done, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void destroy_job_pool(struct JobPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->running = 0;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0; i < pool->worker_count; ++i)
+        pthread_join(pool->workers[i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+}
@@ -1,8 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "renderer.h"
+#include "scene.h"
+
+#define DEFAULT_SPRITE_COUNT 1000u
+
+static void print_usage(void)
+{
+    printf("Usage: Lindmar [--present-mode fifo|fifo-relaxed|mailbox|immediate] [--fps rate]\n"
+        "    [--gpu index|name] [--no-async-compute] [--low-latency] [--tick-rate rate]\n"
+        "    [--msaa samples] [--dynamic-resolution] [--min-scale scale] [--max-scale scale]\n"
+        "    [--damage-tracking] [--stats] [--overlay] [--pipeline-stats] [--overdraw]\n"
+        "    [--verbose-validation] [--pack path] [--vt-budget MiB] [--backdrop name]\n"
+        "    [--virtual-backdrop] [--sprites count] [--no-sprite-culling]\n");
+}
+
+// Returns 0 for an unknown name
+static int parse_present_mode(const char *name, VkPresentModeKHR *mode)
+{
+    if (strcmp(name, "immediate") == 0)
+        *mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    else if (strcmp(name, "mailbox") == 0)
+        *mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    else if (strcmp(name, "fifo-relaxed") == 0)
+        *mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    else if (strcmp(name, "fifo") == 0)
+        *mode = VK_PRESENT_MODE_FIFO_KHR;
+    else
+        return 0;
 
-int main(void)
+    return 1;
+}
+
+// Returns 0 unless text is a positive number
+static int parse_rate(const char *text, double *rate)
+{
+    char *end;
+    *rate = strtod(text, &end);
+
+    return end != text && *end == '\0' && *rate > 0.0;
+}
+
+// Returns 0 unless text is a whole number that fits in 32 bits
+static int parse_count(const char *text, uint32_t *count)
 {
-    struct Renderer *renderer = create_renderer();
+    char *end;
+    const unsigned long long value = strtoull(text, &end, 10);
+    *count = (uint32_t)value;
+
+    return end != text && *end == '\0' && text[0] != '-' && value <= UINT32_MAX;
+}
+
+// Returns 0 for unknown flags, missing values and invalid values
+static int parse_settings(int argc, char **argv, struct RendererSettings *settings,
+    uint32_t *sprite_count)
+{
+    const char *gpu = getenv("LINDMAR_GPU");
+
+    if (gpu != NULL)
+        settings->gpu = gpu;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--gpu") == 0 && i + 1 < argc)
+            settings->gpu = argv[++i];
+        else if (strcmp(argv[i], "--no-async-compute") == 0)
+            settings->async_compute = 0;
+        else if (strcmp(argv[i], "--no-sprite-culling") == 0)
+            settings->sprite_culling = 0;
+        else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+            if (!parse_present_mode(argv[++i], &settings->present_mode))
+                return 0;
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            double fps;
+
+            if (!parse_rate(argv[++i], &fps))
+                return 0;
+
+            settings->target_frame_time = 1.0 / fps;
+        } else if (strcmp(argv[i], "--stats") == 0)
+            settings->print_stats = 1;
+        else if (strcmp(argv[i], "--overlay") == 0)
+            settings->overlay = 1;
+        else if (strcmp(argv[i], "--verbose-validation") == 0)
+            settings->verbose_validation = 1;
+        else if (strcmp(argv[i], "--pipeline-stats") == 0)
+            settings->pipeline_statistics = 1;
+        else if (strcmp(argv[i], "--overdraw") == 0)
+            settings->overdraw = 1;
+        else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+            uint32_t *samples = &settings->msaa_samples;
+
+            if (!parse_count(argv[++i], samples) || *samples == 0 || *samples > 8 ||
+                (*samples & (*samples - 1)) != 0)
+                return 0;
+        } else if (strcmp(argv[i], "--damage-tracking") == 0)
+            settings->damage_tracking = 1;
+        else if (strcmp(argv[i], "--dynamic-resolution") == 0)
+            settings->dynamic_resolution = 1;
+        else if (strcmp(argv[i], "--min-scale") == 0 && i + 1 < argc)
+            settings->min_resolution_scale = atof(argv[++i]);
+        else if (strcmp(argv[i], "--max-scale") == 0 && i + 1 < argc)
+            settings->max_resolution_scale = atof(argv[++i]);
+        else if (strcmp(argv[i], "--low-latency") == 0)
+            settings->low_latency = 1;
+        else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+            settings->asset_pack = argv[++i];
+        else if (strcmp(argv[i], "--vt-budget") == 0 && i + 1 < argc)
+            settings->virtual_texture_budget = strtoull(argv[++i], NULL, 10) * 1024u * 1024u;
+        else if (strcmp(argv[i], "--backdrop") == 0 && i + 1 < argc)
+            settings->backdrop = argv[++i];
+        else if (strcmp(argv[i], "--virtual-backdrop") == 0)
+            settings->virtual_backdrop = 1;
+        else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            if (!parse_rate(argv[++i], &settings->tick_rate))
+                return 0;
+        } else if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) {
+            if (!parse_count(argv[++i], sprite_count))
+                return 0;
+        } else {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    struct RendererSettings settings;
+    get_default_renderer_settings(&settings);
+    uint32_t sprite_count = DEFAULT_SPRITE_COUNT;
+
+    if (!parse_settings(argc, argv, &settings, &sprite_count)) {
+        print_usage();
+        return -1;
+    }
+
+    struct Renderer *renderer = create_renderer(&settings);
+    struct Scene scene;
+    create_scene(renderer, sprite_count, settings.print_stats, &scene);
+    set_renderer_tick(renderer, tick_scene, &scene);
+    set_renderer_update(renderer, update_scene, &scene);
     run_renderer(renderer);
+    destroy_scene(&scene);
     destroy_renderer(renderer);
 }
\ No newline at end of file
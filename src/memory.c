@@ -0,0 +1,337 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "instance.h"
+#include "memory.h"
+
+// Without VK_EXT_memory_budget, the share of a heap assumed safe to fill
+#define FALLBACK_BUDGET_SHARE 0.8
+
+// Process wide, the renderer owns a single device
+static atomic_uint_fast64_t heap_usage[VK_MAX_MEMORY_HEAPS];
+
+uint32_t get_texture_family(VkFormat format)
+{
+    if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK)
+        return TEXTURE_FAMILY_BC;
+    if (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK)
+        return TEXTURE_FAMILY_ETC2;
+    if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+        return TEXTURE_FAMILY_ASTC;
+
+    return 0;
+}
+
+VkDeviceSize get_texture_level_size(VkFormat format, uint32_t width, uint32_t height)
+{
+    const VkDeviceSize texels = (VkDeviceSize)width * height;
+    const VkDeviceSize blocks = (VkDeviceSize)((width + 3) / 4) * ((height + 3) / 4);
+
+    switch (format) {
+    case VK_FORMAT_R8_UNORM:
+        return texels;
+    case VK_FORMAT_R8G8_UNORM:
+        return texels * 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_R32_SFLOAT:
+        return texels * 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return texels * 8;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        return blocks * 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        return blocks * 16;
+    default:
+        print_exit("Failed to size a texture level, unsupported format!");
+        return 0;
+    }
+}
+
+const char *get_texture_format_name(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8_UNORM:
+        return "R8";
+    case VK_FORMAT_R8G8_UNORM:
+        return "RG8";
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return "RGBA8";
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return "RGBA8 sRGB";
+    case VK_FORMAT_B8G8R8A8_UNORM:
+        return "BGRA8";
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return "BGRA8 sRGB";
+    case VK_FORMAT_R32_SFLOAT:
+        return "R32F";
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return "RGBA16F";
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        return "BC1";
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return "BC1 sRGB";
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+        return "BC3";
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        return "BC3 sRGB";
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        return "BC4";
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        return "BC5";
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+        return "BC7";
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return "BC7 sRGB";
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        return "ETC2 RGB";
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        return "ETC2 RGB sRGB";
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+        return "ETC2 RGBA";
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        return "ETC2 RGBA sRGB";
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+        return "ASTC 4x4";
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        return "ASTC 4x4 sRGB";
+    default:
+        return "unknown";
+    }
+}
+
+// UINT32_MAX when no memory type in type_bits has all of properties
+static uint32_t search_memory_type(VkPhysicalDevice gpu, uint32_t type_bits,
+    VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memprops;
+    vkGetPhysicalDeviceMemoryProperties(gpu, &memprops);
+
+    for (uint32_t i = 0; i < memprops.memoryTypeCount; ++i)
+        if ((type_bits & (1u << i)) &&
+            (memprops.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+
+    return UINT32_MAX;
+}
+
+uint32_t find_memory_type(VkPhysicalDevice gpu, uint32_t type_bits,
+    VkMemoryPropertyFlags properties)
+{
+    const uint32_t type = search_memory_type(gpu, type_bits, properties);
+
+    if (type == UINT32_MAX)
+        print_exit("Failed to find a suitable Vulkan memory type!");
+
+    return type;
+}
+
+uint64_t get_memory_heap_usage(uint32_t heap)
+{
+    return atomic_load(&heap_usage[heap]);
+}
+
+static VkDeviceMemory allocate_memory(VkDevice device, VkPhysicalDevice gpu,
+    const VkMemoryRequirements *reqs, VkMemoryPropertyFlags properties, uint32_t *heap)
+{
+    VkPhysicalDeviceMemoryProperties memprops;
+    vkGetPhysicalDeviceMemoryProperties(gpu, &memprops);
+
+    VkMemoryAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.allocationSize = reqs->size;
+    info.memoryTypeIndex = find_memory_type(gpu, reqs->memoryTypeBits, properties);
+
+    VkDeviceMemory memory;
+    assert_vulkan(vkAllocateMemory(device, &info, NULL, &memory),
+        "Failed to allocate Vulkan device memory!");
+
+    *heap = memprops.memoryTypes[info.memoryTypeIndex].heapIndex;
+
+    // Lazily allocated memory takes nothing from the heap until it is committed
+    if (!(properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+        atomic_fetch_add(&heap_usage[*heap], reqs->size);
+
+    return memory;
+}
+
+void create_buffer(VkDevice device, VkPhysicalDevice gpu, VkDeviceSize size,
+    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, struct GpuBuffer *buffer)
+{
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    assert_vulkan(vkCreateBuffer(device, &info, NULL, &buffer->buffer),
+        "Failed to create a Vulkan buffer!");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(device, buffer->buffer, &reqs);
+
+    buffer->memory = allocate_memory(device, gpu, &reqs, properties, &buffer->heap);
+    buffer->allocation_size = reqs.size;
+    buffer->size = size;
+    buffer->mapped = NULL;
+
+    assert_vulkan(vkBindBufferMemory(device, buffer->buffer, buffer->memory, 0),
+        "Failed to bind Vulkan buffer memory!");
+
+    if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        assert_vulkan(vkMapMemory(device, buffer->memory, 0, VK_WHOLE_SIZE, 0, &buffer->mapped),
+            "Failed to map Vulkan buffer memory!");
+}
+
+void destroy_buffer(VkDevice device, struct GpuBuffer *buffer)
+{
+    vkDestroyBuffer(device, buffer->buffer, NULL);
+    vkFreeMemory(device, buffer->memory, NULL);
+    atomic_fetch_sub(&heap_usage[buffer->heap], buffer->allocation_size);
+}
+
+static void create_image(VkDevice device, VkPhysicalDevice gpu, VkFormat format,
+    VkExtent2D extent, uint32_t levels, VkSampleCountFlagBits samples, VkImageUsageFlags usage,
+    struct Texture *texture)
+{
+    VkImageCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = format;
+    info.extent.width = extent.width;
+    info.extent.height = extent.height;
+    info.extent.depth = 1;
+    info.mipLevels = levels;
+    info.arrayLayers = 1;
+    info.samples = samples;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    assert_vulkan(vkCreateImage(device, &info, NULL, &texture->image),
+        "Failed to create a Vulkan image!");
+
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(device, texture->image, &reqs);
+
+    // Tile based GPUs keep transient attachments in tile memory and never back them
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    if ((usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && search_memory_type(gpu,
+        reqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != UINT32_MAX)
+        properties = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+    texture->memory = allocate_memory(device, gpu, &reqs, properties, &texture->heap);
+    texture->allocation_size = properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT ? 0 : reqs.size;
+    texture->format = format;
+    texture->extent = extent;
+    texture->levels = levels;
+
+    assert_vulkan(vkBindImageMemory(device, texture->image, texture->memory, 0),
+        "Failed to bind Vulkan image memory!");
+
+    VkImageViewCreateInfo viewinfo = {};
+    viewinfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewinfo.image = texture->image;
+    viewinfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewinfo.format = format;
+    viewinfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewinfo.subresourceRange.levelCount = levels;
+    viewinfo.subresourceRange.layerCount = 1;
+
+    assert_vulkan(vkCreateImageView(device, &viewinfo, NULL, &texture->view),
+        "Failed to create a Vulkan image view!");
+}
+
+void create_texture(VkDevice device, VkPhysicalDevice gpu, VkFormat format, VkExtent2D extent,
+    uint32_t levels, VkImageUsageFlags usage, struct Texture *texture)
+{
+    create_image(device, gpu, format, extent, levels, VK_SAMPLE_COUNT_1_BIT, usage, texture);
+}
+
+void create_transient_texture(VkDevice device, VkPhysicalDevice gpu, VkFormat format,
+    VkExtent2D extent, VkSampleCountFlagBits samples, struct Texture *texture)
+{
+    create_image(device, gpu, format, extent, 1, samples,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, texture);
+}
+
+void destroy_texture(VkDevice device, struct Texture *texture)
+{
+    vkDestroyImageView(device, texture->view, NULL);
+    vkDestroyImage(device, texture->image, NULL);
+    vkFreeMemory(device, texture->memory, NULL);
+    atomic_fetch_sub(&heap_usage[texture->heap], texture->allocation_size);
+}
+
+void create_memory_budget(VkPhysicalDevice gpu, int extension_enabled, double pressure_threshold,
+    struct MemoryBudget *budget)
+{
+    memset(budget, 0, sizeof(*budget));
+    budget->gpu = gpu;
+    budget->extension_enabled = extension_enabled;
+    budget->pressure_threshold = pressure_threshold;
+
+    poll_memory_budget(budget);
+}
+
+void add_memory_pressure_callback(struct MemoryBudget *budget, MemoryPressureFunc func,
+    void *user_data)
+{
+    if (budget->callback_count == MEMORY_PRESSURE_CALLBACK_MAX)
+        print_exit("Failed to add a memory pressure callback, too many callbacks!");
+
+    budget->callbacks[budget->callback_count].func = func;
+    budget->callbacks[budget->callback_count++].user_data = user_data;
+}
+
+void poll_memory_budget(struct MemoryBudget *budget)
+{
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetprops = {};
+    budgetprops.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memprops = {};
+    memprops.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memprops.pNext = budget->extension_enabled ? &budgetprops : NULL;
+    vkGetPhysicalDeviceMemoryProperties2(budget->gpu, &memprops);
+
+    budget->heap_count = memprops.memoryProperties.memoryHeapCount;
+    budget->pressured_heaps = 0;
+
+    for (uint32_t i = 0; i < budget->heap_count; ++i) {
+        budget->heap_sizes[i] = memprops.memoryProperties.memoryHeaps[i].size;
+
+        if (budget->extension_enabled) {
+            budget->usage[i] = budgetprops.heapUsage[i];
+            budget->budget[i] = budgetprops.heapBudget[i];
+        } else {
+            budget->usage[i] = get_memory_heap_usage(i);
+            budget->budget[i] = (VkDeviceSize)(budget->heap_sizes[i] * FALLBACK_BUDGET_SHARE);
+        }
+
+        if (budget->budget[i] > 0 &&
+            budget->usage[i] >= budget->budget[i] * budget->pressure_threshold)
+            budget->pressured_heaps |= 1u << i;
+    }
+
+    for (uint32_t i = 0; i < budget->heap_count; ++i)
+        if (budget->pressured_heaps & (1u << i))
+            for (uint32_t j = 0; j < budget->callback_count; ++j)
+                budget->callbacks[j].func(i, budget->usage[i], budget->budget[i],
+                    budget->callbacks[j].user_data);
+}
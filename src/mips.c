@@ -0,0 +1,412 @@
+#include <string.h>
+
+#include "debug.h"
+#include "instance.h"
+#include "mips.h"
+
+#define MIP_WORKGROUP_SIZE 8u
+
+// Matches the push constant block of downsample.comp
+struct DownsampleConstants {
+    int32_t source_width;
+    int32_t source_height;
+    uint32_t level_count;
+};
+
+uint32_t get_mip_count(VkExtent2D extent)
+{
+    uint32_t levels = 1;
+
+    while (extent.width >> levels > 0 || extent.height >> levels > 0)
+        ++levels;
+
+    return levels;
+}
+
+static void create_downsample_pipeline(const uint32_t *code, size_t code_size,
+    struct MipGenerator *generator)
+{
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = MIP_LEVELS_PER_DISPATCH;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo setinfo = {};
+    setinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setinfo.bindingCount = 2;
+    setinfo.pBindings = bindings;
+
+    assert_vulkan(vkCreateDescriptorSetLayout(generator->device, &setinfo, NULL,
+        &generator->set_layout), "Failed to create a Vulkan descriptor set layout!");
+
+    VkPushConstantRange range = {};
+    range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range.size = sizeof(struct DownsampleConstants);
+
+    VkPipelineLayoutCreateInfo layoutinfo = {};
+    layoutinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutinfo.setLayoutCount = 1;
+    layoutinfo.pSetLayouts = &generator->set_layout;
+    layoutinfo.pushConstantRangeCount = 1;
+    layoutinfo.pPushConstantRanges = &range;
+
+    assert_vulkan(vkCreatePipelineLayout(generator->device, &layoutinfo, NULL,
+        &generator->layout), "Failed to create a Vulkan pipeline layout!");
+
+    VkShaderModuleCreateInfo moduleinfo = {};
+    moduleinfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleinfo.codeSize = code_size;
+    moduleinfo.pCode = code;
+
+    assert_vulkan(vkCreateShaderModule(generator->device, &moduleinfo, NULL,
+        &generator->module), "Failed to create a Vulkan shader module!");
+
+    VkComputePipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = generator->module;
+    info.stage.pName = "main";
+    info.layout = generator->layout;
+
+    assert_vulkan(vkCreateComputePipelines(generator->device, VK_NULL_HANDLE, 1, &info, NULL,
+        &generator->pipeline), "Failed to create the Vulkan downsample pipeline!");
+
+    VkDescriptorPoolSize sizes[2] = {};
+    sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    sizes[0].descriptorCount = MIP_MAX_SETS;
+    sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    sizes[1].descriptorCount = MIP_MAX_SETS * MIP_LEVELS_PER_DISPATCH;
+
+    VkDescriptorPoolCreateInfo poolinfo = {};
+    poolinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolinfo.maxSets = MIP_MAX_SETS;
+    poolinfo.poolSizeCount = 2;
+    poolinfo.pPoolSizes = sizes;
+
+    assert_vulkan(vkCreateDescriptorPool(generator->device, &poolinfo, NULL, &generator->pool),
+        "Failed to create a Vulkan descriptor pool!");
+
+    // Only read through texelFetch, so filtering never applies
+    VkSamplerCreateInfo samplerinfo = {};
+    samplerinfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerinfo.magFilter = VK_FILTER_NEAREST;
+    samplerinfo.minFilter = VK_FILTER_NEAREST;
+    samplerinfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerinfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerinfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    assert_vulkan(vkCreateSampler(generator->device, &samplerinfo, NULL, &generator->sampler),
+        "Failed to create a Vulkan sampler!");
+
+    set_debug_name(generator->device, VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT,
+        (uint64_t)generator->set_layout, "downsample set layout");
+    set_debug_name(generator->device, VK_OBJECT_TYPE_PIPELINE_LAYOUT,
+        (uint64_t)generator->layout, "downsample layout");
+    set_debug_name(generator->device, VK_OBJECT_TYPE_SHADER_MODULE,
+        (uint64_t)generator->module, "downsample.comp");
+    set_debug_name(generator->device, VK_OBJECT_TYPE_PIPELINE, (uint64_t)generator->pipeline,
+        "downsample");
+    set_debug_name(generator->device, VK_OBJECT_TYPE_DESCRIPTOR_POOL,
+        (uint64_t)generator->pool, "downsample descriptors");
+    set_debug_name(generator->device, VK_OBJECT_TYPE_SAMPLER, (uint64_t)generator->sampler,
+        "downsample sampler");
+}
+
+void create_mip_generator(VkDevice device, VkPhysicalDevice gpu, const uint32_t *code,
+    size_t code_size, struct MipGenerator *generator)
+{
+    memset(generator, 0, sizeof(*generator));
+    generator->device = device;
+    generator->gpu = gpu;
+
+    if (code != NULL)
+        create_downsample_pipeline(code, code_size, generator);
+}
+
+enum MipPath get_mip_path(const struct MipGenerator *generator, VkFormat format)
+{
+    if (get_texture_family(format) != 0)
+        return MIP_PATH_NONE;
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(generator->gpu, format, &props);
+
+    const VkFormatFeatureFlags features = props.optimalTilingFeatures;
+    const VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+        VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    const VkFormatFeatureFlags compute = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+
+    if ((features & blit) == blit)
+        return MIP_PATH_BLIT;
+    if (generator->pipeline != VK_NULL_HANDLE && (features & compute) == compute)
+        return MIP_PATH_COMPUTE;
+
+    return MIP_PATH_NONE;
+}
+
+VkImageUsageFlags get_mip_usage(enum MipPath path)
+{
+    switch (path) {
+    case MIP_PATH_BLIT:
+        return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    case MIP_PATH_COMPUTE:
+        return VK_IMAGE_USAGE_STORAGE_BIT;
+    default:
+        return 0;
+    }
+}
+
+static uint32_t get_dispatch_count(uint32_t levels)
+{
+    return (levels - 1 + MIP_LEVELS_PER_DISPATCH - 1) / MIP_LEVELS_PER_DISPATCH;
+}
+
+int has_mip_capacity(const struct MipGenerator *generator, uint32_t levels)
+{
+    return generator->view_count + levels <= MIP_MAX_VIEWS &&
+        generator->set_count + get_dispatch_count(levels) <= MIP_MAX_SETS;
+}
+
+void transition_texture_levels(VkCommandBuffer buffer, const struct Texture *texture,
+    uint32_t base_level, uint32_t level_count, VkImageLayout old_layout,
+    VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access,
+    VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = texture->image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = base_level;
+    barrier.subresourceRange.levelCount = level_count;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+static int32_t get_level_dimension(uint32_t size, uint32_t level)
+{
+    return size >> level > 0 ? (int32_t)(size >> level) : 1;
+}
+
+static void record_blits(VkCommandBuffer buffer, const struct Texture *texture,
+    uint32_t base_level)
+{
+    for (uint32_t i = base_level + 1; i < texture->levels; ++i) {
+        transition_texture_levels(buffer, texture, i - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        transition_texture_levels(buffer, texture, i, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkImageBlit blit = {};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[1].x = get_level_dimension(texture->extent.width, i - 1);
+        blit.srcOffsets[1].y = get_level_dimension(texture->extent.height, i - 1);
+        blit.srcOffsets[1].z = 1;
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstOffsets[1].x = get_level_dimension(texture->extent.width, i);
+        blit.dstOffsets[1].y = get_level_dimension(texture->extent.height, i);
+        blit.dstOffsets[1].z = 1;
+
+        vkCmdBlitImage(buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+        transition_texture_levels(buffer, texture, i - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    transition_texture_levels(buffer, texture, texture->levels - 1, 1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+// Single level view owned by the generator until reset
+static VkImageView create_level_view(struct MipGenerator *generator,
+    const struct Texture *texture, uint32_t level)
+{
+    VkImageViewCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    info.image = texture->image;
+    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    info.format = texture->format;
+    info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    info.subresourceRange.baseMipLevel = level;
+    info.subresourceRange.levelCount = 1;
+    info.subresourceRange.layerCount = 1;
+
+    VkImageView *view = &generator->views[generator->view_count++];
+
+    assert_vulkan(vkCreateImageView(generator->device, &info, NULL, view),
+        "Failed to create a Vulkan image view!");
+
+    return *view;
+}
+
+static VkDescriptorSet write_dispatch_set(struct MipGenerator *generator,
+    const VkImageView *level_views, uint32_t count)
+{
+    VkDescriptorSetAllocateInfo allocinfo = {};
+    allocinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocinfo.descriptorPool = generator->pool;
+    allocinfo.descriptorSetCount = 1;
+    allocinfo.pSetLayouts = &generator->set_layout;
+
+    VkDescriptorSet set;
+    assert_vulkan(vkAllocateDescriptorSets(generator->device, &allocinfo, &set),
+        "Failed to allocate a Vulkan descriptor set!");
+    ++generator->set_count;
+
+    VkDescriptorImageInfo source = {};
+    source.sampler = generator->sampler;
+    source.imageView = level_views[0];
+    source.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    // Unused slots repeat the last level, the shader never writes them
+    VkDescriptorImageInfo targets[MIP_LEVELS_PER_DISPATCH];
+
+    for (uint32_t i = 0; i < MIP_LEVELS_PER_DISPATCH; ++i) {
+        targets[i].sampler = VK_NULL_HANDLE;
+        targets[i].imageView = level_views[1 + (i < count ? i : count - 1)];
+        targets[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    VkWriteDescriptorSet writes[2] = {};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = set;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &source;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = set;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = MIP_LEVELS_PER_DISPATCH;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].pImageInfo = targets;
+
+    vkUpdateDescriptorSets(generator->device, 2, writes, 0, NULL);
+
+    return set;
+}
+
+/*
+ * Each 8x8 workgroup reads a 16x16 tile of the source level once and reduces
+ * it through shared memory, so one dispatch writes up to four levels
+ */
+static void record_dispatches(struct MipGenerator *generator, VkCommandBuffer buffer,
+    const struct Texture *texture, uint32_t base_level)
+{
+    if (!has_mip_capacity(generator, texture->levels - base_level))
+        print_exit("Failed to generate mips, the generator has to be reset first!");
+
+    VkImageView views[MIP_MAX_VIEWS];
+
+    for (uint32_t i = base_level; i < texture->levels; ++i)
+        views[i] = create_level_view(generator, texture, i);
+
+    transition_texture_levels(buffer, texture, base_level, 1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    transition_texture_levels(buffer, texture, base_level + 1,
+        texture->levels - base_level - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+        0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, generator->pipeline);
+
+    for (uint32_t src = base_level; src + 1 < texture->levels; src += MIP_LEVELS_PER_DISPATCH) {
+        const uint32_t remaining = texture->levels - 1 - src;
+        const uint32_t count = remaining < MIP_LEVELS_PER_DISPATCH ? remaining :
+            MIP_LEVELS_PER_DISPATCH;
+        const VkDescriptorSet set = write_dispatch_set(generator, &views[src], count);
+
+        struct DownsampleConstants constants;
+        constants.source_width = get_level_dimension(texture->extent.width, src);
+        constants.source_height = get_level_dimension(texture->extent.height, src);
+        constants.level_count = count;
+
+        vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, generator->layout, 0, 1,
+            &set, 0, NULL);
+        vkCmdPushConstants(buffer, generator->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+            sizeof(constants), &constants);
+
+        const uint32_t width = get_level_dimension(texture->extent.width, src + 1);
+        const uint32_t height = get_level_dimension(texture->extent.height, src + 1);
+        vkCmdDispatch(buffer, (width + MIP_WORKGROUP_SIZE - 1) / MIP_WORKGROUP_SIZE,
+            (height + MIP_WORKGROUP_SIZE - 1) / MIP_WORKGROUP_SIZE, 1);
+
+        // The last level written is the next dispatch's source
+        transition_texture_levels(buffer, texture, src + 1, count, VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+}
+
+void record_mip_generation(struct MipGenerator *generator, VkCommandBuffer buffer,
+    const struct Texture *texture, uint32_t base_level)
+{
+    switch (get_mip_path(generator, texture->format)) {
+    case MIP_PATH_BLIT:
+        begin_debug_label(buffer, "mips blit");
+        record_blits(buffer, texture, base_level);
+        ++generator->blit_count;
+        break;
+    case MIP_PATH_COMPUTE:
+        begin_debug_label(buffer, "mips compute");
+        record_dispatches(generator, buffer, texture, base_level);
+        ++generator->compute_count;
+        break;
+    default:
+        print_exit("Failed to generate mips, the format supports neither blits nor storage!");
+    }
+
+    end_debug_label(buffer);
+}
+
+void reset_mip_generator(struct MipGenerator *generator)
+{
+    for (uint32_t i = 0; i < generator->view_count; ++i)
+        vkDestroyImageView(generator->device, generator->views[i], NULL);
+
+    if (generator->set_count > 0)
+        vkResetDescriptorPool(generator->device, generator->pool, 0);
+
+    generator->view_count = 0;
+    generator->set_count = 0;
+}
+
+void destroy_mip_generator(struct MipGenerator *generator)
+{
+    reset_mip_generator(generator);
+
+    if (generator->pipeline == VK_NULL_HANDLE)
+        return;
+
+    vkDestroySampler(generator->device, generator->sampler, NULL);
+    vkDestroyDescriptorPool(generator->device, generator->pool, NULL);
+    vkDestroyPipeline(generator->device, generator->pipeline, NULL);
+    vkDestroyShaderModule(generator->device, generator->module, NULL);
+    vkDestroyPipelineLayout(generator->device, generator->layout, NULL);
+    vkDestroyDescriptorSetLayout(generator->device, generator->set_layout, NULL);
+}
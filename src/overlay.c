@@ -0,0 +1,206 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "overlay.h"
+
+#define ORIGIN 8.0f
+#define PADDING 6.0f
+// Pixels per font texel
+#define TEXEL 2.0f
+#define GLYPH_WIDTH 3u
+#define GLYPH_HEIGHT 5u
+#define LINE_HEIGHT ((GLYPH_HEIGHT + 2) * TEXEL)
+#define CHARACTER_WIDTH ((GLYPH_WIDTH + 1) * TEXEL)
+#define LINE_LENGTH 64u
+#define BAR_WIDTH 2.0f
+#define GRAPH_HEIGHT 66.0f
+// Seconds at the top of the graph, two 60 Hz frames
+#define GRAPH_RANGE (2.0 / 60.0)
+#define PANEL_WIDTH (OVERLAY_HISTORY * BAR_WIDTH * 2.0f)
+#define PANEL_COLOR 0xb0000000u
+#define TEXT_COLOR 0xffffffffu
+#define FRAME_COLOR 0xff40d040u
+#define GPU_COLOR 0xff3090f0u
+#define GUIDE_COLOR 0x80ffffffu
+
+// Rows top to bottom as octal digits, the highest bit of a row is the left texel
+static const uint16_t GLYPHS[128] = {
+    ['0'] = 075557, ['1'] = 026227, ['2'] = 071747, ['3'] = 071717, ['4'] = 055711,
+    ['5'] = 074717, ['6'] = 074757, ['7'] = 071111, ['8'] = 075757, ['9'] = 075717,
+    ['A'] = 025755, ['B'] = 065656, ['C'] = 034443, ['D'] = 065556, ['E'] = 074647,
+    ['F'] = 074644, ['G'] = 034553, ['H'] = 055755, ['I'] = 072227, ['J'] = 011152,
+    ['K'] = 055655, ['L'] = 044447, ['M'] = 057755, ['N'] = 065555, ['O'] = 025552,
+    ['P'] = 065644, ['Q'] = 025563, ['R'] = 065655, ['S'] = 034216, ['T'] = 072222,
+    ['U'] = 055557, ['V'] = 055552, ['W'] = 055775, ['X'] = 055255, ['Y'] = 055222,
+    ['Z'] = 071247, ['.'] = 000002, [':'] = 002020, ['/'] = 011244, ['%'] = 051245,
+    ['-'] = 000700
+};
+
+static double get_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void create_overlay(int visible, struct Overlay *overlay)
+{
+    memset(overlay, 0, sizeof(*overlay));
+    overlay->visible = visible;
+}
+
+// Axis aligned quad with its top left corner at x, y
+static void push_quad(struct SpriteBatch *batch, float x, float y, float width, float height,
+    uint32_t color)
+{
+    if (batch->count == batch->capacity) {
+        batch->capacity = batch->capacity > 0 ? batch->capacity * 2 : 1024;
+        batch->instances = realloc(batch->instances,
+            batch->capacity * sizeof(struct SpriteInstance));
+    }
+
+    struct SpriteInstance *instance = &batch->instances[batch->count++];
+    instance->position[0] = x + width * 0.5f;
+    instance->position[1] = y + height * 0.5f;
+    instance->size[0] = width;
+    instance->size[1] = height;
+    instance->rotation = 0.0f;
+    instance->color = color;
+}
+
+static void push_text(struct SpriteBatch *batch, float x, float y, const char *text)
+{
+    for (; *text != '\0'; ++text, x += CHARACTER_WIDTH) {
+        const uint16_t glyph = GLYPHS[toupper((unsigned char)*text) & 0x7f];
+
+        for (uint32_t row = 0; row < GLYPH_HEIGHT; ++row) {
+            const uint32_t bits = (glyph >> (GLYPH_HEIGHT - 1 - row) * GLYPH_WIDTH) & 07u;
+            uint32_t column = 0;
+
+            while (column < GLYPH_WIDTH) {
+                if (!(bits & (04u >> column))) {
+                    ++column;
+                    continue;
+                }
+
+                const uint32_t start = column;
+
+                while (column < GLYPH_WIDTH && (bits & (04u >> column)))
+                    ++column;
+
+                push_quad(batch, x + start * TEXEL, y + row * TEXEL,
+                    (column - start) * TEXEL, TEXEL, TEXT_COLOR);
+            }
+        }
+    }
+}
+
+static float get_bar_height(float time)
+{
+    const float height = (float)(time / GRAPH_RANGE) * GRAPH_HEIGHT;
+
+    return height < GRAPH_HEIGHT ? height : GRAPH_HEIGHT;
+}
+
+// Oldest frame on the left, frame time and GPU time side by side per frame
+static void push_graph(struct Overlay *overlay, float y)
+{
+    const float bottom = y + GRAPH_HEIGHT;
+
+    push_quad(&overlay->batch, ORIGIN, bottom - GRAPH_HEIGHT * 0.5f, PANEL_WIDTH, 1.0f,
+        GUIDE_COLOR);
+
+    for (uint32_t i = 0; i < OVERLAY_HISTORY; ++i) {
+        const uint32_t index = (overlay->head + i) % OVERLAY_HISTORY;
+        const float x = ORIGIN + i * BAR_WIDTH * 2.0f;
+        const float frame = get_bar_height(overlay->frame_times[index]);
+        const float gpu = get_bar_height(overlay->gpu_times[index]);
+
+        if (frame > 0.0f)
+            push_quad(&overlay->batch, x, bottom - frame, BAR_WIDTH, frame, FRAME_COLOR);
+        if (gpu > 0.0f)
+            push_quad(&overlay->batch, x + BAR_WIDTH, bottom - gpu, BAR_WIDTH, gpu, GPU_COLOR);
+    }
+}
+
+void build_overlay(struct Overlay *overlay, const struct OverlayFrame *frame)
+{
+    const double start = get_seconds();
+
+    overlay->frame_times[overlay->head] = (float)frame->frame_time;
+    overlay->gpu_times[overlay->head] = (float)frame->gpu_time;
+    overlay->head = (overlay->head + 1) % OVERLAY_HISTORY;
+    overlay->batch.count = 0;
+
+    if (!overlay->visible)
+        return;
+
+    const uint32_t line_count = 5 + frame->heap_count + (frame->statistics ? 1 : 0) +
+        (frame->dynamic_resolution ? 1 : 0);
+    const float text_y = ORIGIN + PADDING + GRAPH_HEIGHT + PADDING;
+
+    push_quad(&overlay->batch, ORIGIN - PADDING, ORIGIN - PADDING, PANEL_WIDTH + PADDING * 2.0f,
+        text_y - ORIGIN + PADDING + line_count * LINE_HEIGHT, PANEL_COLOR);
+    push_graph(overlay, ORIGIN);
+
+    char line[LINE_LENGTH];
+    float y = text_y;
+
+    snprintf(line, sizeof(line), "frame %.2f ms  cpu %.2f ms  gpu %.2f ms",
+        frame->frame_time * 1000.0, frame->cpu_time * 1000.0, frame->gpu_time * 1000.0);
+    push_text(&overlay->batch, ORIGIN, y, line);
+    y += LINE_HEIGHT;
+
+    snprintf(line, sizeof(line), "fence wait %.2f ms  acquire %.2f ms",
+        frame->fence_wait * 1000.0, frame->acquire_wait * 1000.0);
+    push_text(&overlay->batch, ORIGIN, y, line);
+    y += LINE_HEIGHT;
+
+    snprintf(line, sizeof(line), "draws %u  instances %u  binds %u", frame->counters.draws,
+        frame->counters.instances, frame->counters.pipeline_binds);
+    push_text(&overlay->batch, ORIGIN, y, line);
+    y += LINE_HEIGHT;
+
+    snprintf(line, sizeof(line), "upload %.1f kb  perf warnings %u",
+        frame->upload_bytes / 1024.0, frame->performance_warnings);
+    push_text(&overlay->batch, ORIGIN, y, line);
+    y += LINE_HEIGHT;
+
+    if (frame->statistics) {
+        snprintf(line, sizeof(line), "fill %.2f px/px  verts %llu  prims %llu",
+            frame->fragments_per_pixel, (unsigned long long)frame->vertex_invocations,
+            (unsigned long long)frame->clipping_primitives);
+        push_text(&overlay->batch, ORIGIN, y, line);
+        y += LINE_HEIGHT;
+    }
+
+    if (frame->dynamic_resolution) {
+        snprintf(line, sizeof(line), "scale %.2f  scene %ux%u", frame->resolution_scale,
+            frame->scene_extent.width, frame->scene_extent.height);
+        push_text(&overlay->batch, ORIGIN, y, line);
+        y += LINE_HEIGHT;
+    }
+
+    for (uint32_t i = 0; i < frame->heap_count; ++i) {
+        snprintf(line, sizeof(line), "heap %u: %.1f / %.0f mb", i,
+            frame->heap_usage[i] / (1024.0 * 1024.0),
+            frame->heap_budgets[i] / (1024.0 * 1024.0));
+        push_text(&overlay->batch, ORIGIN, y, line);
+        y += LINE_HEIGHT;
+    }
+
+    snprintf(line, sizeof(line), "overlay cpu %.3f ms  gpu %.3f ms",
+        overlay->build_time * 1000.0, frame->overlay_time * 1000.0);
+    push_text(&overlay->batch, ORIGIN, y, line);
+
+    overlay->build_time = get_seconds() - start;
+}
+
+void destroy_overlay(struct Overlay *overlay)
+{
+    destroy_sprite_batch(&overlay->batch);
+}
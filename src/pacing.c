@@ -0,0 +1,237 @@
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#define GLFW_INCLUDE_VULKAN
+#include <glfw/glfw3.h>
+
+#include "pacing.h"
+
+// Sleeping is imprecise, the last stretch before a deadline is spun
+#define SPIN_THRESHOLD 0.002
+#define PRESENT_WAIT_TIMEOUT 100000000ull
+#define MISSED_VSYNC_FACTOR 1.5
+#define LATENCY_SMOOTHING 0.1
+#define RESOLUTION_SCALE_STEP 0.05
+// Scale changes aim this far below the target so the next frame has slack
+#define RESOLUTION_HEADROOM 0.9
+// The scale only grows back once the GPU time drops under this part of the target
+#define RESOLUTION_RAISE_THRESHOLD 0.75
+// Steps the scale may grow by at once, shrinking is not limited
+#define RESOLUTION_MAX_RAISE 2.0
+// About two time constants of the GPU timer smoothing
+#define RESOLUTION_COOLDOWN 20u
+
+void create_frame_pacer(double target, double refresh_period,
+    PFN_vkWaitForPresentKHR wait_for_present, int low_latency, struct FramePacer *pacer)
+{
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->target = target;
+    pacer->refresh_period = refresh_period;
+    pacer->wait_for_present = wait_for_present;
+    pacer->low_latency = low_latency;
+    pacer->swapchain_first_id = 1;
+    pacer->frame_start = glfwGetTime();
+}
+
+static void smooth(double *average, double sample)
+{
+    *average = *average == 0.0 ? sample :
+        *average * (1.0 - LATENCY_SMOOTHING) + sample * LATENCY_SMOOTHING;
+}
+
+void reset_frame_pacer(struct FramePacer *pacer)
+{
+    pacer->swapchain_first_id = pacer->present_id + 1;
+    pacer->last_shown = 0.0;
+}
+
+void sleep_until(double time)
+{
+    double now = glfwGetTime();
+
+    while (time - now > SPIN_THRESHOLD) {
+        const double duration = time - now - SPIN_THRESHOLD;
+        struct timespec request;
+        request.tv_sec = (time_t)duration;
+        request.tv_nsec = (long)((duration - request.tv_sec) * 1e9);
+        nanosleep(&request, NULL);
+        now = glfwGetTime();
+    }
+
+    while (glfwGetTime() < time)
+        ;
+}
+
+static double get_interval(const struct FramePacer *pacer)
+{
+    return pacer->target > pacer->refresh_period ? pacer->target : pacer->refresh_period;
+}
+
+void pace_frame(struct FramePacer *pacer, VkDevice device, VkSwapchainKHR swapchain)
+{
+    const double previous_start = pacer->frame_start;
+    const double interval = get_interval(pacer);
+    double deadline = 0.0;
+
+    // Low latency waits for the last frame, otherwise one frame stays queued
+    const uint64_t wait_id = pacer->low_latency ? pacer->present_id : pacer->present_id - 1;
+
+    if (pacer->wait_for_present != NULL && pacer->present_id > 0 &&
+        wait_id >= pacer->swapchain_first_id) {
+        const VkResult res = pacer->wait_for_present(device, swapchain, wait_id,
+            PRESENT_WAIT_TIMEOUT);
+
+        if (res == VK_SUCCESS) {
+            const double shown = glfwGetTime();
+            double *input = &pacer->present_inputs[wait_id % LATENCY_HISTORY];
+
+            if (*input > 0.0) {
+                smooth(&pacer->input_to_present, shown - *input);
+                *input = 0.0;
+            }
+
+            if (pacer->last_shown > 0.0 && interval > 0.0 &&
+                shown - pacer->last_shown > interval * MISSED_VSYNC_FACTOR)
+                ++pacer->missed_vsyncs;
+
+            pacer->last_shown = shown;
+
+            if (pacer->target > 0.0)
+                deadline = shown + pacer->target - pacer->cpu_time * 1.25;
+        }
+    } else if (pacer->frames > 0) {
+        // Without present feedback only the CPU side cadence can be observed
+        if (interval > 0.0 && glfwGetTime() - previous_start > interval * MISSED_VSYNC_FACTOR)
+            ++pacer->missed_vsyncs;
+
+        if (pacer->target > 0.0)
+            deadline = previous_start + pacer->target;
+    }
+
+    if (deadline > 0.0)
+        sleep_until(deadline);
+
+    pacer->frame_start = glfwGetTime();
+}
+
+void record_input(struct FramePacer *pacer)
+{
+    if (pacer->pending_input == 0.0)
+        pacer->pending_input = glfwGetTime();
+}
+
+void begin_input(struct FramePacer *pacer)
+{
+    pacer->frame_input = pacer->pending_input;
+    pacer->pending_input = 0.0;
+}
+
+void record_submit(struct FramePacer *pacer)
+{
+    if (pacer->frame_input > 0.0)
+        smooth(&pacer->input_to_submit, glfwGetTime() - pacer->frame_input);
+}
+
+uint64_t end_frame(struct FramePacer *pacer)
+{
+    const double cpu_time = glfwGetTime() - pacer->frame_start;
+
+    pacer->cpu_time = pacer->frames == 0 ? cpu_time : pacer->cpu_time * 0.9 + cpu_time * 0.1;
+    ++pacer->frames;
+    ++pacer->present_id;
+
+    if (pacer->wait_for_present != NULL)
+        pacer->present_inputs[pacer->present_id % LATENCY_HISTORY] = pacer->frame_input;
+
+    return pacer->present_id;
+}
+
+void record_present(struct FramePacer *pacer)
+{
+    if (pacer->wait_for_present == NULL && pacer->frame_input > 0.0)
+        smooth(&pacer->input_to_present, glfwGetTime() - pacer->frame_input);
+}
+
+void create_fixed_timestep(double tick_rate, uint32_t max_ticks, struct FixedTimestep *timestep)
+{
+    memset(timestep, 0, sizeof(*timestep));
+    timestep->tick_time = 1.0 / tick_rate;
+    timestep->max_ticks = max_ticks > 0 ? max_ticks : 1;
+    timestep->last_time = glfwGetTime();
+}
+
+uint32_t advance_fixed_timestep(struct FixedTimestep *timestep)
+{
+    const double now = glfwGetTime();
+
+    timestep->accumulator += now - timestep->last_time;
+    timestep->last_time = now;
+
+    uint64_t ticks = (uint64_t)(timestep->accumulator / timestep->tick_time);
+
+    // Catching up on a long stall would make the next frame even slower
+    if (ticks > timestep->max_ticks) {
+        timestep->dropped_ticks += ticks - timestep->max_ticks;
+        ticks = timestep->max_ticks;
+        timestep->accumulator = timestep->max_ticks * timestep->tick_time +
+            fmod(timestep->accumulator, timestep->tick_time);
+    }
+
+    timestep->accumulator -= ticks * timestep->tick_time;
+    timestep->alpha = timestep->accumulator / timestep->tick_time;
+    timestep->ticks += ticks;
+    timestep->frame_ticks = (uint32_t)ticks;
+    timestep->ticks_per_frame = timestep->ticks_per_frame * 0.9 + ticks * 0.1;
+
+    return timestep->frame_ticks;
+}
+
+static double clamp_scale(double scale, double min, double max)
+{
+    return scale < min ? min : scale > max ? max : scale;
+}
+
+void create_resolution_scale(double target_time, double min_scale, double max_scale,
+    struct ResolutionScale *resolution)
+{
+    memset(resolution, 0, sizeof(*resolution));
+    resolution->target_time = target_time;
+    resolution->max_scale = clamp_scale(max_scale, RESOLUTION_SCALE_STEP, 1.0);
+    resolution->min_scale = clamp_scale(min_scale, RESOLUTION_SCALE_STEP,
+        resolution->max_scale);
+    resolution->scale = resolution->max_scale;
+}
+
+int update_resolution_scale(struct ResolutionScale *resolution, double gpu_time)
+{
+    if (resolution->cooldown > 0) {
+        --resolution->cooldown;
+        return 0;
+    }
+
+    if (gpu_time <= 0.0 || (gpu_time <= resolution->target_time &&
+        gpu_time >= resolution->target_time * RESOLUTION_RAISE_THRESHOLD))
+        return 0;
+
+    double scale = resolution->scale *
+        sqrt(resolution->target_time * RESOLUTION_HEADROOM / gpu_time);
+    const double raise_limit = resolution->scale + RESOLUTION_MAX_RAISE * RESOLUTION_SCALE_STEP;
+
+    if (scale > raise_limit)
+        scale = raise_limit;
+
+    // Shrinking rounds down so one change is enough to get under the target
+    scale = gpu_time > resolution->target_time ?
+        floor(scale / RESOLUTION_SCALE_STEP) * RESOLUTION_SCALE_STEP :
+        round(scale / RESOLUTION_SCALE_STEP) * RESOLUTION_SCALE_STEP;
+    scale = clamp_scale(scale, resolution->min_scale, resolution->max_scale);
+
+    if (fabs(scale - resolution->scale) < RESOLUTION_SCALE_STEP * 0.5)
+        return 0;
+
+    resolution->scale = scale;
+    resolution->cooldown = RESOLUTION_COOLDOWN;
+    ++resolution->changes;
+
+    return 1;
+}
@@ -0,0 +1,221 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "pack.h"
+
+#define PACK_WRITER_INITIAL_CAPACITY 64u
+
+uint64_t hash_bytes(const void *data, size_t size)
+{
+    return mix_hash_bytes(HASH_BASIS, data, size);
+}
+
+uint64_t mix_hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+static int is_pack_valid(const struct AssetPack *pack)
+{
+    if (pack->size < sizeof(struct PackHeader))
+        return 0;
+
+    const struct PackHeader *header = (const struct PackHeader *)pack->data;
+
+    if (header->magic != PACK_MAGIC || header->version != PACK_VERSION ||
+        header->size != pack->size || header->toc_offset % _Alignof(struct PackEntry) != 0 ||
+        header->toc_offset > pack->size ||
+        header->entry_count > (pack->size - header->toc_offset) / sizeof(struct PackEntry))
+        return 0;
+
+    const struct PackEntry *entries =
+        (const struct PackEntry *)(pack->data + header->toc_offset);
+
+    for (uint32_t i = 0; i < header->entry_count; ++i)
+        if (entries[i].offset % PACK_ALIGNMENT != 0 || entries[i].offset > pack->size ||
+            entries[i].size > pack->size - entries[i].offset ||
+            entries[i].name[PACK_NAME_MAX - 1] != '\0')
+            return 0;
+
+    return 1;
+}
+
+void open_asset_pack(const char *path, struct AssetPack *pack)
+{
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        printf("Failed to open asset pack at %s\n", path);
+        exit(-1);
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        printf("Failed to stat asset pack at %s\n", path);
+        exit(-1);
+    }
+
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    pack->size = (size_t)info.st_size;
+    pack->mapped_size = (pack->size + page - 1) / page * page;
+
+    void *data = mmap(NULL, pack->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        printf("Failed to map asset pack at %s\n", path);
+        exit(-1);
+    }
+
+    // Levels are read front to back, let the kernel read ahead aggressively
+    madvise(data, pack->size, MADV_SEQUENTIAL);
+    pack->data = data;
+
+    if (!is_pack_valid(pack)) {
+        printf("Failed to validate asset pack at %s\n", path);
+        exit(-1);
+    }
+
+    const struct PackHeader *header = (const struct PackHeader *)pack->data;
+    pack->entry_count = header->entry_count;
+    pack->entries = (const struct PackEntry *)(pack->data + header->toc_offset);
+}
+
+const struct PackEntry *find_pack_entry(const struct AssetPack *pack, const char *name)
+{
+    const uint64_t hash = hash_bytes(name, strlen(name));
+    uint32_t low = 0;
+    uint32_t high = pack->entry_count;
+
+    while (low < high) {
+        const uint32_t mid = low + (high - low) / 2;
+
+        if (pack->entries[mid].name_hash < hash)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (uint32_t i = low; i < pack->entry_count && pack->entries[i].name_hash == hash; ++i)
+        if (strcmp(pack->entries[i].name, name) == 0)
+            return &pack->entries[i];
+
+    return NULL;
+}
+
+const void *get_pack_payload(const struct AssetPack *pack, const struct PackEntry *entry)
+{
+    return pack->data + entry->offset;
+}
+
+int is_pack_entry_intact(const struct AssetPack *pack, const struct PackEntry *entry)
+{
+    return hash_bytes(get_pack_payload(pack, entry), entry->size) == entry->hash;
+}
+
+void close_asset_pack(struct AssetPack *pack)
+{
+    munmap((void *)pack->data, pack->size);
+}
+
+static void write_bytes(struct PackWriter *writer, const void *data, size_t size)
+{
+    if (fwrite(data, 1, size, writer->file) != size)
+        print_exit("Failed to write an asset pack!");
+
+    writer->offset += size;
+}
+
+static void write_padding(struct PackWriter *writer, uint64_t alignment)
+{
+    static const uint8_t zeros[PACK_ALIGNMENT] = {};
+
+    write_bytes(writer, zeros, (alignment - writer->offset % alignment) % alignment);
+}
+
+void create_pack_writer(const char *path, struct PackWriter *writer)
+{
+    writer->file = fopen(path, "wb");
+
+    if (writer->file == NULL) {
+        printf("Failed to create asset pack at %s\n", path);
+        exit(-1);
+    }
+
+    writer->offset = 0;
+    writer->count = 0;
+    writer->capacity = PACK_WRITER_INITIAL_CAPACITY;
+    writer->entries = malloc(writer->capacity * sizeof(struct PackEntry));
+
+    // Rewritten with the final values by finish_pack_writer()
+    const struct PackHeader header = {};
+    write_bytes(writer, &header, sizeof(header));
+}
+
+void add_pack_entry(struct PackWriter *writer, const struct PackEntry *entry, const void *data,
+    size_t size)
+{
+    if (strnlen(entry->name, PACK_NAME_MAX) == PACK_NAME_MAX)
+        print_exit("Failed to add an asset pack entry, name is too long!");
+
+    if (writer->count == writer->capacity) {
+        writer->capacity *= 2;
+        writer->entries = realloc(writer->entries, writer->capacity * sizeof(struct PackEntry));
+    }
+
+    write_padding(writer, PACK_ALIGNMENT);
+
+    struct PackEntry *added = &writer->entries[writer->count++];
+    *added = *entry;
+    added->name_hash = hash_bytes(entry->name, strlen(entry->name));
+    added->hash = hash_bytes(data, size);
+    added->offset = writer->offset;
+    added->size = size;
+
+    write_bytes(writer, data, size);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const struct PackEntry *left = a;
+    const struct PackEntry *right = b;
+
+    if (left->name_hash != right->name_hash)
+        return left->name_hash < right->name_hash ? -1 : 1;
+
+    return strcmp(left->name, right->name);
+}
+
+void finish_pack_writer(struct PackWriter *writer)
+{
+    qsort(writer->entries, writer->count, sizeof(struct PackEntry), &compare_entries);
+    write_padding(writer, _Alignof(struct PackEntry));
+
+    struct PackHeader header = {};
+    header.magic = PACK_MAGIC;
+    header.version = PACK_VERSION;
+    header.entry_count = writer->count;
+    header.toc_offset = writer->offset;
+
+    write_bytes(writer, writer->entries, writer->count * sizeof(struct PackEntry));
+    header.size = writer->offset;
+
+    if (fseek(writer->file, 0, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, writer->file) != 1 || fclose(writer->file) != 0)
+        print_exit("Failed to write an asset pack!");
+
+    free(writer->entries);
+}
@@ -0,0 +1,253 @@
+#include <string.h>
+
+#include "debug.h"
+#include "instance.h"
+#include "record.h"
+#include "statistics.h"
+
+static void allocate_buffers(VkDevice device, VkCommandPool pool, VkCommandBufferLevel level,
+    uint32_t count, VkCommandBuffer *buffers)
+{
+    VkCommandBufferAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    info.commandBufferCount = count;
+    info.commandPool = pool;
+    info.level = level;
+
+    assert_vulkan(vkAllocateCommandBuffers(device, &info, buffers),
+        "Failed to allocate Vulkan command buffers!");
+}
+
+void create_draw_pass_list(VkDevice device, uint32_t family, struct DrawPassList *list)
+{
+    memset(list, 0, sizeof(*list));
+
+    VkCommandPoolCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    info.queueFamilyIndex = family;
+
+    assert_vulkan(vkCreateCommandPool(device, &info, NULL, &list->cache_pool),
+        "Failed to create a Vulkan command pool!");
+    set_debug_name(device, VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)list->cache_pool,
+        "draw pass cache pool");
+}
+
+uint32_t add_draw_pass(VkDevice device, struct DrawPassList *list, const struct DrawPass *pass)
+{
+    if (list->count == DRAW_PASS_MAX)
+        print_exit("Failed to add a draw pass, too many passes!");
+
+    struct DrawPassEntry *entry = &list->entries[list->count];
+    entry->pass = *pass;
+    entry->valid = 0;
+
+    if (pass->cached)
+        allocate_buffers(device, list->cache_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            FRAMES_IN_FLIGHT, entry->secondaries);
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT && pass->cached; ++i)
+        set_debug_name(device, VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)entry->secondaries[i],
+            "%s frame %u", pass->name, i);
+
+    return list->count++;
+}
+
+void invalidate_draw_pass(struct DrawPassList *list, uint32_t index)
+{
+    list->entries[index].valid = 0;
+}
+
+void invalidate_draw_passes(struct DrawPassList *list)
+{
+    for (uint32_t i = 0; i < list->count; ++i)
+        list->entries[i].valid = 0;
+}
+
+VkSubpassContents get_draw_pass_contents(const struct DrawPassList *list)
+{
+    for (uint32_t i = 0; i < list->count; ++i)
+        if (list->entries[i].pass.cached)
+            return VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+
+    return VK_SUBPASS_CONTENTS_INLINE;
+}
+
+static void set_viewport(VkCommandBuffer buffer, VkExtent2D extent)
+{
+    VkViewport viewport = {};
+    viewport.height = extent.height;
+    viewport.width = extent.width;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor = {};
+    scissor.extent = extent;
+
+    vkCmdSetViewport(buffer, 0, 1, &viewport);
+    vkCmdSetScissor(buffer, 0, 1, &scissor);
+}
+
+/*
+ * Labeled by the pass name so GPU profilers show each pass on the timeline,
+ * queried as pass index when the list collects pipeline statistics. With
+ * regions the pass is recorded once per region, scissored to it.
+ */
+static void record_pass(VkCommandBuffer buffer, const struct DrawPassList *list,
+    uint32_t index, const VkRect2D *regions, uint32_t region_count,
+    struct DrawCounters *counters)
+{
+    const struct DrawPass *pass = &list->entries[index].pass;
+    begin_debug_label(buffer, pass->name);
+
+    if (list->statistics != NULL)
+        begin_statistics_query(list->statistics, buffer, index);
+
+    if (regions == NULL)
+        pass->record(buffer, counters, pass->user_data);
+
+    for (uint32_t i = 0; regions != NULL && i < region_count; ++i) {
+        vkCmdSetScissor(buffer, 0, 1, &regions[i]);
+        pass->record(buffer, counters, pass->user_data);
+    }
+
+    if (list->statistics != NULL)
+        end_statistics_query(list->statistics, buffer, index);
+
+    end_debug_label(buffer);
+}
+
+// Secondaries do not inherit dynamic state, so each one sets the viewport itself
+static void record_secondary(VkCommandBuffer buffer, const struct DrawPassList *list,
+    uint32_t index, VkRenderPass render_pass, VkExtent2D extent, VkCommandBufferUsageFlags usage,
+    struct DrawCounters *counters)
+{
+    VkCommandBufferInheritanceInfo inhinfo = {};
+    inhinfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inhinfo.renderPass = render_pass;
+    inhinfo.subpass = 0;
+
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | usage;
+    info.pInheritanceInfo = &inhinfo;
+
+    assert_vulkan(vkBeginCommandBuffer(buffer, &info),
+        "Failed to begin a Vulkan secondary command buffer!");
+    set_viewport(buffer, extent);
+    record_pass(buffer, list, index, NULL, 0, counters);
+    assert_vulkan(vkEndCommandBuffer(buffer), "Failed to end a Vulkan secondary command buffer!");
+}
+
+static void add_counters(struct DrawCounters *total, const struct DrawCounters *counters)
+{
+    total->draws += counters->draws;
+    total->instances += counters->instances;
+    total->pipeline_binds += counters->pipeline_binds;
+}
+
+void record_draw_passes(VkDevice device, struct DrawPassList *list,
+    struct FrameCommands *commands, VkRenderPass render_pass, VkExtent2D extent,
+    struct DrawCounters *counters)
+{
+    if (get_draw_pass_contents(list) == VK_SUBPASS_CONTENTS_INLINE) {
+        set_viewport(commands->primary, extent);
+
+        for (uint32_t i = 0; i < list->count; ++i)
+            record_pass(commands->primary, list, i, NULL, 0, counters);
+
+        return;
+    }
+
+    VkCommandBuffer *secondaries = ALLOCATE_ARRAY(&commands->scratch, VkCommandBuffer,
+        list->count);
+    uint32_t dynamic_count = 0;
+
+    for (uint32_t i = 0; i < list->count; ++i) {
+        struct DrawPassEntry *entry = &list->entries[i];
+
+        if (!entry->pass.cached) {
+            if (dynamic_count == commands->secondary_count)
+                allocate_buffers(device, commands->pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1,
+                    &commands->secondaries[commands->secondary_count++]);
+
+            secondaries[i] = commands->secondaries[dynamic_count++];
+            record_secondary(secondaries[i], list, i, render_pass, extent,
+                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, counters);
+            continue;
+        }
+
+        const uint32_t bit = 1u << commands->index;
+        secondaries[i] = entry->secondaries[commands->index];
+
+        if (!(entry->valid & bit)) {
+            memset(&entry->counters[commands->index], 0, sizeof(struct DrawCounters));
+            record_secondary(secondaries[i], list, i, render_pass, extent, 0,
+                &entry->counters[commands->index]);
+            entry->valid |= bit;
+        }
+
+        add_counters(counters, &entry->counters[commands->index]);
+    }
+
+    vkCmdExecuteCommands(commands->primary, list->count, secondaries);
+}
+
+void record_draw_pass_regions(struct DrawPassList *list, struct FrameCommands *commands,
+    VkExtent2D extent, const VkRect2D *regions, uint32_t region_count,
+    struct DrawCounters *counters)
+{
+    set_viewport(commands->primary, extent);
+
+    for (uint32_t i = 0; i < list->count; ++i)
+        record_pass(commands->primary, list, i, regions, region_count, counters);
+}
+
+void destroy_draw_pass_list(VkDevice device, struct DrawPassList *list)
+{
+    vkDestroyCommandPool(device, list->cache_pool, NULL);
+}
+
+void create_frame_commands(VkDevice device, uint32_t family, uint32_t index,
+    struct FrameCommands *commands)
+{
+    commands->index = index;
+
+    VkCommandPoolCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    info.queueFamilyIndex = family;
+
+    assert_vulkan(vkCreateCommandPool(device, &info, NULL, &commands->pool),
+        "Failed to create a Vulkan transient command pool!");
+
+    allocate_buffers(device, commands->pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1,
+        &commands->primary);
+    set_debug_name(device, VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)commands->pool,
+        "frame %u pool", index);
+    set_debug_name(device, VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)commands->primary,
+        "frame %u primary", index);
+    commands->secondary_count = 0;
+    create_arena("frame", FRAME_ARENA_SIZE, &commands->scratch);
+}
+
+VkCommandBuffer begin_frame_commands(VkDevice device, struct FrameCommands *commands)
+{
+    assert_vulkan(vkResetCommandPool(device, commands->pool, 0),
+        "Failed to reset a Vulkan transient command pool!");
+    reset_arena(&commands->scratch, 0);
+
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    assert_vulkan(vkBeginCommandBuffer(commands->primary, &info),
+        "Failed to begin a Vulkan command buffer!");
+
+    return commands->primary;
+}
+
+void destroy_frame_commands(VkDevice device, struct FrameCommands *commands)
+{
+    vkDestroyCommandPool(device, commands->pool, NULL);
+    destroy_arena(&commands->scratch);
+}
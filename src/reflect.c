@@ -0,0 +1,655 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "instance.h"
+#include "reflect.h"
+
+#define SPIRV_MAGIC 0x07230203u
+#define SPIRV_HEADER_SIZE 5u
+#define LAYOUT_CACHE_INITIAL_CAPACITY 8u
+
+enum SpirvOp {
+    SPIRV_OP_ENTRY_POINT = 15,
+    SPIRV_OP_TYPE_BOOL = 20,
+    SPIRV_OP_TYPE_INT = 21,
+    SPIRV_OP_TYPE_FLOAT = 22,
+    SPIRV_OP_TYPE_VECTOR = 23,
+    SPIRV_OP_TYPE_MATRIX = 24,
+    SPIRV_OP_TYPE_IMAGE = 25,
+    SPIRV_OP_TYPE_SAMPLER = 26,
+    SPIRV_OP_TYPE_SAMPLED_IMAGE = 27,
+    SPIRV_OP_TYPE_ARRAY = 28,
+    SPIRV_OP_TYPE_RUNTIME_ARRAY = 29,
+    SPIRV_OP_TYPE_STRUCT = 30,
+    SPIRV_OP_TYPE_POINTER = 32,
+    SPIRV_OP_CONSTANT = 43,
+    SPIRV_OP_VARIABLE = 59,
+    SPIRV_OP_DECORATE = 71,
+    SPIRV_OP_MEMBER_DECORATE = 72
+};
+
+enum SpirvDecoration {
+    SPIRV_DECORATION_SPEC_ID = 1,
+    SPIRV_DECORATION_BLOCK = 2,
+    SPIRV_DECORATION_BUFFER_BLOCK = 3,
+    SPIRV_DECORATION_ARRAY_STRIDE = 6,
+    SPIRV_DECORATION_MATRIX_STRIDE = 7,
+    SPIRV_DECORATION_BUILTIN = 11,
+    SPIRV_DECORATION_LOCATION = 30,
+    SPIRV_DECORATION_BINDING = 33,
+    SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+    SPIRV_DECORATION_OFFSET = 35
+};
+
+enum SpirvStorageClass {
+    SPIRV_STORAGE_UNIFORM_CONSTANT = 0,
+    SPIRV_STORAGE_INPUT = 1,
+    SPIRV_STORAGE_UNIFORM = 2,
+    SPIRV_STORAGE_PUSH_CONSTANT = 9,
+    SPIRV_STORAGE_STORAGE_BUFFER = 12
+};
+
+enum SpirvDim {
+    SPIRV_DIM_BUFFER = 5,
+    SPIRV_DIM_SUBPASS_DATA = 6
+};
+
+enum SpirvIdFlags {
+    ID_HAS_SET = 1u << 0,
+    ID_HAS_BINDING = 1u << 1,
+    ID_HAS_LOCATION = 1u << 2,
+    ID_BUILTIN = 1u << 3,
+    ID_BLOCK = 1u << 4,
+    ID_BUFFER_BLOCK = 1u << 5,
+    ID_HAS_SPEC_ID = 1u << 6
+};
+
+// Everything reflection needs to know about a single result id
+struct SpirvId {
+    uint32_t opcode;
+    // Pointee, element, component or variable pointer type depending on opcode
+    uint32_t type;
+    uint32_t storage;
+    // Vector and matrix component count or constant value
+    uint32_t count;
+    uint32_t width;
+    uint32_t signedness;
+    uint32_t dim;
+    uint32_t sampled;
+    uint32_t length;
+    // Word offset of the defining instruction, used for struct members
+    uint32_t word;
+    uint32_t set;
+    uint32_t binding;
+    uint32_t location;
+    uint32_t array_stride;
+    uint32_t spec_id;
+    uint32_t flags;
+};
+
+struct SpirvMember {
+    uint32_t id;
+    uint32_t member;
+    uint32_t offset;
+    uint32_t matrix_stride;
+};
+
+struct SpirvModule {
+    const uint32_t *code;
+    uint32_t bound;
+    struct SpirvId *ids;
+    uint32_t member_count;
+    uint32_t member_capacity;
+    struct SpirvMember *members;
+};
+
+static struct SpirvMember *get_member(struct SpirvModule *module, uint32_t id, uint32_t member)
+{
+    for (uint32_t i = 0; i < module->member_count; ++i)
+        if (module->members[i].id == id && module->members[i].member == member)
+            return &module->members[i];
+
+    if (module->member_count == module->member_capacity) {
+        module->member_capacity = module->member_capacity ? module->member_capacity * 2 : 16;
+        module->members = realloc(module->members,
+            module->member_capacity * sizeof(struct SpirvMember));
+    }
+
+    struct SpirvMember *mbr = &module->members[module->member_count++];
+    memset(mbr, 0, sizeof(*mbr));
+    mbr->id = id;
+    mbr->member = member;
+
+    return mbr;
+}
+
+static struct SpirvId *get_id(struct SpirvModule *module, uint32_t id)
+{
+    if (id >= module->bound)
+        print_exit("Failed to reflect a SPIR-V module with an id out of bounds!");
+
+    return &module->ids[id];
+}
+
+static void decorate(struct SpirvId *id, const uint32_t *ops, uint32_t opcount)
+{
+    const uint32_t literal = opcount > 1 ? ops[1] : 0;
+
+    switch (ops[0]) {
+    case SPIRV_DECORATION_SPEC_ID:
+        id->flags |= ID_HAS_SPEC_ID;
+        id->spec_id = literal;
+        break;
+    case SPIRV_DECORATION_BLOCK:
+        id->flags |= ID_BLOCK;
+        break;
+    case SPIRV_DECORATION_BUFFER_BLOCK:
+        id->flags |= ID_BUFFER_BLOCK;
+        break;
+    case SPIRV_DECORATION_ARRAY_STRIDE:
+        id->array_stride = literal;
+        break;
+    case SPIRV_DECORATION_BUILTIN:
+        id->flags |= ID_BUILTIN;
+        break;
+    case SPIRV_DECORATION_LOCATION:
+        id->flags |= ID_HAS_LOCATION;
+        id->location = literal;
+        break;
+    case SPIRV_DECORATION_BINDING:
+        id->flags |= ID_HAS_BINDING;
+        id->binding = literal;
+        break;
+    case SPIRV_DECORATION_DESCRIPTOR_SET:
+        id->flags |= ID_HAS_SET;
+        id->set = literal;
+        break;
+    }
+}
+
+static VkShaderStageFlagBits get_stage(uint32_t execution_model)
+{
+    switch (execution_model) {
+    case 0:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    print_exit("Failed to reflect an unsupported SPIR-V execution model!");
+    return 0;
+}
+
+// Parses every instruction into module->ids, returns the stage of the first entry point
+static VkShaderStageFlagBits parse_module(struct SpirvModule *module, uint32_t wordcount)
+{
+    VkShaderStageFlagBits stage = 0;
+    const uint32_t *code = module->code;
+
+    for (uint32_t w = SPIRV_HEADER_SIZE; w < wordcount;) {
+        const uint32_t opcode = code[w] & 0xffffu;
+        const uint32_t count = code[w] >> 16;
+
+        if (count == 0 || w + count > wordcount)
+            print_exit("Failed to reflect a malformed SPIR-V module!");
+
+        const uint32_t *ops = &code[w + 1];
+        struct SpirvId *id = NULL;
+
+        switch (opcode) {
+        case SPIRV_OP_ENTRY_POINT:
+            if (stage == 0)
+                stage = get_stage(ops[0]);
+            break;
+        case SPIRV_OP_DECORATE:
+            if (ops[0] < module->bound)
+                decorate(&module->ids[ops[0]], &ops[1], count - 2);
+            break;
+        case SPIRV_OP_MEMBER_DECORATE:
+            if (ops[2] == SPIRV_DECORATION_OFFSET)
+                get_member(module, ops[0], ops[1])->offset = ops[3];
+            else if (ops[2] == SPIRV_DECORATION_MATRIX_STRIDE)
+                get_member(module, ops[0], ops[1])->matrix_stride = ops[3];
+            break;
+        case SPIRV_OP_TYPE_BOOL:
+        case SPIRV_OP_TYPE_SAMPLER:
+        case SPIRV_OP_TYPE_STRUCT:
+            id = get_id(module, ops[0]);
+            break;
+        case SPIRV_OP_TYPE_INT:
+            id = get_id(module, ops[0]);
+            id->width = ops[1];
+            id->signedness = ops[2];
+            break;
+        case SPIRV_OP_TYPE_FLOAT:
+            id = get_id(module, ops[0]);
+            id->width = ops[1];
+            break;
+        case SPIRV_OP_TYPE_VECTOR:
+        case SPIRV_OP_TYPE_MATRIX:
+            id = get_id(module, ops[0]);
+            id->type = ops[1];
+            id->count = ops[2];
+            break;
+        case SPIRV_OP_TYPE_IMAGE:
+            id = get_id(module, ops[0]);
+            id->type = ops[1];
+            id->dim = ops[2];
+            id->sampled = ops[6];
+            break;
+        case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+        case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+            id = get_id(module, ops[0]);
+            id->type = ops[1];
+            break;
+        case SPIRV_OP_TYPE_ARRAY:
+            id = get_id(module, ops[0]);
+            id->type = ops[1];
+            id->length = ops[2];
+            break;
+        case SPIRV_OP_TYPE_POINTER:
+            id = get_id(module, ops[0]);
+            id->storage = ops[1];
+            id->type = ops[2];
+            break;
+        case SPIRV_OP_CONSTANT:
+            id = get_id(module, ops[1]);
+            id->type = ops[0];
+            id->count = ops[2];
+            break;
+        case SPIRV_OP_VARIABLE:
+            id = get_id(module, ops[1]);
+            id->type = ops[0];
+            id->storage = ops[2];
+            break;
+        }
+
+        if (id != NULL) {
+            id->opcode = opcode;
+            id->word = w;
+        }
+
+        w += count;
+    }
+
+    return stage;
+}
+
+static uint32_t get_type_size(const struct SpirvModule *module, uint32_t type,
+    uint32_t matrix_stride)
+{
+    const struct SpirvId *id = &module->ids[type];
+
+    switch (id->opcode) {
+    case SPIRV_OP_TYPE_BOOL:
+        return 4;
+    case SPIRV_OP_TYPE_INT:
+    case SPIRV_OP_TYPE_FLOAT:
+        return id->width / 8;
+    case SPIRV_OP_TYPE_VECTOR:
+        return id->count * get_type_size(module, id->type, 0);
+    case SPIRV_OP_TYPE_MATRIX:
+        return id->count * (matrix_stride ? matrix_stride : get_type_size(module, id->type, 0));
+    case SPIRV_OP_TYPE_ARRAY:
+        return module->ids[id->length].count *
+            (id->array_stride ? id->array_stride : get_type_size(module, id->type, 0));
+    case SPIRV_OP_TYPE_STRUCT: {
+        const uint32_t *instr = &module->code[id->word];
+        const uint32_t mbrcount = (instr[0] >> 16) - 2;
+        uint32_t size = 0;
+
+        for (uint32_t i = 0; i < mbrcount; ++i) {
+            uint32_t offset = 0, stride = 0;
+
+            for (uint32_t j = 0; j < module->member_count; ++j) {
+                if (module->members[j].id == type && module->members[j].member == i) {
+                    offset = module->members[j].offset;
+                    stride = module->members[j].matrix_stride;
+                }
+            }
+
+            const uint32_t end = offset + get_type_size(module, instr[2 + i], stride);
+
+            if (end > size)
+                size = end;
+        }
+
+        return size;
+    }
+    }
+
+    return 0;
+}
+
+static VkFormat get_attribute_format(const struct SpirvModule *module, uint32_t type)
+{
+    const VkFormat floats[4] = {
+        VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+        VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+    };
+    const VkFormat sints[4] = {
+        VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+        VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT
+    };
+    const VkFormat uints[4] = {
+        VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+        VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT
+    };
+
+    const struct SpirvId *id = &module->ids[type];
+    uint32_t count = 1;
+
+    if (id->opcode == SPIRV_OP_TYPE_VECTOR) {
+        count = id->count;
+        id = &module->ids[id->type];
+    }
+
+    if (count < 1 || count > 4 || id->width != 32)
+        print_exit("Failed to reflect an unsupported vertex attribute type!");
+
+    if (id->opcode == SPIRV_OP_TYPE_FLOAT)
+        return floats[count - 1];
+
+    return id->signedness ? sints[count - 1] : uints[count - 1];
+}
+
+// Returns 0 when the variable is not a descriptor
+static int get_descriptor(const struct SpirvModule *module, const struct SpirvId *var,
+    struct DescriptorBinding *binding)
+{
+    if (var->storage != SPIRV_STORAGE_UNIFORM_CONSTANT && var->storage != SPIRV_STORAGE_UNIFORM &&
+        var->storage != SPIRV_STORAGE_STORAGE_BUFFER)
+        return 0;
+
+    uint32_t type = module->ids[var->type].type;
+    binding->count = 1;
+
+    while (module->ids[type].opcode == SPIRV_OP_TYPE_ARRAY ||
+        module->ids[type].opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY) {
+        if (module->ids[type].opcode == SPIRV_OP_TYPE_ARRAY)
+            binding->count *= module->ids[module->ids[type].length].count;
+
+        type = module->ids[type].type;
+    }
+
+    const struct SpirvId *id = &module->ids[type];
+
+    if (var->storage == SPIRV_STORAGE_STORAGE_BUFFER) {
+        binding->type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    } else if (var->storage == SPIRV_STORAGE_UNIFORM) {
+        binding->type = id->flags & ID_BUFFER_BLOCK ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER :
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    } else if (id->opcode == SPIRV_OP_TYPE_SAMPLER) {
+        binding->type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    } else if (id->opcode == SPIRV_OP_TYPE_SAMPLED_IMAGE) {
+        binding->type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    } else if (id->opcode == SPIRV_OP_TYPE_IMAGE) {
+        if (id->dim == SPIRV_DIM_SUBPASS_DATA)
+            binding->type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        else if (id->dim == SPIRV_DIM_BUFFER)
+            binding->type = id->sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER :
+                VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        else
+            binding->type = id->sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE :
+                VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    } else {
+        return 0;
+    }
+
+    binding->set = var->set;
+    binding->binding = var->binding;
+
+    return 1;
+}
+
+void reflect_shader(const uint32_t *code, size_t size, struct ShaderReflection *reflection)
+{
+    const uint32_t wordcount = size / sizeof(uint32_t);
+
+    if (wordcount < SPIRV_HEADER_SIZE || code[0] != SPIRV_MAGIC)
+        print_exit("Failed to reflect an invalid SPIR-V module!");
+
+    struct SpirvModule module = {};
+    module.code = code;
+    module.bound = code[3];
+    module.ids = calloc(module.bound, sizeof(struct SpirvId));
+
+    memset(reflection, 0, sizeof(*reflection));
+    reflection->stage = parse_module(&module, wordcount);
+
+    for (uint32_t i = 0; i < module.bound; ++i) {
+        const struct SpirvId *var = &module.ids[i];
+
+        if ((var->flags & ID_HAS_SPEC_ID) && var->spec_id < 32)
+            reflection->spec_constants |= 1u << var->spec_id;
+
+        if (var->opcode != SPIRV_OP_VARIABLE)
+            continue;
+
+        const uint32_t pointee = module.ids[var->type].type;
+        struct DescriptorBinding binding = {};
+
+        if (var->storage == SPIRV_STORAGE_PUSH_CONSTANT) {
+            reflection->push_constant_size = get_type_size(&module, pointee, 0);
+        } else if (var->storage == SPIRV_STORAGE_INPUT &&
+            reflection->stage == VK_SHADER_STAGE_VERTEX_BIT &&
+            (var->flags & ID_HAS_LOCATION) && !(var->flags & ID_BUILTIN)) {
+            if (reflection->attribute_count == REFLECT_MAX_ATTRIBUTES)
+                print_exit("Failed to reflect a shader with too many vertex attributes!");
+
+            struct VertexAttribute *attr = &reflection->attributes[reflection->attribute_count++];
+            attr->location = var->location;
+            attr->format = get_attribute_format(&module, pointee);
+            attr->size = get_type_size(&module, pointee, 0);
+        } else if (get_descriptor(&module, var, &binding)) {
+            if (reflection->binding_count == REFLECT_MAX_BINDINGS)
+                print_exit("Failed to reflect a shader with too many descriptor bindings!");
+
+            if (binding.set >= REFLECT_MAX_SETS)
+                print_exit("Failed to reflect a shader with too many descriptor sets!");
+
+            binding.stages = reflection->stage;
+            reflection->bindings[reflection->binding_count++] = binding;
+        }
+    }
+
+    // Insertion sort, attribute counts are tiny
+    for (uint32_t i = 1; i < reflection->attribute_count; ++i) {
+        struct VertexAttribute attr = reflection->attributes[i];
+        uint32_t j = i;
+
+        for (; j > 0 && reflection->attributes[j - 1].location > attr.location; --j)
+            reflection->attributes[j] = reflection->attributes[j - 1];
+
+        reflection->attributes[j] = attr;
+    }
+
+    free(module.members);
+    free(module.ids);
+}
+
+void create_layout_cache(struct LayoutCache *cache)
+{
+    cache->set_count = 0;
+    cache->set_capacity = LAYOUT_CACHE_INITIAL_CAPACITY;
+    cache->sets = malloc(cache->set_capacity * sizeof(struct SetLayoutEntry));
+    cache->pipeline_count = 0;
+    cache->pipeline_capacity = LAYOUT_CACHE_INITIAL_CAPACITY;
+    cache->pipelines = malloc(cache->pipeline_capacity * sizeof(struct PipelineLayoutEntry));
+}
+
+// bindings must be sorted by binding number and have set zeroed
+static VkDescriptorSetLayout get_set_layout(VkDevice device, struct LayoutCache *cache,
+    const struct DescriptorBinding *bindings, uint32_t count)
+{
+    for (uint32_t i = 0; i < cache->set_count; ++i)
+        if (cache->sets[i].binding_count == count &&
+            memcmp(cache->sets[i].bindings, bindings, count * sizeof(*bindings)) == 0)
+            return cache->sets[i].layout;
+
+    VkDescriptorSetLayoutBinding lytbindings[REFLECT_MAX_BINDINGS];
+
+    for (uint32_t i = 0; i < count; ++i) {
+        lytbindings[i].binding = bindings[i].binding;
+        lytbindings[i].descriptorCount = bindings[i].count;
+        lytbindings[i].descriptorType = bindings[i].type;
+        lytbindings[i].stageFlags = bindings[i].stages;
+        lytbindings[i].pImmutableSamplers = NULL;
+    }
+
+    VkDescriptorSetLayoutCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    info.bindingCount = count;
+    info.pBindings = lytbindings;
+
+    if (cache->set_count == cache->set_capacity) {
+        cache->set_capacity *= 2;
+        cache->sets = realloc(cache->sets, cache->set_capacity * sizeof(struct SetLayoutEntry));
+    }
+
+    struct SetLayoutEntry *entry = &cache->sets[cache->set_count];
+    assert_vulkan(vkCreateDescriptorSetLayout(device, &info, NULL, &entry->layout),
+        "Failed to create a Vulkan descriptor set layout!");
+    set_debug_name(device, VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)entry->layout,
+        "set layout %u", cache->set_count);
+    entry->binding_count = count;
+    memcpy(entry->bindings, bindings, count * sizeof(*bindings));
+    ++cache->set_count;
+
+    return entry->layout;
+}
+
+// Returns the merged binding count
+static uint32_t merge_bindings(const struct ShaderReflection *reflections, uint32_t count,
+    struct DescriptorBinding merged[REFLECT_MAX_BINDINGS])
+{
+    uint32_t mrgcount = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t j = 0; j < reflections[i].binding_count; ++j) {
+            const struct DescriptorBinding *binding = &reflections[i].bindings[j];
+            uint32_t k = 0;
+
+            for (; k < mrgcount; ++k)
+                if (merged[k].set == binding->set && merged[k].binding == binding->binding)
+                    break;
+
+            if (k < mrgcount) {
+                if (merged[k].type != binding->type || merged[k].count != binding->count)
+                    print_exit("Failed to merge conflicting descriptor bindings!");
+
+                merged[k].stages |= binding->stages;
+                continue;
+            }
+
+            if (mrgcount == REFLECT_MAX_BINDINGS)
+                print_exit("Failed to merge too many descriptor bindings!");
+
+            merged[mrgcount++] = *binding;
+        }
+    }
+
+    return mrgcount;
+}
+
+VkPipelineLayout get_pipeline_layout(VkDevice device, struct LayoutCache *cache,
+    const struct ShaderReflection *reflections, uint32_t count,
+    VkDescriptorSetLayout set_layouts[REFLECT_MAX_SETS], uint32_t *set_count)
+{
+    struct DescriptorBinding merged[REFLECT_MAX_BINDINGS];
+    const uint32_t mrgcount = merge_bindings(reflections, count, merged);
+
+    VkPushConstantRange range = {};
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (reflections[i].push_constant_size == 0)
+            continue;
+
+        range.stageFlags |= reflections[i].stage;
+
+        if (reflections[i].push_constant_size > range.size)
+            range.size = reflections[i].push_constant_size;
+    }
+
+    *set_count = 0;
+
+    for (uint32_t i = 0; i < mrgcount; ++i)
+        if (merged[i].set + 1 > *set_count)
+            *set_count = merged[i].set + 1;
+
+    for (uint32_t set = 0; set < *set_count; ++set) {
+        struct DescriptorBinding bindings[REFLECT_MAX_BINDINGS];
+        uint32_t bndcount = 0;
+
+        for (uint32_t i = 0; i < mrgcount; ++i) {
+            if (merged[i].set != set)
+                continue;
+
+            uint32_t j = bndcount++;
+
+            for (; j > 0 && bindings[j - 1].binding > merged[i].binding; --j)
+                bindings[j] = bindings[j - 1];
+
+            bindings[j] = merged[i];
+            bindings[j].set = 0;
+        }
+
+        set_layouts[set] = get_set_layout(device, cache, bindings, bndcount);
+    }
+
+    for (uint32_t i = 0; i < cache->pipeline_count; ++i) {
+        const struct PipelineLayoutEntry *entry = &cache->pipelines[i];
+
+        if (entry->set_count == *set_count &&
+            memcmp(entry->set_layouts, set_layouts, *set_count * sizeof(*set_layouts)) == 0 &&
+            entry->push_range.stageFlags == range.stageFlags &&
+            entry->push_range.size == range.size)
+            return entry->layout;
+    }
+
+    VkPipelineLayoutCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    info.setLayoutCount = *set_count;
+    info.pSetLayouts = set_layouts;
+    info.pushConstantRangeCount = range.size > 0 ? 1 : 0;
+    info.pPushConstantRanges = &range;
+
+    if (cache->pipeline_count == cache->pipeline_capacity) {
+        cache->pipeline_capacity *= 2;
+        cache->pipelines = realloc(cache->pipelines,
+            cache->pipeline_capacity * sizeof(struct PipelineLayoutEntry));
+    }
+
+    struct PipelineLayoutEntry *entry = &cache->pipelines[cache->pipeline_count];
+    assert_vulkan(vkCreatePipelineLayout(device, &info, NULL, &entry->layout),
+        "Failed to create a Vulkan pipeline layout!");
+    set_debug_name(device, VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)entry->layout,
+        "pipeline layout %u", cache->pipeline_count);
+    entry->set_count = *set_count;
+    memcpy(entry->set_layouts, set_layouts, *set_count * sizeof(*set_layouts));
+    entry->push_range = range;
+    ++cache->pipeline_count;
+
+    return entry->layout;
+}
+
+void destroy_layout_cache(VkDevice device, struct LayoutCache *cache)
+{
+    for (uint32_t i = 0; i < cache->pipeline_count; ++i)
+        vkDestroyPipelineLayout(device, cache->pipelines[i].layout, NULL);
+
+    for (uint32_t i = 0; i < cache->set_count; ++i)
+        vkDestroyDescriptorSetLayout(device, cache->sets[i].layout, NULL);
+
+    free(cache->pipelines);
+    free(cache->sets);
+}
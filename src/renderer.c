@@ -1,27 +1,96 @@
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #define GLFW_INCLUDE_VULKAN
 #include <glfw/glfw3.h>
 
+#include "arena.h"
+#include "backdrop.h"
+#include "cull.h"
+#include "damage.h"
+#include "debug.h"
 #include "instance.h"
+#include "overlay.h"
 #include "renderer.h"
+#include "pacing.h"
+#include "record.h"
+#include "shader.h"
+#include "sprite.h"
+#include "statistics.h"
+#include "timer.h"
+#include "upload.h"
+#include "virtual.h"
 
 #define DEFAULT_WIDTH 1280u
 #define DEFAULT_HEIGHT 720u
 #define DEVICE_EXTENSION_COUNT 1u
-
+#define OPTIONAL_EXTENSION_MAX 5u
+#define STATS_INTERVAL 1.0
+#define SCRATCH_ARENA_SIZE (256u * 1024u)
+#define SWAPCHAIN_ARENA_SIZE (16u * 1024u)
+#define VIRTUAL_TEXTURE_MAX 8u
+#define DEFAULT_VIRTUAL_TEXTURE_BUDGET (64u * 1024u * 1024u)
+#define DEFAULT_TICK_RATE 120.0
+// Eight 120 Hz ticks catch up a frame of up to 15 Hz
+#define DEFAULT_MAX_TICKS_PER_FRAME 8u
+#define DEFAULT_MEMORY_PRESSURE_THRESHOLD 0.9
+#define DEFAULT_MIN_RESOLUTION_SCALE 0.5
+#define DEFAULT_MAX_RESOLUTION_SCALE 1.0
+// Part of the frame period the scene may take on the GPU by default
+#define DEFAULT_GPU_TIME_BUDGET 0.85
+#define FALLBACK_FRAME_PERIOD (1.0 / 60.0)
+#define MAX_SAMPLE_COUNT 8u
+#define SHADER_PATH_MAX 256u
+// Damage over this share of the extent is cheaper to redraw with one full clear
+#define PARTIAL_REDRAW_MAX_SHARE 0.5
+// Pixels added around sprite bounds for rasterization rounding
+#define SPRITE_DAMAGE_MARGIN 1.0f
+#define DYNAMIC_RESOLUTION_FEATURES (VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | \
+    VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | \
+    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+
+// Background the scene is drawn over, also what partial redraws clear damaged rectangles to
+static const VkClearValue CLEAR_VALUE = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+/*
+ * compute and transfer fall back to the graphics family when the GPU has no
+ * dedicated family, compare against graphics to know if work can overlap
+ */
 struct QueueFamilyIndices {
     int graphics;
     int present;
+    int compute;
+    int transfer;
+};
+
+// Resources owned by one frame in flight, reused FRAMES_IN_FLIGHT frames later
+struct Frame {
+    struct FrameCommands commands;
+    VkFence fence;
+    VkSemaphore acquired;
+    VkSemaphore rendered;
+    // Sprite instances of the frame, host visible and grown on demand
+    struct GpuBuffer instances;
+    uint32_t instance_count;
+    // The instances are drawn from the culler's output instead of directly
+    int culled;
+    // Overlay quads of the frame, drawn after the main render pass
+    struct GpuBuffer overlay_instances;
+    uint32_t overlay_count;
 };
 
 struct Renderer {
+    // Temporary allocations during init and swapchain recreation, empty in between
+    struct Arena scratch;
+    // Allocations that live as long as the swapchain
+    struct Arena swapchain_arena;
     GLFWwindow *window;
     int resized;
     VkInstance instance;
 #ifndef NDEBUG
-    VkDebugUtilsMessengerEXT debug_messenger;
+    struct DebugMessenger debug_messenger;
 #endif
     VkSurfaceKHR surface;
     struct QueueFamilyIndices queue_families;
@@ -29,20 +98,119 @@ struct Renderer {
     VkDevice device;
     VkQueue graphics_queue;
     VkQueue present_queue;
-    VkCommandPool command_pool;
+    VkQueue compute_queue;
+    VkQueue transfer_queue;
+    int present_id_enabled;
+    int present_wait_enabled;
+    int host_import_enabled;
+    int memory_budget_enabled;
+    int incremental_present_enabled;
+    struct MemoryBudget memory_budget;
+    // TextureFamily bits of the compression features enabled on the device
+    uint32_t texture_families;
+    // shaderStorageImageWriteWithoutFormat, needed by the compute mip path
+    int storage_write_enabled;
+    // Virtual texture feedback is written from fragment shaders
+    int fragment_stores_enabled;
+    // multiDrawIndirect and drawIndirectFirstInstance, needed by sprite culling
+    int indirect_draws_enabled;
+    // pack.data is NULL when no asset pack was given
+    struct AssetPack pack;
+    struct Uploader uploader;
+    struct MipGenerator mips;
+    struct GpuTimers timers;
+    VkDeviceSize virtual_texture_budget;
+    uint32_t virtual_texture_count;
+    struct VirtualTexture *virtual_textures[VIRTUAL_TEXTURE_MAX];
+    struct ComputeScheduler compute;
+    // Compute passes add_renderer_compute_pass() added, they force full redraws
+    uint32_t added_compute_passes;
+    // Sprites are culled on the GPU when the cull shader and indirect draws are available
+    int sprite_culling;
+    struct SpriteCuller culler;
+    uint32_t cull_pass;
     VkSurfaceFormatKHR surface_format;
     VkExtent2D extent;
     uint32_t image_count;
+    VkPresentModeKHR preferred_present_mode;
+    VkPresentModeKHR present_mode;
     VkSwapchainKHR swapchain;
+    VkImage *images;
     VkImageView *image_views;
+    // The scene renders offscreen at resolution.scale and is blitted to the swapchain
+    int dynamic_resolution;
+    struct ResolutionScale resolution;
+    // Extent the scene renders at, renderer->extent without dynamic resolution
+    VkExtent2D scene_extent;
+    // Sized for resolution.max_scale so scale changes only move the viewport
+    struct Texture scene_targets[FRAMES_IN_FLIGHT];
+    VkFramebuffer scene_framebuffers[FRAMES_IN_FLIGHT];
+    VkSampleCountFlagBits samples;
+    // Resolved into the output at the end of the main pass, unused with 1 sample
+    struct Texture msaa_target;
+    // Main pass framebuffers per swapchain image with MSAA, NULL otherwise
+    VkFramebuffer *msaa_framebuffers;
     VkRenderPass render_pass;
-    VkPipelineLayout pipeline_layout;
+    // Loads what render_pass stored so the overlay draws on top of it
+    VkRenderPass overlay_render_pass;
+    struct LayoutCache layout_cache;
+    struct ShaderProgram basic_program;
+    // Sprites are not drawn when the sprite shaders are missing
+    int sprites_enabled;
+    struct ShaderProgram sprite_program;
+    // Drawn first when RendererSettings.backdrop is set and the backdrop shaders exist
+    int backdrop_enabled;
+    struct ShaderProgram backdrop_program;
+    struct Backdrop backdrop;
+    // Drawn by the backdrop instead of a streamed texture when backdrop_virtual is set
+    int backdrop_virtual;
+    struct VirtualTexture backdrop_texture;
+    struct PipelineCache pipeline_cache;
     VkPipeline graphics_pipeline;
-    VkCommandBuffer *command_buffers;
+    VkPipeline sprite_pipeline;
+    VkPipeline backdrop_pipeline;
+    // Alpha blended sprites on top of the frame, unaffected by overdraw
+    VkPipeline overlay_pipeline;
+    // Draw the overdraw heatmap instead of the scene
+    int overdraw;
+    int statistics_supported;
+    struct PipelineStatistics statistics;
     VkFramebuffer *framebuffers;
-    VkSemaphore rendered_semaphore;
-    VkSemaphore presented_semaphore;
-    VkFence *fences;
+    struct DrawPassList draw_passes;
+    struct Frame frames[FRAMES_IN_FLIGHT];
+    uint32_t frame;
+    // Fence of the frame last rendering to each swapchain image, VK_NULL_HANDLE when idle
+    VkFence *image_fences;
+    // Without damage tracking every frame is fully damaged
+    int damage_tracking;
+    // Changed since the last presented frame
+    struct DamageRegion damage;
+    // Changed since each swapchain image was last rendered, allocated from swapchain_arena
+    struct DamageRegion *image_damage;
+    // Sprites last passed to set_renderer_sprites(), diffed against the next ones
+    struct SpriteBatch drawn_sprites;
+    // Overlay panel of the last frame, empty while hidden
+    VkRect2D overlay_bounds;
+    uint64_t skipped_frames;
+    double redraw_share;
+    struct FramePacer pacer;
+    RendererUpdateFunc update;
+    void *update_data;
+    double update_time;
+    RendererTickFunc tick;
+    void *tick_data;
+    struct FixedTimestep timestep;
+    int print_stats;
+    int low_latency;
+    double stats_time;
+    uint64_t stats_frames;
+    struct Overlay overlay;
+    // Of the frame last recorded
+    struct DrawCounters counters;
+    double fence_wait;
+    double acquire_wait;
+    // Uploader byte totals when the overlay was last built
+    uint64_t uploaded_bytes;
 };
 
 struct SwapchainDetails {
@@ -64,22 +232,46 @@ static void create_window(struct Renderer *renderer)
 
 static void framebuffer_resize_callback(GLFWwindow *window, int width, int height)
 {
-    int *resized = (int *)glfwGetWindowUserPointer(window);
-    *resized = 1;
+    struct Renderer *renderer = (struct Renderer *)glfwGetWindowUserPointer(window);
+    renderer->resized = 1;
 }
 
-static void create_resized_callback(struct Renderer *renderer)
+/*
+ * Input callbacks timestamp events for latency measurement, F3 toggles the
+ * overlay and F4 the overdraw heatmap
+ */
+static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
-    renderer->resized = 0;
+    struct Renderer *renderer = (struct Renderer *)glfwGetWindowUserPointer(window);
+    record_input(&renderer->pacer);
 
-    glfwSetWindowUserPointer(renderer->window, &renderer->resized);
-    glfwSetFramebufferSizeCallback(renderer->window, &framebuffer_resize_callback);
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+        renderer->overlay.visible = !renderer->overlay.visible;
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+        set_renderer_overdraw(renderer, !renderer->overdraw);
+}
+
+static void mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
+{
+    struct Renderer *renderer = (struct Renderer *)glfwGetWindowUserPointer(window);
+    record_input(&renderer->pacer);
 }
 
-static void assert_vulkan(VkResult result, const char *message) 
+static void cursor_position_callback(GLFWwindow *window, double x, double y)
 {
-    if (result != VK_SUCCESS)
-        print_exit(message);
+    struct Renderer *renderer = (struct Renderer *)glfwGetWindowUserPointer(window);
+    record_input(&renderer->pacer);
+}
+
+static void create_window_callbacks(struct Renderer *renderer)
+{
+    renderer->resized = 0;
+
+    glfwSetWindowUserPointer(renderer->window, renderer);
+    glfwSetFramebufferSizeCallback(renderer->window, &framebuffer_resize_callback);
+    glfwSetKeyCallback(renderer->window, &key_callback);
+    glfwSetMouseButtonCallback(renderer->window, &mouse_button_callback);
+    glfwSetCursorPosCallback(renderer->window, &cursor_position_callback);
 }
 
 // renderer->instance should be cleaned up by vkDestroyInstance()
@@ -87,7 +279,7 @@ static void create_instance(struct Renderer *renderer)
 {
     VkApplicationInfo appinfo = {};
     appinfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-    appinfo.apiVersion = VK_API_VERSION_1_0;
+    appinfo.apiVersion = VK_API_VERSION_1_1;
     appinfo.applicationVersion = VK_MAKE_VERSION(0, 0, 0);
     appinfo.pApplicationName = "Lindmar";
     appinfo.engineVersion = VK_MAKE_VERSION(0, 1, 0);
@@ -96,60 +288,19 @@ static void create_instance(struct Renderer *renderer)
     VkInstanceCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     info.pApplicationInfo = &appinfo;
-    info.ppEnabledExtensionNames = create_instance_extensions(&info.enabledExtensionCount);
+    info.ppEnabledExtensionNames = create_instance_extensions(&renderer->scratch,
+        &info.enabledExtensionCount);
 #ifndef NDEBUG
     const char *layers[LAYER_COUNT];
-    get_layers(layers);
+    get_layers(&renderer->scratch, layers);
 
     info.enabledLayerCount = LAYER_COUNT;
     info.ppEnabledLayerNames = layers;
 #endif
 
     assert_vulkan(vkCreateInstance(&info, NULL, &renderer->instance), "Failed to create a Vulkan instance!");
-#ifndef NDEBUG
-    free((void *)info.ppEnabledExtensionNames);
-#endif
 }
 
-#ifndef NDEBUG
-static VkBool32 debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
-    VkDebugUtilsMessageTypeFlagsEXT type,
-    const VkDebugUtilsMessengerCallbackDataEXT *callback_data, void *user_data)
-{
-    printf("%s\n", callback_data->pMessage);
-    return VK_FALSE;
-}
-
-// renderer->debug_messenger should be cleaned up by destroy_debug_messenger()
-static void create_debug_messenger(struct Renderer *renderer)
-{
-    VkDebugUtilsMessengerCreateInfoEXT info = {};
-    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-    info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT |
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
-    info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT |
-        VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
-    info.pfnUserCallback = &debug_callback;
-
-    PFN_vkCreateDebugUtilsMessengerEXT func = 
-        (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
-        renderer->instance, "vkCreateDebugUtilsMessengerEXT");
-
-    assert_vulkan(func(renderer->instance, &info, NULL, &renderer->debug_messenger),
-        "Failed to create a Vulkan debug messenger!");
-}
-
-static void destroy_debug_messenger(struct Renderer *renderer)
-{
-    PFN_vkDestroyDebugUtilsMessengerEXT func = 
-        (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
-        renderer->instance, "vkDestroyDebugUtilsMessengerEXT");
-
-    func(renderer->instance, renderer->debug_messenger, NULL); 
-}
-#endif
-
 // renderer->surface should be cleaned up by vkDestroySurfaceKHR()
 static void create_surface(struct Renderer *renderer)
 {
@@ -162,27 +313,56 @@ static int is_queue_families_complete(struct Renderer *renderer)
     uint32_t famcount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(renderer->gpu, &famcount, NULL);
 
-    VkQueueFamilyProperties families[famcount];
+    const size_t mark = get_arena_mark(&renderer->scratch);
+    VkQueueFamilyProperties *families = ALLOCATE_ARRAY(&renderer->scratch,
+        VkQueueFamilyProperties, famcount);
     vkGetPhysicalDeviceQueueFamilyProperties(renderer->gpu, &famcount, families);
 
-    renderer->queue_families.graphics = -1;
-    renderer->queue_families.present = -1;
+    struct QueueFamilyIndices *indices = &renderer->queue_families;
+    indices->graphics = -1;
+    indices->present = -1;
+    indices->compute = -1;
+    indices->transfer = -1;
+
+    int combined = -1;
 
     for (uint32_t i = 0; i < famcount; ++i) {
-        if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
-            renderer->queue_families.graphics = i;
-        
+        const VkQueueFlags flags = families[i].queueFlags;
+
         VkBool32 presentspprt = 0;
         vkGetPhysicalDeviceSurfaceSupportKHR(renderer->gpu, i, renderer->surface, &presentspprt);
 
-        if (presentspprt)
-            renderer->queue_families.present = i;
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && presentspprt && combined < 0)
+            combined = i;
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && indices->graphics < 0)
+            indices->graphics = i;
+        if (presentspprt && indices->present < 0)
+            indices->present = i;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) &&
+            indices->compute < 0)
+            indices->compute = i;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+            !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && indices->transfer < 0)
+            indices->transfer = i;
     }
 
-    return renderer->queue_families.graphics >= 0 && renderer->queue_families.present >= 0;
+    reset_arena(&renderer->scratch, mark);
+
+    // One family for both avoids concurrent sharing of swapchain images
+    if (combined >= 0) {
+        indices->graphics = combined;
+        indices->present = combined;
+    }
+
+    if (indices->compute < 0)
+        indices->compute = indices->graphics;
+    if (indices->transfer < 0)
+        indices->transfer = indices->compute;
+
+    return indices->graphics >= 0 && indices->present >= 0;
 }
 
-static int is_device_extensions_support(const struct Renderer *renderer,
+static int is_device_extensions_support(struct Renderer *renderer,
     const char *extensions[DEVICE_EXTENSION_COUNT])
 {
     extensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
@@ -190,24 +370,28 @@ static int is_device_extensions_support(const struct Renderer *renderer,
     uint32_t extcount = 0;
     vkEnumerateDeviceExtensionProperties(renderer->gpu, NULL, &extcount, NULL);
 
-    VkExtensionProperties exts[extcount];
+    const size_t mark = get_arena_mark(&renderer->scratch);
+    VkExtensionProperties *exts = ALLOCATE_ARRAY(&renderer->scratch, VkExtensionProperties,
+        extcount);
     vkEnumerateDeviceExtensionProperties(renderer->gpu, NULL, &extcount, exts);
 
-    for (uint32_t i = 0; i < DEVICE_EXTENSION_COUNT; ++i) {
+    int supported = 1;
+
+    for (uint32_t i = 0; i < DEVICE_EXTENSION_COUNT && supported; ++i) {
+        supported = 0;
+
         for (uint32_t j = 0; j < extcount; ++j)
             if (strcmp(extensions[i], exts[j].extensionName) == 0)
-                goto nextExtensions;
-            
-        return 0;
-
-        nextExtensions:;
+                supported = 1;
     }
 
-    return 1;
+    reset_arena(&renderer->scratch, mark);
+
+    return supported;
 }
 
-// True: details should be cleaned up by destroy_swapchain_details()
-static int is_swapchain_details_complete(const struct Renderer *renderer,
+// True: details are allocated from renderer->scratch
+static int is_swapchain_details_complete(struct Renderer *renderer,
     struct SwapchainDetails *details)
 {
     vkGetPhysicalDeviceSurfaceFormatsKHR(renderer->gpu, renderer->surface,
@@ -222,10 +406,10 @@ static int is_swapchain_details_complete(const struct Renderer *renderer,
     if (details->present_mode_count == 0)
         return 0;
 
-    details->surface_formats = malloc(
-        sizeof(details->surface_format_count));
-    details->present_modes = malloc(
-        sizeof(details->present_mode_count));
+    details->surface_formats = ALLOCATE_ARRAY(&renderer->scratch, VkSurfaceFormatKHR,
+        details->surface_format_count);
+    details->present_modes = ALLOCATE_ARRAY(&renderer->scratch, VkPresentModeKHR,
+        details->present_mode_count);
 
     vkGetPhysicalDeviceSurfaceFormatsKHR(renderer->gpu, renderer->surface,
         &details->surface_format_count,
@@ -239,13 +423,7 @@ static int is_swapchain_details_complete(const struct Renderer *renderer,
     return 1;
 }
 
-static void destroy_swapchain_details(struct SwapchainDetails *details)
-{
-    free(details->surface_formats);
-    free(details->present_modes);
-}
-
-// True: details should be cleaned up by destroy_swapchain_details()
+// True: details are allocated from renderer->scratch
 static int is_gpu_suitable(struct Renderer *renderer,
     const char *extensions[DEVICE_EXTENSION_COUNT],
     struct SwapchainDetails *details)
@@ -255,68 +433,357 @@ static int is_gpu_suitable(struct Renderer *renderer,
         is_swapchain_details_complete(renderer, details);
 }
 
-// details should be cleaned up by destroy_swapchain_details()
-static void select_gpu(struct Renderer *renderer, const char *extensions[DEVICE_EXTENSION_COUNT],
-    struct SwapchainDetails *details)
+static uint32_t score_gpu(VkPhysicalDevice gpu)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(gpu, &props);
+
+    VkPhysicalDeviceMemoryProperties memprops;
+    vkGetPhysicalDeviceMemoryProperties(gpu, &memprops);
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(gpu, &features);
+
+    // Device type dominates, everything else only orders GPUs of the same type
+    uint32_t score = 0;
+
+    switch (props.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        score += 100000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        score += 50000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        score += 20000;
+        break;
+    default:
+        score += 1000;
+        break;
+    }
+
+    VkDeviceSize local_size = 0;
+
+    for (uint32_t i = 0; i < memprops.memoryHeapCount; ++i)
+        if (memprops.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            local_size += memprops.memoryHeaps[i].size;
+
+    score += local_size / (64ull * 1024 * 1024);
+    score += props.limits.maxImageDimension2D / 1024;
+    score += props.limits.maxPushConstantsSize / 64;
+
+    const VkBool32 optional[] = {
+        features.samplerAnisotropy,
+        features.textureCompressionBC,
+        features.textureCompressionETC2,
+        features.textureCompressionASTC_LDR,
+        features.pipelineStatisticsQuery,
+        features.fillModeNonSolid
+    };
+
+    for (uint32_t i = 0; i < sizeof(optional) / sizeof(optional[0]); ++i)
+        if (optional[i])
+            score += 50;
+
+    return score;
+}
+
+// Returns the index of the GPU named by override, or gpucount when nothing matches
+static uint32_t find_gpu_override(const char *override, const VkPhysicalDevice *gpus,
+    uint32_t gpucount)
+{
+    char *end = NULL;
+    unsigned long index = strtoul(override, &end, 10);
+
+    if (end != override && *end == '\0')
+        return index < gpucount ? index : gpucount;
+
+    for (uint32_t i = 0; i < gpucount; ++i) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(gpus[i], &props);
+
+        if (strstr(props.deviceName, override) != NULL)
+            return i;
+    }
+
+    return gpucount;
+}
+
+// details are allocated from renderer->scratch
+static void select_gpu(struct Renderer *renderer, const char *override,
+    const char *extensions[DEVICE_EXTENSION_COUNT], struct SwapchainDetails *details)
 {
     uint32_t gpucount = 0;
     vkEnumeratePhysicalDevices(renderer->instance, &gpucount, NULL);
 
-    VkPhysicalDevice gpus[gpucount];
+    const size_t mark = get_arena_mark(&renderer->scratch);
+    VkPhysicalDevice *gpus = ALLOCATE_ARRAY(&renderer->scratch, VkPhysicalDevice, gpucount);
     vkEnumeratePhysicalDevices(renderer->instance, &gpucount, gpus);
 
+    // 0 marks an unsuitable GPU, suitable GPUs always score above it
+    uint32_t *scores = ALLOCATE_ARRAY(&renderer->scratch, uint32_t, gpucount);
+    uint32_t best = gpucount;
+    const size_t gpu_mark = get_arena_mark(&renderer->scratch);
+
     for (uint32_t i = 0; i < gpucount; ++i) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(gpus[i], &props);
+
         renderer->gpu = gpus[i];
+        scores[i] = 0;
 
-        if (is_gpu_suitable(renderer, extensions, details))
-            return;
+        const int suitable = is_gpu_suitable(renderer, extensions, details);
+        reset_arena(&renderer->scratch, gpu_mark);
+
+        if (suitable) {
+            scores[i] = score_gpu(gpus[i]);
+
+            if (best == gpucount || scores[i] > scores[best])
+                best = i;
+
+            printf("GPU %u: %s, score %u\n", i, props.deviceName, scores[i]);
+        } else {
+            printf("GPU %u: %s, unsuitable\n", i, props.deviceName);
+        }
+    }
+
+    if (override != NULL) {
+        const uint32_t chosen = find_gpu_override(override, gpus, gpucount);
+
+        if (chosen == gpucount)
+            printf("GPU override \"%s\" matches no GPU, using the best scored GPU\n", override);
+        else if (scores[chosen] == 0)
+            printf("GPU override \"%s\" is unsuitable, using the best scored GPU\n", override);
+        else
+            best = chosen;
     }
 
-    print_exit("Failed to select a suitable GPU!");
+    if (best == gpucount)
+        print_exit("Failed to select a suitable GPU!");
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(gpus[best], &props);
+    printf("Selected GPU %u: %s\n", best, props.deviceName);
+
+    // Repopulates queue families and details for the selected GPU
+    renderer->gpu = gpus[best];
+    reset_arena(&renderer->scratch, mark);
+    is_gpu_suitable(renderer, extensions, details);
 }
 
-// Should be cleaned up by free()
-static VkDeviceQueueCreateInfo *get_queue_create_infos(const struct Renderer *renderer,
+// Allocated from renderer->scratch
+static VkDeviceQueueCreateInfo *get_queue_create_infos(struct Renderer *renderer,
     uint32_t *count)
 {
-    *count = 1;
+    static const float priority = 1.0f;
+
+    const int families[4] = {
+        renderer->queue_families.graphics,
+        renderer->queue_families.present,
+        renderer->queue_families.compute,
+        renderer->queue_families.transfer
+    };
 
-    float priority = 1.0f;
-    VkDeviceQueueCreateInfo info = {};
-    info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    info.pQueuePriorities = &priority;
-    info.queueCount = 1;
-    info.queueFamilyIndex = renderer->queue_families.graphics;
+    VkDeviceQueueCreateInfo *infos = ALLOCATE_ARRAY(&renderer->scratch,
+        VkDeviceQueueCreateInfo, 4);
+    *count = 0;
 
-    VkDeviceQueueCreateInfo *infos;
+    for (uint32_t i = 0; i < 4; ++i) {
+        uint32_t j = 0;
 
-    if (renderer->queue_families.graphics == renderer->queue_families.present) {
-        infos = malloc(*count * sizeof(VkDeviceQueueCreateInfo));
-        infos[0] = info;
-    } else {
-        *count = 2;
-        infos = malloc(*count * sizeof(VkDeviceQueueCreateInfo));
-        infos[0] = info;
-        infos[1] = info;
-        infos[1].queueFamilyIndex = renderer->queue_families.present;
+        while (j < *count && infos[j].queueFamilyIndex != (uint32_t)families[i])
+            ++j;
+
+        if (j < *count)
+            continue;
+
+        VkDeviceQueueCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        info.pQueuePriorities = &priority;
+        info.queueCount = 1;
+        info.queueFamilyIndex = families[i];
+        infos[(*count)++] = info;
     }
 
     return infos;
 }
 
+static int is_device_extension_available(struct Arena *scratch, VkPhysicalDevice gpu,
+    const char *name)
+{
+    uint32_t extcount = 0;
+    vkEnumerateDeviceExtensionProperties(gpu, NULL, &extcount, NULL);
+
+    const size_t mark = get_arena_mark(scratch);
+    VkExtensionProperties *exts = ALLOCATE_ARRAY(scratch, VkExtensionProperties, extcount);
+    vkEnumerateDeviceExtensionProperties(gpu, NULL, &extcount, exts);
+
+    int available = 0;
+
+    for (uint32_t i = 0; i < extcount && !available; ++i)
+        available = strcmp(name, exts[i].extensionName) == 0;
+
+    reset_arena(scratch, mark);
+
+    return available;
+}
+
+/*
+ * Sets renderer->present_id_enabled and renderer->present_wait_enabled, the
+ * feature structs are chained in idfeatures -> waitfeatures order
+ */
+static void query_present_wait(struct Renderer *renderer,
+    VkPhysicalDevicePresentIdFeaturesKHR *idfeatures,
+    VkPhysicalDevicePresentWaitFeaturesKHR *waitfeatures)
+{
+    renderer->present_id_enabled = 0;
+    renderer->present_wait_enabled = 0;
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(renderer->gpu, &props);
+
+    if (props.apiVersion < VK_API_VERSION_1_1 ||
+        !is_device_extension_available(&renderer->scratch, renderer->gpu,
+        VK_KHR_PRESENT_ID_EXTENSION_NAME))
+        return;
+
+    const int wait_available =
+        is_device_extension_available(&renderer->scratch, renderer->gpu,
+        VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+    idfeatures->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    idfeatures->pNext = wait_available ? waitfeatures : NULL;
+    waitfeatures->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    waitfeatures->pNext = NULL;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = idfeatures;
+    vkGetPhysicalDeviceFeatures2(renderer->gpu, &features);
+
+    renderer->present_id_enabled = idfeatures->presentId;
+    renderer->present_wait_enabled = idfeatures->presentId && wait_available &&
+        waitfeatures->presentWait;
+
+    if (!renderer->present_wait_enabled)
+        idfeatures->pNext = NULL;
+}
+
+/*
+ * Enables every block compression family the device samples from, formatless
+ * storage writes, the fragment atomics virtual texture feedback uses, the
+ * indirect draws of sprite culling and pipeline statistics queries
+ */
+static void enable_device_features(struct Renderer *renderer, VkPhysicalDeviceFeatures *features)
+{
+    VkPhysicalDeviceFeatures supported;
+    vkGetPhysicalDeviceFeatures(renderer->gpu, &supported);
+
+    features->fragmentStoresAndAtomics = supported.fragmentStoresAndAtomics;
+    renderer->fragment_stores_enabled = supported.fragmentStoresAndAtomics;
+    features->pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+    renderer->statistics_supported = supported.pipelineStatisticsQuery;
+
+    features->shaderStorageImageWriteWithoutFormat =
+        supported.shaderStorageImageWriteWithoutFormat;
+    renderer->storage_write_enabled = supported.shaderStorageImageWriteWithoutFormat;
+
+    features->multiDrawIndirect = supported.multiDrawIndirect;
+    features->drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+    renderer->indirect_draws_enabled = supported.multiDrawIndirect &&
+        supported.drawIndirectFirstInstance;
+
+    features->textureCompressionBC = supported.textureCompressionBC;
+    features->textureCompressionETC2 = supported.textureCompressionETC2;
+    features->textureCompressionASTC_LDR = supported.textureCompressionASTC_LDR;
+
+    renderer->texture_families = 0;
+
+    if (supported.textureCompressionBC)
+        renderer->texture_families |= TEXTURE_FAMILY_BC;
+    if (supported.textureCompressionETC2)
+        renderer->texture_families |= TEXTURE_FAMILY_ETC2;
+    if (supported.textureCompressionASTC_LDR)
+        renderer->texture_families |= TEXTURE_FAMILY_ASTC;
+
+    printf("Texture compression: BC %s, ETC2 %s, ASTC %s\n",
+        supported.textureCompressionBC ? "yes" : "no",
+        supported.textureCompressionETC2 ? "yes" : "no",
+        supported.textureCompressionASTC_LDR ? "yes" : "no");
+}
+
+// Highest sample count up to requested that color attachments support
+static void select_sample_count(struct Renderer *renderer, uint32_t requested)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(renderer->gpu, &props);
+
+    const VkSampleCountFlags supported = props.limits.framebufferColorSampleCounts;
+    uint32_t samples = MAX_SAMPLE_COUNT;
+
+    while (samples > 1 && (samples > requested || !(supported & samples)))
+        samples >>= 1;
+
+    if (samples != requested && requested > 1)
+        printf("MSAA: %ux is unsupported, using %ux\n", requested, samples);
+
+    renderer->samples = (VkSampleCountFlagBits)samples;
+}
+
 // renderer->device should be cleaned up by vkDestroyDevice()
 static void create_device(const char *const extensions[DEVICE_EXTENSION_COUNT],
     const struct SwapchainDetails *details, struct Renderer *renderer)
 {
+    const size_t mark = get_arena_mark(&renderer->scratch);
     uint32_t qinfo_count = 0;
     VkDeviceQueueCreateInfo *qinfos = get_queue_create_infos(renderer, &qinfo_count);
 
+    const char *extnames[DEVICE_EXTENSION_COUNT + OPTIONAL_EXTENSION_MAX];
+    uint32_t extcount = DEVICE_EXTENSION_COUNT;
+    memcpy(extnames, extensions, DEVICE_EXTENSION_COUNT * sizeof(const char *));
+
+    VkPhysicalDevicePresentIdFeaturesKHR idfeatures = {};
+    VkPhysicalDevicePresentWaitFeaturesKHR waitfeatures = {};
+    query_present_wait(renderer, &idfeatures, &waitfeatures);
+
+    if (renderer->present_id_enabled)
+        extnames[extcount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+    if (renderer->present_wait_enabled)
+        extnames[extcount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+
+    // Importing host memory builds on external memory, which is core in 1.1
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(renderer->gpu, &props);
+    renderer->host_import_enabled = props.apiVersion >= VK_API_VERSION_1_1 &&
+        is_device_extension_available(&renderer->scratch, renderer->gpu,
+        VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+
+    if (renderer->host_import_enabled)
+        extnames[extcount++] = VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME;
+
+    // Budgets are queried through vkGetPhysicalDeviceMemoryProperties2, core in 1.1
+    renderer->memory_budget_enabled = props.apiVersion >= VK_API_VERSION_1_1 &&
+        is_device_extension_available(&renderer->scratch, renderer->gpu,
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    if (renderer->memory_budget_enabled)
+        extnames[extcount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+
+    renderer->incremental_present_enabled = is_device_extension_available(&renderer->scratch,
+        renderer->gpu, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+
+    if (renderer->incremental_present_enabled)
+        extnames[extcount++] = VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME;
+
     VkPhysicalDeviceFeatures features = {};
+    enable_device_features(renderer, &features);
+
     VkDeviceCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    info.pNext = renderer->present_id_enabled ? &idfeatures : NULL;
     info.pEnabledFeatures = &features;
-    info.enabledExtensionCount = DEVICE_EXTENSION_COUNT;
-    info.ppEnabledExtensionNames = extensions;
+    info.enabledExtensionCount = extcount;
+    info.ppEnabledExtensionNames = extnames;
     info.queueCreateInfoCount = qinfo_count;
     info.pQueueCreateInfos = qinfos;
     
@@ -326,18 +793,86 @@ static void create_device(const char *const extensions[DEVICE_EXTENSION_COUNT],
         &renderer->graphics_queue);
     vkGetDeviceQueue(renderer->device, renderer->queue_families.present, 0,
         &renderer->present_queue);
-    free(qinfos);
+    vkGetDeviceQueue(renderer->device, renderer->queue_families.compute, 0,
+        &renderer->compute_queue);
+    vkGetDeviceQueue(renderer->device, renderer->queue_families.transfer, 0,
+        &renderer->transfer_queue);
+    reset_arena(&renderer->scratch, mark);
+
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_DEVICE, (uint64_t)renderer->device,
+        "device");
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_QUEUE, (uint64_t)renderer->graphics_queue,
+        "graphics queue");
+
+    if (renderer->compute_queue != renderer->graphics_queue)
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_QUEUE,
+            (uint64_t)renderer->compute_queue, "compute queue");
+    if (renderer->transfer_queue != renderer->graphics_queue &&
+        renderer->transfer_queue != renderer->compute_queue)
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_QUEUE,
+            (uint64_t)renderer->transfer_queue, "transfer queue");
+
+    printf("Queue families: graphics %d, present %d, compute %d, transfer %d\n",
+        renderer->queue_families.graphics, renderer->queue_families.present,
+        renderer->queue_families.compute, renderer->queue_families.transfer);
+    printf("Memory budget: %s\n", renderer->memory_budget_enabled ?
+        "VK_EXT_memory_budget" : "estimated from own allocations");
 }
 
-// renderer->command_pool should be cleaned up by destroy_command_pool()
-static void create_command_pool(struct Renderer *renderer)
+// renderer->frames should be cleaned up by destroy_frames()
+static void create_frames(struct Renderer *renderer)
 {
-    VkCommandPoolCreateInfo info = {};
-    info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    info.queueFamilyIndex = renderer->queue_families.graphics;
+    VkSemaphoreCreateInfo seminfo = {};
+    seminfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo feninfo = {};
+    feninfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    feninfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        struct Frame *frame = &renderer->frames[i];
+
+        create_frame_commands(renderer->device, renderer->queue_families.graphics, i,
+            &frame->commands);
+        assert_vulkan(vkCreateFence(renderer->device, &feninfo, NULL, &frame->fence),
+            "Failed to create a Vulkan fence!");
+        assert_vulkan(vkCreateSemaphore(renderer->device, &seminfo, NULL, &frame->acquired),
+            "Failed to create a Vulkan image acquired semaphore!");
+        assert_vulkan(vkCreateSemaphore(renderer->device, &seminfo, NULL, &frame->rendered),
+            "Failed to create a Vulkan render finished semaphore!");
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_FENCE, (uint64_t)frame->fence,
+            "frame %u fence", i);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)frame->acquired,
+            "frame %u acquired", i);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)frame->rendered,
+            "frame %u rendered", i);
+        frame->instances.buffer = VK_NULL_HANDLE;
+        frame->instances.size = 0;
+        frame->instance_count = 0;
+        frame->culled = 0;
+        frame->overlay_instances.buffer = VK_NULL_HANDLE;
+        frame->overlay_instances.size = 0;
+        frame->overlay_count = 0;
+    }
+
+    renderer->frame = 0;
+}
 
-    assert_vulkan(vkCreateCommandPool(renderer->device, &info, NULL, &renderer->command_pool),
-        "Failed to create a Vulkan command pool!");
+static void destroy_frames(struct Renderer *renderer)
+{
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        struct Frame *frame = &renderer->frames[i];
+
+        destroy_frame_commands(renderer->device, &frame->commands);
+        vkDestroyFence(renderer->device, frame->fence, NULL);
+        vkDestroySemaphore(renderer->device, frame->acquired, NULL);
+        vkDestroySemaphore(renderer->device, frame->rendered, NULL);
+
+        if (frame->instances.buffer != VK_NULL_HANDLE)
+            destroy_buffer(renderer->device, &frame->instances);
+        if (frame->overlay_instances.buffer != VK_NULL_HANDLE)
+            destroy_buffer(renderer->device, &frame->overlay_instances);
+    }
 }
 
 static void select_surface_format(const struct SwapchainDetails *details,
@@ -378,8 +913,8 @@ static void select_extent(const uint32_t width, const uint32_t height,
         details->capabilities.minImageExtent.height);      
 }
 
-// Should be cleaned up free()
-static uint32_t *create_queue_indices(const struct Renderer *renderer, uint32_t *count,
+// Allocated from renderer->scratch
+static uint32_t *create_queue_indices(struct Renderer *renderer, uint32_t *count,
     VkSharingMode *sharing_mode)
 {
     uint32_t *qindices;
@@ -391,7 +926,7 @@ static uint32_t *create_queue_indices(const struct Renderer *renderer, uint32_t
     } else {
         *count = 2;
         *sharing_mode = VK_SHARING_MODE_CONCURRENT;
-        qindices = malloc(*count * sizeof(uint32_t));
+        qindices = ALLOCATE_ARRAY(&renderer->scratch, uint32_t, *count);
         qindices[0] = renderer->queue_families.graphics;
         qindices[1] = renderer->queue_families.present;
     }
@@ -409,15 +944,59 @@ static uint32_t select_image_count(const struct SwapchainDetails *details)
     return imgcount;
 }
 
-static VkPresentModeKHR select_present_mode(const struct SwapchainDetails *details)
+static int is_present_mode_supported(const struct SwapchainDetails *details,
+    VkPresentModeKHR mode)
 {
     for (uint32_t i = 0; i < details->present_mode_count; ++i)
-        if (details->present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
-            return details->present_modes[i];
+        if (details->present_modes[i] == mode)
+            return 1;
+
+    return 0;
+}
+
+// Matches the --present-mode names
+static const char *get_present_mode_name(VkPresentModeKHR mode)
+{
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "fifo-relaxed";
+    default:
+        return "unknown";
+    }
+}
+
+// Tearing modes fall back to each other before FIFO, which is always supported
+static VkPresentModeKHR select_present_mode(const struct SwapchainDetails *details,
+    VkPresentModeKHR preferred)
+{
+    if (is_present_mode_supported(details, preferred))
+        return preferred;
+
+    if (preferred == VK_PRESENT_MODE_IMMEDIATE_KHR &&
+        is_present_mode_supported(details, VK_PRESENT_MODE_FIFO_RELAXED_KHR))
+        return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
 
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+// The scene target shares the surface format and is blitted with linear filtering
+static int is_dynamic_resolution_supported(struct Renderer *renderer,
+    const struct SwapchainDetails *details)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(renderer->gpu, renderer->surface_format.format, &props);
+
+    return (details->capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+        (props.optimalTilingFeatures & DYNAMIC_RESOLUTION_FEATURES) ==
+        DYNAMIC_RESOLUTION_FEATURES;
+}
+
 // renderer->swapchain should be cleaned up by vkDestroySwapchain()
 static void create_swapchain(const uint32_t width, const uint32_t height,
     const struct SwapchainDetails *details, struct Renderer *renderer)
@@ -425,36 +1004,60 @@ static void create_swapchain(const uint32_t width, const uint32_t height,
     select_surface_format(details, renderer);
     select_extent(width, height, details, renderer);
 
+    const size_t mark = get_arena_mark(&renderer->scratch);
     VkSwapchainCreateInfoKHR info = {};
     info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     info.surface = renderer->surface;
     info.pQueueFamilyIndices = create_queue_indices(renderer, &info.queueFamilyIndexCount,
         &info.imageSharingMode);
-    info.clipped = VK_TRUE;
+    // Damage tracking redraws only what changed, so pixels under other windows have to be kept
+    info.clipped = renderer->damage_tracking ? VK_FALSE : VK_TRUE;
     info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     info.imageArrayLayers = 1;
     info.imageColorSpace = renderer->surface_format.colorSpace;
     info.imageExtent = renderer->extent;
     info.imageFormat = renderer->surface_format.format;
     info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+    if (renderer->dynamic_resolution && !is_dynamic_resolution_supported(renderer, details)) {
+        printf("Dynamic resolution: disabled, the swapchain cannot be blitted to\n");
+        renderer->dynamic_resolution = 0;
+    }
+
+    if (renderer->dynamic_resolution)
+        info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
     info.minImageCount = select_image_count(details);
-    info.presentMode = select_present_mode(details);
+    info.presentMode = select_present_mode(details, renderer->preferred_present_mode);
     info.preTransform = details->capabilities.currentTransform;
 
     assert_vulkan(vkCreateSwapchainKHR(renderer->device, &info, NULL, &renderer->swapchain),
         "Failed to create a Vulkan swapchain");
-    free((void *)info.pQueueFamilyIndices);
+    reset_arena(&renderer->scratch, mark);
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_SWAPCHAIN_KHR, (uint64_t)renderer->swapchain,
+        "swapchain");
+
+    if (info.presentMode != renderer->preferred_present_mode)
+        printf("Present mode %s is unsupported, using %s\n",
+            get_present_mode_name(renderer->preferred_present_mode),
+            get_present_mode_name(info.presentMode));
+
+    renderer->present_mode = info.presentMode;
 }
 
-// renderer->image_views should be cleaned up by destroy_image_views()
+// renderer->images and renderer->image_views should be cleaned up by destroy_image_views(),
+// allocated from renderer->swapchain_arena
 static void create_image_views(struct Renderer *renderer)
 {
     vkGetSwapchainImagesKHR(renderer->device, renderer->swapchain, &renderer->image_count, NULL);
 
-    VkImage images[renderer->image_count];
-    vkGetSwapchainImagesKHR(renderer->device, renderer->swapchain, &renderer->image_count, images);
+    renderer->images = ALLOCATE_ARRAY(&renderer->swapchain_arena, VkImage,
+        renderer->image_count);
+    vkGetSwapchainImagesKHR(renderer->device, renderer->swapchain, &renderer->image_count,
+        renderer->images);
 
-    renderer->image_views = malloc(renderer->image_count * sizeof(VkImageView));
+    renderer->image_views = ALLOCATE_ARRAY(&renderer->swapchain_arena, VkImageView,
+        renderer->image_count);
 
     for (uint32_t i = 0; i < renderer->image_count; ++i) {
         VkImageViewCreateInfo info = {};
@@ -464,7 +1067,7 @@ static void create_image_views(struct Renderer *renderer)
         info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
         info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
         info.format = renderer->surface_format.format;
-        info.image = images[i];
+        info.image = renderer->images[i];
         info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         info.subresourceRange.layerCount = 1;
         info.subresourceRange.levelCount = 1;
@@ -472,6 +1075,10 @@ static void create_image_views(struct Renderer *renderer)
 
         assert_vulkan(vkCreateImageView(renderer->device, &info, NULL, &renderer->image_views[i]),
             "Failed to create a Vulkan image view!");
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_IMAGE, (uint64_t)renderer->images[i],
+            "swapchain image %u", i);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_IMAGE_VIEW,
+            (uint64_t)renderer->image_views[i], "swapchain view %u", i);
     }
 }
 
@@ -479,18 +1086,94 @@ static void destroy_image_views(struct Renderer *renderer)
 {
     for (uint32_t i = 0; i < renderer->image_count; ++i) 
         vkDestroyImageView(renderer->device, renderer->image_views[i], NULL);
-
-    free(renderer->image_views);
 }
 
-// renderer->render_pass should be cleaned up by vkDestroyRenderPass()
+/*
+ * Attachment 0 is the single sampled output. With MSAA the subpass draws to
+ * the transient attachment 1 and resolves into 0 at its end, so the samples
+ * never leave tile memory on GPUs that have it.
+ * renderer->render_pass should be cleaned up by vkDestroyRenderPass()
+ */
 static void create_render_pass(struct Renderer *renderer)
+{
+    const int multisampled = renderer->samples != VK_SAMPLE_COUNT_1_BIT;
+
+    VkAttachmentDescription attachments[2] = {};
+    attachments[0].finalLayout = renderer->dynamic_resolution ?
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachments[0].format = renderer->surface_format.format;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].loadOp = multisampled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE :
+        VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    attachments[1] = attachments[0];
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].samples = renderer->samples;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    VkAttachmentReference attchref = {};
+    attchref.attachment = multisampled ? 1 : 0;
+    attchref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference resolveref = {};
+    resolveref.attachment = 0;
+    resolveref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDependency depends[2] = {};
+    depends[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    depends[0].dstSubpass = 0;
+    // The MSAA target is shared, the previous frame's writes to it have to finish first
+    depends[0].srcAccessMask = multisampled ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
+    depends[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    depends[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    depends[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    // The upscale blit reads the scene target right after the pass
+    depends[1].srcSubpass = 0;
+    depends[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    depends[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    depends[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    depends[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    depends[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkSubpassDescription subpass = {};
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &attchref;
+    subpass.pResolveAttachments = multisampled ? &resolveref : NULL;
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+    VkRenderPassCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    info.attachmentCount = multisampled ? 2 : 1;
+    info.pAttachments = attachments;
+    info.pSubpasses = &subpass;
+    info.subpassCount = 1;
+    info.dependencyCount = renderer->dynamic_resolution ? 2 : 1;
+    info.pDependencies = depends;
+
+    assert_vulkan(vkCreateRenderPass(renderer->device, &info, NULL, &renderer->render_pass),
+        "Failed to create a Vulkan render pass!");
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_RENDER_PASS,
+        (uint64_t)renderer->render_pass, "main pass");
+}
+
+/*
+ * Compatible with renderer->render_pass without MSAA, so the swapchain
+ * framebuffers serve both. renderer->overlay_render_pass should be cleaned up
+ * by vkDestroyRenderPass()
+ */
+static void create_overlay_render_pass(struct Renderer *renderer)
 {
     VkAttachmentDescription attachment = {};
     attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     attachment.format = renderer->surface_format.format;
-    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
     attachment.samples = VK_SAMPLE_COUNT_1_BIT;
     attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -500,12 +1183,14 @@ static void create_render_pass(struct Renderer *renderer)
     attchref.attachment = 0;
     attchref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    // Blending reads what the main pass wrote
     VkSubpassDependency depend = {};
     depend.srcSubpass = VK_SUBPASS_EXTERNAL;
     depend.dstSubpass = 0;
-    depend.srcAccessMask = 0;
+    depend.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     depend.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    depend.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    depend.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     depend.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
     VkSubpassDescription subpass = {};
@@ -522,309 +1207,764 @@ static void create_render_pass(struct Renderer *renderer)
     info.dependencyCount = 1;
     info.pDependencies = &depend;
 
-    assert_vulkan(vkCreateRenderPass(renderer->device, &info, NULL, &renderer->render_pass),
-        "Failed to create a Vulkan render pass!");
+    assert_vulkan(vkCreateRenderPass(renderer->device, &info, NULL,
+        &renderer->overlay_render_pass), "Failed to create a Vulkan overlay render pass!");
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_RENDER_PASS,
+        (uint64_t)renderer->overlay_render_pass, "overlay pass");
 }
 
-// Should be cleaned up by free()
-static uint32_t *get_shader_code(const char *path, size_t *size)
+// Binaries the build compiled into shader/ of the working directory, returns 0 when missing
+static int find_shader_binary(const char *name, char path[SHADER_PATH_MAX])
 {
-    FILE *file = fopen(path, "rb");
+    snprintf(path, SHADER_PATH_MAX, "shader/%s.spv", name);
 
-    if (file == NULL) {
-        printf("Failed to open file at %s\n", path);
-        exit(-1);
+    return access(path, R_OK) == 0;
+}
+
+/*
+ * The compute path is optional, without downsample_cs or formatless storage
+ * writes only formats with linear blits get generated mips
+ */
+static void create_mips(struct Renderer *renderer)
+{
+    char path[SHADER_PATH_MAX];
+    const int packed = renderer->pack.data != NULL;
+    const struct PackEntry *entry = packed ?
+        find_pack_entry(&renderer->pack, "shader/downsample_cs") : NULL;
+    const uint32_t *code = NULL;
+    uint32_t *file_code = NULL;
+    size_t code_size = 0;
+
+    if (renderer->storage_write_enabled && entry != NULL && entry->type == PACK_ENTRY_SHADER) {
+        code = (const uint32_t *)get_pack_payload(&renderer->pack, entry);
+        code_size = entry->size;
+    } else if (renderer->storage_write_enabled && !packed &&
+        find_shader_binary("downsample_cs", path)) {
+        file_code = get_shader_code(path, &code_size);
+        code = file_code;
     }
 
-    fseek(file, 0, SEEK_END);
-    
-    *size = ftell(file);
+    create_mip_generator(renderer->device, renderer->gpu, code, code_size, &renderer->mips);
+    free(file_code);
 
-    rewind(file);
+    printf("Mip generation: blit%s\n", code != NULL ? " and compute" : " only");
+}
 
-    size_t count = *size / 4;
-    uint32_t *code = malloc(*size);
-    
-    if (fread(code, sizeof(uint32_t), count, file) != count) {
-        printf("Failed to read file at %s\n", path);
-        exit(-1);
-    }
-    
-    fclose(file);
+// Should be cleaned up by destroy_assets()
+static void create_assets(const struct RendererSettings *settings, struct Renderer *renderer)
+{
+    renderer->pack.data = NULL;
+
+    if (settings->asset_pack != NULL)
+        open_asset_pack(settings->asset_pack, &renderer->pack);
+
+    create_uploader(renderer->device, renderer->gpu, renderer->graphics_queue,
+        renderer->queue_families.graphics, renderer->host_import_enabled,
+        renderer->texture_families, &renderer->uploader);
+    renderer->uploader.report = settings->print_stats;
+    create_mips(renderer);
+    renderer->uploader.mips = &renderer->mips;
+    renderer->virtual_texture_budget = settings->virtual_texture_budget;
+    renderer->virtual_texture_count = 0;
+}
+
+static void destroy_assets(struct Renderer *renderer)
+{
+    destroy_uploader(&renderer->uploader);
+    destroy_mip_generator(&renderer->mips);
 
-    return code;
+    if (renderer->pack.data != NULL)
+        close_asset_pack(&renderer->pack);
 }
 
-// infos should be cleaned up by destroy_shader_infos()
-static void create_shader_infos(const VkDevice device, VkPipelineShaderStageCreateInfo infos[2])
+/*
+* renderer->layout_cache should be cleaned up by destroy_layout_cache()
+* renderer->basic_program should be cleaned up by destroy_shader_program()
+* renderer->pipeline_cache should be cleaned up by destroy_pipeline_cache()
+*/
+static void create_shader_programs(struct Renderer *renderer)
 {
-    const char *paths[2] = { 
-        "../include/shader/basic_vs.spv",
-        "../include/shader/basic_fs.spv" 
+    char basic_paths[SHADER_STAGE_COUNT][SHADER_PATH_MAX];
+    char sprite_paths[SHADER_STAGE_COUNT][SHADER_PATH_MAX];
+    const char *const paths[SHADER_STAGE_COUNT] = {basic_paths[0], basic_paths[1]};
+    const char *const names[SHADER_STAGE_COUNT] = {
+        "shader/basic_vs",
+        "shader/basic_fs"
     };
 
-    const VkShaderStageFlagBits stages[2] = {
-        VK_SHADER_STAGE_VERTEX_BIT,
-        VK_SHADER_STAGE_FRAGMENT_BIT
+    const char *const sprite_stage_paths[SHADER_STAGE_COUNT] = {
+        sprite_paths[0], sprite_paths[1]
     };
+    const char *const sprite_names[SHADER_STAGE_COUNT] = {
+        "shader/sprite_vs",
+        "shader/sprite_fs"
+    };
+
+    create_layout_cache(&renderer->layout_cache);
 
-    for (uint32_t i = 0; i < 2; ++i) {
-        size_t code_size = 0;
-        uint32_t *code = get_shader_code(paths[i], &code_size);
-        VkShaderModuleCreateInfo mdlinfo = {};
-        mdlinfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        mdlinfo.codeSize = code_size;
-        mdlinfo.pCode = code;
+    if (renderer->pack.data != NULL) {
+        create_shader_program_from_pack(renderer->device, &renderer->layout_cache,
+            &renderer->pack, names, SHADER_FEATURE_OVERDRAW, &renderer->basic_program);
+        renderer->sprites_enabled = find_pack_entry(&renderer->pack, sprite_names[0]) != NULL &&
+            find_pack_entry(&renderer->pack, sprite_names[1]) != NULL;
 
-        infos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        infos[i].flags = 0;
-        infos[i].pName = "main";
-        infos[i].pNext = NULL;
-        infos[i].pSpecializationInfo = NULL;
-        infos[i].stage = stages[i];
-        assert_vulkan(vkCreateShaderModule(device, &mdlinfo, NULL, &infos[i].module),
-            "Failed to create a Vulkan shader module!");
-        free(code);
+        if (renderer->sprites_enabled)
+            create_shader_program_from_pack(renderer->device, &renderer->layout_cache,
+                &renderer->pack, sprite_names, SHADER_FEATURE_OVERDRAW,
+                &renderer->sprite_program);
+    } else {
+        // A missing basic binary fails to load with its path in the message
+        find_shader_binary("basic_vs", basic_paths[0]);
+        find_shader_binary("basic_fs", basic_paths[1]);
+        create_shader_program(renderer->device, &renderer->layout_cache, paths,
+            SHADER_FEATURE_OVERDRAW, &renderer->basic_program);
+        renderer->sprites_enabled = find_shader_binary("sprite_vs", sprite_paths[0]) &&
+            find_shader_binary("sprite_fs", sprite_paths[1]);
+
+        if (renderer->sprites_enabled)
+            create_shader_program(renderer->device, &renderer->layout_cache,
+                sprite_stage_paths, SHADER_FEATURE_OVERDRAW, &renderer->sprite_program);
     }
+
+    if (!renderer->sprites_enabled)
+        printf("Sprites: disabled, the sprite shaders are missing\n");
+
+    create_pipeline_cache(renderer->device, &renderer->pipeline_cache);
 }
 
-static void destroy_shader_infos(const VkDevice device,
-    VkPipelineShaderStageCreateInfo infos[2])
-{    
-    vkDestroyShaderModule(device, infos[0].module, NULL);
-    vkDestroyShaderModule(device, infos[1].module, NULL);    
+static void record_culling(VkCommandBuffer buffer, void *user_data)
+{
+    const struct Renderer *renderer = user_data;
+
+    record_sprite_culling(&renderer->culler, buffer, renderer->frame);
 }
 
-/* 
-* renderer->pipeline_layout should be cleaned up by vkDestroyPipelineLayout()
-* renderer->graphics_pipeline should be cleaned up by vkDestroyGraphicsPipeline()
-*/
-static void create_graphics_pipeline(struct Renderer *renderer)
+/*
+ * Culling is optional, without sprite_cull_cs or indirect draws sprites are
+ * drawn directly. Needs the compute scheduler and the sprite shaders.
+ * renderer->culler should be cleaned up by destroy_sprite_culler() when
+ * renderer->sprite_culling is set
+ */
+static void create_sprite_culling(const struct RendererSettings *settings,
+    struct Renderer *renderer)
 {
-    VkPipelineLayoutCreateInfo lytinfo = {};
-    lytinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    char path[SHADER_PATH_MAX];
+    const int packed = renderer->pack.data != NULL;
+    const struct PackEntry *entry = packed ?
+        find_pack_entry(&renderer->pack, "shader/sprite_cull_cs") : NULL;
+    const uint32_t *code = NULL;
+    uint32_t *file_code = NULL;
+    size_t code_size = 0;
+
+    renderer->sprite_culling = 0;
+
+    if (!settings->sprite_culling || !renderer->sprites_enabled ||
+        !renderer->indirect_draws_enabled) {
+        printf("Sprite culling: off\n");
+        return;
+    }
 
-    assert_vulkan(vkCreatePipelineLayout(renderer->device, &lytinfo, NULL,
-            &renderer->pipeline_layout),
-            "Failed to create a Vulkan pipeline layout!");
+    if (entry != NULL && entry->type == PACK_ENTRY_SHADER) {
+        code = (const uint32_t *)get_pack_payload(&renderer->pack, entry);
+        code_size = entry->size;
+    } else if (!packed && find_shader_binary("sprite_cull_cs", path)) {
+        file_code = get_shader_code(path, &code_size);
+        code = file_code;
+    }
 
-    VkPipelineColorBlendAttachmentState blndattach_state = {};
-    blndattach_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    if (code == NULL) {
+        printf("Sprite culling: off, sprite_cull_cs is missing\n");
+        return;
+    }
 
-    VkPipelineColorBlendStateCreateInfo blndinfo = {};
-    blndinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    blndinfo.attachmentCount = 1;
-    blndinfo.pAttachments = &blndattach_state;
+    create_sprite_culler(renderer->device, renderer->gpu, code, code_size, &renderer->culler);
+    free(file_code);
 
-    VkPipelineInputAssemblyStateCreateInfo inptassembly_info = {};
-    inptassembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inptassembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    struct ComputePass pass = {};
+    pass.name = "sprite culling";
+    pass.queue = COMPUTE_QUEUE_ASYNC;
+    pass.record = record_culling;
+    pass.user_data = renderer;
+    pass.dst_stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    pass.dst_access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
 
-    VkPipelineRasterizationStateCreateInfo rstrinfo = {};
-    rstrinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rstrinfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rstrinfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rstrinfo.lineWidth = 1.0f;
-    rstrinfo.polygonMode = VK_POLYGON_MODE_FILL;
+    renderer->cull_pass = add_compute_pass(&renderer->compute, &pass);
+    renderer->sprite_culling = 1;
 
-    VkPipelineMultisampleStateCreateInfo mltsample_info = {};
-    mltsample_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    mltsample_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    printf("Sprite culling: on the %s queue\n",
+        renderer->compute.async ? "async compute" : "graphics");
+}
 
-    uint32_t shdrcount = 2;
-    VkPipelineShaderStageCreateInfo shdrinfos[shdrcount];
-    create_shader_infos(renderer->device, shdrinfos);
+/*
+ * Needs the asset pack, whose shaders are the only ones the backdrop is
+ * loaded from. renderer->backdrop and renderer->backdrop_program should be
+ * cleaned up by destroy_renderer_backdrop()
+ */
+static void create_renderer_backdrop(const struct RendererSettings *settings,
+    struct Renderer *renderer)
+{
+    const char *names[SHADER_STAGE_COUNT] = {
+        "shader/backdrop_vs",
+        "shader/backdrop_fs"
+    };
 
-    VkPipelineVertexInputStateCreateInfo vrtinput_info = {};
-    vrtinput_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    
-    VkRect2D scissor = {};
-    scissor.extent.height = renderer->extent.height;
-    scissor.extent.width = renderer->extent.width;
+    renderer->backdrop_enabled = 0;
+    renderer->backdrop_virtual = 0;
 
-    VkViewport viewport= {};
-    viewport.height = renderer->extent.height;
-    viewport.width = renderer->extent.width;
-    viewport.maxDepth = 1.0f;
+    if (settings->backdrop == NULL)
+        return;
 
-    VkPipelineViewportStateCreateInfo vwprtinfo = {};
-    vwprtinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    vwprtinfo.pScissors = &scissor;
-    vwprtinfo.pViewports = &viewport;
-    vwprtinfo.scissorCount = 1;
-    vwprtinfo.viewportCount = 1;
-
-    VkGraphicsPipelineCreateInfo info = {};
-    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    info.layout = renderer->pipeline_layout;
-    info.pColorBlendState = &blndinfo;
-    info.pInputAssemblyState = &inptassembly_info;
-    info.pRasterizationState = &rstrinfo;
-    info.pMultisampleState = &mltsample_info;
-    info.pStages = shdrinfos;
-    info.pVertexInputState = &vrtinput_info;
-    info.pViewportState = &vwprtinfo;
-    info.renderPass = renderer->render_pass;
-    info.stageCount = shdrcount;
-    info.subpass = 0;
-
-    assert_vulkan(vkCreateGraphicsPipelines(renderer->device, NULL, 1, &info, NULL,
-        &renderer->graphics_pipeline), "Failed to create a Vulkan graphics pipeline!");
-
-    vkDestroyShaderModule(renderer->device, shdrinfos[0].module, NULL);
-    vkDestroyShaderModule(renderer->device, shdrinfos[1].module, NULL);
-}
-
-// renderer->command_buffers should be cleaned up by destroy_command_buffers
-static void create_command_buffers(struct Renderer *renderer)
-{
-    renderer->command_buffers = malloc(renderer->image_count * sizeof(VkCommandBuffer));
-    VkCommandBufferAllocateInfo info = {};
-    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    info.commandBufferCount = renderer->image_count;
-    info.commandPool = renderer->command_pool;
-    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    
-    assert_vulkan(vkAllocateCommandBuffers(renderer->device, &info, renderer->command_buffers),
-        "Failed to allocate Vulkan command buffers!");
-}
+    const struct PackEntry *entry = renderer->pack.data != NULL ?
+        find_pack_entry(&renderer->pack, settings->backdrop) : NULL;
 
-static void destroy_command_buffers(struct Renderer *renderer)
-{
-    vkFreeCommandBuffers(renderer->device, renderer->command_pool, renderer->image_count,
-        renderer->command_buffers);
-    free(renderer->command_buffers);
-}
+    if (entry == NULL) {
+        printf("Failed to create backdrop %s, it is not in the asset pack\n", settings->backdrop);
+        exit(-1);
+    }
 
-// renderer->framebuffers should be cleaned up by destroy_framebuffers()
-static void create_framebuffers(struct Renderer *renderer)
-{
-    renderer->framebuffers = malloc(renderer->image_count * sizeof(VkFramebuffer));
-    
-    for (uint32_t i = 0; i < renderer->image_count; ++i) {
-        VkFramebufferCreateInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        info.attachmentCount = 1;
-        info.height = renderer->extent.height;
-        info.width = renderer->extent.width;
-        info.layers = 1;
-        info.pAttachments = &renderer->image_views[i];
-        info.renderPass = renderer->render_pass;
+    if (find_pack_entry(&renderer->pack, names[0]) == NULL ||
+        find_pack_entry(&renderer->pack, names[1]) == NULL) {
+        printf("Backdrop: disabled, the backdrop shaders are missing\n");
+        return;
+    }
 
-        assert_vulkan(vkCreateFramebuffer(renderer->device, &info, NULL,
-            &renderer->framebuffers[i]), "Failed to create a Vulkan framebuffer!");
+    // Falls back to streaming by detail level when the virtual shader or device support is missing
+    if (settings->virtual_backdrop) {
+        if (find_pack_entry(&renderer->pack, "shader/backdrop_virtual_fs") == NULL)
+            printf("Backdrop: not virtual, the virtual backdrop shader is missing\n");
+        else if (create_renderer_virtual_texture(renderer, settings->backdrop,
+            &renderer->backdrop_texture)) {
+            names[1] = "shader/backdrop_virtual_fs";
+            renderer->backdrop_virtual = 1;
+        }
     }
+
+    create_shader_program_from_pack(renderer->device, &renderer->layout_cache, &renderer->pack,
+        names, SHADER_FEATURE_OVERDRAW, &renderer->backdrop_program);
+
+    if (renderer->backdrop_virtual)
+        create_virtual_backdrop(&renderer->backdrop_texture,
+            renderer->backdrop_program.set_layouts[0], &renderer->backdrop);
+    else
+        create_backdrop(&renderer->uploader, &renderer->pack, entry,
+            renderer->backdrop_program.set_layouts[0], &renderer->backdrop);
+
+    flush_uploads(&renderer->uploader);
+    renderer->backdrop_enabled = 1;
 }
 
-static void destroy_framebuffers(struct Renderer *renderer)
+static void destroy_renderer_backdrop(struct Renderer *renderer)
 {
-    for (uint32_t i = 0; i < renderer->image_count; ++i)
-        vkDestroyFramebuffer(renderer->device, renderer->framebuffers[i], NULL);
+    if (renderer->backdrop_enabled) {
+        destroy_backdrop(&renderer->uploader, &renderer->backdrop);
+        destroy_shader_program(renderer->device, &renderer->backdrop_program);
+    }
 
-    free(renderer->framebuffers);
+    if (renderer->backdrop_virtual)
+        destroy_renderer_virtual_texture(renderer, &renderer->backdrop_texture);
 }
 
-static void record_command_buffers(struct Renderer *renderer) 
+/*
+ * renderer->graphics_pipeline is owned by renderer->pipeline_cache. The
+ * overdraw heatmap swaps the scene pipelines for additive permutations.
+ */
+static void create_graphics_pipeline(struct Renderer *renderer)
 {
-    for (uint32_t i = 0; i < renderer->image_count; ++i) {
-        VkCommandBufferBeginInfo bgninfo = {};
-        bgninfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        
-        const VkCommandBuffer buffer = renderer->command_buffers[i];
-
-        assert_vulkan(vkBeginCommandBuffer(buffer, &bgninfo),
-            "Failed to begin a Vulkan command buffer!");
-
-        VkClearValue clear = {0.0f, 0.0f, 0.0f, 1.0f};
-        VkRenderPassBeginInfo rndrbegin = {};
-        rndrbegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        rndrbegin.clearValueCount = 1;
-        rndrbegin.framebuffer = renderer->framebuffers[i];
-        rndrbegin.pClearValues = &clear;
-        rndrbegin.renderArea.extent = renderer->extent;
-        rndrbegin.renderArea.offset.x = 0;
-        rndrbegin.renderArea.offset.y = 0;
-        rndrbegin.renderPass = renderer->render_pass;
-
-        vkCmdBeginRenderPass(buffer, &rndrbegin, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->graphics_pipeline);
-        vkCmdDraw(buffer, 3, 1, 0, 0);
-        vkCmdEndRenderPass(buffer);
-        assert_vulkan(vkEndCommandBuffer(buffer), "Failed to end a Vulkan command buffer!");
-    }
-}
-
-// Should be cleaned up by destroy_sync_objects()
-static void create_sync_objects(struct Renderer *renderer)
-{      
-    renderer->fences = malloc(renderer->image_count * sizeof(VkFence));
+    const uint32_t permutation = renderer->overdraw ? SHADER_FEATURE_OVERDRAW : 0;
+
+    struct PipelineState state = {};
+    state.render_pass = renderer->render_pass;
+    state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    state.cull_mode = VK_CULL_MODE_BACK_BIT;
+    state.samples = renderer->samples;
+    state.blend_mode = renderer->overdraw ? BLEND_MODE_ADDITIVE : BLEND_MODE_OPAQUE;
+
+    renderer->graphics_pipeline = get_pipeline(renderer->device, &renderer->pipeline_cache,
+        &renderer->basic_program, &state, permutation);
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_PIPELINE,
+        (uint64_t)renderer->graphics_pipeline, "triangle pipeline%s",
+        renderer->overdraw ? " overdraw" : "");
+
+    state.cull_mode = VK_CULL_MODE_NONE;
+
+    if (renderer->backdrop_enabled) {
+        renderer->backdrop_pipeline = get_pipeline(renderer->device, &renderer->pipeline_cache,
+            &renderer->backdrop_program, &state, permutation);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_PIPELINE,
+            (uint64_t)renderer->backdrop_pipeline, "backdrop pipeline%s",
+            renderer->overdraw ? " overdraw" : "");
+    }
 
-    VkSemaphoreCreateInfo seminfo = {};
-    seminfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (!renderer->sprites_enabled)
+        return;
 
-    assert_vulkan(vkCreateSemaphore(renderer->device, &seminfo, NULL,
-        &renderer->rendered_semaphore), "Failed to create a Vulkan image acquired semaphore!");
-    assert_vulkan(vkCreateSemaphore(renderer->device, &seminfo, NULL,
-        &renderer->presented_semaphore), "Failed to create a Vulkan render finished semaphore!");
+    state.blend_mode = renderer->overdraw ? BLEND_MODE_ADDITIVE : BLEND_MODE_ALPHA;
+    state.input_rate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
-    VkFenceCreateInfo feninfo = {};
-    feninfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    feninfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    
-    for (uint32_t i = 0; i < renderer->image_count; ++i)
-        assert_vulkan(vkCreateFence(renderer->device, &feninfo, NULL, &renderer->fences[i]), 
-            "Failed to create a Vulkan fence!");
-}
+    renderer->sprite_pipeline = get_pipeline(renderer->device, &renderer->pipeline_cache,
+        &renderer->sprite_program, &state, permutation);
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_PIPELINE,
+        (uint64_t)renderer->sprite_pipeline, "sprite pipeline%s",
+        renderer->overdraw ? " overdraw" : "");
 
-static void destroy_sync_objects(struct Renderer *renderer)
+    // The overlay draws after the resolve, on the single sampled image
+    state.render_pass = renderer->overlay_render_pass;
+    state.samples = VK_SAMPLE_COUNT_1_BIT;
+    state.blend_mode = BLEND_MODE_ALPHA;
+
+    renderer->overlay_pipeline = get_pipeline(renderer->device, &renderer->pipeline_cache,
+        &renderer->sprite_program, &state, 0);
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_PIPELINE,
+        (uint64_t)renderer->overlay_pipeline, "overlay pipeline");
+}
+
+void set_renderer_overdraw(struct Renderer *renderer, int overdraw)
+{
+    if (renderer->overdraw == overdraw)
+        return;
+
+    // Frames in flight keep using the old pipelines, the cache owns both
+    renderer->overdraw = overdraw;
+    create_graphics_pipeline(renderer);
+    invalidate_draw_passes(&renderer->draw_passes);
+    add_full_damage(&renderer->damage);
+}
+
+// Allocated from renderer->swapchain_arena
+static void create_image_fences(struct Renderer *renderer)
+{
+    renderer->image_fences = ALLOCATE_ARRAY(&renderer->swapchain_arena, VkFence,
+        renderer->image_count);
+    memset(renderer->image_fences, 0, renderer->image_count * sizeof(VkFence));
+}
+
+// New images hold nothing yet, allocated from renderer->swapchain_arena
+static void create_image_damage(struct Renderer *renderer)
 {
-    vkDestroySemaphore(renderer->device, renderer->rendered_semaphore, NULL);
-    vkDestroySemaphore(renderer->device, renderer->presented_semaphore, NULL);
+    renderer->image_damage = ALLOCATE_ARRAY(&renderer->swapchain_arena, struct DamageRegion,
+        renderer->image_count);
 
     for (uint32_t i = 0; i < renderer->image_count; ++i)
-        vkDestroyFence(renderer->device, renderer->fences[i], NULL);
+        add_full_damage(&renderer->image_damage[i]);
+
+    add_full_damage(&renderer->damage);
+}
+
+// Rounds up so the largest scene extent always fits the target
+static uint32_t get_scaled_size(uint32_t size, double scale)
+{
+    const uint32_t scaled = (uint32_t)(size * scale + 0.999);
+
+    return scaled > 0 ? scaled : 1;
+}
+
+// Extent of the images the main pass renders to, the largest scene extent
+static VkExtent2D get_target_extent(const struct Renderer *renderer)
+{
+    if (!renderer->dynamic_resolution)
+        return renderer->extent;
+
+    VkExtent2D extent;
+    extent.width = get_scaled_size(renderer->extent.width, renderer->resolution.max_scale);
+    extent.height = get_scaled_size(renderer->extent.height, renderer->resolution.max_scale);
+
+    return extent;
+}
+
+/*
+ * One target shared by every frame in flight, the render pass resolves it
+ * before the next frame clears it. renderer->msaa_target should be cleaned up
+ * by destroy_msaa_target()
+ */
+static void create_msaa_target(struct Renderer *renderer)
+{
+    if (renderer->samples == VK_SAMPLE_COUNT_1_BIT)
+        return;
+
+    create_transient_texture(renderer->device, renderer->gpu, renderer->surface_format.format,
+        get_target_extent(renderer), renderer->samples, &renderer->msaa_target);
+    set_debug_name(renderer->device, VK_OBJECT_TYPE_IMAGE,
+        (uint64_t)renderer->msaa_target.image, "msaa target %ux", renderer->samples);
+}
+
+static void destroy_msaa_target(struct Renderer *renderer)
+{
+    if (renderer->samples != VK_SAMPLE_COUNT_1_BIT)
+        destroy_texture(renderer->device, &renderer->msaa_target);
+}
+
+// view is the single sampled output, with multisampled the MSAA target resolves into it
+static VkFramebuffer create_framebuffer(struct Renderer *renderer, VkRenderPass render_pass,
+    VkImageView view, VkExtent2D extent, int multisampled)
+{
+    const VkImageView views[2] = {view,
+        multisampled ? renderer->msaa_target.view : VK_NULL_HANDLE};
+
+    VkFramebufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    info.attachmentCount = multisampled ? 2 : 1;
+    info.height = extent.height;
+    info.width = extent.width;
+    info.layers = 1;
+    info.pAttachments = views;
+    info.renderPass = render_pass;
+
+    VkFramebuffer framebuffer;
+    assert_vulkan(vkCreateFramebuffer(renderer->device, &info, NULL, &framebuffer),
+        "Failed to create a Vulkan framebuffer!");
+
+    return framebuffer;
+}
+
+/*
+ * renderer->framebuffers hold the swapchain image alone, for the overlay and
+ * for the main pass when it renders straight to the swapchain without MSAA.
+ * renderer->framebuffers and renderer->msaa_framebuffers should be cleaned up
+ * by destroy_framebuffers(), allocated from renderer->swapchain_arena
+ */
+static void create_framebuffers(struct Renderer *renderer)
+{
+    const int multisampled = renderer->samples != VK_SAMPLE_COUNT_1_BIT &&
+        !renderer->dynamic_resolution;
+
+    renderer->framebuffers = ALLOCATE_ARRAY(&renderer->swapchain_arena, VkFramebuffer,
+        renderer->image_count);
+    renderer->msaa_framebuffers = multisampled ? ALLOCATE_ARRAY(&renderer->swapchain_arena,
+        VkFramebuffer, renderer->image_count) : NULL;
+
+    for (uint32_t i = 0; i < renderer->image_count; ++i) {
+        renderer->framebuffers[i] = create_framebuffer(renderer, renderer->overlay_render_pass,
+            renderer->image_views[i], renderer->extent, 0);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_FRAMEBUFFER,
+            (uint64_t)renderer->framebuffers[i], "framebuffer %u", i);
+
+        if (!multisampled)
+            continue;
+
+        renderer->msaa_framebuffers[i] = create_framebuffer(renderer, renderer->render_pass,
+            renderer->image_views[i], renderer->extent, 1);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_FRAMEBUFFER,
+            (uint64_t)renderer->msaa_framebuffers[i], "msaa framebuffer %u", i);
+    }
+}
+
+static void destroy_framebuffers(struct Renderer *renderer)
+{
+    for (uint32_t i = 0; i < renderer->image_count; ++i) {
+        vkDestroyFramebuffer(renderer->device, renderer->framebuffers[i], NULL);
+
+        if (renderer->msaa_framebuffers != NULL)
+            vkDestroyFramebuffer(renderer->device, renderer->msaa_framebuffers[i], NULL);
+    }
+}
+
+static void update_scene_extent(struct Renderer *renderer)
+{
+    if (!renderer->dynamic_resolution) {
+        renderer->scene_extent = renderer->extent;
+        return;
+    }
+
+    renderer->scene_extent.width = get_scaled_size(renderer->extent.width,
+        renderer->resolution.scale);
+    renderer->scene_extent.height = get_scaled_size(renderer->extent.height,
+        renderer->resolution.scale);
+}
+
+/*
+ * One target per frame in flight so a frame never renders over the target
+ * the previous frame still blits from. renderer->scene_targets and
+ * renderer->scene_framebuffers should be cleaned up by destroy_scene_targets()
+ */
+static void create_scene_targets(struct Renderer *renderer)
+{
+    update_scene_extent(renderer);
+
+    if (!renderer->dynamic_resolution)
+        return;
+
+    const VkExtent2D extent = get_target_extent(renderer);
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        struct Texture *target = &renderer->scene_targets[i];
+        create_texture(renderer->device, renderer->gpu, renderer->surface_format.format,
+            extent, 1, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            target);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_IMAGE, (uint64_t)target->image,
+            "scene target %u", i);
+
+        renderer->scene_framebuffers[i] = create_framebuffer(renderer, renderer->render_pass,
+            target->view, extent, renderer->samples != VK_SAMPLE_COUNT_1_BIT);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_FRAMEBUFFER,
+            (uint64_t)renderer->scene_framebuffers[i], "scene framebuffer %u", i);
+    }
+}
+
+static void destroy_scene_targets(struct Renderer *renderer)
+{
+    if (!renderer->dynamic_resolution)
+        return;
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        vkDestroyFramebuffer(renderer->device, renderer->scene_framebuffers[i], NULL);
+        destroy_texture(renderer->device, &renderer->scene_targets[i]);
+    }
+}
+
+// Framebuffer the main pass of the current frame renders to
+static VkFramebuffer get_scene_framebuffer(const struct Renderer *renderer, uint32_t img)
+{
+    if (renderer->dynamic_resolution)
+        return renderer->scene_framebuffers[renderer->frame];
+    if (renderer->msaa_framebuffers != NULL)
+        return renderer->msaa_framebuffers[img];
+
+    return renderer->framebuffers[img];
+}
+
+// The backdrop streams new levels in, so the pass is recorded every frame
+static void draw_backdrop(VkCommandBuffer buffer, struct DrawCounters *counters, void *user_data)
+{
+    const struct Renderer *renderer = user_data;
+
+    if (!renderer->backdrop_enabled)
+        return;
+
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->backdrop_pipeline);
+    record_backdrop(&renderer->backdrop, buffer, renderer->backdrop_program.layout,
+        renderer->extent, renderer->frame);
+    ++counters->pipeline_binds;
+    ++counters->draws;
+    ++counters->instances;
+}
+
+static void draw_triangle(VkCommandBuffer buffer, struct DrawCounters *counters, void *user_data)
+{
+    const struct Renderer *renderer = user_data;
+
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->graphics_pipeline);
+    vkCmdDraw(buffer, 3, 1, 0, 0);
+    ++counters->pipeline_binds;
+    ++counters->draws;
+    ++counters->instances;
+}
 
-    free(renderer->fences);
+// Instances come from set_renderer_sprites(), so the pass is recorded every frame
+static void draw_sprites(VkCommandBuffer buffer, struct DrawCounters *counters, void *user_data)
+{
+    const struct Renderer *renderer = user_data;
+    const struct Frame *frame = &renderer->frames[renderer->frame];
+
+    if (frame->instance_count == 0)
+        return;
+
+    const float scale[2] = {2.0f / renderer->extent.width, 2.0f / renderer->extent.height};
+    const VkDeviceSize offset = 0;
+
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->sprite_pipeline);
+    vkCmdPushConstants(buffer, renderer->sprite_program.layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+        sizeof(scale), scale);
+
+    if (frame->culled) {
+        record_culled_sprites(&renderer->culler, buffer, renderer->frame);
+    } else {
+        vkCmdBindVertexBuffers(buffer, 0, 1, &frame->instances.buffer, &offset);
+        vkCmdDraw(buffer, 6, frame->instance_count, 0, 0);
+    }
+
+    ++counters->pipeline_binds;
+    ++counters->draws;
+    counters->instances += frame->instance_count;
 }
 
-struct Renderer *create_renderer()
+// renderer->draw_passes should be cleaned up by destroy_draw_pass_list()
+static void create_draw_passes(const struct RendererSettings *settings,
+    struct Renderer *renderer)
+{
+    create_draw_pass_list(renderer->device, renderer->queue_families.graphics,
+        &renderer->draw_passes);
+
+    if (renderer->statistics.pool != VK_NULL_HANDLE)
+        renderer->draw_passes.statistics = &renderer->statistics;
+
+    // Added before the backdrop is loaded so it draws first, skipped if it fails to load
+    if (settings->backdrop != NULL) {
+        struct DrawPass backdrop = {};
+        backdrop.name = "backdrop";
+        backdrop.record = draw_backdrop;
+        backdrop.user_data = renderer;
+
+        add_draw_pass(renderer->device, &renderer->draw_passes, &backdrop);
+    }
+
+    struct DrawPass triangle = {};
+    triangle.name = "triangle";
+    triangle.record = draw_triangle;
+    triangle.user_data = renderer;
+    triangle.cached = 1;
+
+    add_draw_pass(renderer->device, &renderer->draw_passes, &triangle);
+
+    struct DrawPass sprites = {};
+    sprites.name = "sprites";
+    sprites.record = draw_sprites;
+    sprites.user_data = renderer;
+
+    add_draw_pass(renderer->device, &renderer->draw_passes, &sprites);
+}
+
+void get_default_renderer_settings(struct RendererSettings *settings)
+{
+    settings->gpu = NULL;
+    settings->async_compute = 1;
+    settings->sprite_culling = 1;
+    settings->present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    settings->target_frame_time = 0.0;
+    settings->print_stats = 0;
+    settings->low_latency = 0;
+    settings->asset_pack = NULL;
+    settings->virtual_texture_budget = DEFAULT_VIRTUAL_TEXTURE_BUDGET;
+    settings->backdrop = NULL;
+    settings->virtual_backdrop = 0;
+    settings->tick_rate = DEFAULT_TICK_RATE;
+    settings->max_ticks_per_frame = DEFAULT_MAX_TICKS_PER_FRAME;
+    settings->overlay = 0;
+    settings->memory_pressure_threshold = DEFAULT_MEMORY_PRESSURE_THRESHOLD;
+    settings->verbose_validation = 0;
+    settings->pipeline_statistics = 0;
+    settings->overdraw = 0;
+    settings->dynamic_resolution = 0;
+    settings->min_resolution_scale = DEFAULT_MIN_RESOLUTION_SCALE;
+    settings->max_resolution_scale = DEFAULT_MAX_RESOLUTION_SCALE;
+    settings->target_gpu_time = 0.0;
+    settings->msaa_samples = 1;
+    settings->damage_tracking = 0;
+}
+
+// Seconds between frames the pacer aims for
+static double get_frame_period(const struct Renderer *renderer)
+{
+    if (renderer->pacer.target > 0.0)
+        return renderer->pacer.target;
+
+    return renderer->pacer.refresh_period > 0.0 ? renderer->pacer.refresh_period :
+        FALLBACK_FRAME_PERIOD;
+}
+
+// renderer->pacer is paced against the primary monitor's refresh rate
+static void create_pacer(const struct RendererSettings *settings, struct Renderer *renderer)
+{
+    double refresh_period = 0.0;
+    GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode *mode = monitor != NULL ? glfwGetVideoMode(monitor) : NULL;
+
+    if (mode != NULL && mode->refreshRate > 0)
+        refresh_period = 1.0 / mode->refreshRate;
+
+    PFN_vkWaitForPresentKHR wait = NULL;
+
+    if (renderer->present_wait_enabled)
+        wait = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(renderer->device,
+            "vkWaitForPresentKHR");
+
+    create_frame_pacer(settings->target_frame_time, refresh_period, wait, settings->low_latency,
+        &renderer->pacer);
+    renderer->update = NULL;
+    renderer->update_data = NULL;
+    renderer->tick = NULL;
+    renderer->tick_data = NULL;
+    renderer->print_stats = settings->print_stats;
+    renderer->low_latency = settings->low_latency;
+    renderer->stats_time = glfwGetTime();
+    renderer->update_time = renderer->stats_time;
+    renderer->stats_frames = 0;
+    create_fixed_timestep(settings->tick_rate, settings->max_ticks_per_frame,
+        &renderer->timestep);
+    create_overlay(settings->overlay, &renderer->overlay);
+    renderer->overdraw = settings->overdraw;
+    renderer->dynamic_resolution = settings->dynamic_resolution;
+
+    create_resolution_scale(settings->target_gpu_time > 0.0 ? settings->target_gpu_time :
+        get_frame_period(renderer) * DEFAULT_GPU_TIME_BUDGET, settings->min_resolution_scale,
+        settings->max_resolution_scale, &renderer->resolution);
+    renderer->damage_tracking = settings->damage_tracking;
+    clear_damage(&renderer->damage);
+    memset(&renderer->drawn_sprites, 0, sizeof(renderer->drawn_sprites));
+    memset(&renderer->overlay_bounds, 0, sizeof(renderer->overlay_bounds));
+    renderer->skipped_frames = 0;
+    renderer->redraw_share = 1.0;
+    memset(&renderer->counters, 0, sizeof(renderer->counters));
+    renderer->fence_wait = 0.0;
+    renderer->acquire_wait = 0.0;
+    renderer->uploaded_bytes = 0;
+}
+
+struct Renderer *create_renderer(const struct RendererSettings *settings)
 {
     struct Renderer *renderer = malloc(sizeof(struct Renderer));
+    create_arena("scratch", SCRATCH_ARENA_SIZE, &renderer->scratch);
+    create_arena("swapchain", SWAPCHAIN_ARENA_SIZE, &renderer->swapchain_arena);
     create_window(renderer);
+    create_window_callbacks(renderer);
     create_instance(renderer);
 #ifndef NDEBUG
-    create_debug_messenger(renderer);
+    load_debug_functions(renderer->instance);
+    create_debug_messenger(renderer->instance, settings->verbose_validation,
+        &renderer->debug_messenger);
 #endif
     create_surface(renderer);  
 
     const char *device_extensions[DEVICE_EXTENSION_COUNT];
     struct SwapchainDetails details;
-    select_gpu(renderer, device_extensions, &details);
+    renderer->preferred_present_mode = settings->present_mode;
+    select_gpu(renderer, settings->gpu, device_extensions, &details);
     create_device(device_extensions, &details, renderer);
-    create_command_pool(renderer);
+    select_sample_count(renderer, settings->msaa_samples);
+    create_memory_budget(renderer->gpu, renderer->memory_budget_enabled,
+        settings->memory_pressure_threshold, &renderer->memory_budget);
+    create_assets(settings, renderer);
+    create_frames(renderer);
+    create_gpu_timers(renderer->device, renderer->gpu, renderer->queue_families.graphics,
+        &renderer->timers);
+    create_pipeline_statistics(renderer->device,
+        settings->pipeline_statistics && renderer->statistics_supported, &renderer->statistics);
+    create_draw_passes(settings, renderer);
+    create_pacer(settings, renderer);
+    create_compute_scheduler(renderer->device, renderer->gpu, renderer->graphics_queue,
+        renderer->queue_families.graphics, renderer->compute_queue,
+        renderer->queue_families.compute, settings->async_compute, &renderer->compute);
+    renderer->added_compute_passes = 0;
     create_swapchain(DEFAULT_WIDTH, DEFAULT_HEIGHT, &details, renderer);
-    destroy_swapchain_details(&details);
+    // Releases details and everything else init allocated
+    reset_arena(&renderer->scratch, 0);
     create_image_views(renderer);
     create_render_pass(renderer);
+    create_overlay_render_pass(renderer);
+    create_shader_programs(renderer);
+    create_sprite_culling(settings, renderer);
+    create_renderer_backdrop(settings, renderer);
     create_graphics_pipeline(renderer);
-    create_command_buffers(renderer);
+    create_msaa_target(renderer);
     create_framebuffers(renderer);
-    record_command_buffers(renderer);
-    create_sync_objects(renderer);
+    create_scene_targets(renderer);
+    create_image_fences(renderer);
+    create_image_damage(renderer);
 
     return renderer;
 }
 
 static void destroy_swapchain_objects(struct Renderer *renderer)
 {
+    destroy_scene_targets(renderer);
     destroy_framebuffers(renderer);
-    destroy_command_buffers(renderer);
-    vkDestroyPipelineLayout(renderer->device, renderer->pipeline_layout, NULL);
-    vkDestroyPipeline(renderer->device, renderer->graphics_pipeline, NULL);
+    destroy_msaa_target(renderer);
+    // Cached pipelines reference the render pass that is about to be destroyed
+    clear_pipeline_cache(renderer->device, &renderer->pipeline_cache);
     vkDestroyRenderPass(renderer->device, renderer->render_pass, NULL);
+    vkDestroyRenderPass(renderer->device, renderer->overlay_render_pass, NULL);
     destroy_image_views(renderer);
     vkDestroySwapchainKHR(renderer->device, renderer->swapchain, NULL);
+    reset_arena(&renderer->swapchain_arena, 0);
 }
 
 static void recreate_swapchain_objects(struct Renderer *renderer)
@@ -839,64 +1979,854 @@ static void recreate_swapchain_objects(struct Renderer *renderer)
 
     vkDeviceWaitIdle(renderer->device);
     destroy_swapchain_objects(renderer);
+    reset_frame_pacer(&renderer->pacer);
 
+    const size_t mark = get_arena_mark(&renderer->scratch);
     struct SwapchainDetails details;
 
     if (!is_swapchain_details_complete(renderer, &details))
         print_exit("Failed to complete swapchain details!");
 
     create_swapchain(width, height, &details, renderer);
-    destroy_swapchain_details(&details);
+    reset_arena(&renderer->scratch, mark);
     create_image_views(renderer);
     create_render_pass(renderer);
+    create_overlay_render_pass(renderer);
     create_graphics_pipeline(renderer);
-    create_command_buffers(renderer);
+    create_msaa_target(renderer);
     create_framebuffers(renderer);
-    record_command_buffers(renderer);
+    create_scene_targets(renderer);
+    create_image_fences(renderer);
+    create_image_damage(renderer);
+    // Cached passes captured the old pipeline and extent
+    invalidate_draw_passes(&renderer->draw_passes);
+}
+
+void add_renderer_compute_pass(struct Renderer *renderer, const struct ComputePass *pass)
+{
+    add_compute_pass(&renderer->compute, pass);
+    ++renderer->added_compute_passes;
+}
+
+uint32_t add_renderer_draw_pass(struct Renderer *renderer, const struct DrawPass *pass)
+{
+    add_full_damage(&renderer->damage);
+
+    return add_draw_pass(renderer->device, &renderer->draw_passes, pass);
+}
+
+void invalidate_renderer_draw_pass(struct Renderer *renderer, uint32_t index)
+{
+    invalidate_draw_pass(&renderer->draw_passes, index);
+    add_full_damage(&renderer->damage);
+}
+
+void add_renderer_damage(struct Renderer *renderer, const VkRect2D *rect)
+{
+    if (rect == NULL)
+        add_full_damage(&renderer->damage);
+    else
+        add_damage(&renderer->damage, rect, renderer->extent);
+}
+
+void set_renderer_backdrop_view(struct Renderer *renderer, float x, float y, float zoom)
+{
+    if (renderer->backdrop_enabled && set_backdrop_view(&renderer->backdrop, x, y, zoom))
+        add_full_damage(&renderer->damage);
+}
+
+const struct AssetPack *get_renderer_pack(const struct Renderer *renderer)
+{
+    return renderer->pack.data != NULL ? &renderer->pack : NULL;
+}
+
+struct Uploader *get_renderer_uploader(struct Renderer *renderer)
+{
+    return &renderer->uploader;
+}
+
+int create_renderer_virtual_texture(struct Renderer *renderer, const char *name,
+    struct VirtualTexture *texture)
+{
+    if (!renderer->fragment_stores_enabled) {
+        printf("Virtual texture %s: not created, fragmentStoresAndAtomics is unsupported\n",
+            name);
+        return 0;
+    }
+
+    const struct PackEntry *entry = renderer->pack.data != NULL ?
+        find_pack_entry(&renderer->pack, name) : NULL;
+
+    if (entry == NULL) {
+        printf("Failed to create virtual texture %s, it is not in the asset pack\n", name);
+        exit(-1);
+    }
+
+    if (renderer->virtual_texture_count == VIRTUAL_TEXTURE_MAX)
+        print_exit("Failed to create a virtual texture, too many virtual textures!");
+
+    create_virtual_texture(&renderer->uploader, &renderer->pack, entry,
+        renderer->virtual_texture_budget, texture);
+    renderer->virtual_textures[renderer->virtual_texture_count++] = texture;
+
+    return 1;
+}
+
+void destroy_renderer_virtual_texture(struct Renderer *renderer, struct VirtualTexture *texture)
+{
+    // Frames in flight may still copy into or sample the cache
+    vkDeviceWaitIdle(renderer->device);
+
+    for (uint32_t i = 0; i < renderer->virtual_texture_count; ++i)
+        if (renderer->virtual_textures[i] == texture) {
+            renderer->virtual_textures[i] =
+                renderer->virtual_textures[--renderer->virtual_texture_count];
+            break;
+        }
+
+    destroy_virtual_texture(texture);
+}
+
+void set_renderer_update(struct Renderer *renderer, RendererUpdateFunc update, void *user_data)
+{
+    renderer->update = update;
+    renderer->update_data = user_data;
+}
+
+void set_renderer_tick(struct Renderer *renderer, RendererTickFunc tick, void *user_data)
+{
+    renderer->tick = tick;
+    renderer->tick_data = user_data;
+}
+
+// The frame's fence has been waited on, so its old buffer is no longer read
+static void write_instances(struct Renderer *renderer, const struct SpriteInstance *instances,
+    uint32_t count, const char *name, struct GpuBuffer *buffer)
+{
+    const VkDeviceSize size = (VkDeviceSize)count * sizeof(struct SpriteInstance);
+
+    if (size > buffer->size) {
+        VkDeviceSize capacity = buffer->size > 0 ? buffer->size : 4096;
+
+        while (capacity < size)
+            capacity *= 2;
+
+        if (buffer->buffer != VK_NULL_HANDLE)
+            destroy_buffer(renderer->device, buffer);
+
+        create_buffer(renderer->device, renderer->gpu, capacity,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer);
+        set_debug_name(renderer->device, VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer->buffer,
+            "frame %u %s", renderer->frame, name);
+    }
+
+    memcpy(buffer->mapped, instances, size);
+}
+
+// Bounding box of the rotated sprite, clipped to the extent
+static void add_sprite_damage(struct Renderer *renderer, const struct SpriteInstance *sprite)
+{
+    const float c = fabsf(cosf(sprite->rotation));
+    const float s = fabsf(sinf(sprite->rotation));
+    const float half_width = (sprite->size[0] * c + sprite->size[1] * s) * 0.5f +
+        SPRITE_DAMAGE_MARGIN;
+    const float half_height = (sprite->size[0] * s + sprite->size[1] * c) * 0.5f +
+        SPRITE_DAMAGE_MARGIN;
+    const float width = (float)renderer->extent.width;
+    const float height = (float)renderer->extent.height;
+
+    const float left = fmaxf(floorf(sprite->position[0] - half_width), 0.0f);
+    const float top = fmaxf(floorf(sprite->position[1] - half_height), 0.0f);
+    const float right = fminf(ceilf(sprite->position[0] + half_width), width);
+    const float bottom = fminf(ceilf(sprite->position[1] + half_height), height);
+
+    // Clipping first keeps the conversions below in range
+    if (!(left < right && top < bottom))
+        return;
+
+    VkRect2D rect;
+    rect.offset.x = (int32_t)left;
+    rect.offset.y = (int32_t)top;
+    rect.extent.width = (uint32_t)(right - left);
+    rect.extent.height = (uint32_t)(bottom - top);
+    add_damage(&renderer->damage, &rect, renderer->extent);
+}
+
+// Damages where sprites differ from the last call, both where they were and where they are
+static void diff_sprites(struct Renderer *renderer, const struct SpriteInstance *instances,
+    uint32_t count)
+{
+    struct SpriteBatch *drawn = &renderer->drawn_sprites;
+    const uint32_t common = count < drawn->count ? count : drawn->count;
+
+    for (uint32_t i = 0; i < common && !renderer->damage.full; ++i) {
+        if (memcmp(&instances[i], &drawn->instances[i], sizeof(struct SpriteInstance)) == 0)
+            continue;
+
+        add_sprite_damage(renderer, &drawn->instances[i]);
+        add_sprite_damage(renderer, &instances[i]);
+    }
+
+    for (uint32_t i = common; i < drawn->count && !renderer->damage.full; ++i)
+        add_sprite_damage(renderer, &drawn->instances[i]);
+    for (uint32_t i = common; i < count && !renderer->damage.full; ++i)
+        add_sprite_damage(renderer, &instances[i]);
+
+    if (count > drawn->capacity) {
+        while (count > drawn->capacity)
+            drawn->capacity = drawn->capacity > 0 ? drawn->capacity * 2 : 1024;
+
+        drawn->instances = realloc(drawn->instances,
+            drawn->capacity * sizeof(struct SpriteInstance));
+    }
+
+    if (count > 0)
+        memcpy(drawn->instances, instances, count * sizeof(struct SpriteInstance));
+
+    drawn->count = count;
+}
+
+void set_renderer_sprites(struct Renderer *renderer, const struct SpriteInstance *instances,
+    uint32_t count)
+{
+    struct Frame *frame = &renderer->frames[renderer->frame];
+
+    frame->instance_count = renderer->sprites_enabled ? count : 0;
+
+    if (renderer->damage_tracking)
+        diff_sprites(renderer, instances, frame->instance_count);
+
+    if (frame->instance_count > 0)
+        write_instances(renderer, instances, count, "instances", &frame->instances);
+
+    // Too many sprites for one indirect draw are drawn directly
+    if (renderer->sprite_culling)
+        frame->culled = set_culled_sprites(&renderer->culler, renderer->frame,
+            &frame->instances, frame->instance_count, renderer->extent) &&
+            frame->instance_count > 0;
+}
+
+struct Arena *get_renderer_frame_arena(struct Renderer *renderer)
+{
+    return &renderer->frames[renderer->frame].commands.scratch;
+}
+
+VkExtent2D get_renderer_extent(const struct Renderer *renderer)
+{
+    return renderer->extent;
+}
+
+static double get_fragments_per_pixel(const struct Renderer *renderer,
+    const struct PipelineCounts *counts)
+{
+    return (double)counts->fragment_invocations /
+        ((double)renderer->scene_extent.width * renderer->scene_extent.height);
+}
+
+void get_renderer_stats(const struct Renderer *renderer, struct RendererStats *stats)
+{
+    stats->frames = renderer->pacer.frames;
+    stats->missed_vsyncs = renderer->pacer.missed_vsyncs;
+    stats->cpu_time = renderer->pacer.cpu_time;
+    stats->present_mode = renderer->present_mode;
+    stats->present_wait = renderer->pacer.wait_for_present != NULL;
+    stats->input_to_submit = renderer->pacer.input_to_submit;
+    stats->input_to_present = renderer->pacer.input_to_present;
+    stats->gpu_draw_time = get_gpu_time(&renderer->timers, "draw");
+    stats->gpu_cull_time = renderer->sprite_culling ?
+        get_compute_time(&renderer->compute, "sprite culling") : 0.0;
+    stats->ticks = renderer->timestep.ticks;
+    stats->dropped_ticks = renderer->timestep.dropped_ticks;
+    stats->ticks_per_frame = renderer->timestep.ticks_per_frame;
+    stats->heap_count = renderer->memory_budget.heap_count;
+    stats->pressured_heaps = renderer->memory_budget.pressured_heaps;
+
+    for (uint32_t i = 0; i < stats->heap_count; ++i) {
+        stats->heap_usage[i] = renderer->memory_budget.usage[i];
+        stats->heap_budget[i] = renderer->memory_budget.budget[i];
+    }
+
+#ifndef NDEBUG
+    stats->performance_warnings = renderer->debug_messenger.frame_performance_warnings;
+#else
+    stats->performance_warnings = 0;
+#endif
+
+    struct PipelineCounts totals;
+    get_pipeline_totals(&renderer->statistics, &totals);
+    stats->vertex_invocations = totals.vertex_invocations;
+    stats->clipping_primitives = totals.clipping_primitives;
+    stats->fragment_invocations = totals.fragment_invocations;
+    stats->fragments_per_pixel = get_fragments_per_pixel(renderer, &totals);
+    stats->resolution_scale = renderer->dynamic_resolution ? renderer->resolution.scale : 1.0;
+    stats->scene_extent = renderer->scene_extent;
+    stats->resolution_changes = renderer->resolution.changes;
+    stats->msaa_samples = renderer->samples;
+    stats->skipped_frames = renderer->skipped_frames;
+    stats->redraw_share = renderer->redraw_share;
+    stats->incremental_present = renderer->incremental_present_enabled;
+}
+
+void add_renderer_memory_pressure_callback(struct Renderer *renderer, MemoryPressureFunc func,
+    void *user_data)
+{
+    add_memory_pressure_callback(&renderer->memory_budget, func, user_data);
+}
+
+static void update_stats(struct Renderer *renderer)
+{
+    const double now = glfwGetTime();
+
+    if (!renderer->print_stats || now - renderer->stats_time < STATS_INTERVAL)
+        return;
+
+    struct RendererStats stats;
+    get_renderer_stats(renderer, &stats);
+
+    const double elapsed = now - renderer->stats_time;
+    const double fps = (stats.frames - renderer->stats_frames) / elapsed;
+
+    printf("%.1f fps, cpu %.2f ms, gpu draw %.2f ms (%ux msaa), gpu cull %.2f ms, "
+        "missed vsyncs %llu, present mode %s%s, input to submit %.2f ms, "
+        "input to present %.2f ms, ticks per frame %.2f, dropped ticks %llu\n", fps,
+        stats.cpu_time * 1000.0, stats.gpu_draw_time * 1000.0, stats.msaa_samples,
+        stats.gpu_cull_time * 1000.0,
+        (unsigned long long)stats.missed_vsyncs, get_present_mode_name(stats.present_mode),
+        stats.present_wait ? ", present wait" : "", stats.input_to_submit * 1000.0,
+        stats.input_to_present * 1000.0, stats.ticks_per_frame,
+        (unsigned long long)stats.dropped_ticks);
+
+    printf("Memory:");
+
+    for (uint32_t i = 0; i < stats.heap_count; ++i)
+        printf(" heap %u %.1f / %.1f MiB%s%s", i, stats.heap_usage[i] / (1024.0 * 1024.0),
+            stats.heap_budget[i] / (1024.0 * 1024.0),
+            stats.pressured_heaps & (1u << i) ? " (pressure)" : "",
+            i + 1 < stats.heap_count ? "," : "");
+
+    printf("\n");
+
+    if (renderer->statistics.pool != VK_NULL_HANDLE) {
+        printf("Fill: %.2f fragments per pixel, %llu vertices, %llu primitives",
+            stats.fragments_per_pixel, (unsigned long long)stats.vertex_invocations,
+            (unsigned long long)stats.clipping_primitives);
+
+        for (uint32_t i = 0; i < renderer->statistics.count; ++i)
+            printf(", %s %.2f", renderer->draw_passes.entries[i].pass.name,
+                get_fragments_per_pixel(renderer, &renderer->statistics.counts[i]));
+
+        printf("\n");
+    }
+
+    if (renderer->damage_tracking)
+        printf("Damage: %llu skipped frames, last redraw %.1f%% of the frame%s\n",
+            (unsigned long long)stats.skipped_frames, stats.redraw_share * 100.0,
+            stats.incremental_present ? ", incremental present" : "");
+
+    if (renderer->dynamic_resolution)
+        printf("Resolution: scale %.2f, %ux%u of %ux%u, target %.2f ms, %llu changes\n",
+            stats.resolution_scale, stats.scene_extent.width, stats.scene_extent.height,
+            renderer->extent.width, renderer->extent.height,
+            renderer->resolution.target_time * 1000.0,
+            (unsigned long long)stats.resolution_changes);
+
+    renderer->stats_time = now;
+    renderer->stats_frames = stats.frames;
+}
+
+/*
+ * The overlay changes every frame it is shown, so its panel is damaged where
+ * it was and where it is, which also clears it away once hidden
+ */
+static void damage_overlay(struct Renderer *renderer, const struct Frame *frame)
+{
+    const struct SpriteBatch *batch = &renderer->overlay.batch;
+    add_damage(&renderer->damage, &renderer->overlay_bounds, renderer->extent);
+    memset(&renderer->overlay_bounds, 0, sizeof(renderer->overlay_bounds));
+
+    if (frame->overlay_count == 0)
+        return;
+
+    float left = batch->instances[0].position[0];
+    float top = batch->instances[0].position[1];
+    float right = left;
+    float bottom = top;
+
+    for (uint32_t i = 0; i < frame->overlay_count; ++i) {
+        const struct SpriteInstance *quad = &batch->instances[i];
+        left = fminf(left, quad->position[0] - quad->size[0] * 0.5f);
+        top = fminf(top, quad->position[1] - quad->size[1] * 0.5f);
+        right = fmaxf(right, quad->position[0] + quad->size[0] * 0.5f);
+        bottom = fmaxf(bottom, quad->position[1] + quad->size[1] * 0.5f);
+    }
+
+    // Quads are axis aligned and start at the top left of the window
+    renderer->overlay_bounds.offset.x = (int32_t)floorf(left);
+    renderer->overlay_bounds.offset.y = (int32_t)floorf(top);
+    renderer->overlay_bounds.extent.width = (uint32_t)ceilf(right - floorf(left));
+    renderer->overlay_bounds.extent.height = (uint32_t)ceilf(bottom - floorf(top));
+    add_damage(&renderer->damage, &renderer->overlay_bounds, renderer->extent);
+}
+
+static void update_overlay(struct Renderer *renderer, struct Frame *frame, double frame_time)
+{
+    struct OverlayFrame overlay = {};
+    overlay.frame_time = frame_time;
+    overlay.cpu_time = renderer->pacer.cpu_time;
+    overlay.gpu_time = get_gpu_time(&renderer->timers, "draw");
+    overlay.fence_wait = renderer->fence_wait;
+    overlay.acquire_wait = renderer->acquire_wait;
+    overlay.overlay_time = get_gpu_time(&renderer->timers, "overlay");
+    overlay.counters = renderer->counters;
+#ifndef NDEBUG
+    overlay.performance_warnings = renderer->debug_messenger.frame_performance_warnings;
+#else
+    overlay.performance_warnings = 0;
+#endif
+
+    if (renderer->statistics.pool != VK_NULL_HANDLE) {
+        struct PipelineCounts totals;
+        get_pipeline_totals(&renderer->statistics, &totals);
+        overlay.statistics = 1;
+        overlay.fragments_per_pixel = get_fragments_per_pixel(renderer, &totals);
+        overlay.vertex_invocations = totals.vertex_invocations;
+        overlay.clipping_primitives = totals.clipping_primitives;
+    }
+
+    overlay.dynamic_resolution = renderer->dynamic_resolution;
+    overlay.resolution_scale = renderer->resolution.scale;
+    overlay.scene_extent = renderer->scene_extent;
+
+    const uint64_t uploaded = renderer->uploader.staged_bytes +
+        renderer->uploader.imported_bytes;
+    overlay.upload_bytes = uploaded - renderer->uploaded_bytes;
+    renderer->uploaded_bytes = uploaded;
+
+    overlay.heap_count = renderer->memory_budget.heap_count;
+
+    for (uint32_t i = 0; i < overlay.heap_count; ++i) {
+        overlay.heap_usage[i] = renderer->memory_budget.usage[i];
+        overlay.heap_budgets[i] = renderer->memory_budget.budget[i];
+    }
+
+    build_overlay(&renderer->overlay, &overlay);
+    frame->overlay_count = renderer->sprites_enabled ? renderer->overlay.batch.count : 0;
+    damage_overlay(renderer, frame);
+
+    if (frame->overlay_count > 0)
+        write_instances(renderer, renderer->overlay.batch.instances, frame->overlay_count,
+            "overlay instances", &frame->overlay_instances);
+}
+
+// One instanced draw of the overlay quads on top of the finished frame
+static void draw_overlay(struct Renderer *renderer, const struct Frame *frame,
+    VkCommandBuffer buffer, uint32_t img)
+{
+    begin_debug_label(buffer, "overlay");
+    const uint32_t scope = begin_gpu_scope(&renderer->timers, buffer, "overlay");
+
+    VkRenderPassBeginInfo rndrbegin = {};
+    rndrbegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rndrbegin.framebuffer = renderer->framebuffers[img];
+    rndrbegin.renderArea.extent = renderer->extent;
+    rndrbegin.renderPass = renderer->overlay_render_pass;
+
+    VkViewport viewport = {};
+    viewport.width = renderer->extent.width;
+    viewport.height = renderer->extent.height;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor = {};
+    scissor.extent = renderer->extent;
+
+    const float scale[2] = {2.0f / renderer->extent.width, 2.0f / renderer->extent.height};
+    const VkDeviceSize offset = 0;
+
+    vkCmdBeginRenderPass(buffer, &rndrbegin, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdSetViewport(buffer, 0, 1, &viewport);
+    vkCmdSetScissor(buffer, 0, 1, &scissor);
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->overlay_pipeline);
+    vkCmdPushConstants(buffer, renderer->sprite_program.layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+        sizeof(scale), scale);
+    vkCmdBindVertexBuffers(buffer, 0, 1, &frame->overlay_instances.buffer, &offset);
+    vkCmdDraw(buffer, 6, frame->overlay_count, 0, 0);
+    vkCmdEndRenderPass(buffer);
+    end_gpu_scope(&renderer->timers, buffer, scope);
+    end_debug_label(buffer);
+}
+
+/*
+ * Stretches the used part of the frame's scene target over the swapchain
+ * image with a linear blit. The render pass left the target in
+ * TRANSFER_SRC_OPTIMAL, the image ends up ready for the overlay pass.
+ */
+static void upscale_scene(struct Renderer *renderer, VkCommandBuffer buffer, uint32_t img)
+{
+    begin_debug_label(buffer, "upscale");
+    const uint32_t scope = begin_gpu_scope(&renderer->timers, buffer, "upscale");
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = renderer->images[img];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+    // Chains onto the acquire semaphore, which waits at color attachment output
+    vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[1].x = (int32_t)renderer->scene_extent.width;
+    blit.srcOffsets[1].y = (int32_t)renderer->scene_extent.height;
+    blit.srcOffsets[1].z = 1;
+    blit.dstSubresource = blit.srcSubresource;
+    blit.dstOffsets[1].x = (int32_t)renderer->extent.width;
+    blit.dstOffsets[1].y = (int32_t)renderer->extent.height;
+    blit.dstOffsets[1].z = 1;
+
+    vkCmdBlitImage(buffer, renderer->scene_targets[renderer->frame].image,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, renderer->images[img],
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+    // The overlay pass loads the image and the presentation engine reads it
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+    end_gpu_scope(&renderer->timers, buffer, scope);
+    end_debug_label(buffer);
+}
+
+// Clears and draws the whole scene
+static void record_scene(struct Renderer *renderer, struct Frame *frame,
+    VkCommandBuffer buffer, uint32_t img)
+{
+    // Indexed by attachment, only the attachment that is drawn to is cleared
+    VkClearValue clears[2] = {CLEAR_VALUE, CLEAR_VALUE};
+    VkRenderPassBeginInfo rndrbegin = {};
+    rndrbegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rndrbegin.clearValueCount = renderer->samples != VK_SAMPLE_COUNT_1_BIT ? 2 : 1;
+    rndrbegin.framebuffer = get_scene_framebuffer(renderer, img);
+    rndrbegin.pClearValues = clears;
+    rndrbegin.renderArea.extent = renderer->scene_extent;
+    rndrbegin.renderArea.offset.x = 0;
+    rndrbegin.renderArea.offset.y = 0;
+    rndrbegin.renderPass = renderer->render_pass;
+
+    vkCmdBeginRenderPass(buffer, &rndrbegin, get_draw_pass_contents(&renderer->draw_passes));
+    record_draw_passes(renderer->device, &renderer->draw_passes, &frame->commands,
+        renderer->render_pass, renderer->scene_extent, &renderer->counters);
+    vkCmdEndRenderPass(buffer);
+}
+
+/*
+ * Loads the image, clears every damaged rectangle and redraws every pass once
+ * per rectangle. The overlay render pass loads and keeps the present layout,
+ * which is what a partial redraw needs, and is compatible with the main pass
+ * without MSAA.
+ */
+static void redraw_damage(struct Renderer *renderer, struct Frame *frame,
+    VkCommandBuffer buffer, uint32_t img, const struct DamageRegion *redraw)
+{
+    VkRenderPassBeginInfo rndrbegin = {};
+    rndrbegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rndrbegin.framebuffer = renderer->framebuffers[img];
+    rndrbegin.renderArea = get_damage_bounds(redraw, renderer->extent);
+    rndrbegin.renderPass = renderer->overlay_render_pass;
+
+    vkCmdBeginRenderPass(buffer, &rndrbegin, VK_SUBPASS_CONTENTS_INLINE);
+
+    // Whatever moved out of a rectangle would otherwise stay behind in the loaded image
+    VkClearAttachment attachment = {};
+    attachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    attachment.colorAttachment = 0;
+    attachment.clearValue = CLEAR_VALUE;
+
+    VkClearRect rects[DAMAGE_RECT_MAX];
+
+    for (uint32_t i = 0; i < redraw->count; ++i) {
+        rects[i].rect = redraw->rects[i];
+        rects[i].baseArrayLayer = 0;
+        rects[i].layerCount = 1;
+    }
+
+    vkCmdClearAttachments(buffer, 1, &attachment, redraw->count, rects);
+    record_draw_pass_regions(&renderer->draw_passes, &frame->commands, renderer->extent,
+        redraw->rects, redraw->count, &renderer->counters);
+    vkCmdEndRenderPass(buffer);
+}
+
+// Partial redraws need the image's old content, which MSAA and the scene targets do not keep
+static int is_partial_redraw(const struct Renderer *renderer,
+    const struct DamageRegion *redraw)
+{
+    const double pixels = (double)renderer->extent.width * renderer->extent.height;
+
+    return !redraw->full && renderer->samples == VK_SAMPLE_COUNT_1_BIT &&
+        !renderer->dynamic_resolution &&
+        get_damage_area(redraw, renderer->extent) <= pixels * PARTIAL_REDRAW_MAX_SHARE;
+}
+
+static void record_frame(struct Renderer *renderer, struct Frame *frame, uint32_t img,
+    const struct DamageRegion *redraw)
+{
+    const VkCommandBuffer buffer = begin_frame_commands(renderer->device, &frame->commands);
+    begin_gpu_timers(&renderer->timers, buffer, renderer->frame);
+    begin_pipeline_statistics(&renderer->statistics, buffer, renderer->frame,
+        renderer->draw_passes.count);
+
+    if (renderer->virtual_texture_count > 0) {
+        begin_debug_label(buffer, "stream");
+        const uint32_t stream_scope = begin_gpu_scope(&renderer->timers, buffer, "stream");
+
+        for (uint32_t i = 0; i < renderer->virtual_texture_count; ++i)
+            update_virtual_texture(renderer->virtual_textures[i], buffer, renderer->frame);
+
+        end_gpu_scope(&renderer->timers, buffer, stream_scope);
+        end_debug_label(buffer);
+    }
+
+    begin_debug_label(buffer, "draw");
+    const uint32_t draw_scope = begin_gpu_scope(&renderer->timers, buffer, "draw");
+    memset(&renderer->counters, 0, sizeof(renderer->counters));
+
+    if (is_partial_redraw(renderer, redraw)) {
+        redraw_damage(renderer, frame, buffer, img, redraw);
+        renderer->redraw_share = (double)get_damage_area(redraw, renderer->extent) /
+            ((double)renderer->extent.width * renderer->extent.height);
+    } else {
+        record_scene(renderer, frame, buffer, img);
+        renderer->redraw_share = 1.0;
+    }
+
+    end_gpu_scope(&renderer->timers, buffer, draw_scope);
+    end_debug_label(buffer);
+
+    // update_virtual_texture() reads the feedback once the frame's fence signals
+    if (renderer->virtual_texture_count > 0)
+        record_virtual_feedback_barrier(buffer);
+
+    if (renderer->dynamic_resolution)
+        upscale_scene(renderer, buffer, img);
+
+    if (frame->overlay_count > 0)
+        draw_overlay(renderer, frame, buffer, img);
+
+    assert_vulkan(vkEndCommandBuffer(buffer), "Failed to end a Vulkan command buffer!");
+}
+
+// Runs the frame's ticks and update and builds the overlay
+static void update_frame(struct Renderer *renderer, struct Frame *frame)
+{
+    if (renderer->low_latency)
+        glfwPollEvents();
+
+    begin_input(&renderer->pacer);
+
+    const uint32_t ticks = advance_fixed_timestep(&renderer->timestep);
+    const double now = glfwGetTime();
+
+    for (uint32_t i = 0; i < ticks && renderer->tick != NULL; ++i)
+        renderer->tick(renderer, renderer->timestep.tick_time, renderer->tick_data);
+
+    if (renderer->update != NULL)
+        renderer->update(renderer, now - renderer->update_time, renderer->timestep.alpha,
+            renderer->update_data);
+
+    // Detail streamed in for the view the update just set
+    if (renderer->backdrop_enabled && update_backdrop(&renderer->backdrop, &renderer->uploader,
+        &renderer->pack, renderer->extent, renderer->frame))
+        add_full_damage(&renderer->damage);
+
+    update_overlay(renderer, frame, now - renderer->update_time);
+
+    renderer->update_time = now;
+
+    // Compute passes run every rendered frame and their results may show anywhere
+    if (!renderer->damage_tracking || renderer->added_compute_passes > 0)
+        add_full_damage(&renderer->damage);
+}
+
+/*
+ * The last presented image is still current, so nothing is acquired or
+ * submitted. Input wakes the loop early, otherwise it idles for a frame.
+ */
+static void skip_frame(struct Renderer *renderer)
+{
+    ++renderer->skipped_frames;
+    glfwWaitEventsTimeout(get_frame_period(renderer));
+    update_stats(renderer);
+}
+
+/*
+ * Adds the frame's damage to every image and takes what img missed since it
+ * was last rendered. present gets the frame's own damage, what changed since
+ * the last presented image.
+ */
+static void take_damage(struct Renderer *renderer, uint32_t img, struct DamageRegion *redraw,
+    struct DamageRegion *present)
+{
+    for (uint32_t i = 0; i < renderer->image_count; ++i)
+        merge_damage(&renderer->image_damage[i], &renderer->damage, renderer->extent);
+
+    *redraw = renderer->image_damage[img];
+    *present = renderer->damage;
+    clear_damage(&renderer->image_damage[img]);
+    clear_damage(&renderer->damage);
 }
 
 void run_renderer(struct Renderer *renderer)
 {
     while (!glfwWindowShouldClose(renderer->window))
     {
-        glfwPollEvents();
-        
+        pace_frame(&renderer->pacer, renderer->device, renderer->swapchain);
+
+        // Low latency samples input only once the frame slot is free
+        if (!renderer->low_latency)
+            glfwPollEvents();
+
+        struct Frame *frame = &renderer->frames[renderer->frame];
+        const double fence_start = glfwGetTime();
+        vkWaitForFences(renderer->device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+        renderer->fence_wait = glfwGetTime() - fence_start;
+        poll_memory_budget(&renderer->memory_budget);
+#ifndef NDEBUG
+        flush_debug_messenger(&renderer->debug_messenger);
+#endif
+
+        // Whether the frame changed is only known after the update, so it runs before acquire
+        if (renderer->damage_tracking) {
+            update_frame(renderer, frame);
+
+            if (!is_damaged(&renderer->damage)) {
+                skip_frame(renderer);
+                continue;
+            }
+        }
+
+        const double acquire_start = glfwGetTime();
         uint32_t img = 0;
         VkResult res = vkAcquireNextImageKHR(renderer->device, renderer->swapchain, UINT64_MAX,
-            renderer->presented_semaphore, NULL, &img);
+            frame->acquired, NULL, &img);
+        renderer->acquire_wait = glfwGetTime() - acquire_start;
 
         if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+            if (renderer->low_latency)
+                glfwPollEvents();
+
             recreate_swapchain_objects(renderer);
             continue;
         } else if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
             printf("Failed to acquire a swapchain image!");
             exit(-1);
         }
-        
+
+        // The image can come back before the frame that last rendered to it finished
+        if (renderer->image_fences[img] != VK_NULL_HANDLE)
+            vkWaitForFences(renderer->device, 1, &renderer->image_fences[img], VK_TRUE,
+                UINT64_MAX);
+
+        renderer->image_fences[img] = frame->fence;
+        vkResetFences(renderer->device, 1, &frame->fence);
+
+        if (!renderer->damage_tracking)
+            update_frame(renderer, frame);
+
+        // Cached passes baked in the old viewport
+        if (renderer->dynamic_resolution && update_resolution_scale(&renderer->resolution,
+            get_gpu_time(&renderer->timers, "draw"))) {
+            update_scene_extent(renderer);
+            invalidate_draw_passes(&renderer->draw_passes);
+            add_full_damage(&renderer->damage);
+        }
+
+        struct DamageRegion redraw, changed;
+        take_damage(renderer, img, &redraw, &changed);
+        record_frame(renderer, frame, img, &redraw);
+
+        // The culler writes per frame buffers, which are regrown on demand
+        if (renderer->sprite_culling) {
+            VkBuffer culled[CULL_BUFFER_COUNT];
+            const uint32_t count = get_culled_buffers(&renderer->culler, renderer->frame,
+                culled);
+
+            set_compute_pass_buffers(&renderer->compute, renderer->cull_pass, count, culled);
+        }
+
+        const VkSemaphore compute_signal = submit_compute(&renderer->compute);
+        const VkSemaphore signals[2] = { frame->rendered, compute_signal };
+
         VkPipelineStageFlagBits waitstgs = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
         VkSubmitInfo submit = {};
         submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submit.commandBufferCount = 1;
-        submit.pCommandBuffers = &renderer->command_buffers[img];
+        submit.pCommandBuffers = &frame->commands.primary;
         submit.waitSemaphoreCount = 1;
         submit.pWaitDstStageMask = &waitstgs;
-        submit.pWaitSemaphores = &renderer->presented_semaphore;
-        submit.signalSemaphoreCount = 1;
-        submit.pSignalSemaphores = &renderer->rendered_semaphore;
+        submit.pWaitSemaphores = &frame->acquired;
+        submit.signalSemaphoreCount = compute_signal != VK_NULL_HANDLE ? 2 : 1;
+        submit.pSignalSemaphores = signals;
+
+        vkQueueSubmit(renderer->graphics_queue, 1, &submit, frame->fence);
+        record_submit(&renderer->pacer);
+
+        const uint64_t present_id = end_frame(&renderer->pacer);
+
+        VkPresentIdKHR presentid = {};
+        presentid.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentid.swapchainCount = 1;
+        presentid.pPresentIds = &present_id;
+
+        // Lets the compositor copy only what changed since the last present
+        VkRectLayerKHR rects[DAMAGE_RECT_MAX];
+        VkPresentRegionKHR region = {};
+        region.rectangleCount = changed.count;
+        region.pRectangles = rects;
+
+        for (uint32_t i = 0; i < changed.count; ++i) {
+            rects[i].offset = changed.rects[i].offset;
+            rects[i].extent = changed.rects[i].extent;
+            rects[i].layer = 0;
+        }
 
-        vkWaitForFences(renderer->device, 1, &renderer->fences[img], VK_TRUE, UINT64_MAX);
-        vkResetFences(renderer->device, 1, &renderer->fences[img]);
-        vkQueueSubmit(renderer->graphics_queue, 1, &submit, renderer->fences[img]);
+        VkPresentRegionsKHR regions = {};
+        regions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+        regions.pNext = renderer->present_id_enabled ? &presentid : NULL;
+        regions.swapchainCount = 1;
+        regions.pRegions = &region;
 
         VkPresentInfoKHR present = {};
         present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present.pNext = renderer->present_id_enabled ? &presentid : NULL;
+
+        if (renderer->incremental_present_enabled && !changed.full)
+            present.pNext = &regions;
+
         present.waitSemaphoreCount = 1;
-        present.pWaitSemaphores = &renderer->rendered_semaphore;
+        present.pWaitSemaphores = &frame->rendered;
         present.swapchainCount = 1;
         present.pSwapchains = &renderer->swapchain;
         present.pImageIndices = &img;
 
         res = vkQueuePresentKHR(renderer->present_queue, &present);
+        record_present(&renderer->pacer);
+        renderer->frame = (renderer->frame + 1) % FRAMES_IN_FLIGHT;
 
         if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || renderer->resized) {
             renderer->resized = 0;
@@ -906,23 +2836,62 @@ void run_renderer(struct Renderer *renderer)
             printf("Failed to present a swapchain image!");
             exit(-1);
         }
+
+        update_stats(renderer);
     }
 
     vkDeviceWaitIdle(renderer->device);
 }
 
+void close_renderer(struct Renderer *renderer)
+{
+    glfwSetWindowShouldClose(renderer->window, GLFW_TRUE);
+}
+
+static void print_arena_usages(const struct Renderer *renderer)
+{
+    print_arena_usage(&renderer->scratch);
+    print_arena_usage(&renderer->swapchain_arena);
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i)
+        print_arena_usage(&renderer->frames[i].commands.scratch);
+}
+
 void destroy_renderer(struct Renderer *renderer)
 {
-    destroy_sync_objects(renderer);
+    if (renderer->print_stats)
+        print_arena_usages(renderer);
+
     destroy_swapchain_objects(renderer);
-    vkDestroyCommandPool(renderer->device, renderer->command_pool, NULL);
+    destroy_overlay(&renderer->overlay);
+    destroy_sprite_batch(&renderer->drawn_sprites);
+    destroy_pipeline_cache(renderer->device, &renderer->pipeline_cache);
+    destroy_shader_program(renderer->device, &renderer->basic_program);
+
+    if (renderer->sprites_enabled)
+        destroy_shader_program(renderer->device, &renderer->sprite_program);
+
+    destroy_renderer_backdrop(renderer);
+    destroy_layout_cache(renderer->device, &renderer->layout_cache);
+
+    if (renderer->sprite_culling)
+        destroy_sprite_culler(&renderer->culler);
+
+    destroy_compute_scheduler(&renderer->compute);
+    destroy_draw_pass_list(renderer->device, &renderer->draw_passes);
+    destroy_gpu_timers(&renderer->timers);
+    destroy_pipeline_statistics(&renderer->statistics);
+    destroy_frames(renderer);
+    destroy_assets(renderer);
     vkDestroyDevice(renderer->device, NULL);
     vkDestroySurfaceKHR(renderer->instance, renderer->surface, NULL);
 #ifndef NDEBUG
-    destroy_debug_messenger(renderer);
+    destroy_debug_messenger(&renderer->debug_messenger);
 #endif
     vkDestroyInstance(renderer->instance, NULL);
     glfwDestroyWindow(renderer->window);
     glfwTerminate();
+    destroy_arena(&renderer->swapchain_arena);
+    destroy_arena(&renderer->scratch);
     free(renderer);
 }
\ No newline at end of file
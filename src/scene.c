@@ -0,0 +1,355 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scene.h"
+
+#define SPRITE_SIZE 16.0f
+// Flow tiles cover the default window, sprites outside clamp to the border tiles
+#define FLOW_TILE_SIZE 16u
+#define FLOW_WIDTH 80u
+#define FLOW_HEIGHT 45u
+#define WALL_CHANCE 0.08f
+#define WALL_COLOR 0xff606060u
+#define GOAL_INTERVAL 5.0f
+#define WALL_INTERVAL 0.25f
+// How quickly seekers turn toward the flow, per second
+#define STEERING 4.0f
+#define TAU 6.28318531f
+#define PULSE_PERIOD 2.0f
+#define PULSE_MIN_ALPHA 64.0f
+// The backdrop circles its center while zooming between 1 and 4
+#define BACKDROP_PERIOD 30.0f
+#define BACKDROP_RADIUS 0.25f
+
+static const uint32_t GOALS[][2] = {
+    {FLOW_WIDTH / 2, FLOW_HEIGHT / 2}, {2, 2}, {FLOW_WIDTH - 3, 2},
+    {FLOW_WIDTH - 3, FLOW_HEIGHT - 3}, {2, FLOW_HEIGHT - 3}
+};
+
+static void move_sprites(struct World *world, const struct ChunkView *view, void *user_data)
+{
+    (void)world;
+    const struct Scene *scene = user_data;
+    struct Transform *transforms = get_chunk_column(view, scene->sprite_components.transform);
+    const struct Velocity *velocities = get_chunk_column(view, scene->velocity);
+
+    for (uint32_t i = 0; i < view->count; ++i) {
+        transforms[i].x += velocities[i].x * scene->delta;
+        transforms[i].y += velocities[i].y * scene->delta;
+        transforms[i].rotation += velocities[i].spin * scene->delta;
+    }
+}
+
+/*
+ * Fades the alpha of every sprite up and down, phased by its red channel so
+ * they do not pulse in step. Independent of movement so it runs next to it.
+ */
+static void pulse_sprites(struct World *world, const struct ChunkView *view, void *user_data)
+{
+    (void)world;
+    const struct Scene *scene = user_data;
+    struct Sprite *sprites = get_chunk_column(view, scene->sprite_components.sprite);
+    const float angle = scene->pulse_time / PULSE_PERIOD * TAU;
+
+    for (uint32_t i = 0; i < view->count; ++i) {
+        const float phase = (float)(sprites[i].color & 0xffu) / 255.0f * TAU;
+        const float wave = 0.5f + 0.5f * sinf(angle + phase);
+        const uint32_t alpha = (uint32_t)(PULSE_MIN_ALPHA + (255.0f - PULSE_MIN_ALPHA) * wave);
+        sprites[i].color = (sprites[i].color & 0xffffffu) | alpha << 24;
+    }
+}
+
+static void bounce_sprites(struct World *world, const struct ChunkView *view, void *user_data)
+{
+    (void)world;
+    const struct Scene *scene = user_data;
+    const struct Transform *transforms = get_chunk_column(view,
+        scene->sprite_components.transform);
+    struct Velocity *velocities = get_chunk_column(view, scene->velocity);
+
+    for (uint32_t i = 0; i < view->count; ++i) {
+        if ((transforms[i].x < 0.0f && velocities[i].x < 0.0f) ||
+            (transforms[i].x > scene->width && velocities[i].x > 0.0f))
+            velocities[i].x = -velocities[i].x;
+        if ((transforms[i].y < 0.0f && velocities[i].y < 0.0f) ||
+            (transforms[i].y > scene->height && velocities[i].y > 0.0f))
+            velocities[i].y = -velocities[i].y;
+    }
+}
+
+static uint32_t get_flow_coordinate(float position, uint32_t size)
+{
+    const float tile = position / (float)FLOW_TILE_SIZE;
+
+    return tile <= 0.0f ? 0 : tile >= (float)size ? size - 1 : (uint32_t)tile;
+}
+
+// Blends velocity toward the field, seekers on unreachable tiles keep bouncing around
+static void seek_goal(struct World *world, const struct ChunkView *view, void *user_data)
+{
+    (void)world;
+    const struct Scene *scene = user_data;
+    const struct Transform *transforms = get_chunk_column(view,
+        scene->sprite_components.transform);
+    const struct Seeker *seekers = get_chunk_column(view, scene->seeker);
+    struct Velocity *velocities = get_chunk_column(view, scene->velocity);
+    const float blend = fminf(scene->delta * STEERING, 1.0f);
+
+    for (uint32_t i = 0; i < view->count; ++i) {
+        float flow[2];
+        get_flow_vector(&scene->flow, scene->field,
+            get_flow_coordinate(transforms[i].x, FLOW_WIDTH),
+            get_flow_coordinate(transforms[i].y, FLOW_HEIGHT), flow);
+
+        if (flow[0] == 0.0f && flow[1] == 0.0f)
+            continue;
+
+        velocities[i].x += (flow[0] * seekers[i].speed - velocities[i].x) * blend;
+        velocities[i].y += (flow[1] * seekers[i].speed - velocities[i].y) * blend;
+    }
+}
+
+static float get_random(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+static int is_goal(uint32_t tile)
+{
+    for (uint32_t i = 0; i < sizeof(GOALS) / sizeof(GOALS[0]); ++i)
+        if (GOALS[i][1] * FLOW_WIDTH + GOALS[i][0] == tile)
+            return 1;
+
+    return 0;
+}
+
+// Adds or removes the wall on tile, the entity appears at the next flush
+static void toggle_wall(struct Scene *scene, uint32_t tile)
+{
+    if (scene->walls[tile] != ECS_NULL_ENTITY) {
+        destroy_entity(&scene->world, scene->walls[tile]);
+        scene->walls[tile] = ECS_NULL_ENTITY;
+        set_flow_cost(&scene->flow, tile % FLOW_WIDTH, tile / FLOW_WIDTH, 1);
+        return;
+    }
+
+    const uint64_t entity = create_entity(&scene->world);
+
+    struct Transform transform = {};
+    transform.x = ((float)(tile % FLOW_WIDTH) + 0.5f) * FLOW_TILE_SIZE;
+    transform.y = ((float)(tile / FLOW_WIDTH) + 0.5f) * FLOW_TILE_SIZE;
+    transform.scale = 1.0f;
+
+    struct Sprite sprite = {};
+    sprite.width = FLOW_TILE_SIZE;
+    sprite.height = FLOW_TILE_SIZE;
+    sprite.color = WALL_COLOR;
+
+    struct Wall wall = {};
+    wall.tile = tile;
+
+    add_component(&scene->world, entity, scene->sprite_components.transform, &transform);
+    add_component(&scene->world, entity, scene->sprite_components.sprite, &sprite);
+    add_component(&scene->world, entity, scene->wall, &wall);
+    scene->walls[tile] = entity;
+    set_flow_cost(&scene->flow, tile % FLOW_WIDTH, tile / FLOW_WIDTH, FLOW_BLOCKED);
+}
+
+static void spawn_walls(struct Scene *scene)
+{
+    for (uint32_t i = 0; i < FLOW_WIDTH * FLOW_HEIGHT; ++i)
+        if (!is_goal(i) && get_random(0.0f, 1.0f) < WALL_CHANCE)
+            toggle_wall(scene, i);
+}
+
+static void spawn_sprites(uint32_t count, struct Scene *scene)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint64_t entity = create_entity(&scene->world);
+
+        struct Transform transform = {};
+        transform.x = get_random(0.0f, scene->width);
+        transform.y = get_random(0.0f, scene->height);
+        transform.scale = get_random(0.5f, 2.0f);
+
+        struct Sprite sprite = {};
+        sprite.width = SPRITE_SIZE;
+        sprite.height = SPRITE_SIZE;
+        sprite.color = (uint32_t)rand();
+
+        struct Velocity velocity = {};
+        velocity.x = get_random(-200.0f, 200.0f);
+        velocity.y = get_random(-200.0f, 200.0f);
+        velocity.spin = get_random(-3.0f, 3.0f);
+
+        add_component(&scene->world, entity, scene->sprite_components.transform, &transform);
+        add_component(&scene->world, entity, scene->sprite_components.sprite, &sprite);
+        add_component(&scene->world, entity, scene->sprite_components.previous, &transform);
+        add_component(&scene->world, entity, scene->velocity, &velocity);
+
+        if (i % 2 == 0) {
+            struct Seeker seeker = {};
+            seeker.speed = get_random(80.0f, 160.0f);
+            add_component(&scene->world, entity, scene->seeker, &seeker);
+        }
+    }
+
+    flush_world(&scene->world);
+}
+
+static void add_scene_systems(struct Scene *scene)
+{
+    const uint64_t transform = ECS_COMPONENT_BIT(scene->sprite_components.transform);
+    const uint64_t sprite = ECS_COMPONENT_BIT(scene->sprite_components.sprite);
+    const uint64_t velocity = ECS_COMPONENT_BIT(scene->velocity);
+    const uint64_t seeker = ECS_COMPONENT_BIT(scene->seeker);
+
+    struct System move = {};
+    move.name = "move";
+    move.reads = velocity;
+    move.writes = transform;
+    move.run = move_sprites;
+    move.user_data = scene;
+
+    struct System pulse = {};
+    pulse.name = "pulse";
+    pulse.writes = sprite;
+    pulse.excludes = ECS_COMPONENT_BIT(scene->wall);
+    pulse.run = pulse_sprites;
+    pulse.user_data = scene;
+
+    struct System bounce = {};
+    bounce.name = "bounce";
+    bounce.reads = transform;
+    bounce.writes = velocity;
+    bounce.run = bounce_sprites;
+    bounce.user_data = scene;
+
+    struct System seek = {};
+    seek.name = "seek";
+    seek.reads = transform | seeker;
+    seek.writes = velocity;
+    seek.run = seek_goal;
+    seek.user_data = scene;
+
+    add_system(&scene->world, &seek);
+    add_system(&scene->world, &move);
+    add_system(&scene->world, &pulse);
+    add_system(&scene->world, &bounce);
+}
+
+void create_scene(const struct Renderer *renderer, uint32_t sprite_count, int print_stats,
+    struct Scene *scene)
+{
+    const VkExtent2D extent = get_renderer_extent(renderer);
+
+    create_world(get_default_worker_count(), &scene->world);
+    register_sprite_components(&scene->world, &scene->sprite_components);
+    scene->velocity = register_component(&scene->world, "velocity", sizeof(struct Velocity));
+    scene->seeker = register_component(&scene->world, "seeker", sizeof(struct Seeker));
+    scene->wall = register_component(&scene->world, "wall", sizeof(struct Wall));
+    scene->batch.count = 0;
+    scene->batch.capacity = 0;
+    scene->batch.instances = NULL;
+    scene->width = (float)extent.width;
+    scene->height = (float)extent.height;
+    scene->delta = 0.0f;
+    scene->pulse_time = 0.0f;
+    scene->backdrop_time = 0.0f;
+    scene->goal = 0;
+    scene->walls = calloc(FLOW_WIDTH * FLOW_HEIGHT, sizeof(uint64_t));
+    scene->goal_timer = 0.0f;
+    scene->wall_timer = 0.0f;
+    scene->stats_timer = 0.0f;
+    scene->print_stats = print_stats;
+    memset(&scene->flow_stats, 0, sizeof(scene->flow_stats));
+
+    // Shares the ECS workers, flow updates and systems never run at the same time
+    create_flow_grid(FLOW_WIDTH, FLOW_HEIGHT, &scene->world.pool, &scene->flow);
+    add_scene_systems(scene);
+    spawn_walls(scene);
+    spawn_sprites(sprite_count, scene);
+    scene->field = request_flow_field(&scene->flow, GOALS[0][0], GOALS[0][1]);
+}
+
+// Cycles through the goals and toggles a wall now and then to exercise incremental solves
+static void update_flow(struct Scene *scene)
+{
+    scene->goal_timer += scene->delta;
+    scene->wall_timer += scene->delta;
+    scene->stats_timer += scene->delta;
+
+    if (scene->goal_timer >= GOAL_INTERVAL) {
+        scene->goal_timer = 0.0f;
+        scene->goal = (scene->goal + 1) % (sizeof(GOALS) / sizeof(GOALS[0]));
+    }
+
+    if (scene->wall_timer >= WALL_INTERVAL) {
+        const uint32_t tile = (uint32_t)rand() % (FLOW_WIDTH * FLOW_HEIGHT);
+        scene->wall_timer = 0.0f;
+
+        if (!is_goal(tile))
+            toggle_wall(scene, tile);
+    }
+
+    scene->field = request_flow_field(&scene->flow, GOALS[scene->goal][0], GOALS[scene->goal][1]);
+    update_flow_grid(&scene->flow);
+
+    const struct FlowStats *stats = &scene->flow.stats;
+    struct FlowStats *total = &scene->flow_stats;
+    total->full_solves += stats->full_solves;
+    total->incremental_solves += stats->incremental_solves;
+    total->sectors_rebuilt += stats->sectors_rebuilt;
+    total->update_time = fmax(total->update_time, stats->update_time);
+    total->max_solve_time = fmax(total->max_solve_time, stats->max_solve_time);
+
+    if (scene->print_stats && scene->stats_timer >= 1.0f) {
+        printf("Flow fields: %u cached, %u full solves, %u incremental, %u sectors, "
+            "slowest update %.3f ms, slowest solve %.3f ms\n", scene->flow.field_count,
+            total->full_solves, total->incremental_solves, total->sectors_rebuilt,
+            total->update_time * 1000.0, total->max_solve_time * 1000.0);
+
+        memset(total, 0, sizeof(*total));
+        scene->stats_timer = 0.0f;
+    }
+}
+
+void tick_scene(struct Renderer *renderer, double tick_time, void *user_data)
+{
+    struct Scene *scene = user_data;
+    const VkExtent2D extent = get_renderer_extent(renderer);
+
+    scene->width = (float)extent.width;
+    scene->height = (float)extent.height;
+    scene->delta = (float)tick_time;
+    scene->pulse_time = fmodf(scene->pulse_time + scene->delta, PULSE_PERIOD);
+
+    save_sprite_transforms(&scene->world, &scene->sprite_components);
+    update_flow(scene);
+    run_systems(&scene->world);
+}
+
+void update_scene(struct Renderer *renderer, double delta, double alpha, void *user_data)
+{
+    struct Scene *scene = user_data;
+    (void)delta;
+
+    gather_sprites(&scene->world, &scene->sprite_components, (float)alpha, &scene->batch);
+    set_renderer_sprites(renderer, scene->batch.instances, scene->batch.count);
+
+    scene->backdrop_time = fmodf(scene->backdrop_time + (float)delta, BACKDROP_PERIOD);
+
+    const float angle = scene->backdrop_time / BACKDROP_PERIOD * TAU;
+    set_renderer_backdrop_view(renderer, 0.5f + cosf(angle) * BACKDROP_RADIUS,
+        0.5f + sinf(angle) * BACKDROP_RADIUS, 2.5f - cosf(angle) * 1.5f);
+}
+
+void destroy_scene(struct Scene *scene)
+{
+    destroy_sprite_batch(&scene->batch);
+    destroy_flow_grid(&scene->flow);
+    destroy_world(&scene->world);
+    free(scene->walls);
+}
@@ -0,0 +1,308 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "instance.h"
+#include "pack.h"
+#include "shader.h"
+
+#define PIPELINE_CACHE_INITIAL_CAPACITY 16u
+
+uint32_t *get_shader_code(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL) {
+        printf("Failed to open file at %s\n", path);
+        exit(-1);
+    }
+
+    fseek(file, 0, SEEK_END);
+
+    *size = ftell(file);
+
+    rewind(file);
+
+    size_t count = *size / 4;
+    uint32_t *code = malloc(*size);
+
+    if (fread(code, sizeof(uint32_t), count, file) != count) {
+        printf("Failed to read file at %s\n", path);
+        exit(-1);
+    }
+
+    fclose(file);
+
+    return code;
+}
+
+static void create_stage(VkDevice device, const char *name, const uint32_t *code,
+    size_t code_size, struct ShaderProgram *program, uint32_t stage)
+{
+    VkShaderModuleCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    info.codeSize = code_size;
+    info.pCode = code;
+
+    reflect_shader(code, code_size, &program->reflections[stage]);
+    program->stages[stage] = program->reflections[stage].stage;
+    assert_vulkan(vkCreateShaderModule(device, &info, NULL, &program->modules[stage]),
+        "Failed to create a Vulkan shader module!");
+    set_debug_name(device, VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)program->modules[stage],
+        "%s", name);
+}
+
+// Binaries compiled before a feature was added lack its constant and never get it
+static void finish_shader_program(VkDevice device, struct LayoutCache *layouts,
+    uint32_t features, struct ShaderProgram *program)
+{
+    uint32_t declared = 0;
+
+    for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
+        declared |= program->reflections[i].spec_constants;
+
+    program->features = features & declared;
+    program->layout = get_pipeline_layout(device, layouts, program->reflections,
+        SHADER_STAGE_COUNT, program->set_layouts, &program->set_count);
+}
+
+void create_shader_program(VkDevice device, struct LayoutCache *layouts,
+    const char *const paths[SHADER_STAGE_COUNT], uint32_t features,
+    struct ShaderProgram *program)
+{
+    for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i) {
+        size_t code_size = 0;
+        uint32_t *code = get_shader_code(paths[i], &code_size);
+        create_stage(device, paths[i], code, code_size, program, i);
+        free(code);
+    }
+
+    finish_shader_program(device, layouts, features, program);
+}
+
+void create_shader_program_from_pack(VkDevice device, struct LayoutCache *layouts,
+    const struct AssetPack *pack, const char *const names[SHADER_STAGE_COUNT],
+    uint32_t features, struct ShaderProgram *program)
+{
+    for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i) {
+        const struct PackEntry *entry = find_pack_entry(pack, names[i]);
+
+        if (entry == NULL || entry->type != PACK_ENTRY_SHADER) {
+            printf("Failed to find shader %s in the asset pack\n", names[i]);
+            exit(-1);
+        }
+
+        create_stage(device, names[i], get_pack_payload(pack, entry), entry->size, program, i);
+    }
+
+    finish_shader_program(device, layouts, features, program);
+}
+
+void destroy_shader_program(VkDevice device, struct ShaderProgram *program)
+{
+    for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
+        vkDestroyShaderModule(device, program->modules[i], NULL);
+}
+
+void create_pipeline_cache(VkDevice device, struct PipelineCache *cache)
+{
+    VkPipelineCacheCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    assert_vulkan(vkCreatePipelineCache(device, &info, NULL, &cache->cache),
+        "Failed to create a Vulkan pipeline cache!");
+    set_debug_name(device, VK_OBJECT_TYPE_PIPELINE_CACHE, (uint64_t)cache->cache,
+        "pipeline cache");
+
+    cache->count = 0;
+    cache->capacity = PIPELINE_CACHE_INITIAL_CAPACITY;
+    cache->entries = malloc(cache->capacity * sizeof(struct PipelineEntry));
+}
+
+static VkPipeline compile_pipeline(VkDevice device, VkPipelineCache vkcache,
+    const struct ShaderProgram *program, const struct PipelineState *state,
+    uint32_t permutation)
+{
+    VkBool32 spcdata[SHADER_FEATURE_COUNT];
+    VkSpecializationMapEntry spcentries[SHADER_FEATURE_COUNT];
+    uint32_t spccount = 0;
+
+    for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; ++i) {
+        if (!(program->features & (1u << i)))
+            continue;
+
+        spcentries[spccount].constantID = i;
+        spcentries[spccount].offset = spccount * sizeof(VkBool32);
+        spcentries[spccount].size = sizeof(VkBool32);
+        spcdata[spccount] = (permutation >> i) & 1u;
+        ++spccount;
+    }
+
+    VkSpecializationInfo spcinfo = {};
+    spcinfo.mapEntryCount = spccount;
+    spcinfo.pMapEntries = spcentries;
+    spcinfo.dataSize = spccount * sizeof(VkBool32);
+    spcinfo.pData = spcdata;
+
+    VkPipelineShaderStageCreateInfo shdrinfos[SHADER_STAGE_COUNT];
+
+    for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i) {
+        shdrinfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shdrinfos[i].flags = 0;
+        shdrinfos[i].pName = "main";
+        shdrinfos[i].pNext = NULL;
+        shdrinfos[i].pSpecializationInfo = spccount > 0 ? &spcinfo : NULL;
+        shdrinfos[i].stage = program->stages[i];
+        shdrinfos[i].module = program->modules[i];
+    }
+
+    VkPipelineColorBlendAttachmentState blndattach_state = {};
+    blndattach_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    if (state->blend_mode != BLEND_MODE_OPAQUE) {
+        blndattach_state.blendEnable = VK_TRUE;
+        blndattach_state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blndattach_state.dstColorBlendFactor = state->blend_mode == BLEND_MODE_ADDITIVE ?
+            VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blndattach_state.colorBlendOp = VK_BLEND_OP_ADD;
+        blndattach_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blndattach_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blndattach_state.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+
+    VkPipelineColorBlendStateCreateInfo blndinfo = {};
+    blndinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blndinfo.attachmentCount = 1;
+    blndinfo.pAttachments = &blndattach_state;
+
+    VkPipelineInputAssemblyStateCreateInfo inptassembly_info = {};
+    inptassembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inptassembly_info.topology = state->topology;
+
+    VkPipelineRasterizationStateCreateInfo rstrinfo = {};
+    rstrinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rstrinfo.cullMode = state->cull_mode;
+    rstrinfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rstrinfo.lineWidth = 1.0f;
+    rstrinfo.polygonMode = VK_POLYGON_MODE_FILL;
+
+    VkPipelineMultisampleStateCreateInfo mltsample_info = {};
+    mltsample_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    mltsample_info.rasterizationSamples = state->samples;
+
+    VkVertexInputAttributeDescription attributes[REFLECT_MAX_ATTRIBUTES];
+    VkVertexInputBindingDescription vrtbinding = {};
+    uint32_t attrcount = 0;
+
+    // Attributes are packed in location order into a single interleaved binding
+    for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i) {
+        const struct ShaderReflection *reflection = &program->reflections[i];
+
+        if (reflection->stage != VK_SHADER_STAGE_VERTEX_BIT)
+            continue;
+
+        for (uint32_t j = 0; j < reflection->attribute_count; ++j) {
+            attributes[attrcount].binding = 0;
+            attributes[attrcount].format = reflection->attributes[j].format;
+            attributes[attrcount].location = reflection->attributes[j].location;
+            attributes[attrcount].offset = vrtbinding.stride;
+            vrtbinding.stride += reflection->attributes[j].size;
+            ++attrcount;
+        }
+    }
+
+    vrtbinding.inputRate = state->input_rate;
+
+    VkPipelineVertexInputStateCreateInfo vrtinput_info = {};
+    vrtinput_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vrtinput_info.vertexAttributeDescriptionCount = attrcount;
+    vrtinput_info.pVertexAttributeDescriptions = attributes;
+    vrtinput_info.vertexBindingDescriptionCount = attrcount > 0 ? 1 : 0;
+    vrtinput_info.pVertexBindingDescriptions = &vrtbinding;
+
+    // Viewport and scissor are dynamic so pipelines survive swapchain resizes
+    VkPipelineViewportStateCreateInfo vwprtinfo = {};
+    vwprtinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    vwprtinfo.scissorCount = 1;
+    vwprtinfo.viewportCount = 1;
+
+    const VkDynamicState dynstates[2] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dyninfo = {};
+    dyninfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dyninfo.dynamicStateCount = 2;
+    dyninfo.pDynamicStates = dynstates;
+
+    VkGraphicsPipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.layout = program->layout;
+    info.pColorBlendState = &blndinfo;
+    info.pDynamicState = &dyninfo;
+    info.pInputAssemblyState = &inptassembly_info;
+    info.pRasterizationState = &rstrinfo;
+    info.pMultisampleState = &mltsample_info;
+    info.pStages = shdrinfos;
+    info.pVertexInputState = &vrtinput_info;
+    info.pViewportState = &vwprtinfo;
+    info.renderPass = state->render_pass;
+    info.stageCount = SHADER_STAGE_COUNT;
+    info.subpass = 0;
+
+    VkPipeline pipeline;
+    assert_vulkan(vkCreateGraphicsPipelines(device, vkcache, 1, &info, NULL, &pipeline),
+        "Failed to create a Vulkan graphics pipeline!");
+
+    return pipeline;
+}
+
+VkPipeline get_pipeline(VkDevice device, struct PipelineCache *cache,
+    const struct ShaderProgram *program, const struct PipelineState *state,
+    uint32_t permutation)
+{
+    struct PipelineKey key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.modules, program->modules, sizeof(key.modules));
+    key.state = *state;
+    key.permutation = permutation & program->features;
+
+    const uint64_t hash = hash_bytes(&key, sizeof(key));
+
+    for (uint32_t i = 0; i < cache->count; ++i)
+        if (cache->entries[i].hash == hash &&
+            memcmp(&cache->entries[i].key, &key, sizeof(key)) == 0)
+            return cache->entries[i].pipeline;
+
+    if (cache->count == cache->capacity) {
+        cache->capacity *= 2;
+        cache->entries = realloc(cache->entries, cache->capacity * sizeof(struct PipelineEntry));
+    }
+
+    struct PipelineEntry *entry = &cache->entries[cache->count++];
+    entry->hash = hash;
+    entry->key = key;
+    entry->pipeline = compile_pipeline(device, cache->cache, program, state, key.permutation);
+    set_debug_name(device, VK_OBJECT_TYPE_PIPELINE, (uint64_t)entry->pipeline,
+        "pipeline %016llx permutation %u", (unsigned long long)hash, key.permutation);
+
+    return entry->pipeline;
+}
+
+void clear_pipeline_cache(VkDevice device, struct PipelineCache *cache)
+{
+    for (uint32_t i = 0; i < cache->count; ++i)
+        vkDestroyPipeline(device, cache->entries[i].pipeline, NULL);
+
+    cache->count = 0;
+}
+
+void destroy_pipeline_cache(VkDevice device, struct PipelineCache *cache)
+{
+    clear_pipeline_cache(device, cache);
+    vkDestroyPipelineCache(device, cache->cache, NULL);
+    free(cache->entries);
+}
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "sprite.h"
+
+void register_sprite_components(struct World *world, struct SpriteComponents *components)
+{
+    components->transform = register_component(world, "transform", sizeof(struct Transform));
+    components->sprite = register_component(world, "sprite", sizeof(struct Sprite));
+    components->previous = register_component(world, "previous transform",
+        sizeof(struct Transform));
+}
+
+static void save_chunk(struct World *world, const struct ChunkView *view, void *user_data)
+{
+    (void)world;
+    const struct SpriteComponents *components = user_data;
+
+    memcpy(get_chunk_column(view, components->previous),
+        get_chunk_column(view, components->transform), view->count * sizeof(struct Transform));
+}
+
+void save_sprite_transforms(struct World *world, const struct SpriteComponents *components)
+{
+    for_each_chunk(world, ECS_COMPONENT_BIT(components->transform) |
+        ECS_COMPONENT_BIT(components->previous), &save_chunk, (void *)components);
+}
+
+struct GatherState {
+    const struct SpriteComponents *components;
+    float alpha;
+    struct SpriteBatch *batch;
+};
+
+static void count_sprites(struct World *world, const struct ChunkView *view, void *user_data)
+{
+    (void)world;
+    struct GatherState *state = user_data;
+    state->batch->count += view->count;
+}
+
+static void gather_chunk(struct World *world, const struct ChunkView *view, void *user_data)
+{
+    (void)world;
+    struct GatherState *state = user_data;
+    const struct Transform *transforms = get_chunk_column(view, state->components->transform);
+    const struct Sprite *sprites = get_chunk_column(view, state->components->sprite);
+    struct SpriteInstance *instances = state->batch->instances + state->batch->count;
+
+    if (view->archetype->mask & ECS_COMPONENT_BIT(state->components->previous)) {
+        const struct Transform *previous = get_chunk_column(view, state->components->previous);
+        const float alpha = state->alpha;
+
+        for (uint32_t i = 0; i < view->count; ++i) {
+            const float scale = previous[i].scale + (transforms[i].scale - previous[i].scale) *
+                alpha;
+
+            instances[i].position[0] = previous[i].x + (transforms[i].x - previous[i].x) * alpha;
+            instances[i].position[1] = previous[i].y + (transforms[i].y - previous[i].y) * alpha;
+            instances[i].size[0] = sprites[i].width * scale;
+            instances[i].size[1] = sprites[i].height * scale;
+            instances[i].rotation = previous[i].rotation +
+                (transforms[i].rotation - previous[i].rotation) * alpha;
+            instances[i].color = sprites[i].color;
+        }
+
+        state->batch->count += view->count;
+        return;
+    }
+
+    // Straight loop over two packed columns, the compiler vectorizes the scaling
+    for (uint32_t i = 0; i < view->count; ++i) {
+        instances[i].position[0] = transforms[i].x;
+        instances[i].position[1] = transforms[i].y;
+        instances[i].size[0] = sprites[i].width * transforms[i].scale;
+        instances[i].size[1] = sprites[i].height * transforms[i].scale;
+        instances[i].rotation = transforms[i].rotation;
+        instances[i].color = sprites[i].color;
+    }
+
+    state->batch->count += view->count;
+}
+
+void gather_sprites(struct World *world, const struct SpriteComponents *components, float alpha,
+    struct SpriteBatch *batch)
+{
+    const uint64_t mask = ECS_COMPONENT_BIT(components->transform) |
+        ECS_COMPONENT_BIT(components->sprite);
+    struct GatherState state = {components, alpha, batch};
+
+    batch->count = 0;
+    for_each_chunk(world, mask, &count_sprites, &state);
+
+    if (batch->count > batch->capacity) {
+        while (batch->count > batch->capacity)
+            batch->capacity = batch->capacity > 0 ? batch->capacity * 2 : 1024;
+
+        batch->instances = realloc(batch->instances,
+            batch->capacity * sizeof(struct SpriteInstance));
+    }
+
+    batch->count = 0;
+    for_each_chunk(world, mask, &gather_chunk, &state);
+}
+
+void destroy_sprite_batch(struct SpriteBatch *batch)
+{
+    free(batch->instances);
+}
@@ -0,0 +1,101 @@
+#include <string.h>
+
+#include "debug.h"
+#include "instance.h"
+#include "statistics.h"
+
+// Counters per query, one per bit of STATISTICS_FLAGS
+#define STATISTICS_COUNTER_COUNT 4u
+
+void create_pipeline_statistics(VkDevice device, int enabled, struct PipelineStatistics *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->device = device;
+
+    if (!enabled)
+        return;
+
+    VkQueryPoolCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    info.queryCount = STATISTICS_MAX_QUERIES * FRAMES_IN_FLIGHT;
+    info.pipelineStatistics = STATISTICS_FLAGS;
+
+    assert_vulkan(vkCreateQueryPool(device, &info, NULL, &stats->pool),
+        "Failed to create a Vulkan pipeline statistics query pool!");
+    set_debug_name(device, VK_OBJECT_TYPE_QUERY_POOL, (uint64_t)stats->pool,
+        "pipeline statistics");
+}
+
+static void read_frame(struct PipelineStatistics *stats, uint32_t frame)
+{
+    const uint32_t count = stats->query_counts[frame];
+
+    if (count == 0)
+        return;
+
+    uint64_t results[STATISTICS_MAX_QUERIES * STATISTICS_COUNTER_COUNT];
+
+    // The frame's fence has been waited on, so every written query is available
+    if (vkGetQueryPoolResults(stats->device, stats->pool, frame * STATISTICS_MAX_QUERIES, count,
+        sizeof(results), results, STATISTICS_COUNTER_COUNT * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint64_t *result = &results[i * STATISTICS_COUNTER_COUNT];
+        stats->counts[i].vertex_invocations = result[0];
+        stats->counts[i].clipping_invocations = result[1];
+        stats->counts[i].clipping_primitives = result[2];
+        stats->counts[i].fragment_invocations = result[3];
+    }
+
+    stats->count = count;
+}
+
+void begin_pipeline_statistics(struct PipelineStatistics *stats, VkCommandBuffer buffer,
+    uint32_t frame, uint32_t query_count)
+{
+    stats->frame = frame;
+
+    if (stats->pool == VK_NULL_HANDLE)
+        return;
+
+    read_frame(stats, frame);
+    stats->query_counts[frame] = query_count;
+
+    if (query_count > 0)
+        vkCmdResetQueryPool(buffer, stats->pool, frame * STATISTICS_MAX_QUERIES, query_count);
+}
+
+void begin_statistics_query(struct PipelineStatistics *stats, VkCommandBuffer buffer,
+    uint32_t index)
+{
+    if (stats->pool != VK_NULL_HANDLE)
+        vkCmdBeginQuery(buffer, stats->pool, stats->frame * STATISTICS_MAX_QUERIES + index, 0);
+}
+
+void end_statistics_query(struct PipelineStatistics *stats, VkCommandBuffer buffer,
+    uint32_t index)
+{
+    if (stats->pool != VK_NULL_HANDLE)
+        vkCmdEndQuery(buffer, stats->pool, stats->frame * STATISTICS_MAX_QUERIES + index);
+}
+
+void get_pipeline_totals(const struct PipelineStatistics *stats, struct PipelineCounts *totals)
+{
+    memset(totals, 0, sizeof(*totals));
+
+    for (uint32_t i = 0; i < stats->count; ++i) {
+        totals->vertex_invocations += stats->counts[i].vertex_invocations;
+        totals->clipping_invocations += stats->counts[i].clipping_invocations;
+        totals->clipping_primitives += stats->counts[i].clipping_primitives;
+        totals->fragment_invocations += stats->counts[i].fragment_invocations;
+    }
+}
+
+void destroy_pipeline_statistics(struct PipelineStatistics *stats)
+{
+    if (stats->pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(stats->device, stats->pool, NULL);
+}
@@ -0,0 +1,132 @@
+#include <string.h>
+
+#include "debug.h"
+#include "instance.h"
+#include "timer.h"
+
+#define TIMER_SMOOTHING 0.1
+// Queries of one frame: a begin and an end timestamp per scope
+#define FRAME_QUERY_COUNT (GPU_TIMER_MAX_SCOPES * 2u)
+#define TIMER_MAX_FAMILIES 16u
+
+void create_gpu_timers(VkDevice device, VkPhysicalDevice gpu, uint32_t family,
+    struct GpuTimers *timers)
+{
+    memset(timers, 0, sizeof(*timers));
+    timers->device = device;
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(gpu, &props);
+
+    // Only the first families are written, family indices are small in practice
+    uint32_t family_count = TIMER_MAX_FAMILIES;
+    VkQueueFamilyProperties families[TIMER_MAX_FAMILIES];
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &family_count, families);
+
+    const uint32_t valid_bits = family < family_count ? families[family].timestampValidBits : 0;
+
+    if (valid_bits == 0 || props.limits.timestampPeriod == 0.0f)
+        return;
+
+    timers->period = props.limits.timestampPeriod;
+    timers->valid_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+    VkQueryPoolCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = FRAME_QUERY_COUNT * FRAMES_IN_FLIGHT;
+
+    assert_vulkan(vkCreateQueryPool(device, &info, NULL, &timers->pool),
+        "Failed to create a Vulkan timestamp query pool!");
+    set_debug_name(device, VK_OBJECT_TYPE_QUERY_POOL, (uint64_t)timers->pool, "gpu timers");
+}
+
+static uint32_t find_name(struct GpuTimers *timers, const char *name)
+{
+    for (uint32_t i = 0; i < timers->name_count; ++i)
+        if (strcmp(timers->names[i], name) == 0)
+            return i;
+
+    if (timers->name_count == GPU_TIMER_MAX_SCOPES)
+        print_exit("Failed to begin a GPU timer scope, too many names!");
+
+    timers->names[timers->name_count] = name;
+
+    return timers->name_count++;
+}
+
+static void read_frame(struct GpuTimers *timers, uint32_t frame)
+{
+    struct GpuTimerFrame *scopes = &timers->frames[frame];
+
+    if (scopes->count == 0)
+        return;
+
+    uint64_t results[FRAME_QUERY_COUNT];
+
+    // The frame's fence has been waited on, so every written query is available
+    if (vkGetQueryPoolResults(timers->device, timers->pool, frame * FRAME_QUERY_COUNT,
+        scopes->count * 2, sizeof(results), results, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+
+    for (uint32_t i = 0; i < scopes->count; ++i) {
+        const uint64_t ticks = (results[i * 2 + 1] - results[i * 2]) & timers->valid_mask;
+        const double time = ticks * timers->period * 1e-9;
+        double *average = &timers->times[scopes->scopes[i]];
+
+        *average = *average == 0.0 ? time :
+            *average * (1.0 - TIMER_SMOOTHING) + time * TIMER_SMOOTHING;
+    }
+}
+
+void begin_gpu_timers(struct GpuTimers *timers, VkCommandBuffer buffer, uint32_t frame)
+{
+    timers->frame = frame;
+
+    if (timers->pool == VK_NULL_HANDLE)
+        return;
+
+    read_frame(timers, frame);
+    timers->frames[frame].count = 0;
+    vkCmdResetQueryPool(buffer, timers->pool, frame * FRAME_QUERY_COUNT, FRAME_QUERY_COUNT);
+}
+
+uint32_t begin_gpu_scope(struct GpuTimers *timers, VkCommandBuffer buffer, const char *name)
+{
+    struct GpuTimerFrame *scopes = &timers->frames[timers->frame];
+
+    if (timers->pool == VK_NULL_HANDLE || scopes->count == GPU_TIMER_MAX_SCOPES)
+        return UINT32_MAX;
+
+    const uint32_t scope = scopes->count++;
+    scopes->scopes[scope] = find_name(timers, name);
+    vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timers->pool,
+        timers->frame * FRAME_QUERY_COUNT + scope * 2);
+
+    return scope;
+}
+
+void end_gpu_scope(struct GpuTimers *timers, VkCommandBuffer buffer, uint32_t scope)
+{
+    if (scope == UINT32_MAX)
+        return;
+
+    vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timers->pool,
+        timers->frame * FRAME_QUERY_COUNT + scope * 2 + 1);
+}
+
+double get_gpu_time(const struct GpuTimers *timers, const char *name)
+{
+    for (uint32_t i = 0; i < timers->name_count; ++i)
+        if (strcmp(timers->names[i], name) == 0)
+            return timers->times[i];
+
+    return 0.0;
+}
+
+void destroy_gpu_timers(struct GpuTimers *timers)
+{
+    if (timers->pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(timers->device, timers->pool, NULL);
+}
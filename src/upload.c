@@ -0,0 +1,876 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "decode.h"
+#include "instance.h"
+#include "mips.h"
+#include "upload.h"
+
+void create_uploader(VkDevice device, VkPhysicalDevice gpu, VkQueue queue, uint32_t family,
+    int host_import, uint32_t texture_families, struct Uploader *uploader)
+{
+    memset(uploader, 0, sizeof(*uploader));
+    uploader->device = device;
+    uploader->gpu = gpu;
+    uploader->queue = queue;
+    uploader->texture_families = texture_families;
+
+    VkCommandPoolCreateInfo poolinfo = {};
+    poolinfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolinfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolinfo.queueFamilyIndex = family;
+
+    assert_vulkan(vkCreateCommandPool(device, &poolinfo, NULL, &uploader->pool),
+        "Failed to create a Vulkan upload command pool!");
+
+    VkCommandBufferAllocateInfo allocinfo = {};
+    allocinfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocinfo.commandBufferCount = 1;
+    allocinfo.commandPool = uploader->pool;
+    allocinfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+    assert_vulkan(vkAllocateCommandBuffers(device, &allocinfo, &uploader->buffer),
+        "Failed to allocate a Vulkan upload command buffer!");
+
+    VkFenceCreateInfo feninfo = {};
+    feninfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    assert_vulkan(vkCreateFence(device, &feninfo, NULL, &uploader->fence),
+        "Failed to create a Vulkan fence!");
+
+    create_buffer(device, gpu, UPLOAD_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &uploader->staging);
+    set_debug_name(device, VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)uploader->pool,
+        "upload pool");
+    set_debug_name(device, VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)uploader->buffer,
+        "upload commands");
+    set_debug_name(device, VK_OBJECT_TYPE_FENCE, (uint64_t)uploader->fence, "upload fence");
+    set_debug_name(device, VK_OBJECT_TYPE_BUFFER, (uint64_t)uploader->staging.buffer,
+        "upload staging");
+
+    if (!host_import)
+        return;
+
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostprops = {};
+    hostprops.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 props = {};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &hostprops;
+    vkGetPhysicalDeviceProperties2(gpu, &props);
+
+    uploader->import_alignment = hostprops.minImportedHostPointerAlignment;
+}
+
+int is_texture_format_supported(const struct Uploader *uploader, VkFormat format)
+{
+    const uint32_t family = get_texture_family(format);
+
+    if (family != 0 && !(uploader->texture_families & family))
+        return 0;
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(uploader->gpu, format, &props);
+
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+// True: uploader->imported and uploader->imported_memory should be destroyed
+static int import_pack(struct Uploader *uploader, const struct AssetPack *pack)
+{
+    const VkDeviceSize alignment = uploader->import_alignment;
+
+    if (alignment == 0 || (uintptr_t)pack->data % alignment != 0 ||
+        pack->mapped_size % alignment != 0)
+        return 0;
+
+    PFN_vkGetMemoryHostPointerPropertiesEXT get_properties =
+        (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(uploader->device,
+        "vkGetMemoryHostPointerPropertiesEXT");
+
+    VkMemoryHostPointerPropertiesEXT hostprops = {};
+    hostprops.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+
+    // Some drivers reject read only file mappings, staging still works then
+    if (get_properties == NULL || get_properties(uploader->device,
+        VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, pack->data,
+        &hostprops) != VK_SUCCESS)
+        return 0;
+
+    VkExternalMemoryBufferCreateInfo extinfo = {};
+    extinfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    extinfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+    VkBufferCreateInfo bufinfo = {};
+    bufinfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufinfo.pNext = &extinfo;
+    bufinfo.size = pack->mapped_size;
+    bufinfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufinfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(uploader->device, &bufinfo, NULL, &uploader->imported) != VK_SUCCESS)
+        return 0;
+
+    set_debug_name(uploader->device, VK_OBJECT_TYPE_BUFFER, (uint64_t)uploader->imported,
+        "imported pack");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(uploader->device, uploader->imported, &reqs);
+
+    const uint32_t type_bits = reqs.memoryTypeBits & hostprops.memoryTypeBits;
+
+    VkImportMemoryHostPointerInfoEXT importinfo = {};
+    importinfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+    importinfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    importinfo.pHostPointer = (void *)pack->data;
+
+    VkMemoryAllocateInfo meminfo = {};
+    meminfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    meminfo.pNext = &importinfo;
+    meminfo.allocationSize = pack->mapped_size;
+
+    if (type_bits == 0) {
+        vkDestroyBuffer(uploader->device, uploader->imported, NULL);
+        return 0;
+    }
+
+    meminfo.memoryTypeIndex = find_memory_type(uploader->gpu, type_bits, 0);
+
+    if (vkAllocateMemory(uploader->device, &meminfo, NULL,
+        &uploader->imported_memory) != VK_SUCCESS) {
+        vkDestroyBuffer(uploader->device, uploader->imported, NULL);
+        return 0;
+    }
+
+    if (vkBindBufferMemory(uploader->device, uploader->imported, uploader->imported_memory,
+        0) != VK_SUCCESS) {
+        vkDestroyBuffer(uploader->device, uploader->imported, NULL);
+        vkFreeMemory(uploader->device, uploader->imported_memory, NULL);
+        return 0;
+    }
+
+    return 1;
+}
+
+void begin_pack_uploads(struct Uploader *uploader, const struct AssetPack *pack)
+{
+    end_pack_uploads(uploader);
+
+    if (import_pack(uploader, pack))
+        uploader->imported_pack = pack;
+}
+
+static void begin_recording(struct Uploader *uploader)
+{
+    if (uploader->recording)
+        return;
+
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    assert_vulkan(vkBeginCommandBuffer(uploader->buffer, &info),
+        "Failed to begin a Vulkan upload command buffer!");
+    uploader->recording = 1;
+}
+
+// Copies data into the staging buffer, flushing when it is full, recording is begun
+static VkDeviceSize stage_data(struct Uploader *uploader, const void *data, VkDeviceSize size)
+{
+    if (size > uploader->staging.size)
+        print_exit("Failed to upload an asset, it is larger than the staging buffer!");
+
+    VkDeviceSize start = (uploader->staging_offset + PACK_ALIGNMENT - 1) /
+        PACK_ALIGNMENT * PACK_ALIGNMENT;
+
+    if (start + size > uploader->staging.size) {
+        flush_uploads(uploader);
+        start = 0;
+    }
+
+    begin_recording(uploader);
+    memcpy((uint8_t *)uploader->staging.mapped + start, data, size);
+    uploader->staging_offset = start + size;
+    uploader->staged_bytes += size;
+
+    return start;
+}
+
+/*
+ * Returns the buffer holding size bytes from start of the payload of entry
+ * at *offset, recording is begun
+ */
+static VkBuffer get_source(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, VkDeviceSize start, VkDeviceSize size, VkDeviceSize *offset)
+{
+    if (uploader->imported_pack == pack) {
+        begin_recording(uploader);
+        uploader->imported_bytes += size;
+        *offset = entry->offset + start;
+        return uploader->imported;
+    }
+
+    *offset = stage_data(uploader, get_pack_payload(pack, entry) + start, size);
+
+    return uploader->staging.buffer;
+}
+
+// Fills one copy per level laid out like a pack payload, returns the payload size
+static VkDeviceSize get_level_regions(VkFormat format, uint32_t width, uint32_t height,
+    uint32_t levels, VkBufferImageCopy *regions)
+{
+    VkDeviceSize level_offset = 0;
+    VkDeviceSize payload_size = 0;
+
+    for (uint32_t i = 0; i < levels; ++i) {
+        const uint32_t level_width = width >> i > 0 ? width >> i : 1;
+        const uint32_t level_height = height >> i > 0 ? height >> i : 1;
+
+        memset(&regions[i], 0, sizeof(regions[i]));
+        regions[i].bufferOffset = level_offset;
+        regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        regions[i].imageSubresource.mipLevel = i;
+        regions[i].imageSubresource.layerCount = 1;
+        regions[i].imageExtent.width = level_width;
+        regions[i].imageExtent.height = level_height;
+        regions[i].imageExtent.depth = 1;
+
+        payload_size = level_offset + get_texture_level_size(format, level_width, level_height);
+        level_offset = (payload_size + PACK_LEVEL_ALIGNMENT - 1) / PACK_LEVEL_ALIGNMENT *
+            PACK_LEVEL_ALIGNMENT;
+    }
+
+    return payload_size;
+}
+
+static void begin_level_copy(struct Uploader *uploader, const struct Texture *texture)
+{
+    transition_texture_levels(uploader->buffer, texture, 0, texture->levels,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+}
+
+// Leaves the first ready_levels of texture readable
+static void end_level_copy(struct Uploader *uploader, const struct Texture *texture,
+    uint32_t ready_levels)
+{
+    if (ready_levels > 0)
+        transition_texture_levels(uploader->buffer, texture, 0, ready_levels,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+// Copies region_count levels and leaves the first ready_levels of texture readable
+static void record_level_copy(struct Uploader *uploader, const struct Texture *texture,
+    VkBuffer source, VkDeviceSize offset, VkBufferImageCopy *regions, uint32_t region_count,
+    uint32_t ready_levels)
+{
+    for (uint32_t i = 0; i < region_count; ++i)
+        regions[i].bufferOffset += offset;
+
+    begin_level_copy(uploader, texture);
+    vkCmdCopyBufferToImage(uploader->buffer, source, texture->image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, region_count, regions);
+    end_level_copy(uploader, texture, ready_levels);
+}
+
+/*
+ * Same as record_level_copy() with regions offset into data on the CPU. Each
+ * level is staged on its own, levels larger than the staging buffer in runs
+ * of block rows, so chains of any size fit through it.
+ */
+static void record_staged_level_copy(struct Uploader *uploader, const struct Texture *texture,
+    const uint8_t *data, const VkBufferImageCopy *regions, uint32_t region_count,
+    uint32_t ready_levels)
+{
+    // Every compressed format assets use has 4x4 blocks
+    const uint32_t block = get_texture_family(texture->format) != 0 ? 4 : 1;
+
+    begin_recording(uploader);
+    begin_level_copy(uploader, texture);
+
+    for (uint32_t i = 0; i < region_count; ++i) {
+        const VkExtent3D extent = regions[i].imageExtent;
+        const VkDeviceSize row_size = get_texture_level_size(texture->format, extent.width,
+            block);
+        const uint32_t rows = (extent.height + block - 1) / block;
+        const VkDeviceSize run = uploader->staging.size / row_size;
+
+        if (run == 0)
+            print_exit("Failed to upload an asset, a row is larger than the staging buffer!");
+
+        for (uint32_t row = 0; row < rows; row += (uint32_t)run) {
+            const uint32_t count = rows - row < run ? rows - row : (uint32_t)run;
+            const uint32_t top = row * block;
+
+            VkBufferImageCopy copy = regions[i];
+            copy.bufferOffset = stage_data(uploader, data + regions[i].bufferOffset +
+                row * row_size, count * row_size);
+            copy.imageOffset.y = top;
+            copy.imageExtent.height = count * block < extent.height - top ? count * block :
+                extent.height - top;
+
+            vkCmdCopyBufferToImage(uploader->buffer, uploader->staging.buffer, texture->image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+        }
+    }
+
+    end_level_copy(uploader, texture, ready_levels);
+}
+
+/*
+ * Copies region_count levels of entry, straight from an imported pack or
+ * staged level by level
+ */
+static void record_pack_level_copy(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, const struct Texture *texture, VkBufferImageCopy *regions,
+    uint32_t region_count, uint32_t ready_levels)
+{
+    if (uploader->imported_pack != pack) {
+        record_staged_level_copy(uploader, texture, get_pack_payload(pack, entry), regions,
+            region_count, ready_levels);
+        return;
+    }
+
+    VkDeviceSize offset = 0;
+    const VkBuffer source = get_source(uploader, pack, entry, 0, entry->size, &offset);
+    record_level_copy(uploader, texture, source, offset, regions, region_count, ready_levels);
+}
+
+// Exits unless entry is a texture whose payload holds every level in regions
+static void check_texture_entry(const struct PackEntry *entry, VkBufferImageCopy *regions)
+{
+    if (entry->type != PACK_ENTRY_TEXTURE || entry->levels == 0 ||
+        entry->levels > UPLOAD_MAX_LEVELS)
+        print_exit("Failed to upload an asset, it is not a valid texture!");
+
+    if (get_level_regions(entry->format, entry->width, entry->height, entry->levels,
+        regions) > entry->size)
+        print_exit("Failed to upload an asset, texture payload is truncated!");
+}
+
+// Textures are named after their pack entry
+static void name_texture(struct Uploader *uploader, const struct PackEntry *entry,
+    const struct Texture *texture)
+{
+    set_debug_name(uploader->device, VK_OBJECT_TYPE_IMAGE, (uint64_t)texture->image, "%s",
+        entry->name);
+    set_debug_name(uploader->device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)texture->view,
+        "%s view", entry->name);
+}
+
+static void report_texture(struct Uploader *uploader, const struct PackEntry *entry,
+    VkFormat format, VkDeviceSize size)
+{
+    VkBufferImageCopy regions[UPLOAD_MAX_LEVELS];
+    const VkDeviceSize rgba_size = get_level_regions(VK_FORMAT_R8G8B8A8_UNORM, entry->width,
+        entry->height, entry->levels, regions);
+
+    uploader->texture_bytes += size;
+    uploader->uncompressed_bytes += rgba_size;
+
+    if (uploader->report)
+        printf("Texture %s: %s, %llu KiB, %llu KiB as RGBA8, %.0f%% saved%s\n",
+            entry->name, get_texture_format_name(format), (unsigned long long)size / 1024,
+            (unsigned long long)rgba_size / 1024, 100.0 - 100.0 * size / rgba_size,
+            format != entry->format ? ", decoded on the CPU" : "");
+}
+
+static void *decode_texture(void *data)
+{
+    struct DecodeJob *job = data;
+    const struct PackEntry *entry = job->entry;
+    VkBufferImageCopy src_regions[UPLOAD_MAX_LEVELS];
+    VkBufferImageCopy dst_regions[UPLOAD_MAX_LEVELS];
+
+    get_level_regions(entry->format, entry->width, entry->height, entry->levels, src_regions);
+    get_level_regions(job->texture->format, entry->width, entry->height, entry->levels,
+        dst_regions);
+
+    for (uint32_t i = 0; i < entry->levels; ++i)
+        decode_texture_level(entry->format, src_regions[i].imageExtent.width,
+            src_regions[i].imageExtent.height, job->src + src_regions[i].bufferOffset,
+            job->pixels + dst_regions[i].bufferOffset);
+
+    return NULL;
+}
+
+static void queue_decode(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, struct Texture *texture)
+{
+    if (uploader->decode_count == UPLOAD_MAX_DECODES)
+        flush_uploads(uploader);
+
+    const VkFormat format = get_decoded_format(entry->format);
+    const VkExtent2D extent = {entry->width, entry->height};
+    create_texture(uploader->device, uploader->gpu, format, extent, entry->levels,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, texture);
+    name_texture(uploader, entry, texture);
+
+    VkBufferImageCopy regions[UPLOAD_MAX_LEVELS];
+    struct DecodeJob *job = &uploader->decodes[uploader->decode_count++];
+    job->entry = entry;
+    job->src = get_pack_payload(pack, entry);
+    job->size = get_level_regions(format, entry->width, entry->height, entry->levels, regions);
+    job->pixels = malloc(job->size);
+    job->texture = texture;
+
+    if (pthread_create(&job->thread, NULL, &decode_texture, job) != 0)
+        print_exit("Failed to start a texture decode thread!");
+}
+
+void upload_pack_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, struct Texture *texture)
+{
+    VkBufferImageCopy regions[UPLOAD_MAX_LEVELS];
+    check_texture_entry(entry, regions);
+
+    if (!is_texture_format_supported(uploader, entry->format)) {
+        if (!can_decode_texture(entry->format))
+            print_exit("Failed to upload an asset, its format is unsupported and undecodable!");
+
+        queue_decode(uploader, pack, entry, texture);
+        return;
+    }
+
+    const VkExtent2D extent = {entry->width, entry->height};
+    create_texture(uploader->device, uploader->gpu, entry->format, extent, entry->levels,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, texture);
+    name_texture(uploader, entry, texture);
+    record_pack_level_copy(uploader, pack, entry, texture, regions, entry->levels,
+        entry->levels);
+    report_texture(uploader, entry, entry->format, entry->size);
+}
+
+void upload_pack_texture_mipmapped(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, struct Texture *texture)
+{
+    const VkExtent2D extent = {entry->width, entry->height};
+    const uint32_t levels = get_mip_count(extent);
+    const enum MipPath path = uploader->mips != NULL ?
+        get_mip_path(uploader->mips, entry->format) : MIP_PATH_NONE;
+
+    if (path == MIP_PATH_NONE || entry->levels >= levels ||
+        !is_texture_format_supported(uploader, entry->format)) {
+        upload_pack_texture(uploader, pack, entry, texture);
+        return;
+    }
+
+    VkBufferImageCopy regions[UPLOAD_MAX_LEVELS];
+    check_texture_entry(entry, regions);
+
+    if (!has_mip_capacity(uploader->mips, levels))
+        flush_uploads(uploader);
+
+    create_texture(uploader->device, uploader->gpu, entry->format, extent, levels,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | get_mip_usage(path),
+        texture);
+    name_texture(uploader, entry, texture);
+    record_pack_level_copy(uploader, pack, entry, texture, regions, entry->levels,
+        entry->levels - 1);
+    record_mip_generation(uploader->mips, uploader->buffer, texture, entry->levels - 1);
+    report_texture(uploader, entry, entry->format, entry->size);
+}
+
+// Joins every decode thread and stages the decoded chains
+static void finish_decodes(struct Uploader *uploader)
+{
+    struct DecodeJob decodes[UPLOAD_MAX_DECODES];
+    const uint32_t count = uploader->decode_count;
+
+    // Staging may flush, which must not see these jobs again
+    memcpy(decodes, uploader->decodes, count * sizeof(struct DecodeJob));
+    uploader->decode_count = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        struct DecodeJob *job = &decodes[i];
+        pthread_join(job->thread, NULL);
+
+        VkBufferImageCopy regions[UPLOAD_MAX_LEVELS];
+        get_level_regions(job->texture->format, job->entry->width, job->entry->height,
+            job->entry->levels, regions);
+
+        record_staged_level_copy(uploader, job->texture, job->pixels, regions,
+            job->entry->levels, job->entry->levels);
+        report_texture(uploader, job->entry, job->texture->format, job->size);
+        free(job->pixels);
+    }
+}
+
+static uint32_t get_level_dimension(uint32_t size, uint32_t level)
+{
+    return size >> level > 0 ? size >> level : 1;
+}
+
+/*
+ * Fills regions up to last like get_level_regions() and returns the bytes
+ * levels first to last - 1 take in the payload of entry
+ */
+static VkDeviceSize get_level_range(const struct PackEntry *entry, uint32_t first,
+    uint32_t last, VkBufferImageCopy *regions)
+{
+    const VkDeviceSize end = get_level_regions(entry->format, entry->width, entry->height,
+        last, regions);
+
+    return end - regions[first].bufferOffset;
+}
+
+/*
+ * Copies levels first to last - 1 of entry into levels 0 onwards of texture,
+ * level first starts at offset in source
+ */
+static void record_level_range(VkCommandBuffer buffer, const struct Texture *texture,
+    VkBuffer source, VkDeviceSize offset, VkBufferImageCopy *regions, uint32_t first,
+    uint32_t last)
+{
+    const VkDeviceSize start = regions[first].bufferOffset;
+
+    for (uint32_t i = first; i < last; ++i) {
+        regions[i].bufferOffset += offset - start;
+        regions[i].imageSubresource.mipLevel = i - first;
+    }
+
+    vkCmdCopyBufferToImage(buffer, source, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        last - first, &regions[first]);
+}
+
+// texture holds levels first onwards of entry
+static void create_level_texture(struct Uploader *uploader, const struct PackEntry *entry,
+    uint32_t first, struct Texture *texture)
+{
+    const VkExtent2D extent = {
+        get_level_dimension(entry->width, first),
+        get_level_dimension(entry->height, first)
+    };
+
+    create_texture(uploader->device, uploader->gpu, entry->format, extent,
+        entry->levels - first, VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, texture);
+    name_texture(uploader, entry, texture);
+}
+
+static void begin_level_texture(VkCommandBuffer buffer, const struct Texture *texture)
+{
+    transition_texture_levels(buffer, texture, 0, texture->levels,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+}
+
+static void finish_level_texture(VkCommandBuffer buffer, const struct Texture *texture)
+{
+    transition_texture_levels(buffer, texture, 0, texture->levels,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+void create_streamed_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, uint32_t resident_size, struct StreamedTexture *streamed)
+{
+    memset(streamed, 0, sizeof(*streamed));
+    streamed->entry = entry;
+
+    VkBufferImageCopy regions[UPLOAD_MAX_LEVELS];
+    check_texture_entry(entry, regions);
+
+    /*
+     * Decoded textures are rebuilt on the CPU, streaming them would decode
+     * every level twice. A partial chain lacks the coarse levels streaming
+     * keeps resident, they are generated instead.
+     */
+    const VkExtent2D extent = {entry->width, entry->height};
+
+    if (!is_texture_format_supported(uploader, entry->format) ||
+        entry->levels < get_mip_count(extent)) {
+        upload_pack_texture_mipmapped(uploader, pack, entry, &streamed->texture);
+        return;
+    }
+
+    uint32_t first = 0;
+
+    while (first + 1 < entry->levels && (get_level_dimension(entry->width, first) >
+        resident_size || get_level_dimension(entry->height, first) > resident_size))
+        ++first;
+
+    create_level_texture(uploader, entry, first, &streamed->texture);
+
+    const VkDeviceSize size = get_level_range(entry, first, entry->levels, regions);
+    VkDeviceSize offset = 0;
+    const VkBuffer source = get_source(uploader, pack, entry, regions[first].bufferOffset, size,
+        &offset);
+
+    begin_level_texture(uploader->buffer, &streamed->texture);
+    record_level_range(uploader->buffer, &streamed->texture, source, offset, regions, first,
+        entry->levels);
+    finish_level_texture(uploader->buffer, &streamed->texture);
+
+    streamed->resident_level = first;
+    streamed->wanted_level = first;
+
+    if (uploader->report)
+        printf("Texture %s: streaming, %u of %u levels resident\n", entry->name,
+            entry->levels - first, entry->levels);
+}
+
+void request_texture_detail(struct StreamedTexture *streamed, float scale)
+{
+    if (scale <= 0.0f)
+        return;
+
+    // Sampling stays at or below one texel per pixel from the wanted level
+    uint32_t level = 0;
+
+    for (float texels = 1.0f / scale; texels >= 2.0f && level + 1 < streamed->entry->levels;
+        texels *= 0.5f)
+        ++level;
+
+    if (level < streamed->wanted_level)
+        streamed->wanted_level = level;
+}
+
+// streamed->buffer and streamed->fence are created on the first growth
+static void create_growth_commands(struct Uploader *uploader, struct StreamedTexture *streamed)
+{
+    VkCommandBufferAllocateInfo allocinfo = {};
+    allocinfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocinfo.commandBufferCount = 1;
+    allocinfo.commandPool = uploader->pool;
+    allocinfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+    assert_vulkan(vkAllocateCommandBuffers(uploader->device, &allocinfo, &streamed->buffer),
+        "Failed to allocate a Vulkan upload command buffer!");
+
+    VkFenceCreateInfo feninfo = {};
+    feninfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    assert_vulkan(vkCreateFence(uploader->device, &feninfo, NULL, &streamed->fence),
+        "Failed to create a Vulkan fence!");
+    set_debug_name(uploader->device, VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)streamed->buffer,
+        "%s streaming", streamed->entry->name);
+    set_debug_name(uploader->device, VK_OBJECT_TYPE_FENCE, (uint64_t)streamed->fence,
+        "%s streaming fence", streamed->entry->name);
+}
+
+/*
+ * Submits the growth without waiting for it. The new texture gets the
+ * requested levels from a staging buffer of its own, so the uploader stays
+ * free for other work, and the resident ones copied on the GPU, so nothing
+ * already uploaded is read again.
+ */
+static void grow_streamed_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    struct StreamedTexture *streamed)
+{
+    const struct PackEntry *entry = streamed->entry;
+    const uint32_t first = streamed->wanted_level;
+    const uint32_t shift = streamed->resident_level - first;
+    const struct Texture *old = &streamed->texture;
+
+    if (streamed->buffer == VK_NULL_HANDLE)
+        create_growth_commands(uploader, streamed);
+
+    VkBufferImageCopy regions[UPLOAD_MAX_LEVELS];
+    const VkDeviceSize size = get_level_range(entry, first, streamed->resident_level, regions);
+
+    create_buffer(uploader->device, uploader->gpu, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &streamed->staging);
+    set_debug_name(uploader->device, VK_OBJECT_TYPE_BUFFER, (uint64_t)streamed->staging.buffer,
+        "%s streaming staging", entry->name);
+    memcpy(streamed->staging.mapped, get_pack_payload(pack, entry) + regions[first].bufferOffset,
+        size);
+    uploader->staged_bytes += size;
+
+    create_level_texture(uploader, entry, first, &streamed->grown);
+
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    assert_vulkan(vkBeginCommandBuffer(streamed->buffer, &info),
+        "Failed to begin a Vulkan upload command buffer!");
+    begin_level_texture(streamed->buffer, &streamed->grown);
+    record_level_range(streamed->buffer, &streamed->grown, streamed->staging.buffer, 0,
+        regions, first, streamed->resident_level);
+    transition_texture_levels(streamed->buffer, old, 0, old->levels,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkImageCopy copies[UPLOAD_MAX_LEVELS];
+
+    for (uint32_t i = 0; i < old->levels; ++i) {
+        memset(&copies[i], 0, sizeof(copies[i]));
+        copies[i].srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copies[i].srcSubresource.mipLevel = i;
+        copies[i].srcSubresource.layerCount = 1;
+        copies[i].dstSubresource = copies[i].srcSubresource;
+        copies[i].dstSubresource.mipLevel = i + shift;
+        copies[i].extent.width = get_level_dimension(old->extent.width, i);
+        copies[i].extent.height = get_level_dimension(old->extent.height, i);
+        copies[i].extent.depth = 1;
+    }
+
+    vkCmdCopyImage(streamed->buffer, old->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        streamed->grown.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, old->levels, copies);
+    // Frames submitted until the swap still sample the old texture
+    transition_texture_levels(streamed->buffer, old, 0, old->levels,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    finish_level_texture(streamed->buffer, &streamed->grown);
+    assert_vulkan(vkEndCommandBuffer(streamed->buffer),
+        "Failed to end a Vulkan upload command buffer!");
+
+    VkSubmitInfo submit = {};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &streamed->buffer;
+
+    assert_vulkan(vkQueueSubmit(uploader->queue, 1, &submit, streamed->fence),
+        "Failed to submit Vulkan uploads!");
+
+    streamed->grown_level = first;
+    streamed->growing = 1;
+}
+
+// Swaps in the grown texture, the old one is retired until frames in flight no longer sample it
+static void finish_growth(struct Uploader *uploader, struct StreamedTexture *streamed)
+{
+    vkResetFences(uploader->device, 1, &streamed->fence);
+    destroy_buffer(uploader->device, &streamed->staging);
+
+    if (uploader->report)
+        printf("Texture %s: streamed in levels %u to %u\n", streamed->entry->name,
+            streamed->grown_level, streamed->resident_level - 1);
+
+    streamed->retired = streamed->texture;
+    streamed->retire_countdown = FRAMES_IN_FLIGHT + 1;
+    streamed->texture = streamed->grown;
+    streamed->resident_level = streamed->grown_level;
+    streamed->growing = 0;
+}
+
+int update_streamed_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    struct StreamedTexture *streamed)
+{
+    if (streamed->retire_countdown > 0 && --streamed->retire_countdown == 0)
+        destroy_texture(uploader->device, &streamed->retired);
+
+    if (streamed->growing) {
+        if (vkGetFenceStatus(uploader->device, streamed->fence) != VK_SUCCESS)
+            return 0;
+
+        finish_growth(uploader, streamed);
+        return 1;
+    }
+
+    // One replacement at a time keeps at most two copies alive
+    if (streamed->wanted_level < streamed->resident_level && streamed->retire_countdown == 0)
+        grow_streamed_texture(uploader, pack, streamed);
+
+    return 0;
+}
+
+void destroy_streamed_texture(struct Uploader *uploader, struct StreamedTexture *streamed)
+{
+    if (streamed->growing) {
+        vkWaitForFences(uploader->device, 1, &streamed->fence, VK_TRUE, UINT64_MAX);
+        destroy_buffer(uploader->device, &streamed->staging);
+        destroy_texture(uploader->device, &streamed->grown);
+    }
+
+    if (streamed->buffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(uploader->device, uploader->pool, 1, &streamed->buffer);
+        vkDestroyFence(uploader->device, streamed->fence, NULL);
+    }
+
+    if (streamed->retire_countdown > 0)
+        destroy_texture(uploader->device, &streamed->retired);
+
+    destroy_texture(uploader->device, &streamed->texture);
+}
+
+void upload_pack_buffer(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, VkBufferUsageFlags usage, struct GpuBuffer *buffer)
+{
+    create_buffer(uploader->device, uploader->gpu, entry->size,
+        usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer);
+    set_debug_name(uploader->device, VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer->buffer, "%s",
+        entry->name);
+
+    VkBufferCopy region = {};
+    region.size = entry->size;
+
+    const VkBuffer source = get_source(uploader, pack, entry, 0, entry->size,
+        &region.srcOffset);
+    vkCmdCopyBuffer(uploader->buffer, source, buffer->buffer, 1, &region);
+}
+
+void flush_uploads(struct Uploader *uploader)
+{
+    finish_decodes(uploader);
+
+    if (!uploader->recording)
+        return;
+
+    // Makes buffer copies visible to whatever reads them in later submissions
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+    vkCmdPipelineBarrier(uploader->buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+    assert_vulkan(vkEndCommandBuffer(uploader->buffer),
+        "Failed to end a Vulkan upload command buffer!");
+
+    VkSubmitInfo submit = {};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &uploader->buffer;
+
+    assert_vulkan(vkQueueSubmit(uploader->queue, 1, &submit, uploader->fence),
+        "Failed to submit Vulkan uploads!");
+    vkWaitForFences(uploader->device, 1, &uploader->fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(uploader->device, 1, &uploader->fence);
+    vkResetCommandBuffer(uploader->buffer, 0);
+
+    if (uploader->mips != NULL)
+        reset_mip_generator(uploader->mips);
+
+    uploader->recording = 0;
+    uploader->staging_offset = 0;
+}
+
+void end_pack_uploads(struct Uploader *uploader)
+{
+    flush_uploads(uploader);
+
+    if (uploader->imported_pack == NULL)
+        return;
+
+    vkDestroyBuffer(uploader->device, uploader->imported, NULL);
+    vkFreeMemory(uploader->device, uploader->imported_memory, NULL);
+    uploader->imported_pack = NULL;
+}
+
+void destroy_uploader(struct Uploader *uploader)
+{
+    end_pack_uploads(uploader);
+
+    if (uploader->report && uploader->uncompressed_bytes > 0)
+        printf("Textures: %llu KiB, %llu KiB as RGBA8\n",
+            (unsigned long long)uploader->texture_bytes / 1024,
+            (unsigned long long)uploader->uncompressed_bytes / 1024);
+
+    destroy_buffer(uploader->device, &uploader->staging);
+    vkDestroyFence(uploader->device, uploader->fence, NULL);
+    vkDestroyCommandPool(uploader->device, uploader->pool, NULL);
+}
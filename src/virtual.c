@@ -0,0 +1,660 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "instance.h"
+#include "mips.h"
+#include "virtual.h"
+
+#define PINNED_SLOT 0u
+#define MIN_SLOT_COUNT 2u
+
+static uint32_t get_level_dimension(uint32_t size, uint32_t level)
+{
+    return size >> level > 0 ? size >> level : 1;
+}
+
+static uint32_t get_level_pages(uint32_t size, uint32_t level)
+{
+    return (get_level_dimension(size, level) + VIRTUAL_PAGE_SIZE - 1) / VIRTUAL_PAGE_SIZE;
+}
+
+static uint32_t get_page_index(const struct VirtualTexture *texture, uint32_t level,
+    uint32_t x, uint32_t y)
+{
+    return texture->header.level_offsets[level] + y * texture->header.level_pages[level] + x;
+}
+
+static void get_page_location(const struct VirtualTexture *texture, uint32_t page,
+    uint32_t *level, uint32_t *x, uint32_t *y)
+{
+    const struct VirtualHeader *header = &texture->header;
+
+    *level = texture->level_count - 1;
+
+    while (*level > 0 && header->level_offsets[*level] > page)
+        --*level;
+
+    const uint32_t local = page - header->level_offsets[*level];
+    *x = local % header->level_pages[*level];
+    *y = local / header->level_pages[*level];
+}
+
+// Block rows of one page plus its border, edges repeat the outermost blocks
+static void read_page(const struct VirtualTexture *texture, uint32_t page, uint8_t *dst)
+{
+    uint32_t level, page_x, page_y;
+    get_page_location(texture, page, &level, &page_x, &page_y);
+
+    const uint32_t block = texture->block_size;
+    const uint32_t bytes = texture->block_bytes;
+    const uint32_t width = (get_level_dimension(texture->entry->width, level) + block - 1) /
+        block;
+    const uint32_t height = (get_level_dimension(texture->entry->height, level) + block - 1) /
+        block;
+    const uint32_t slot = VIRTUAL_SLOT_SIZE / block;
+    const int32_t x0 = ((int32_t)(page_x * VIRTUAL_PAGE_SIZE) - (int32_t)VIRTUAL_PAGE_BORDER) /
+        (int32_t)block;
+    const int32_t y0 = ((int32_t)(page_y * VIRTUAL_PAGE_SIZE) - (int32_t)VIRTUAL_PAGE_BORDER) /
+        (int32_t)block;
+    const uint8_t *level_data = get_pack_payload(texture->pack, texture->entry) +
+        texture->level_offsets[level];
+
+    const int32_t lo = x0 > 0 ? x0 : 0;
+    const int32_t hi = x0 + (int32_t)slot < (int32_t)width ? x0 + (int32_t)slot :
+        (int32_t)width;
+
+    for (uint32_t row = 0; row < slot; ++row, dst += (size_t)slot * bytes) {
+        int32_t y = y0 + (int32_t)row;
+        y = y < 0 ? 0 : y >= (int32_t)height ? (int32_t)height - 1 : y;
+
+        const uint8_t *src = level_data + (size_t)y * width * bytes;
+        uint32_t column = 0;
+
+        for (; (int32_t)column < lo - x0; ++column)
+            memcpy(dst + column * bytes, src, bytes);
+
+        memcpy(dst + column * bytes, src + (size_t)lo * bytes, (size_t)(hi - lo) * bytes);
+        column += hi - lo;
+
+        for (; column < slot; ++column)
+            memcpy(dst + column * bytes, src + (size_t)(width - 1) * bytes, bytes);
+    }
+}
+
+/*
+ * Reading the pack mapping faults pages in from disk, which is why it
+ * happens here and never on the thread recording frames
+ */
+static void *stream_pages(void *data)
+{
+    struct VirtualTexture *texture = data;
+
+    pthread_mutex_lock(&texture->lock);
+
+    while (texture->running) {
+        uint32_t staging = VIRTUAL_STAGING_PAGES;
+
+        for (uint32_t i = 0; i < VIRTUAL_STAGING_PAGES && texture->request_count > 0; ++i)
+            if (texture->staging_pages[i].state == VIRTUAL_STAGING_FREE) {
+                staging = i;
+                break;
+            }
+
+        if (staging == VIRTUAL_STAGING_PAGES) {
+            pthread_cond_wait(&texture->wake, &texture->lock);
+            continue;
+        }
+
+        const uint32_t page = texture->requests[texture->request_start];
+        texture->request_start = (texture->request_start + 1) % VIRTUAL_MAX_REQUESTS;
+        --texture->request_count;
+        texture->staging_pages[staging].state = VIRTUAL_STAGING_FILLING;
+        texture->staging_pages[staging].page = page;
+        pthread_mutex_unlock(&texture->lock);
+
+        read_page(texture, page,
+            (uint8_t *)texture->staging.mapped + staging * texture->staging_page_size);
+
+        pthread_mutex_lock(&texture->lock);
+        texture->staging_pages[staging].state = VIRTUAL_STAGING_READY;
+    }
+
+    pthread_mutex_unlock(&texture->lock);
+
+    return NULL;
+}
+
+static void unlink_slot(struct VirtualTexture *texture, uint32_t slot)
+{
+    const uint32_t prev = texture->slot_prev[slot];
+    const uint32_t next = texture->slot_next[slot];
+
+    if (prev != UINT32_MAX)
+        texture->slot_next[prev] = next;
+    else
+        texture->lru_head = next;
+
+    if (next != UINT32_MAX)
+        texture->slot_prev[next] = prev;
+    else
+        texture->lru_tail = prev;
+}
+
+// Moves slot to the most recently used end
+static void touch_slot(struct VirtualTexture *texture, uint32_t slot)
+{
+    texture->slot_used[slot] = texture->frames;
+
+    if (texture->lru_head == slot)
+        return;
+
+    unlink_slot(texture, slot);
+    texture->slot_prev[slot] = UINT32_MAX;
+    texture->slot_next[slot] = texture->lru_head;
+    texture->slot_prev[texture->lru_head] = slot;
+    texture->lru_head = slot;
+}
+
+// Every slot but the pinned one starts free at the least recently used end
+static void create_slots(struct VirtualTexture *texture)
+{
+    texture->slot_pages = malloc(texture->slot_count * sizeof(uint32_t));
+    texture->slot_prev = malloc(texture->slot_count * sizeof(uint32_t));
+    texture->slot_next = malloc(texture->slot_count * sizeof(uint32_t));
+    texture->slot_used = calloc(texture->slot_count, sizeof(uint64_t));
+
+    for (uint32_t i = 0; i < texture->slot_count; ++i) {
+        texture->slot_pages[i] = UINT32_MAX;
+        texture->slot_prev[i] = i > PINNED_SLOT + 1 ? i - 1 : UINT32_MAX;
+        texture->slot_next[i] = i + 1 < texture->slot_count ? i + 1 : UINT32_MAX;
+    }
+
+    texture->lru_head = PINNED_SLOT + 1;
+    texture->lru_tail = texture->slot_count - 1;
+}
+
+/*
+ * Rewrites the entries of page and of every page below it that resolves to
+ * an ancestor, stopping at resident pages which resolve to themselves
+ */
+static void resolve_page(struct VirtualTexture *texture, uint32_t level, uint32_t x,
+    uint32_t y, uint32_t parent_entry)
+{
+    const uint32_t page = get_page_index(texture, level, x, y);
+    const uint32_t slot = texture->page_slots[page];
+    const uint32_t entry = slot != UINT32_MAX ?
+        VIRTUAL_ENTRY_VALID | level << VIRTUAL_ENTRY_LEVEL_SHIFT | slot : parent_entry;
+
+    texture->entries[page] = entry;
+
+    if (level == 0)
+        return;
+
+    const uint32_t pages_x = get_level_pages(texture->entry->width, level - 1);
+    const uint32_t pages_y = get_level_pages(texture->entry->height, level - 1);
+
+    for (uint32_t child_y = y * 2; child_y < y * 2 + 2 && child_y < pages_y; ++child_y)
+        for (uint32_t child_x = x * 2; child_x < x * 2 + 2 && child_x < pages_x; ++child_x)
+            if (texture->page_slots[get_page_index(texture, level - 1, child_x, child_y)] ==
+                UINT32_MAX)
+                resolve_page(texture, level - 1, child_x, child_y, entry);
+}
+
+static void update_page_entries(struct VirtualTexture *texture, uint32_t page)
+{
+    uint32_t level, x, y;
+    get_page_location(texture, page, &level, &x, &y);
+
+    const uint32_t parent_entry = level + 1 < texture->level_count ?
+        texture->entries[get_page_index(texture, level + 1, x / 2, y / 2)] : 0;
+
+    resolve_page(texture, level, x, y, parent_entry);
+    ++texture->version;
+}
+
+static void create_page_buffers(struct VirtualTexture *texture, VkPhysicalDevice gpu)
+{
+    const VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    texture->feedback_size = (texture->page_count + 31) / 32 * sizeof(uint32_t);
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        create_buffer(texture->device, gpu,
+            sizeof(struct VirtualHeader) + texture->page_count * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host, &texture->page_tables[i]);
+        create_buffer(texture->device, gpu, texture->feedback_size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host, &texture->feedback[i]);
+        set_debug_name(texture->device, VK_OBJECT_TYPE_BUFFER,
+            (uint64_t)texture->page_tables[i].buffer, "%s page table %u", texture->entry->name, i);
+        set_debug_name(texture->device, VK_OBJECT_TYPE_BUFFER,
+            (uint64_t)texture->feedback[i].buffer, "%s feedback %u", texture->entry->name, i);
+
+        memcpy(texture->page_tables[i].mapped, &texture->header, sizeof(texture->header));
+        memset(texture->feedback[i].mapped, 0, texture->feedback_size);
+        // Forces the first update to write the entries
+        texture->frame_versions[i] = UINT64_MAX;
+    }
+}
+
+static void create_cache(struct VirtualTexture *texture, VkPhysicalDevice gpu,
+    VkDeviceSize budget)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(gpu, &props);
+
+    const VkDeviceSize slot_bytes = (VkDeviceSize)(VIRTUAL_SLOT_SIZE / texture->block_size) *
+        (VIRTUAL_SLOT_SIZE / texture->block_size) * texture->block_bytes;
+    const uint32_t max_slots_per_row = props.limits.maxImageDimension2D / VIRTUAL_SLOT_SIZE;
+    uint64_t slot_count = budget / slot_bytes;
+
+    if (slot_count < MIN_SLOT_COUNT)
+        slot_count = MIN_SLOT_COUNT;
+    if (slot_count > (uint64_t)max_slots_per_row * max_slots_per_row)
+        slot_count = (uint64_t)max_slots_per_row * max_slots_per_row;
+    if (slot_count > VIRTUAL_ENTRY_SLOT_MASK)
+        slot_count = VIRTUAL_ENTRY_SLOT_MASK;
+
+    uint32_t per_row = 1;
+
+    while ((uint64_t)per_row * per_row < slot_count)
+        ++per_row;
+
+    texture->slot_count = (uint32_t)slot_count;
+    texture->slots_per_row = per_row;
+
+    const VkExtent2D extent = {
+        per_row * VIRTUAL_SLOT_SIZE,
+        (texture->slot_count + per_row - 1) / per_row * VIRTUAL_SLOT_SIZE
+    };
+
+    create_texture(texture->device, gpu, texture->entry->format, extent, 1,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, &texture->cache);
+    set_debug_name(texture->device, VK_OBJECT_TYPE_IMAGE, (uint64_t)texture->cache.image,
+        "%s page cache", texture->entry->name);
+    set_debug_name(texture->device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)texture->cache.view,
+        "%s page cache view", texture->entry->name);
+
+    texture->header.slots_per_row = per_row;
+    texture->header.cache_width = extent.width;
+    texture->header.cache_height = extent.height;
+}
+
+// Fills the level layout of the pack payload and the page table header
+static void create_levels(struct VirtualTexture *texture)
+{
+    const struct PackEntry *entry = texture->entry;
+    struct VirtualHeader *header = &texture->header;
+    VkDeviceSize offset = 0;
+
+    texture->level_count = 0;
+    texture->page_count = 0;
+
+    for (uint32_t i = 0; i < entry->levels && i < VIRTUAL_MAX_LEVELS; ++i) {
+        const uint32_t width = get_level_dimension(entry->width, i);
+        const uint32_t height = get_level_dimension(entry->height, i);
+
+        texture->level_offsets[i] = offset;
+        header->level_offsets[i] = texture->page_count;
+        header->level_pages[i] = get_level_pages(entry->width, i);
+        texture->page_count += header->level_pages[i] * get_level_pages(entry->height, i);
+        ++texture->level_count;
+
+        if (width <= VIRTUAL_PAGE_SIZE && height <= VIRTUAL_PAGE_SIZE)
+            break;
+
+        offset = (offset + get_texture_level_size(entry->format, width, height) +
+            PACK_LEVEL_ALIGNMENT - 1) / PACK_LEVEL_ALIGNMENT * PACK_LEVEL_ALIGNMENT;
+    }
+
+    const uint32_t last = texture->level_count - 1;
+
+    if (get_level_dimension(entry->width, last) > VIRTUAL_PAGE_SIZE ||
+        get_level_dimension(entry->height, last) > VIRTUAL_PAGE_SIZE) {
+        printf("Failed to create virtual texture %s, its levels stop above one page\n",
+            entry->name);
+        exit(-1);
+    }
+
+    header->width = entry->width;
+    header->height = entry->height;
+    header->level_count = texture->level_count;
+    header->page_size = VIRTUAL_PAGE_SIZE;
+    header->border = VIRTUAL_PAGE_BORDER;
+}
+
+static void queue_page(struct VirtualTexture *texture, uint32_t page)
+{
+    const uint32_t end = (texture->request_start + texture->request_count) %
+        VIRTUAL_MAX_REQUESTS;
+
+    texture->requests[end] = page;
+    ++texture->request_count;
+    texture->page_states[page] = VIRTUAL_PAGE_QUEUED;
+}
+
+void create_virtual_texture(struct Uploader *uploader, const struct AssetPack *pack,
+    const struct PackEntry *entry, VkDeviceSize budget, struct VirtualTexture *texture)
+{
+    if (entry->type != PACK_ENTRY_TEXTURE || entry->levels == 0)
+        print_exit("Failed to create a virtual texture, the entry is not a texture!");
+
+    memset(texture, 0, sizeof(*texture));
+    texture->device = uploader->device;
+    texture->pack = pack;
+    texture->entry = entry;
+    texture->report = uploader->report;
+
+    // Pages are cut along block boundaries, so compressed pages copy whole blocks
+    texture->block_size = get_texture_family(entry->format) != 0 ? 4 : 1;
+    texture->block_bytes = (uint32_t)get_texture_level_size(entry->format,
+        texture->block_size, texture->block_size);
+
+    create_levels(texture);
+
+    VkDeviceSize payload_size = texture->level_offsets[texture->level_count - 1] +
+        get_texture_level_size(entry->format,
+        get_level_dimension(entry->width, texture->level_count - 1),
+        get_level_dimension(entry->height, texture->level_count - 1));
+
+    if (payload_size > entry->size)
+        print_exit("Failed to create a virtual texture, texture payload is truncated!");
+
+    create_cache(texture, uploader->gpu, budget);
+    create_page_buffers(texture, uploader->gpu);
+    create_slots(texture);
+
+    texture->page_slots = malloc(texture->page_count * sizeof(uint32_t));
+    texture->page_states = calloc(texture->page_count, 1);
+    texture->entries = calloc(texture->page_count, sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < texture->page_count; ++i)
+        texture->page_slots[i] = UINT32_MAX;
+
+    texture->staging_page_size = ((VkDeviceSize)(VIRTUAL_SLOT_SIZE / texture->block_size) *
+        (VIRTUAL_SLOT_SIZE / texture->block_size) * texture->block_bytes + PACK_ALIGNMENT - 1) /
+        PACK_ALIGNMENT * PACK_ALIGNMENT;
+    create_buffer(texture->device, uploader->gpu,
+        texture->staging_page_size * VIRTUAL_STAGING_PAGES, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &texture->staging);
+    set_debug_name(texture->device, VK_OBJECT_TYPE_BUFFER, (uint64_t)texture->staging.buffer,
+        "%s page staging", texture->entry->name);
+
+    // The single page of the last level is pinned so every lookup resolves to something
+    queue_page(texture, texture->page_count - 1);
+
+    pthread_mutex_init(&texture->lock, NULL);
+    pthread_cond_init(&texture->wake, NULL);
+    texture->running = 1;
+
+    if (pthread_create(&texture->thread, NULL, &stream_pages, texture) != 0)
+        print_exit("Failed to start the virtual texture streaming thread!");
+
+    if (texture->report)
+        printf("Virtual texture %s: %u levels, %u pages, %u cache slots\n", entry->name,
+            texture->level_count, texture->page_count, texture->slot_count);
+}
+
+static int compare_pages(const void *a, const void *b)
+{
+    const uint32_t left = *(const uint32_t *)a;
+    const uint32_t right = *(const uint32_t *)b;
+
+    // Coarser levels have larger indices, streaming them first sharpens the fallback soonest
+    return left < right ? 1 : left > right ? -1 : 0;
+}
+
+// Marks wanted pages used and returns the missing ones with their missing ancestors
+static uint32_t read_feedback(struct VirtualTexture *texture, uint32_t frame,
+    uint32_t missing[VIRTUAL_MAX_REQUESTS])
+{
+    uint32_t *bits = texture->feedback[frame].mapped;
+    const uint32_t word_count = (uint32_t)(texture->feedback_size / sizeof(uint32_t));
+    uint32_t count = 0;
+
+    for (uint32_t word = 0; word < word_count; ++word) {
+        for (uint32_t set = bits[word]; set != 0; set &= set - 1) {
+            uint32_t page = word * 32 + (uint32_t)__builtin_ctz(set);
+            uint32_t level, x, y;
+            get_page_location(texture, page, &level, &x, &y);
+
+            for (; level < texture->level_count; ++level, x /= 2, y /= 2) {
+                page = get_page_index(texture, level, x, y);
+
+                if (texture->page_states[page] == VIRTUAL_PAGE_RESIDENT) {
+                    if (texture->page_slots[page] != PINNED_SLOT)
+                        touch_slot(texture, texture->page_slots[page]);
+                    break;
+                }
+
+                if (texture->page_states[page] == VIRTUAL_PAGE_QUEUED ||
+                    count == VIRTUAL_MAX_REQUESTS)
+                    break;
+
+                texture->page_states[page] = VIRTUAL_PAGE_QUEUED;
+                missing[count++] = page;
+            }
+        }
+
+        bits[word] = 0;
+    }
+
+    qsort(missing, count, sizeof(uint32_t), &compare_pages);
+
+    return count;
+}
+
+// Least recently used slot, UINT32_MAX when even that one is still on screen
+static uint32_t evict_slot(struct VirtualTexture *texture)
+{
+    const uint32_t slot = texture->lru_tail;
+    const uint32_t page = texture->slot_pages[slot];
+
+    if (page == UINT32_MAX)
+        return slot;
+
+    if (texture->frames - texture->slot_used[slot] <= FRAMES_IN_FLIGHT)
+        return UINT32_MAX;
+
+    texture->page_slots[page] = UINT32_MAX;
+    texture->page_states[page] = VIRTUAL_PAGE_ABSENT;
+    texture->slot_pages[slot] = UINT32_MAX;
+    update_page_entries(texture, page);
+    ++texture->evicted_pages;
+
+    return slot;
+}
+
+static void record_page_copy(struct VirtualTexture *texture, VkCommandBuffer buffer,
+    uint32_t staging, uint32_t slot)
+{
+    VkBufferImageCopy region = {};
+    region.bufferOffset = staging * texture->staging_page_size;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset.x = (int32_t)(slot % texture->slots_per_row * VIRTUAL_SLOT_SIZE);
+    region.imageOffset.y = (int32_t)(slot / texture->slots_per_row * VIRTUAL_SLOT_SIZE);
+    region.imageExtent.width = VIRTUAL_SLOT_SIZE;
+    region.imageExtent.height = VIRTUAL_SLOT_SIZE;
+    region.imageExtent.depth = 1;
+
+    vkCmdCopyBufferToImage(buffer, texture->staging.buffer, texture->cache.image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+// Copies streamed pages into their slots, returns how many were copied
+static uint32_t record_streamed_pages(struct VirtualTexture *texture, VkCommandBuffer buffer,
+    const uint32_t *ready, uint32_t ready_count)
+{
+    uint32_t copied = 0;
+
+    for (uint32_t i = 0; i < ready_count; ++i) {
+        const uint32_t page = texture->staging_pages[ready[i]].page;
+        const uint32_t slot = page == texture->page_count - 1 ? PINNED_SLOT :
+            evict_slot(texture);
+
+        // The budget is too small for what is on screen, the page is asked for again later
+        if (slot == UINT32_MAX) {
+            texture->page_states[page] = VIRTUAL_PAGE_ABSENT;
+            continue;
+        }
+
+        if (copied++ == 0)
+            transition_texture_levels(buffer, &texture->cache, 0, 1,
+                texture->initialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL :
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        record_page_copy(texture, buffer, ready[i], slot);
+
+        texture->page_slots[page] = slot;
+        texture->page_states[page] = VIRTUAL_PAGE_RESIDENT;
+        texture->slot_pages[slot] = page;
+
+        if (slot != PINNED_SLOT)
+            touch_slot(texture, slot);
+
+        update_page_entries(texture, page);
+        ++texture->streamed_pages;
+    }
+
+    if (copied > 0) {
+        transition_texture_levels(buffer, &texture->cache, 0, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        texture->initialized = 1;
+    }
+
+    return copied;
+}
+
+// The cache has to be in a sampled layout even before the pinned page arrives
+static void initialize_cache(struct VirtualTexture *texture, VkCommandBuffer buffer)
+{
+    transition_texture_levels(buffer, &texture->cache, 0, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    texture->initialized = 1;
+}
+
+void update_virtual_texture(struct VirtualTexture *texture, VkCommandBuffer buffer,
+    uint32_t frame)
+{
+    ++texture->frames;
+
+    uint32_t missing[VIRTUAL_MAX_REQUESTS];
+    const uint32_t missing_count = read_feedback(texture, frame, missing);
+    uint32_t ready[VIRTUAL_UPLOADS_PER_FRAME];
+    uint32_t ready_count = 0;
+
+    pthread_mutex_lock(&texture->lock);
+
+    for (uint32_t i = 0; i < VIRTUAL_STAGING_PAGES; ++i) {
+        struct VirtualStagingPage *staging = &texture->staging_pages[i];
+
+        // The frame that copied it has finished
+        if (staging->state == VIRTUAL_STAGING_IN_FLIGHT && staging->frame == frame)
+            staging->state = VIRTUAL_STAGING_FREE;
+
+        if (staging->state == VIRTUAL_STAGING_READY && ready_count < VIRTUAL_UPLOADS_PER_FRAME) {
+            staging->state = VIRTUAL_STAGING_IN_FLIGHT;
+            staging->frame = frame;
+            ready[ready_count++] = i;
+        }
+    }
+
+    for (uint32_t i = 0; i < missing_count; ++i) {
+        if (texture->request_count == VIRTUAL_MAX_REQUESTS) {
+            texture->page_states[missing[i]] = VIRTUAL_PAGE_ABSENT;
+            continue;
+        }
+
+        queue_page(texture, missing[i]);
+    }
+
+    pthread_cond_signal(&texture->wake);
+    pthread_mutex_unlock(&texture->lock);
+
+    if (record_streamed_pages(texture, buffer, ready, ready_count) == 0 &&
+        !texture->initialized)
+        initialize_cache(texture, buffer);
+
+    struct VirtualHeader *header = texture->page_tables[frame].mapped;
+    header->jitter = (uint32_t)(texture->frames % (VIRTUAL_FEEDBACK_GRID * VIRTUAL_FEEDBACK_GRID));
+
+    if (texture->frame_versions[frame] != texture->version) {
+        memcpy(header + 1, texture->entries, texture->page_count * sizeof(uint32_t));
+        texture->frame_versions[frame] = texture->version;
+    }
+}
+
+void record_virtual_feedback_barrier(VkCommandBuffer buffer)
+{
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+int is_virtual_texture_streaming(struct VirtualTexture *texture)
+{
+    pthread_mutex_lock(&texture->lock);
+
+    int streaming = texture->request_count > 0;
+
+    for (uint32_t i = 0; i < VIRTUAL_STAGING_PAGES && !streaming; ++i)
+        streaming = texture->staging_pages[i].state != VIRTUAL_STAGING_FREE;
+
+    pthread_mutex_unlock(&texture->lock);
+
+    return streaming;
+}
+
+VkBuffer get_virtual_page_table(const struct VirtualTexture *texture, uint32_t frame)
+{
+    return texture->page_tables[frame].buffer;
+}
+
+VkBuffer get_virtual_feedback(const struct VirtualTexture *texture, uint32_t frame)
+{
+    return texture->feedback[frame].buffer;
+}
+
+void destroy_virtual_texture(struct VirtualTexture *texture)
+{
+    pthread_mutex_lock(&texture->lock);
+    texture->running = 0;
+    pthread_cond_signal(&texture->wake);
+    pthread_mutex_unlock(&texture->lock);
+    pthread_join(texture->thread, NULL);
+    pthread_cond_destroy(&texture->wake);
+    pthread_mutex_destroy(&texture->lock);
+
+    if (texture->report)
+        printf("Virtual texture %s: %llu pages streamed, %llu evicted\n", texture->entry->name,
+            (unsigned long long)texture->streamed_pages,
+            (unsigned long long)texture->evicted_pages);
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        destroy_buffer(texture->device, &texture->page_tables[i]);
+        destroy_buffer(texture->device, &texture->feedback[i]);
+    }
+
+    destroy_buffer(texture->device, &texture->staging);
+    destroy_texture(texture->device, &texture->cache);
+    free(texture->page_slots);
+    free(texture->page_states);
+    free(texture->entries);
+    free(texture->slot_pages);
+    free(texture->slot_prev);
+    free(texture->slot_next);
+    free(texture->slot_used);
+}
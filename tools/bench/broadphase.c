@@ -0,0 +1,161 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "broadphase.h"
+#include "error.h"
+
+#define CELL_SIZE 16.0f
+#define MIN_BOX_SIZE 2.0f
+#define MAX_BOX_SIZE 12.0f
+// World area per box, keeps the density the same at every scale
+#define AREA_PER_BOX 400.0f
+#define MAX_SPEED 2.0f
+#define WARMUP_TICKS 3u
+#define TICKS 20u
+
+struct Body {
+    float x;
+    float y;
+    float half_width;
+    float half_height;
+    float velocity_x;
+    float velocity_y;
+};
+
+static double get_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static float get_random(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+static void create_bodies(uint32_t count, float side, struct Body *bodies)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        bodies[i].x = get_random(0.0f, side);
+        bodies[i].y = get_random(0.0f, side);
+        bodies[i].half_width = get_random(MIN_BOX_SIZE, MAX_BOX_SIZE) * 0.5f;
+        bodies[i].half_height = get_random(MIN_BOX_SIZE, MAX_BOX_SIZE) * 0.5f;
+        bodies[i].velocity_x = get_random(-MAX_SPEED, MAX_SPEED);
+        bodies[i].velocity_y = get_random(-MAX_SPEED, MAX_SPEED);
+    }
+}
+
+static void move_bodies(uint32_t count, float side, struct Body *bodies, struct Aabb *boxes)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        struct Body *body = &bodies[i];
+        body->x += body->velocity_x;
+        body->y += body->velocity_y;
+
+        if (body->x < 0.0f || body->x > side)
+            body->velocity_x = -body->velocity_x;
+        if (body->y < 0.0f || body->y > side)
+            body->velocity_y = -body->velocity_y;
+
+        boxes[i].min_x = body->x - body->half_width;
+        boxes[i].min_y = body->y - body->half_height;
+        boxes[i].max_x = body->x + body->half_width;
+        boxes[i].max_y = body->y + body->half_height;
+    }
+}
+
+// Brute force pair count, only practical for the smallest run
+static uint64_t count_pairs(uint32_t count, const struct Aabb *boxes)
+{
+    uint64_t pairs = 0;
+
+    for (uint32_t i = 0; i < count; ++i)
+        for (uint32_t j = i + 1; j < count; ++j)
+            pairs += boxes[i].min_x <= boxes[j].max_x && boxes[j].min_x <= boxes[i].max_x &&
+                boxes[i].min_y <= boxes[j].max_y && boxes[j].min_y <= boxes[i].max_y;
+
+    return pairs;
+}
+
+static void run_benchmark(uint32_t count, struct JobPool *pool, int verify)
+{
+    const float side = sqrtf(count * AREA_PER_BOX);
+    struct Body *bodies = malloc(count * sizeof(struct Body));
+    struct Aabb *boxes = malloc(count * sizeof(struct Aabb));
+    struct Broadphase broadphase;
+
+    srand(count);
+    create_bodies(count, side, bodies);
+    create_broadphase(CELL_SIZE, pool, &broadphase);
+
+    double update_time = 0.0;
+    double pair_time = 0.0;
+    uint64_t moved = 0;
+
+    for (uint32_t tick = 0; tick < WARMUP_TICKS + TICKS; ++tick) {
+        move_bodies(count, side, bodies, boxes);
+
+        const double start = get_seconds();
+        update_broadphase(&broadphase, boxes, count);
+        const double updated = get_seconds();
+        find_broadphase_pairs(&broadphase);
+        const double found = get_seconds();
+
+        if (tick >= WARMUP_TICKS) {
+            update_time += updated - start;
+            pair_time += found - updated;
+            moved += broadphase.moved_count;
+        }
+    }
+
+    printf("%8u boxes: update %7.3f ms, pairs %7.3f ms, %5.1f%% moved boxes, %u pairs\n",
+        count, update_time * 1000.0 / TICKS, pair_time * 1000.0 / TICKS,
+        100.0 * moved / ((double)count * TICKS), broadphase.pairs.count);
+
+    if (verify) {
+        const uint64_t expected = count_pairs(count, boxes);
+
+        if (expected != broadphase.pairs.count) {
+            printf("Broadphase found %u pairs, brute force %llu\n", broadphase.pairs.count,
+                (unsigned long long)expected);
+            exit(-1);
+        }
+    }
+
+    destroy_broadphase(&broadphase);
+    free(boxes);
+    free(bodies);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t worker_count = get_default_worker_count();
+    int verify = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            const long threads = atol(argv[++i]);
+            worker_count = threads > 1 ? (uint32_t)threads - 1 : 0;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = 1;
+        } else {
+            printf("Usage: lindmar_bench_broadphase [-j threads] [--verify]\n");
+            return -1;
+        }
+    }
+
+    struct JobPool pool;
+    create_job_pool(worker_count, &pool);
+    printf("Broadphase on %u threads, %u ticks each\n", pool.worker_count + 1, TICKS);
+
+    run_benchmark(10000, &pool, verify);
+    run_benchmark(100000, &pool, 0);
+    run_benchmark(1000000, &pool, 0);
+
+    destroy_job_pool(&pool);
+}
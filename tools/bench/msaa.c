@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "renderer.h"
+#include "scene.h"
+
+#define DEFAULT_SPRITE_COUNT 20000u
+#define WARMUP_FRAMES 120u
+#define FRAMES 600u
+
+struct Benchmark {
+    struct Scene scene;
+    uint32_t frames;
+    // Summed over the measured frames
+    double gpu_time;
+    double fragments_per_pixel;
+};
+
+static void update_benchmark(struct Renderer *renderer, double delta, double alpha,
+    void *user_data)
+{
+    struct Benchmark *benchmark = user_data;
+    update_scene(renderer, delta, alpha, &benchmark->scene);
+
+    if (benchmark->frames++ < WARMUP_FRAMES)
+        return;
+
+    struct RendererStats stats;
+    get_renderer_stats(renderer, &stats);
+    benchmark->gpu_time += stats.gpu_draw_time;
+    benchmark->fragments_per_pixel += stats.fragments_per_pixel;
+
+    if (benchmark->frames == WARMUP_FRAMES + FRAMES)
+        close_renderer(renderer);
+}
+
+// A fresh renderer per sample count, the sample count is fixed at creation
+static void run_benchmark(uint32_t samples, uint32_t sprite_count, const char *gpu)
+{
+    struct RendererSettings settings;
+    get_default_renderer_settings(&settings);
+    settings.gpu = gpu;
+    settings.present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    settings.pipeline_statistics = 1;
+    settings.msaa_samples = samples;
+
+    struct Benchmark benchmark;
+    memset(&benchmark, 0, sizeof(benchmark));
+
+    struct Renderer *renderer = create_renderer(&settings);
+    create_scene(renderer, sprite_count, 0, &benchmark.scene);
+    set_renderer_tick(renderer, tick_scene, &benchmark.scene);
+    set_renderer_update(renderer, update_benchmark, &benchmark);
+    run_renderer(renderer);
+
+    struct RendererStats stats;
+    get_renderer_stats(renderer, &stats);
+
+    // The window was closed early when fewer frames were measured
+    const uint32_t measured = benchmark.frames > WARMUP_FRAMES ?
+        benchmark.frames - WARMUP_FRAMES : 1;
+
+    printf("%ux msaa: gpu draw %7.3f ms, %5.2f fragments per pixel, %llu missed vsyncs\n",
+        stats.msaa_samples, benchmark.gpu_time * 1000.0 / measured,
+        benchmark.fragments_per_pixel / measured, (unsigned long long)stats.missed_vsyncs);
+
+    destroy_scene(&benchmark.scene);
+    destroy_renderer(renderer);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t sprite_count = DEFAULT_SPRITE_COUNT;
+    const char *gpu = getenv("LINDMAR_GPU");
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) {
+            sprite_count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--gpu") == 0 && i + 1 < argc) {
+            gpu = argv[++i];
+        } else {
+            printf("Usage: lindmar_bench_msaa [--sprites count] [--gpu index|name]\n");
+            return -1;
+        }
+    }
+
+    printf("MSAA with %u sprites, %u frames each\n", sprite_count, FRAMES);
+
+    for (uint32_t samples = 1; samples <= 8; samples *= 2)
+        run_benchmark(samples, sprite_count, gpu);
+}
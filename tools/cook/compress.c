@@ -0,0 +1,162 @@
+#include <string.h>
+
+#include "cook.h"
+
+/*
+ * Endpoints are the corners of the block's bounding box, cheap and good
+ * enough for sprites and UI art. Indices pick the nearest palette entry.
+ */
+
+static uint16_t encode_565(const uint8_t *rgb)
+{
+    return (uint16_t)((rgb[0] * 31 + 127) / 255 << 11 | (rgb[1] * 63 + 127) / 255 << 5 |
+        (rgb[2] * 31 + 127) / 255);
+}
+
+static void expand_565(uint16_t color, int *rgb)
+{
+    rgb[0] = (color >> 11 & 31) * 255 / 31;
+    rgb[1] = (color >> 5 & 63) * 255 / 63;
+    rgb[2] = (color & 31) * 255 / 31;
+}
+
+// Reads the 4x4 block at bx, by, texels past the edge repeat the last row or column
+static void fetch_block(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t bx,
+    uint32_t by, uint8_t block[16][4])
+{
+    for (uint32_t y = 0; y < 4; ++y) {
+        const uint32_t sy = by * 4 + y < height ? by * 4 + y : height - 1;
+
+        for (uint32_t x = 0; x < 4; ++x) {
+            const uint32_t sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+            memcpy(block[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+// Four color mode, color0 is always greater than color1 unless the block is flat
+static void encode_color_block(const uint8_t block[16][4], uint8_t *dst)
+{
+    uint8_t low[3] = {255, 255, 255};
+    uint8_t high[3] = {0, 0, 0};
+
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            low[c] = block[i][c] < low[c] ? block[i][c] : low[c];
+            high[c] = block[i][c] > high[c] ? block[i][c] : high[c];
+        }
+    }
+
+    uint16_t c0 = encode_565(high);
+    uint16_t c1 = encode_565(low);
+
+    if (c0 < c1) {
+        const uint16_t swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+
+    int palette[4][3];
+    expand_565(c0, palette[0]);
+    expand_565(c1, palette[1]);
+
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+
+    for (int i = 0; i < 16 && c0 != c1; ++i) {
+        uint32_t best = 0;
+        int best_error = 1 << 30;
+
+        for (uint32_t p = 0; p < 4; ++p) {
+            int error = 0;
+
+            for (int c = 0; c < 3; ++c)
+                error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+
+            if (error < best_error) {
+                best_error = error;
+                best = p;
+            }
+        }
+
+        indices |= best << (i * 2);
+    }
+
+    dst[0] = c0 & 0xff;
+    dst[1] = c0 >> 8;
+    dst[2] = c1 & 0xff;
+    dst[3] = c1 >> 8;
+
+    for (int i = 0; i < 4; ++i)
+        dst[4 + i] = indices >> (i * 8) & 0xff;
+}
+
+// Eight value mode of the BC3 alpha block
+static void encode_alpha_block(const uint8_t block[16][4], uint8_t *dst)
+{
+    uint8_t a0 = 0;
+    uint8_t a1 = 255;
+
+    for (int i = 0; i < 16; ++i) {
+        a0 = block[i][3] > a0 ? block[i][3] : a0;
+        a1 = block[i][3] < a1 ? block[i][3] : a1;
+    }
+
+    int palette[8] = {a0, a1};
+
+    for (int i = 1; i < 7; ++i)
+        palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+
+    uint64_t indices = 0;
+
+    for (int i = 0; i < 16 && a0 != a1; ++i) {
+        uint64_t best = 0;
+        int best_error = 256;
+
+        for (uint32_t p = 0; p < 8; ++p) {
+            const int error = block[i][3] > palette[p] ? block[i][3] - palette[p] :
+                palette[p] - block[i][3];
+
+            if (error < best_error) {
+                best_error = error;
+                best = p;
+            }
+        }
+
+        indices |= best << (i * 3);
+    }
+
+    dst[0] = a0;
+    dst[1] = a1;
+
+    for (int i = 0; i < 6; ++i)
+        dst[2 + i] = indices >> (i * 8) & 0xff;
+}
+
+size_t get_compressed_level_size(uint32_t width, uint32_t height, int alpha)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * (alpha ? 16 : 8);
+}
+
+void compress_level(const uint8_t *rgba, uint32_t width, uint32_t height, int alpha,
+    uint8_t *dst)
+{
+    for (uint32_t by = 0; by < (height + 3) / 4; ++by) {
+        for (uint32_t bx = 0; bx < (width + 3) / 4; ++bx) {
+            uint8_t block[16][4];
+            fetch_block(rgba, width, height, bx, by, block);
+
+            if (alpha) {
+                encode_alpha_block(block, dst);
+                dst += 8;
+            }
+
+            encode_color_block(block, dst);
+            dst += 8;
+        }
+    }
+}
@@ -0,0 +1,555 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cook.h"
+#include "error.h"
+
+// Bump whenever cooked output changes so stale cache entries are ignored
+#define COOK_VERSION "lindmar_cook 2"
+#define COOK_MAX_JOBS 4096u
+#define COOK_MAX_THREADS 64u
+// Longest kind prefix plus the longest suffix added to a job name
+#define COOK_NAME_OVERHEAD 16u
+#define COOK_COMMAND_MAX (COOK_PATH_MAX * 3)
+
+struct CookState {
+    const char *cache;
+    int compress;
+    // Hash of the glslc --version output, shader output changes with the compiler
+    uint64_t glslc_hash;
+    struct CookJob *jobs;
+    uint32_t job_count;
+    atomic_uint next;
+};
+
+static uint64_t mix_file(uint64_t hash, const char *path)
+{
+    size_t size = 0;
+    uint8_t *data = read_file(path, &size);
+
+    if (data == NULL) {
+        printf("Failed to read %s\n", path);
+        exit(-1);
+    }
+
+    hash = mix_hash_bytes(hash, path, strlen(path) + 1);
+    hash = mix_hash_bytes(hash, data, size);
+    free(data);
+
+    return hash;
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Atlas output depends on the names and contents of every file in the directory
+static uint64_t mix_directory(uint64_t hash, const char *path)
+{
+    DIR *dir = opendir(path);
+
+    if (dir == NULL) {
+        printf("Failed to open %s\n", path);
+        exit(-1);
+    }
+
+    char *names[COOK_MAX_JOBS];
+    uint32_t count = 0;
+
+    for (struct dirent *ent = readdir(dir); ent != NULL && count < COOK_MAX_JOBS;
+        ent = readdir(dir))
+        if (ent->d_name[0] != '.')
+            names[count++] = strdup(ent->d_name);
+
+    closedir(dir);
+    qsort(names, count, sizeof(char *), &compare_strings);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        char file[COOK_PATH_MAX * 2];
+        snprintf(file, sizeof(file), "%s/%s", path, names[i]);
+        hash = mix_file(hash, file);
+        free(names[i]);
+    }
+
+    return hash;
+}
+
+static const char *get_glslc(void)
+{
+    return getenv("GLSLC") != NULL ? getenv("GLSLC") : "glslc";
+}
+
+// Standard output of command, NULL when it fails, should be cleaned up by free()
+static char *read_command(const char *command)
+{
+    FILE *pipe = popen(command, "r");
+
+    if (pipe == NULL)
+        return NULL;
+
+    size_t capacity = 256;
+    size_t size = 0;
+    char *output = malloc(capacity);
+
+    for (size_t read = fread(output, 1, capacity - 1, pipe); read > 0;
+        read = fread(output + size, 1, capacity - size - 1, pipe)) {
+        size += read;
+
+        if (size + 1 == capacity)
+            output = realloc(output, capacity *= 2);
+    }
+
+    output[size] = '\0';
+
+    if (pclose(pipe) != 0) {
+        free(output);
+        return NULL;
+    }
+
+    return output;
+}
+
+/*
+ * Shader output depends on the shader and every file it includes, listed by
+ * the make rule glslc -M prints as "target: source include...". Spaces in
+ * paths are escaped with a backslash and long rules continue after one.
+ */
+static uint64_t mix_shader_sources(uint64_t hash, const char *path)
+{
+    char command[COOK_COMMAND_MAX];
+
+    if ((size_t)snprintf(command, sizeof(command), "\"%s\" -M \"%s\"", get_glslc(), path) >=
+        sizeof(command))
+        print_exit("Failed to list shader includes, path is too long!");
+
+    char *rule = read_command(command);
+    const char *cursor = rule != NULL ? strchr(rule, ':') : NULL;
+
+    if (cursor == NULL) {
+        printf("Failed to list the includes of %s\n", path);
+        exit(-1);
+    }
+
+    char source[COOK_PATH_MAX];
+    size_t length = 0;
+
+    for (++cursor;; ++cursor) {
+        if (*cursor == '\\' && cursor[1] == ' ') {
+            ++cursor;
+        } else if (*cursor == '\\' && (cursor[1] == '\n' || cursor[1] == '\r')) {
+            continue;
+        } else if (*cursor == '\0' || *cursor == ' ' || *cursor == '\t' || *cursor == '\n' ||
+            *cursor == '\r') {
+            if (length > 0) {
+                source[length] = '\0';
+                hash = mix_file(hash, source);
+                length = 0;
+            }
+
+            if (*cursor == '\0')
+                break;
+
+            continue;
+        }
+
+        if (length + 1 == COOK_PATH_MAX)
+            print_exit("Failed to list shader includes, path is too long!");
+
+        source[length++] = *cursor;
+    }
+
+    free(rule);
+
+    return hash;
+}
+
+static uint64_t get_glslc_hash(void)
+{
+    char command[COOK_COMMAND_MAX];
+
+    if ((size_t)snprintf(command, sizeof(command), "\"%s\" --version", get_glslc()) >=
+        sizeof(command))
+        print_exit("Failed to run glslc, path is too long!");
+
+    char *version = read_command(command);
+
+    if (version == NULL)
+        print_exit("Failed to run glslc, set GLSLC to its path!");
+
+    const uint64_t hash = mix_hash_bytes(HASH_BASIS, version, strlen(version));
+    free(version);
+
+    return hash;
+}
+
+static uint64_t get_job_key(const struct CookState *state, const struct CookJob *job)
+{
+    uint64_t hash = HASH_BASIS;
+    hash = mix_hash_bytes(hash, COOK_VERSION, sizeof(COOK_VERSION));
+    hash = mix_hash_bytes(hash, &job->kind, sizeof(job->kind));
+    hash = mix_hash_bytes(hash, job->name, strlen(job->name) + 1);
+    hash = mix_hash_bytes(hash, &job->compress, sizeof(job->compress));
+
+    if (job->kind == COOK_ATLAS)
+        return mix_directory(hash, job->path);
+
+    if (job->kind == COOK_SHADER) {
+        hash = mix_hash_bytes(hash, &state->glslc_hash, sizeof(state->glslc_hash));
+        return mix_shader_sources(hash, job->path);
+    }
+
+    hash = mix_file(hash, job->path);
+
+    char image[COOK_PATH_MAX];
+
+    if (job->kind == COOK_FONT && get_font_image_path(job->path, image))
+        hash = mix_file(hash, image);
+
+    return hash;
+}
+
+static void get_cache_path(const char *cache, uint64_t key, const char *suffix,
+    char path[COOK_PATH_MAX])
+{
+    snprintf(path, COOK_PATH_MAX, "%s/%016llx%s", cache, (unsigned long long)key, suffix);
+}
+
+static void cook_shader(const struct CookJob *job, const char *cache, struct PackWriter *writer)
+{
+    char output[COOK_PATH_MAX];
+    get_cache_path(cache, job->key, ".spv", output);
+
+    char command[COOK_COMMAND_MAX];
+
+    if ((size_t)snprintf(command, sizeof(command), "\"%s\" \"%s\" -o \"%s\"", get_glslc(),
+        job->path, output) >= sizeof(command) || system(command) != 0) {
+        printf("Failed to compile shader at %s\n", job->path);
+        exit(-1);
+    }
+
+    size_t size = 0;
+    uint8_t *code = read_file(output, &size);
+    remove(output);
+
+    if (code == NULL || size % 4 != 0) {
+        printf("Failed to read compiled shader for %s\n", job->path);
+        exit(-1);
+    }
+
+    struct PackEntry entry = {};
+
+    if ((size_t)snprintf(entry.name, PACK_NAME_MAX, "shader/%s", job->name) >= PACK_NAME_MAX)
+        print_exit("Failed to cook a shader, name is too long!");
+
+    entry.type = PACK_ENTRY_SHADER;
+    add_pack_entry(writer, &entry, code, size);
+    free(code);
+}
+
+// Cooks into a pack of its own named by the key, renamed into place once complete
+static void run_job(struct CookState *state, struct CookJob *job)
+{
+    job->key = get_job_key(state, job);
+
+    char path[COOK_PATH_MAX];
+    get_cache_path(state->cache, job->key, ".pack", path);
+
+    if (access(path, R_OK) == 0) {
+        job->reused = 1;
+        return;
+    }
+
+    char temp[COOK_PATH_MAX];
+    get_cache_path(state->cache, job->key, ".tmp", temp);
+
+    struct PackWriter writer;
+    create_pack_writer(temp, &writer);
+
+    switch (job->kind) {
+    case COOK_TEXTURE:
+        cook_texture(job, &writer);
+        break;
+    case COOK_ATLAS:
+        cook_atlas(job, &writer);
+        break;
+    case COOK_FONT:
+        cook_font(job, &writer);
+        break;
+    case COOK_TILEMAP:
+        cook_tilemap(job, &writer);
+        break;
+    case COOK_SHADER:
+        cook_shader(job, state->cache, &writer);
+        break;
+    }
+
+    finish_pack_writer(&writer);
+
+    if (rename(temp, path) != 0)
+        print_exit("Failed to move a cooked asset into the cache!");
+
+    printf("Cooked %s\n", job->path);
+}
+
+static void *run_worker(void *data)
+{
+    struct CookState *state = data;
+
+    for (uint32_t i = atomic_fetch_add(&state->next, 1); i < state->job_count;
+        i = atomic_fetch_add(&state->next, 1))
+        run_job(state, &state->jobs[i]);
+
+    return NULL;
+}
+
+static int get_kind(const char *path, int directory, enum CookKind *kind)
+{
+    if (directory) {
+        *kind = COOK_ATLAS;
+        return has_extension(path, ".atlas");
+    }
+
+    if (has_extension(path, ".tga") || has_extension(path, ".ppm") ||
+        has_extension(path, ".pgm") || has_extension(path, ".ktx2"))
+        *kind = COOK_TEXTURE;
+    else if (has_extension(path, ".font"))
+        *kind = COOK_FONT;
+    else if (has_extension(path, ".csv"))
+        *kind = COOK_TILEMAP;
+    else if (has_extension(path, ".vert") || has_extension(path, ".frag") ||
+        has_extension(path, ".comp"))
+        *kind = COOK_SHADER;
+    else
+        return 0;
+
+    return 1;
+}
+
+static void add_job(struct CookState *state, enum CookKind kind, const char *path,
+    const char *file)
+{
+    if (state->job_count == COOK_MAX_JOBS)
+        print_exit("Failed to add a cook job, too many inputs!");
+
+    struct CookJob *job = &state->jobs[state->job_count++];
+    memset(job, 0, sizeof(*job));
+    job->kind = kind;
+    job->compress = state->compress;
+    snprintf(job->path, COOK_PATH_MAX, "%s", path);
+
+    // Entries are named after the file without its extension
+    const size_t stem = strrchr(file, '.') - file;
+
+    if (stem + COOK_NAME_OVERHEAD >= PACK_NAME_MAX) {
+        printf("Failed to add a cook job, name of %s is too long\n", path);
+        exit(-1);
+    }
+
+    memcpy(job->name, file, stem);
+
+    // Stages share a stem, suffixed like the basic_vs.spv output of compile.sh
+    if (kind == COOK_SHADER)
+        strcat(job->name, has_extension(file, ".vert") ? "_vs" :
+            has_extension(file, ".frag") ? "_fs" : "_cs");
+}
+
+static void find_jobs(struct CookState *state, const char *dir_path)
+{
+    DIR *dir = opendir(dir_path);
+
+    if (dir == NULL) {
+        printf("Failed to open source directory %s\n", dir_path);
+        exit(-1);
+    }
+
+    for (struct dirent *ent = readdir(dir); ent != NULL; ent = readdir(dir)) {
+        if (ent->d_name[0] == '.')
+            continue;
+
+        char path[COOK_PATH_MAX];
+
+        if ((size_t)snprintf(path, sizeof(path), "%s/%s", dir_path, ent->d_name) >=
+            sizeof(path))
+            print_exit("Failed to walk the source directory, path is too long!");
+
+        struct stat info;
+
+        if (stat(path, &info) != 0)
+            continue;
+
+        const int directory = S_ISDIR(info.st_mode);
+        enum CookKind kind;
+
+        if (get_kind(path, directory, &kind))
+            add_job(state, kind, path, ent->d_name);
+        else if (directory)
+            find_jobs(state, path);
+    }
+
+    closedir(dir);
+}
+
+static int compare_jobs(const void *a, const void *b)
+{
+    const struct CookJob *left = a;
+    const struct CookJob *right = b;
+
+    if (left->kind != right->kind)
+        return left->kind < right->kind ? -1 : 1;
+
+    const int names = strcmp(left->name, right->name);
+
+    return names != 0 ? names : strcmp(left->path, right->path);
+}
+
+// Glyph sheets are cooked into their font, not into textures of their own
+static void remove_font_sheets(struct CookState *state)
+{
+    for (uint32_t i = 0; i < state->job_count; ++i) {
+        char image[COOK_PATH_MAX];
+
+        if (state->jobs[i].kind != COOK_FONT || !get_font_image_path(state->jobs[i].path, image))
+            continue;
+
+        for (uint32_t j = 0; j < state->job_count; ++j)
+            if (state->jobs[j].kind == COOK_TEXTURE && strcmp(state->jobs[j].path, image) == 0)
+                state->jobs[j--] = state->jobs[--state->job_count];
+    }
+}
+
+static void sort_jobs(struct CookState *state)
+{
+    qsort(state->jobs, state->job_count, sizeof(struct CookJob), &compare_jobs);
+
+    for (uint32_t i = 1; i < state->job_count; ++i)
+        if (state->jobs[i].kind == state->jobs[i - 1].kind &&
+            strcmp(state->jobs[i].name, state->jobs[i - 1].name) == 0) {
+            printf("Failed to cook, %s and %s produce the same entry\n", state->jobs[i - 1].path,
+                state->jobs[i].path);
+            exit(-1);
+        }
+}
+
+static void write_pack(const struct CookState *state, const char *output)
+{
+    char temp[COOK_PATH_MAX + 8];
+    snprintf(temp, sizeof(temp), "%s.tmp", output);
+
+    struct PackWriter writer;
+    create_pack_writer(temp, &writer);
+
+    for (uint32_t i = 0; i < state->job_count; ++i) {
+        char path[COOK_PATH_MAX];
+        get_cache_path(state->cache, state->jobs[i].key, ".pack", path);
+
+        struct AssetPack cooked;
+        open_asset_pack(path, &cooked);
+
+        for (uint32_t j = 0; j < cooked.entry_count; ++j)
+            add_pack_entry(&writer, &cooked.entries[j],
+                get_pack_payload(&cooked, &cooked.entries[j]), cooked.entries[j].size);
+
+        close_asset_pack(&cooked);
+    }
+
+    finish_pack_writer(&writer);
+
+    if (rename(temp, output) != 0)
+        print_exit("Failed to move the asset pack into place!");
+}
+
+static void print_usage(void)
+{
+    printf("Usage: lindmar_cook <source directory> <output pack> [-j threads] "
+        "[--cache directory] [--compress]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        print_usage();
+        return -1;
+    }
+
+    const char *source = argv[1];
+    const char *output = argv[2];
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    char cache[COOK_PATH_MAX];
+    snprintf(cache, sizeof(cache), "%s.cache", output);
+    int compress = 0;
+
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            thread_count = atol(argv[++i]);
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            snprintf(cache, sizeof(cache), "%s", argv[++i]);
+        else if (strcmp(argv[i], "--compress") == 0)
+            compress = 1;
+        else {
+            print_usage();
+            return -1;
+        }
+    }
+
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > COOK_MAX_THREADS)
+        thread_count = COOK_MAX_THREADS;
+
+    mkdir(cache, 0755);
+
+    struct CookState state;
+    state.cache = cache;
+    state.compress = compress;
+    state.glslc_hash = 0;
+    state.jobs = malloc(COOK_MAX_JOBS * sizeof(struct CookJob));
+    state.job_count = 0;
+    atomic_init(&state.next, 0);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    find_jobs(&state, source);
+    remove_font_sheets(&state);
+    sort_jobs(&state);
+
+    // Only packs with shaders need glslc
+    for (uint32_t i = 0; i < state.job_count && state.glslc_hash == 0; ++i)
+        if (state.jobs[i].kind == COOK_SHADER)
+            state.glslc_hash = get_glslc_hash();
+
+    pthread_t threads[COOK_MAX_THREADS];
+
+    for (long i = 0; i < thread_count; ++i)
+        if (pthread_create(&threads[i], NULL, &run_worker, &state) != 0)
+            print_exit("Failed to start a cook thread!");
+
+    for (long i = 0; i < thread_count; ++i)
+        pthread_join(threads[i], NULL);
+
+    write_pack(&state, output);
+
+    uint32_t reused = 0;
+
+    for (uint32_t i = 0; i < state.job_count; ++i)
+        reused += state.jobs[i].reused;
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("Cooked %u of %u inputs into %s on %ld threads in %.2f s\n",
+        state.job_count - reused, state.job_count, output, thread_count,
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    free(state.jobs);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pack.h"
+
+#define COOK_PATH_MAX 1024u
+
+enum CookKind {
+    // .tga, .ppm or .pgm to a mipmapped texture, .ktx2 copied as is
+    COOK_TEXTURE,
+    // Directory ending in .atlas, its images packed into one texture
+    COOK_ATLAS,
+    // .font description of a bitmap glyph sheet to an SDF texture
+    COOK_FONT,
+    // .csv of tile indices
+    COOK_TILEMAP,
+    // .vert, .frag or .comp compiled with glslc
+    COOK_SHADER
+};
+
+struct CookJob {
+    enum CookKind kind;
+    char path[COOK_PATH_MAX];
+    // Entry name without the kind prefix
+    char name[PACK_NAME_MAX];
+    // Content hash of everything the output depends on, names the cache file
+    uint64_t key;
+    int reused;
+    // Block compress textures and atlases
+    int compress;
+};
+
+// Always RGBA8
+struct Image {
+    uint32_t width;
+    uint32_t height;
+    uint8_t *pixels;
+};
+
+// NULL when the file cannot be read, should be cleaned up by free()
+uint8_t *read_file(const char *path, size_t *size);
+
+int has_extension(const char *path, const char *extension);
+
+// Exits when the file is missing or not a supported image
+void load_image(const char *path, struct Image *image);
+
+void destroy_image(struct Image *image);
+
+/*
+ * Writes channels (1 or 4) of pixels as a texture entry. Mipmapped textures
+ * get a full chain filtered in linear space when srgb is set. Compressed
+ * four channel textures become BC1, or BC3 when any texel is translucent.
+ */
+void add_texture_entry(struct PackWriter *writer, const char *name, uint32_t width,
+    uint32_t height, uint32_t channels, const uint8_t *pixels, int srgb, int mipmapped,
+    int compress);
+
+void cook_texture(const struct CookJob *job, struct PackWriter *writer);
+
+// Copies the levels of an uncompressed-supercompression KTX2 file into a texture entry
+void cook_ktx2(const struct CookJob *job, struct PackWriter *writer);
+
+// Bytes of one BC1 level, or BC3 when alpha is set
+size_t get_compressed_level_size(uint32_t width, uint32_t height, int alpha);
+
+// Encodes one RGBA8 level, dst receives get_compressed_level_size() bytes
+void compress_level(const uint8_t *rgba, uint32_t width, uint32_t height, int alpha,
+    uint8_t *dst);
+
+void cook_atlas(const struct CookJob *job, struct PackWriter *writer);
+
+// Path of the glyph sheet a .font description refers to, 0 when there is none
+int get_font_image_path(const char *path, char image_path[COOK_PATH_MAX]);
+
+void cook_font(const struct CookJob *job, struct PackWriter *writer);
+
+void cook_tilemap(const struct CookJob *job, struct PackWriter *writer);
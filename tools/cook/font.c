@@ -0,0 +1,216 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asset.h"
+#include "cook.h"
+#include "error.h"
+
+#define FONT_DEFAULT_SCALE 4u
+#define FONT_DEFAULT_SPREAD 4u
+#define FONT_MAX_SCALE 16u
+#define FONT_MAX_SPREAD 16u
+
+/*
+ * A .font file describes a bitmap glyph sheet with one "key values" pair
+ * per line:
+ *
+ *   image glyphs.pgm    sheet next to the .font file
+ *   cell 8 8            glyph cell size in sheet pixels
+ *   first 32            codepoint of the first cell
+ *   count 95            number of cells, row by row
+ *   scale 4             SDF pixels per sheet pixel
+ *   spread 4            SDF pixels from the edge to 0 or 255
+ */
+struct FontDesc {
+    char image[COOK_PATH_MAX];
+    uint32_t cell_width;
+    uint32_t cell_height;
+    uint32_t first;
+    uint32_t count;
+    uint32_t scale;
+    uint32_t spread;
+};
+
+static int parse_font(const char *path, struct FontDesc *desc)
+{
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+        return 0;
+
+    memset(desc, 0, sizeof(*desc));
+    desc->scale = FONT_DEFAULT_SCALE;
+    desc->spread = FONT_DEFAULT_SPREAD;
+
+    char line[COOK_PATH_MAX];
+    char image[COOK_PATH_MAX] = {};
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char key[16];
+        uint32_t a = 0;
+        uint32_t b = 0;
+
+        if (sscanf(line, "image %1023s", image) == 1)
+            continue;
+        if (sscanf(line, "cell %u %u", &a, &b) == 2) {
+            desc->cell_width = a;
+            desc->cell_height = b;
+        } else if (sscanf(line, "%15s %u", key, &a) == 2) {
+            if (strcmp(key, "first") == 0)
+                desc->first = a;
+            else if (strcmp(key, "count") == 0)
+                desc->count = a;
+            else if (strcmp(key, "scale") == 0)
+                desc->scale = a;
+            else if (strcmp(key, "spread") == 0)
+                desc->spread = a;
+        }
+    }
+
+    fclose(file);
+
+    if (image[0] == '\0')
+        return 0;
+
+    // The sheet path is relative to the .font file
+    const char *slash = strrchr(path, '/');
+    const int dir_length = slash != NULL ? (int)(slash - path + 1) : 0;
+
+    if ((size_t)snprintf(desc->image, sizeof(desc->image), "%.*s%s", dir_length, path, image) >=
+        sizeof(desc->image))
+        print_exit("Failed to cook a font, the sheet path is too long!");
+
+    return 1;
+}
+
+int get_font_image_path(const char *path, char image_path[COOK_PATH_MAX])
+{
+    struct FontDesc desc;
+
+    if (!parse_font(path, &desc))
+        return 0;
+
+    memcpy(image_path, desc.image, COOK_PATH_MAX);
+
+    return 1;
+}
+
+static int is_inside(const struct Image *sheet, uint32_t cell_x, uint32_t cell_y,
+    const struct FontDesc *desc, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= (int)(desc->cell_width * desc->scale) ||
+        y >= (int)(desc->cell_height * desc->scale))
+        return 0;
+
+    const uint8_t *texel = sheet->pixels + ((size_t)(cell_y + y / desc->scale) * sheet->width +
+        cell_x + x / desc->scale) * 4;
+
+    // Light glyphs on a dark or transparent background
+    return (texel[0] + texel[1] + texel[2]) / 3 * texel[3] / 255 >= 128;
+}
+
+/*
+ * Brute force distance to the nearest texel of the opposite state within
+ * spread, in the upscaled glyph. Cheap enough offline for bitmap font sizes.
+ */
+static uint8_t get_distance(const struct Image *sheet, uint32_t cell_x, uint32_t cell_y,
+    const struct FontDesc *desc, int x, int y)
+{
+    const int inside = is_inside(sheet, cell_x, cell_y, desc, x, y);
+    const int spread = desc->spread;
+    float nearest = (float)spread;
+
+    for (int dy = -spread; dy <= spread; ++dy)
+        for (int dx = -spread; dx <= spread; ++dx)
+            if (is_inside(sheet, cell_x, cell_y, desc, x + dx, y + dy) != inside) {
+                const float distance = sqrtf((float)(dx * dx + dy * dy));
+
+                if (distance < nearest)
+                    nearest = distance;
+            }
+
+    // The edge lies half a texel from the nearest texel of the other state
+    const float signed_distance = inside ? nearest - 0.5f : 0.5f - nearest;
+    const float value = 127.5f + signed_distance / spread * 127.5f;
+
+    return value <= 0.0f ? 0 : value >= 255.0f ? 255 : (uint8_t)(value + 0.5f);
+}
+
+void cook_font(const struct CookJob *job, struct PackWriter *writer)
+{
+    struct FontDesc desc;
+
+    if (!parse_font(job->path, &desc) || desc.cell_width == 0 || desc.cell_height == 0 ||
+        desc.count == 0 || desc.scale == 0 || desc.scale > FONT_MAX_SCALE ||
+        desc.spread == 0 || desc.spread > FONT_MAX_SPREAD) {
+        printf("Failed to parse font description at %s\n", job->path);
+        exit(-1);
+    }
+
+    struct Image sheet;
+    load_image(desc.image, &sheet);
+
+    const uint32_t sheet_columns = sheet.width / desc.cell_width;
+
+    if (sheet_columns == 0 ||
+        (desc.count + sheet_columns - 1) / sheet_columns * desc.cell_height > sheet.height)
+        print_exit("Failed to cook a font, the sheet is smaller than its cells!");
+
+    const uint32_t glyph_width = desc.cell_width * desc.scale + desc.spread * 2;
+    const uint32_t glyph_height = desc.cell_height * desc.scale + desc.spread * 2;
+    const uint32_t columns = (uint32_t)ceilf(sqrtf((float)desc.count));
+    const uint32_t rows = (desc.count + columns - 1) / columns;
+    const uint32_t width = columns * glyph_width;
+    const uint32_t height = rows * glyph_height;
+
+    if (width > UINT16_MAX || height > UINT16_MAX)
+        print_exit("Failed to cook a font, the SDF atlas is too large!");
+
+    uint8_t *pixels = calloc((size_t)width * height, 1);
+    const size_t info_size = sizeof(struct FontInfo) + desc.count * sizeof(struct Glyph);
+    uint8_t *info_data = calloc(info_size, 1);
+
+    struct FontInfo *info = (struct FontInfo *)info_data;
+    info->glyph_count = desc.count;
+    info->spread = (float)desc.spread;
+    info->line_height = desc.cell_height * desc.scale;
+
+    struct Glyph *glyphs = (struct Glyph *)(info_data + sizeof(struct FontInfo));
+
+    for (uint32_t i = 0; i < desc.count; ++i) {
+        const uint32_t cell_x = i % sheet_columns * desc.cell_width;
+        const uint32_t cell_y = i / sheet_columns * desc.cell_height;
+        const uint32_t atlas_x = i % columns * glyph_width;
+        const uint32_t atlas_y = i / columns * glyph_height;
+
+        for (uint32_t y = 0; y < glyph_height; ++y)
+            for (uint32_t x = 0; x < glyph_width; ++x)
+                pixels[(size_t)(atlas_y + y) * width + atlas_x + x] = get_distance(&sheet,
+                    cell_x, cell_y, &desc, (int)x - (int)desc.spread, (int)y - (int)desc.spread);
+
+        glyphs[i].codepoint = desc.first + i;
+        glyphs[i].x = atlas_x;
+        glyphs[i].y = atlas_y;
+        glyphs[i].width = glyph_width;
+        glyphs[i].height = glyph_height;
+        glyphs[i].advance = desc.cell_width * desc.scale;
+    }
+
+    char name[PACK_NAME_MAX + 16];
+    snprintf(name, sizeof(name), "font/%s", job->name);
+    add_texture_entry(writer, name, width, height, 1, pixels, 0, 0, 0);
+
+    struct PackEntry entry = {};
+
+    if ((size_t)snprintf(entry.name, PACK_NAME_MAX, "font/%s/glyphs", job->name) >= PACK_NAME_MAX)
+        print_exit("Failed to cook a font, name is too long!");
+
+    entry.type = PACK_ENTRY_BLOB;
+    add_pack_entry(writer, &entry, info_data, info_size);
+
+    free(info_data);
+    free(pixels);
+    destroy_image(&sheet);
+}
@@ -0,0 +1,490 @@
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#include "asset.h"
+#include "cook.h"
+#include "error.h"
+
+#define TGA_HEADER_SIZE 18u
+#define ATLAS_MAX_SIZE 8192u
+#define ATLAS_MAX_IMAGES 1024u
+// Keeps bilinear filtering of one rect from reading its neighbours
+#define ATLAS_PADDING 1u
+
+uint8_t *read_file(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    rewind(file);
+
+    uint8_t *data = malloc(*size > 0 ? *size : 1);
+
+    if (fread(data, 1, *size, file) != *size) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+
+    return data;
+}
+
+int has_extension(const char *path, const char *extension)
+{
+    const size_t length = strlen(path);
+    const size_t extlength = strlen(extension);
+
+    return length > extlength && strcmp(path + length - extlength, extension) == 0;
+}
+
+static int load_tga(const uint8_t *data, size_t size, struct Image *image)
+{
+    if (size < TGA_HEADER_SIZE || data[1] != 0 || (data[2] != 2 && data[2] != 3))
+        return 0;
+
+    const uint32_t bytes = data[16] / 8;
+    const int grey = data[2] == 3;
+
+    if ((grey && bytes != 1) || (!grey && bytes != 3 && bytes != 4))
+        return 0;
+
+    image->width = data[12] | data[13] << 8;
+    image->height = data[14] | data[15] << 8;
+
+    const size_t offset = TGA_HEADER_SIZE + data[0];
+
+    if (offset > size || (size - offset) / bytes < (size_t)image->width * image->height)
+        return 0;
+
+    image->pixels = malloc((size_t)image->width * image->height * 4);
+    // Rows are stored bottom up unless the descriptor says otherwise
+    const int top_down = data[17] & 0x20;
+
+    for (uint32_t y = 0; y < image->height; ++y) {
+        const uint32_t row = top_down ? y : image->height - 1 - y;
+        const uint8_t *src = data + offset + (size_t)row * image->width * bytes;
+        uint8_t *dst = image->pixels + (size_t)y * image->width * 4;
+
+        for (uint32_t x = 0; x < image->width; ++x, src += bytes, dst += 4) {
+            dst[0] = grey ? src[0] : src[2];
+            dst[1] = grey ? src[0] : src[1];
+            dst[2] = src[0];
+            dst[3] = bytes == 4 ? src[3] : 255;
+        }
+    }
+
+    return 1;
+}
+
+// Reads the next header number of a PPM or PGM, skipping comments
+static int read_pnm_number(const uint8_t *data, size_t size, size_t *offset, uint32_t *value)
+{
+    while (*offset < size && (data[*offset] == '#' || data[*offset] <= ' ')) {
+        if (data[*offset] == '#')
+            while (*offset < size && data[*offset] != '\n')
+                ++*offset;
+        else
+            ++*offset;
+    }
+
+    if (*offset == size || data[*offset] < '0' || data[*offset] > '9')
+        return 0;
+
+    *value = 0;
+
+    while (*offset < size && data[*offset] >= '0' && data[*offset] <= '9')
+        *value = *value * 10 + (data[(*offset)++] - '0');
+
+    return 1;
+}
+
+static int load_pnm(const uint8_t *data, size_t size, struct Image *image)
+{
+    if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+        return 0;
+
+    const uint32_t bytes = data[1] == '6' ? 3 : 1;
+    size_t offset = 2;
+    uint32_t maxval = 0;
+
+    if (!read_pnm_number(data, size, &offset, &image->width) ||
+        !read_pnm_number(data, size, &offset, &image->height) ||
+        !read_pnm_number(data, size, &offset, &maxval) || maxval != 255)
+        return 0;
+
+    // A single whitespace byte separates the header from the pixels
+    ++offset;
+
+    if (offset > size || (size - offset) / bytes < (size_t)image->width * image->height)
+        return 0;
+
+    image->pixels = malloc((size_t)image->width * image->height * 4);
+
+    const uint8_t *src = data + offset;
+
+    for (size_t i = 0; i < (size_t)image->width * image->height; ++i, src += bytes) {
+        image->pixels[i * 4 + 0] = src[0];
+        image->pixels[i * 4 + 1] = src[bytes == 3 ? 1 : 0];
+        image->pixels[i * 4 + 2] = src[bytes == 3 ? 2 : 0];
+        image->pixels[i * 4 + 3] = 255;
+    }
+
+    return 1;
+}
+
+void load_image(const char *path, struct Image *image)
+{
+    size_t size = 0;
+    uint8_t *data = read_file(path, &size);
+    int loaded = 0;
+
+    if (data != NULL)
+        loaded = has_extension(path, ".tga") ? load_tga(data, size, image) :
+            load_pnm(data, size, image);
+
+    free(data);
+
+    if (!loaded || image->width == 0 || image->height == 0) {
+        printf("Failed to load image at %s\n", path);
+        exit(-1);
+    }
+}
+
+void destroy_image(struct Image *image)
+{
+    free(image->pixels);
+}
+
+static float srgb_to_linear(uint8_t value)
+{
+    const float c = value / 255.0f;
+
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linear_to_srgb(float value)
+{
+    const float c = value <= 0.0031308f ? value * 12.92f :
+        1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+
+    return (uint8_t)(c * 255.0f + 0.5f);
+}
+
+// Box filters src into the next level, odd edges reuse the last texel
+static void downsample(const uint8_t *src, uint32_t width, uint32_t height, uint32_t channels,
+    int srgb, uint8_t *dst)
+{
+    const uint32_t dst_width = width > 1 ? width / 2 : 1;
+    const uint32_t dst_height = height > 1 ? height / 2 : 1;
+
+    for (uint32_t y = 0; y < dst_height; ++y) {
+        for (uint32_t x = 0; x < dst_width; ++x) {
+            const uint32_t x0 = x * 2 < width ? x * 2 : width - 1;
+            const uint32_t x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+            const uint32_t y0 = y * 2 < height ? y * 2 : height - 1;
+            const uint32_t y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+            const uint8_t *texels[4] = {
+                src + ((size_t)y0 * width + x0) * channels,
+                src + ((size_t)y0 * width + x1) * channels,
+                src + ((size_t)y1 * width + x0) * channels,
+                src + ((size_t)y1 * width + x1) * channels
+            };
+
+            for (uint32_t c = 0; c < channels; ++c) {
+                // Alpha and single channel data are linear already
+                const int gamma = srgb && c < 3 && channels == 4;
+                float sum = 0.0f;
+
+                for (uint32_t i = 0; i < 4; ++i)
+                    sum += gamma ? srgb_to_linear(texels[i][c]) : texels[i][c];
+
+                dst[((size_t)y * dst_width + x) * channels + c] = gamma ?
+                    linear_to_srgb(sum / 4.0f) : (uint8_t)(sum / 4.0f + 0.5f);
+            }
+        }
+    }
+}
+
+static size_t align_level(size_t offset)
+{
+    return (offset + PACK_LEVEL_ALIGNMENT - 1) / PACK_LEVEL_ALIGNMENT * PACK_LEVEL_ALIGNMENT;
+}
+
+static int has_translucency(const uint8_t *rgba, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        if (rgba[i * 4 + 3] != 255)
+            return 1;
+
+    return 0;
+}
+
+// Replaces the RGBA8 chain in *data with its BC1 or BC3 encoding, returns the format
+static VkFormat compress_chain(uint8_t **data, size_t *size, uint32_t width, uint32_t height,
+    uint32_t levels, int srgb)
+{
+    const int alpha = has_translucency(*data, (size_t)width * height);
+    size_t compressed_size = 0;
+
+    for (uint32_t i = 0; i < levels; ++i) {
+        const uint32_t level_width = width >> i > 0 ? width >> i : 1;
+        const uint32_t level_height = height >> i > 0 ? height >> i : 1;
+        compressed_size = align_level(compressed_size) +
+            get_compressed_level_size(level_width, level_height, alpha);
+    }
+
+    uint8_t *compressed = calloc(compressed_size, 1);
+    size_t src_offset = 0;
+    size_t dst_offset = 0;
+
+    for (uint32_t i = 0; i < levels; ++i) {
+        const uint32_t level_width = width >> i > 0 ? width >> i : 1;
+        const uint32_t level_height = height >> i > 0 ? height >> i : 1;
+
+        compress_level(*data + src_offset, level_width, level_height, alpha,
+            compressed + dst_offset);
+        src_offset = align_level(src_offset + (size_t)level_width * level_height * 4);
+        dst_offset = align_level(dst_offset +
+            get_compressed_level_size(level_width, level_height, alpha));
+    }
+
+    free(*data);
+    *data = compressed;
+    *size = compressed_size;
+
+    if (alpha)
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+
+    return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+}
+
+void add_texture_entry(struct PackWriter *writer, const char *name, uint32_t width,
+    uint32_t height, uint32_t channels, const uint8_t *pixels, int srgb, int mipmapped,
+    int compress)
+{
+    uint32_t levels = 1;
+
+    while (mipmapped && (width >> levels > 0 || height >> levels > 0))
+        ++levels;
+
+    size_t size = 0;
+
+    for (uint32_t i = 0; i < levels; ++i) {
+        const uint32_t level_width = width >> i > 0 ? width >> i : 1;
+        const uint32_t level_height = height >> i > 0 ? height >> i : 1;
+        size = align_level(size) + (size_t)level_width * level_height * channels;
+    }
+
+    uint8_t *data = calloc(size, 1);
+    memcpy(data, pixels, (size_t)width * height * channels);
+
+    size_t offset = 0;
+
+    for (uint32_t i = 1; i < levels; ++i) {
+        const uint32_t level_width = width >> (i - 1) > 0 ? width >> (i - 1) : 1;
+        const uint32_t level_height = height >> (i - 1) > 0 ? height >> (i - 1) : 1;
+        const size_t next = align_level(offset + (size_t)level_width * level_height * channels);
+
+        downsample(data + offset, level_width, level_height, channels, srgb, data + next);
+        offset = next;
+    }
+
+    struct PackEntry entry = {};
+    snprintf(entry.name, PACK_NAME_MAX, "%s", name);
+    entry.type = PACK_ENTRY_TEXTURE;
+    entry.format = channels == 1 ? VK_FORMAT_R8_UNORM :
+        srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+
+    if (compress && channels == 4)
+        entry.format = compress_chain(&data, &size, width, height, levels, srgb);
+
+    entry.width = width;
+    entry.height = height;
+    entry.levels = levels;
+
+    add_pack_entry(writer, &entry, data, size);
+    free(data);
+}
+
+void cook_texture(const struct CookJob *job, struct PackWriter *writer)
+{
+    if (has_extension(job->path, ".ktx2")) {
+        cook_ktx2(job, writer);
+        return;
+    }
+
+    struct Image image;
+    load_image(job->path, &image);
+
+    char name[PACK_NAME_MAX + 16];
+    snprintf(name, sizeof(name), "texture/%s", job->name);
+
+    add_texture_entry(writer, name, image.width, image.height, 4, image.pixels, 1, 1,
+        job->compress);
+    destroy_image(&image);
+}
+
+static int is_image(const char *path)
+{
+    return has_extension(path, ".tga") || has_extension(path, ".ppm") ||
+        has_extension(path, ".pgm");
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+struct AtlasItem {
+    uint32_t height;
+    uint32_t index;
+};
+
+// Tallest first, ties keep name order so the layout is deterministic
+static int compare_items(const void *a, const void *b)
+{
+    const struct AtlasItem *left = a;
+    const struct AtlasItem *right = b;
+
+    if (left->height != right->height)
+        return left->height > right->height ? -1 : 1;
+
+    return left->index < right->index ? -1 : left->index > right->index;
+}
+
+// Shelf packs images sorted by height, returns the atlas height or 0 when width is too narrow
+static uint32_t pack_shelves(const struct Image *images, const struct AtlasItem *order,
+    uint32_t count, uint32_t width, struct AtlasRect *rects)
+{
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t shelf = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t index = order[i].index;
+        const struct Image *image = &images[index];
+
+        if (image->width + ATLAS_PADDING * 2 > width)
+            return 0;
+
+        if (x + image->width + ATLAS_PADDING * 2 > width) {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+
+        rects[index].x = x + ATLAS_PADDING;
+        rects[index].y = y + ATLAS_PADDING;
+        rects[index].width = image->width;
+        rects[index].height = image->height;
+
+        x += image->width + ATLAS_PADDING * 2;
+
+        if (image->height + ATLAS_PADDING * 2 > shelf)
+            shelf = image->height + ATLAS_PADDING * 2;
+    }
+
+    return y + shelf;
+}
+
+void cook_atlas(const struct CookJob *job, struct PackWriter *writer)
+{
+    DIR *dir = opendir(job->path);
+
+    if (dir == NULL) {
+        printf("Failed to open atlas directory at %s\n", job->path);
+        exit(-1);
+    }
+
+    char *files[ATLAS_MAX_IMAGES];
+    uint32_t count = 0;
+
+    for (struct dirent *ent = readdir(dir); ent != NULL; ent = readdir(dir)) {
+        if (!is_image(ent->d_name))
+            continue;
+
+        if (count == ATLAS_MAX_IMAGES)
+            print_exit("Failed to cook an atlas, too many images!");
+
+        files[count++] = strdup(ent->d_name);
+    }
+
+    closedir(dir);
+    qsort(files, count, sizeof(char *), &compare_names);
+
+    struct Image *images = malloc((count > 0 ? count : 1) * sizeof(struct Image));
+    struct AtlasRect *rects = calloc(count > 0 ? count : 1, sizeof(struct AtlasRect));
+    struct AtlasItem *order = malloc((count > 0 ? count : 1) * sizeof(struct AtlasItem));
+
+    for (uint32_t i = 0; i < count; ++i) {
+        char path[COOK_PATH_MAX * 2];
+        snprintf(path, sizeof(path), "%s/%s", job->path, files[i]);
+        load_image(path, &images[i]);
+
+        const size_t stem = strrchr(files[i], '.') - files[i];
+
+        if (stem >= ATLAS_NAME_MAX) {
+            printf("Failed to cook an atlas, image name %s is too long\n", files[i]);
+            exit(-1);
+        }
+
+        memcpy(rects[i].name, files[i], stem);
+        order[i].height = images[i].height;
+        order[i].index = i;
+    }
+
+    qsort(order, count, sizeof(struct AtlasItem), &compare_items);
+
+    // The narrowest power of two that fits keeps the atlas close to square
+    uint32_t width = 64;
+    uint32_t height = 0;
+
+    for (; width <= ATLAS_MAX_SIZE; width *= 2) {
+        height = pack_shelves(images, order, count, width, rects);
+
+        if (height != 0 && height <= width)
+            break;
+    }
+
+    if (width > ATLAS_MAX_SIZE || height == 0 || height > ATLAS_MAX_SIZE)
+        print_exit("Failed to cook an atlas, images do not fit!");
+
+    uint8_t *pixels = calloc((size_t)width * height, 4);
+
+    for (uint32_t i = 0; i < count; ++i)
+        for (uint32_t y = 0; y < images[i].height; ++y)
+            memcpy(pixels + ((size_t)(rects[i].y + y) * width + rects[i].x) * 4,
+                images[i].pixels + (size_t)y * images[i].width * 4, images[i].width * 4);
+
+    char name[PACK_NAME_MAX + 16];
+    snprintf(name, sizeof(name), "atlas/%s", job->name);
+    // Mip levels would blend neighbouring rects, atlases are sampled at one scale
+    add_texture_entry(writer, name, width, height, 4, pixels, 1, 0, job->compress);
+
+    struct PackEntry entry = {};
+
+    if ((size_t)snprintf(entry.name, PACK_NAME_MAX, "atlas/%s/rects", job->name) >= PACK_NAME_MAX)
+        print_exit("Failed to cook an atlas, name is too long!");
+
+    entry.type = PACK_ENTRY_BLOB;
+    add_pack_entry(writer, &entry, rects, count * sizeof(struct AtlasRect));
+
+    for (uint32_t i = 0; i < count; ++i) {
+        destroy_image(&images[i]);
+        free(files[i]);
+    }
+
+    free(pixels);
+    free(order);
+    free(rects);
+    free(images);
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cook.h"
+#include "error.h"
+
+#define KTX2_HEADER_SIZE 80u
+#define KTX2_LEVEL_INDEX_SIZE 24u
+#define KTX2_MAX_LEVELS 16u
+
+static const uint8_t KTX2_IDENTIFIER[12] = {
+    0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a
+};
+
+static uint32_t read_u32(const uint8_t *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+static uint64_t read_u64(const uint8_t *data)
+{
+    return read_u32(data) | (uint64_t)read_u32(data + 4) << 32;
+}
+
+static void fail(const char *path, const char *reason)
+{
+    printf("Failed to cook %s, %s\n", path, reason);
+    exit(-1);
+}
+
+/*
+ * The pack keeps levels largest first at PACK_LEVEL_ALIGNMENT, KTX2 stores
+ * them smallest first, so levels are copied one by one. Basis and zstd
+ * supercompressed files would need a transcoder and are rejected.
+ */
+void cook_ktx2(const struct CookJob *job, struct PackWriter *writer)
+{
+    size_t size = 0;
+    uint8_t *data = read_file(job->path, &size);
+
+    if (data == NULL || size < KTX2_HEADER_SIZE ||
+        memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        fail(job->path, "it is not a KTX2 file");
+
+    const uint32_t format = read_u32(data + 12);
+    const uint32_t width = read_u32(data + 20);
+    const uint32_t height = read_u32(data + 24);
+    const uint32_t depth = read_u32(data + 28);
+    const uint32_t layers = read_u32(data + 32);
+    const uint32_t faces = read_u32(data + 36);
+    const uint32_t levels = read_u32(data + 40) > 0 ? read_u32(data + 40) : 1;
+    const uint32_t supercompression = read_u32(data + 44);
+
+    if (format == 0 || supercompression != 0)
+        fail(job->path, "supercompressed KTX2 files are not supported");
+    if (width == 0 || height == 0 || depth > 1 || layers > 1 || faces != 1)
+        fail(job->path, "only single 2D textures are supported");
+    if (levels > KTX2_MAX_LEVELS ||
+        KTX2_HEADER_SIZE + (size_t)levels * KTX2_LEVEL_INDEX_SIZE > size)
+        fail(job->path, "its level index is invalid");
+
+    size_t total = 0;
+
+    for (uint32_t i = 0; i < levels; ++i) {
+        const uint8_t *index = data + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_SIZE;
+        const uint64_t offset = read_u64(index);
+        const uint64_t length = read_u64(index + 8);
+
+        if (offset > size || length > size - offset)
+            fail(job->path, "a level lies outside the file");
+
+        total = (total + PACK_LEVEL_ALIGNMENT - 1) / PACK_LEVEL_ALIGNMENT *
+            PACK_LEVEL_ALIGNMENT + length;
+    }
+
+    uint8_t *payload = calloc(total > 0 ? total : 1, 1);
+    size_t payload_offset = 0;
+
+    for (uint32_t i = 0; i < levels; ++i) {
+        const uint8_t *index = data + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_SIZE;
+        const uint64_t length = read_u64(index + 8);
+
+        payload_offset = (payload_offset + PACK_LEVEL_ALIGNMENT - 1) / PACK_LEVEL_ALIGNMENT *
+            PACK_LEVEL_ALIGNMENT;
+        memcpy(payload + payload_offset, data + read_u64(index), length);
+        payload_offset += length;
+    }
+
+    struct PackEntry entry = {};
+
+    if ((size_t)snprintf(entry.name, PACK_NAME_MAX, "texture/%s", job->name) >= PACK_NAME_MAX)
+        print_exit("Failed to cook a KTX2 texture, name is too long!");
+
+    entry.type = PACK_ENTRY_TEXTURE;
+    entry.format = format;
+    entry.width = width;
+    entry.height = height;
+    entry.levels = levels;
+
+    add_pack_entry(writer, &entry, payload, total);
+    free(payload);
+    free(data);
+}
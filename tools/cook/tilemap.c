@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asset.h"
+#include "cook.h"
+#include "error.h"
+
+/*
+ * Rows of comma separated tile indices, -1 marks an empty tile. Every row
+ * must have the same number of columns.
+ */
+void cook_tilemap(const struct CookJob *job, struct PackWriter *writer)
+{
+    size_t size = 0;
+    char *text = (char *)read_file(job->path, &size);
+
+    if (text == NULL) {
+        printf("Failed to read tilemap at %s\n", job->path);
+        exit(-1);
+    }
+
+    // One tile per byte is the upper bound, header included
+    uint8_t *data = malloc(sizeof(struct TilemapHeader) + (size + 1) * sizeof(uint16_t));
+    struct TilemapHeader *header = (struct TilemapHeader *)data;
+    uint16_t *tiles = (uint16_t *)(data + sizeof(struct TilemapHeader));
+    header->width = 0;
+    header->height = 0;
+
+    uint32_t count = 0;
+    uint32_t columns = 0;
+    size_t i = 0;
+
+    while (i < size) {
+        if (text[i] == '\n' && columns > 0) {
+            if (header->width == 0)
+                header->width = columns;
+            else if (columns != header->width)
+                print_exit("Failed to cook a tilemap, rows differ in length!");
+
+            ++header->height;
+            columns = 0;
+        }
+
+        // Blank lines and whitespace around values separate nothing
+        if (text[i] == '\n' || text[i] == '\r' || text[i] == ' ' || text[i] == '\t' ||
+            text[i] == ',') {
+            ++i;
+            continue;
+        }
+
+        char *end = NULL;
+        const long value = strtol(text + i, &end, 10);
+
+        if (end == text + i) {
+            printf("Failed to parse tilemap at %s\n", job->path);
+            exit(-1);
+        }
+
+        if (value < -1 || value >= TILEMAP_EMPTY)
+            print_exit("Failed to cook a tilemap, tile index is out of range!");
+
+        tiles[count++] = value < 0 ? TILEMAP_EMPTY : (uint16_t)value;
+        ++columns;
+        i = end - text;
+    }
+
+    if (columns > 0) {
+        if (header->width != 0 && columns != header->width)
+            print_exit("Failed to cook a tilemap, rows differ in length!");
+
+        header->width = columns;
+        ++header->height;
+    }
+
+    struct PackEntry entry = {};
+
+    if ((size_t)snprintf(entry.name, PACK_NAME_MAX, "tilemap/%s", job->name) >= PACK_NAME_MAX)
+        print_exit("Failed to cook a tilemap, name is too long!");
+
+    entry.type = PACK_ENTRY_BLOB;
+    entry.width = header->width;
+    entry.height = header->height;
+    add_pack_entry(writer, &entry, data, sizeof(struct TilemapHeader) + count * sizeof(uint16_t));
+
+    free(data);
+    free(text);
+}